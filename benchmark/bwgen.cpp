@@ -0,0 +1,626 @@
+/**
+ * @file bwgen.cpp
+ * @brief Memory bandwidth generator
+ *
+ * Streams over a private buffer per thread with load, store or
+ * non-temporal store kernels in SSE2, AVX2 or AVX-512. The widest
+ * kernel the CPU supports is picked at run time from CPUID, so one
+ * binary serves all machines. Without a target rate every thread runs
+ * flat out; with -R each thread is paced to its share of the target so
+ * a calibrated amount of interference can be generated for MBM and MBA
+ * experiments, e.g.
+ *     pqos -a "llc:2=4-7" -e "llc:2=0xff0"
+ *     ./bwgen -k nt -t 4 -c 4-7 -R 10 -d 30
+ * Achieved GB/s of every thread is printed as CSV once per interval
+ * and for the whole run at the end.
+ * @version 0.1
+ * @date 2026-10-19
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <csignal>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BWGEN_X86 1
+#endif
+using namespace std;
+
+#define LINE_SIZE 64
+
+enum Kernel { LOAD, STORE, NT };
+enum Isa { SCALAR, SSE2, AVX2, AVX512 };
+
+static const char *kernelNames[] = {"load", "store", "nt"};
+static const char *isaNames[] = {"scalar", "sse2", "avx2", "avx512"};
+
+/**
+ * @brief Benchmark parameters
+ */
+struct Config
+{
+    Kernel kernel = LOAD;
+    int isa = -1;                 // -1 = widest supported
+    unsigned threads = 1;
+    vector<int> cpus;             // cores to pin threads to
+    size_t bytes = 0;             // buffer per thread, 0 = 4 x LLC / threads
+    size_t chunk = 64 << 10;      // bytes between pacing checks
+    double rate = 0.0;            // target GB/s over all threads, 0 = max
+    double duration = 10.0;       // seconds, 0 = until interrupted
+    double interval = 1.0;        // seconds between reports, 0 = final only
+    string tag;                   // label copied to every record
+};
+
+static volatile sig_atomic_t stopFlag = 0;
+
+/**
+ * @brief SIGINT/SIGTERM handler, ends the run
+ */
+static void onSignal(int)
+{
+    stopFlag = 1;
+}
+
+typedef uint64_t (*KernelFn)(char *buf, size_t bytes);
+
+/**
+ * Kernels make one pass over bytes of buf, a multiple of LINE_SIZE
+ * aligned to LINE_SIZE. Loads are folded into the return value so they
+ * are not optimized out.
+ */
+static uint64_t loadScalar(char *buf, size_t bytes)
+{
+    const volatile uint64_t *p = (const uint64_t *)buf;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i += 8)
+        sum += p[i] ^ p[i + 1] ^ p[i + 2] ^ p[i + 3] ^
+               p[i + 4] ^ p[i + 5] ^ p[i + 6] ^ p[i + 7];
+    return sum;
+}
+
+static uint64_t storeScalar(char *buf, size_t bytes)
+{
+    volatile uint64_t *p = (uint64_t *)buf;
+    for (size_t i = 0; i < bytes / sizeof(uint64_t); i++)
+        p[i] = i;
+    return 0;
+}
+
+#ifdef BWGEN_X86
+static uint64_t loadSse2(char *buf, size_t bytes)
+{
+    __m128i a = _mm_setzero_si128(), b = _mm_setzero_si128();
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        const __m128i *p = (const __m128i *)(buf + i);
+        a = _mm_xor_si128(a, _mm_load_si128(p));
+        b = _mm_xor_si128(b, _mm_load_si128(p + 1));
+        a = _mm_xor_si128(a, _mm_load_si128(p + 2));
+        b = _mm_xor_si128(b, _mm_load_si128(p + 3));
+    }
+    return (uint64_t)_mm_cvtsi128_si64(_mm_xor_si128(a, b));
+}
+
+static uint64_t storeSse2(char *buf, size_t bytes)
+{
+    const __m128i v = _mm_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        __m128i *p = (__m128i *)(buf + i);
+        _mm_store_si128(p, v);
+        _mm_store_si128(p + 1, v);
+        _mm_store_si128(p + 2, v);
+        _mm_store_si128(p + 3, v);
+    }
+    return 0;
+}
+
+static uint64_t ntSse2(char *buf, size_t bytes)
+{
+    const __m128i v = _mm_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        __m128i *p = (__m128i *)(buf + i);
+        _mm_stream_si128(p, v);
+        _mm_stream_si128(p + 1, v);
+        _mm_stream_si128(p + 2, v);
+        _mm_stream_si128(p + 3, v);
+    }
+    _mm_sfence();
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static uint64_t loadAvx2(char *buf, size_t bytes)
+{
+    __m256i a = _mm256_setzero_si256(), b = _mm256_setzero_si256();
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        const __m256i *p = (const __m256i *)(buf + i);
+        a = _mm256_xor_si256(a, _mm256_load_si256(p));
+        b = _mm256_xor_si256(b, _mm256_load_si256(p + 1));
+    }
+    return (uint64_t)_mm256_extract_epi64(_mm256_xor_si256(a, b), 0);
+}
+
+__attribute__((target("avx2")))
+static uint64_t storeAvx2(char *buf, size_t bytes)
+{
+    const __m256i v = _mm256_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        __m256i *p = (__m256i *)(buf + i);
+        _mm256_store_si256(p, v);
+        _mm256_store_si256(p + 1, v);
+    }
+    return 0;
+}
+
+__attribute__((target("avx2")))
+static uint64_t ntAvx2(char *buf, size_t bytes)
+{
+    const __m256i v = _mm256_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+    {
+        __m256i *p = (__m256i *)(buf + i);
+        _mm256_stream_si256(p, v);
+        _mm256_stream_si256(p + 1, v);
+    }
+    _mm_sfence();
+    return 0;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t loadAvx512(char *buf, size_t bytes)
+{
+    __m512i a = _mm512_setzero_si512(), b = _mm512_setzero_si512();
+    size_t i = 0;
+    for (; i + 2 * LINE_SIZE <= bytes; i += 2 * LINE_SIZE)
+    {
+        a = _mm512_xor_si512(a, _mm512_load_si512(buf + i));
+        b = _mm512_xor_si512(b, _mm512_load_si512(buf + i + LINE_SIZE));
+    }
+    for (; i < bytes; i += LINE_SIZE)
+        a = _mm512_xor_si512(a, _mm512_load_si512(buf + i));
+    return (uint64_t)_mm512_reduce_add_epi64(_mm512_xor_si512(a, b));
+}
+
+__attribute__((target("avx512f")))
+static uint64_t storeAvx512(char *buf, size_t bytes)
+{
+    const __m512i v = _mm512_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+        _mm512_store_si512(buf + i, v);
+    return 0;
+}
+
+__attribute__((target("avx512f")))
+static uint64_t ntAvx512(char *buf, size_t bytes)
+{
+    const __m512i v = _mm512_set1_epi32(1);
+    for (size_t i = 0; i < bytes; i += LINE_SIZE)
+        _mm512_stream_si512((__m512i *)(buf + i), v);
+    _mm_sfence();
+    return 0;
+}
+#endif
+
+/**
+ * @brief Kernel table indexed by [isa][kernel], NULL if not available
+ */
+static const KernelFn kernels[4][3] = {
+    {loadScalar, storeScalar, NULL},
+#ifdef BWGEN_X86
+    {loadSse2, storeSse2, ntSse2},
+    {loadAvx2, storeAvx2, ntAvx2},
+    {loadAvx512, storeAvx512, ntAvx512},
+#else
+    {NULL, NULL, NULL},
+    {NULL, NULL, NULL},
+    {NULL, NULL, NULL},
+#endif
+};
+
+/**
+ * @brief Checks CPU and OS support of isa
+ *
+ * __builtin_cpu_supports() reads CPUID and also checks with XGETBV that
+ * the OS saves the wider register state.
+ */
+static bool isaSupported(int isa)
+{
+    switch (isa)
+    {
+    case SCALAR:
+        return true;
+#ifdef BWGEN_X86
+    case SSE2:
+        return __builtin_cpu_supports("sse2");
+    case AVX2:
+        return __builtin_cpu_supports("avx2");
+    case AVX512:
+        return __builtin_cpu_supports("avx512f");
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Returns LLC size in bytes, 32MB if not known
+ */
+static size_t llcSize()
+{
+    long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return size > 0 ? (size_t)size : (size_t)32 << 20;
+}
+
+/**
+ * @brief Parses size with optional k, m or g suffix
+ */
+static bool parseSize(const char *str, size_t &val)
+{
+    char *end = NULL;
+    unsigned long long v = strtoull(str, &end, 0);
+    if (end == str)
+        return false;
+    switch (*end)
+    {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    }
+    if (*end != '\0')
+        return false;
+    val = (size_t)v;
+    return true;
+}
+
+/**
+ * @brief Parses list of cores e.g. "0,2,4-7"
+ */
+static bool parseCpus(const char *str, vector<int> &cpus)
+{
+    string s(str);
+    size_t pos = 0;
+    while (pos <= s.size())
+    {
+        size_t comma = s.find(',', pos);
+        string tok = s.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        int first, last;
+        char dash;
+        int n = sscanf(tok.c_str(), "%d%c%d", &first, &dash, &last);
+        if (n == 1)
+            last = first;
+        else if (n != 3 || dash != '-')
+            return false;
+        if (first < 0 || last < first)
+            return false;
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+        if (comma == string::npos)
+            break;
+        pos = comma + 1;
+    }
+    return !cpus.empty();
+}
+
+/**
+ * @brief Pins calling thread to cpu
+ */
+static void pinThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        cerr << "Cannot pin thread to core " << cpu << endl;
+}
+
+/**
+ * @brief Per thread state, padded so counters do not share a line
+ */
+struct alignas(LINE_SIZE) Worker
+{
+    char *buf = NULL;
+    int cpu = -1;
+    atomic<uint64_t> bytes{0};    // bytes moved so far
+    uint64_t sink = 0;
+};
+
+/**
+ * @brief Streams over the worker buffer until stop is set
+ *
+ * With a target rate the thread checks after every chunk whether it is
+ * ahead of bytes = rate x elapsed and if so waits for the schedule to
+ * catch up: sleeps for gaps of 200us and more, spins on pause below
+ * that so short chunks do not overshoot by a timer slack each.
+ */
+static void runWorker(const Config &cfg, KernelFn fn, Worker &w, double rate,
+                      const atomic<bool> &stop)
+{
+    typedef chrono::steady_clock clock;
+    const size_t chunk = min(cfg.chunk, cfg.bytes);
+    const clock::time_point t0 = clock::now();
+    uint64_t done = 0;
+    size_t off = 0;
+
+    if (w.cpu >= 0)
+        pinThread(w.cpu);
+
+    while (!stop.load(memory_order_relaxed))
+    {
+        size_t n = min(chunk, cfg.bytes - off);
+        w.sink += fn(w.buf + off, n);
+        off = (off + n == cfg.bytes) ? 0 : off + n;
+        done += n;
+        w.bytes.store(done, memory_order_relaxed);
+
+        if (rate <= 0.0)
+            continue;
+        for (;;)
+        {
+            double ahead = done / rate -
+                           chrono::duration<double, nano>(clock::now() - t0).count();
+            if (ahead <= 0.0 || stop.load(memory_order_relaxed))
+                break;
+            if (ahead >= 200e3)
+            {
+                struct timespec ts;
+                ts.tv_sec = (time_t)(ahead / 1e9);
+                ts.tv_nsec = (long)(ahead - ts.tv_sec * 1e9);
+                nanosleep(&ts, NULL);
+            }
+#ifdef BWGEN_X86
+            else
+                _mm_pause();
+#endif
+        }
+    }
+}
+
+/**
+ * @brief Prints one CSV record per thread and one for all threads
+ *
+ * @param period "interval" or "run"
+ * @param cur bytes per thread now
+ * @param prev bytes per thread at the start of the period
+ * @param sec length of the period
+ */
+static void report(const Config &cfg, const char *isa, const char *period, double t,
+                   const vector<uint64_t> &cur, const vector<uint64_t> &prev,
+                   double sec, const vector<Worker> &workers)
+{
+    double total = 0.0;
+    for (size_t i = 0; i < cur.size(); i++)
+    {
+        double gbps = (cur[i] - prev[i]) / sec / 1e9;
+        total += gbps;
+        printf("%s,%s,%s,%s,%.3f,%zu,%d,%.3f,%.3f\n", cfg.tag.c_str(),
+               kernelNames[cfg.kernel], isa, period, t, i, workers[i].cpu,
+               cfg.rate / cfg.threads, gbps);
+    }
+    printf("%s,%s,%s,%s,%.3f,all,-1,%.3f,%.3f\n", cfg.tag.c_str(),
+           kernelNames[cfg.kernel], isa, period, t, cfg.rate, total);
+    fflush(stdout);
+}
+
+/**
+ * @brief Prints help
+ */
+static void printHelp(const char *name)
+{
+    cout << "Usage: " << name << " [options]\n"
+         << "  -k, --kernel load|store|nt       kernel, nt is non-temporal store (default load)\n"
+         << "  -I, --isa scalar|sse2|avx2|avx512  instruction set (default widest supported)\n"
+         << "  -t, --threads <n>                threads (default 1)\n"
+         << "  -c, --cpus <list>                cores to pin threads to, e.g. 0,2,4-7\n"
+         << "  -s, --size <size>                buffer per thread (default 4 x LLC / threads)\n"
+         << "  -b, --chunk <size>               bytes between rate checks (default 64k)\n"
+         << "  -R, --rate <GB/s>                target rate over all threads (default max)\n"
+         << "  -d, --duration <sec>             run time, 0 until interrupted (default 10)\n"
+         << "  -i, --interval <sec>             report interval, 0 final only (default 1)\n"
+         << "  -T, --tag <text>                 label of every record, e.g. COS name\n"
+         << "Records: tag,kernel,isa,period,time_s,thread,cpu,target_gb_per_s,gb_per_s\n"
+         << "period is interval or run, time_s is the end of the period.\n";
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longOpts[] = {
+        {"kernel", required_argument, NULL, 'k'},
+        {"isa", required_argument, NULL, 'I'},
+        {"threads", required_argument, NULL, 't'},
+        {"cpus", required_argument, NULL, 'c'},
+        {"size", required_argument, NULL, 's'},
+        {"chunk", required_argument, NULL, 'b'},
+        {"rate", required_argument, NULL, 'R'},
+        {"duration", required_argument, NULL, 'd'},
+        {"interval", required_argument, NULL, 'i'},
+        {"tag", required_argument, NULL, 'T'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    Config cfg;
+    int opt;
+    bool ok = true;
+
+    while (ok && (opt = getopt_long(argc, argv, "k:I:t:c:s:b:R:d:i:T:h", longOpts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'k':
+            if (!strcmp(optarg, "load"))
+                cfg.kernel = LOAD;
+            else if (!strcmp(optarg, "store"))
+                cfg.kernel = STORE;
+            else if (!strcmp(optarg, "nt"))
+                cfg.kernel = NT;
+            else
+                ok = false;
+            break;
+        case 'I':
+            cfg.isa = -1;
+            for (int i = 0; i < 4; i++)
+                if (!strcmp(optarg, isaNames[i]))
+                    cfg.isa = i;
+            ok = cfg.isa >= 0;
+            break;
+        case 't':
+            cfg.threads = atoi(optarg);
+            ok = cfg.threads > 0;
+            break;
+        case 'c':
+            ok = parseCpus(optarg, cfg.cpus);
+            break;
+        case 's':
+            ok = parseSize(optarg, cfg.bytes) && cfg.bytes >= LINE_SIZE;
+            break;
+        case 'b':
+            ok = parseSize(optarg, cfg.chunk) && cfg.chunk >= LINE_SIZE;
+            break;
+        case 'R':
+            cfg.rate = atof(optarg);
+            ok = cfg.rate > 0;
+            break;
+        case 'd':
+            cfg.duration = atof(optarg);
+            ok = cfg.duration >= 0;
+            break;
+        case 'i':
+            cfg.interval = atof(optarg);
+            ok = cfg.interval >= 0;
+            break;
+        case 'T':
+            cfg.tag = optarg;
+            break;
+        case 'h':
+            printHelp(argv[0]);
+            return 0;
+        default:
+            ok = false;
+        }
+    }
+    if (!ok || optind < argc)
+    {
+        printHelp(argv[0]);
+        return 1;
+    }
+
+    // pick the widest kernel the CPU has unless one was forced
+    if (cfg.isa < 0)
+    {
+        for (int i = 3; i >= 0 && cfg.isa < 0; i--)
+            if (isaSupported(i) && kernels[i][cfg.kernel] != NULL)
+                cfg.isa = i;
+    }
+    if (cfg.isa < 0 || !isaSupported(cfg.isa) || kernels[cfg.isa][cfg.kernel] == NULL)
+    {
+        cerr << "Kernel " << kernelNames[cfg.kernel] << " is not available"
+             << (cfg.isa >= 0 ? string(" with ") + isaNames[cfg.isa] : string())
+             << " on this CPU" << endl;
+        return 1;
+    }
+    const KernelFn fn = kernels[cfg.isa][cfg.kernel];
+
+    if (cfg.bytes == 0)
+        cfg.bytes = max<size_t>(4 * llcSize() / cfg.threads, 1 << 20);
+    cfg.bytes = cfg.bytes / LINE_SIZE * LINE_SIZE;
+    cfg.chunk = cfg.chunk / LINE_SIZE * LINE_SIZE;
+
+    vector<Worker> workers(cfg.threads);
+    for (unsigned t = 0; t < cfg.threads; t++)
+    {
+        void *p = NULL;
+        if (posix_memalign(&p, 2 << 20, cfg.bytes) != 0)
+        {
+            cerr << "Cannot allocate " << cfg.bytes << " bytes" << endl;
+            return 1;
+        }
+        memset(p, 1, cfg.bytes);
+        workers[t].buf = (char *)p;
+        if (!cfg.cpus.empty())
+            workers[t].cpu = cfg.cpus[t % cfg.cpus.size()];
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    printf("tag,kernel,isa,period,time_s,thread,cpu,target_gb_per_s,gb_per_s\n");
+
+    typedef chrono::steady_clock clock;
+    atomic<bool> stop(false);
+    const double rate = cfg.rate / cfg.threads;     // bytes per ns per thread
+    vector<uint64_t> first(cfg.threads, 0), prev(cfg.threads, 0), cur(cfg.threads);
+    vector<thread> threads;
+    const clock::time_point t0 = clock::now();
+    clock::time_point last = t0;
+
+    for (unsigned t = 0; t < cfg.threads; t++)
+        threads.emplace_back(runWorker, cref(cfg), fn, ref(workers[t]), rate, cref(stop));
+
+    // report every interval until the duration is over or a signal arrives
+    double nextReport = cfg.interval;
+    while (!stopFlag)
+    {
+        double now = chrono::duration<double>(clock::now() - t0).count();
+        if (cfg.duration > 0 && now >= cfg.duration)
+            break;
+        if (cfg.interval > 0 && now >= nextReport)
+        {
+            clock::time_point t = clock::now();
+            for (unsigned i = 0; i < cfg.threads; i++)
+                cur[i] = workers[i].bytes.load(memory_order_relaxed);
+            report(cfg, isaNames[cfg.isa], "interval", chrono::duration<double>(t - t0).count(),
+                   cur, prev, chrono::duration<double>(t - last).count(), workers);
+            prev = cur;
+            last = t;
+            nextReport += cfg.interval;
+            continue;
+        }
+        double wait = 0.1;
+        if (cfg.duration > 0)
+            wait = min(wait, cfg.duration - now);
+        if (cfg.interval > 0)
+            wait = min(wait, nextReport - now);
+        struct timespec ts;
+        ts.tv_sec = (time_t)wait;
+        ts.tv_nsec = (long)((wait - ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+
+    clock::time_point t1 = clock::now();
+    for (unsigned i = 0; i < cfg.threads; i++)
+        cur[i] = workers[i].bytes.load(memory_order_relaxed);
+    stop.store(true);
+    for (thread &th : threads)
+        th.join();
+
+    double sec = chrono::duration<double>(t1 - t0).count();
+    report(cfg, isaNames[cfg.isa], "run", sec, cur, first, sec, workers);
+
+    uint64_t sink = 0;
+    for (Worker &w : workers)
+    {
+        sink += w.sink;
+        free(w.buf);
+    }
+    return sink == 42 ? 2 : 0;
+}
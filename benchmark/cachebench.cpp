@@ -0,0 +1,558 @@
+/**
+ * @file cachebench.cpp
+ * @brief Working set sweep benchmark
+ *
+ * Sweeps the working set from L1 size to several times the LLC with a
+ * selectable access pattern (sequential, strided, random) and operation
+ * (read, read-write, write) on one or more threads, timed with rdtsc.
+ * One CSV or JSON line is printed per working set size so the curves
+ * can be compared between classes of service, e.g.
+ *     pqos -a "llc:1=0-3" -e "llc:1=0x3"
+ *     taskset -c 0-3 ./cachebench -t 4 -c 0-3 -T cos1 > cos1.csv
+ * @version 0.1
+ * @date 2026-10-19
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <getopt.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include "tsc.h"
+using namespace std;
+
+#define LINE_SIZE 64
+#define WORD_SIZE sizeof(uint64_t)
+
+enum Pattern { SEQ, STRIDE, RANDOM };
+enum Op { READ, RW, WRITE };
+
+static const char *patternNames[] = {"seq", "stride", "random"};
+static const char *opNames[] = {"read", "rw", "write"};
+
+/**
+ * @brief Benchmark parameters
+ */
+struct Config
+{
+    size_t minWs = 4096;          // smallest working set, bytes
+    size_t maxWs = 0;             // largest working set, 0 = 4 x LLC
+    unsigned steps = 4;           // points per doubling of working set
+    Pattern pattern = SEQ;
+    Op op = READ;
+    size_t stride = 256;          // bytes between accesses for STRIDE
+    unsigned threads = 1;
+    vector<int> cpus;             // cores to pin threads to
+    double minTime = 0.05;        // seconds per measurement
+    unsigned reps = 3;            // measurements per point, best is kept
+    bool json = false;
+    string tag;                   // label copied to every record
+    unsigned seed = 1;
+};
+
+/**
+ * @brief Calibrates time stamp counter against CLOCK_MONOTONIC
+ *
+ * @return TSC ticks per nanosecond
+ */
+static double tscPerNs()
+{
+    tsc_clock clk;
+    if (tsc_init(&clk, 100) != TSC_RETVAL_OK)
+    {
+        cerr << "TSC calibration failed" << endl;
+        exit(1);
+    }
+    if (!clk.invariant)
+        cerr << "TSC is not invariant, cycles follow frequency changes" << endl;
+    return clk.hz / 1e9;
+}
+
+/**
+ * @brief Returns LLC size in bytes, 32MB if not known
+ */
+static size_t llcSize()
+{
+    long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (size <= 0)
+        size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    return size > 0 ? (size_t)size : (size_t)32 << 20;
+}
+
+/**
+ * @brief Parses size with optional k, m or g suffix
+ */
+static bool parseSize(const char *str, size_t &val)
+{
+    char *end = NULL;
+    unsigned long long v = strtoull(str, &end, 0);
+    if (end == str)
+        return false;
+    switch (*end)
+    {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    }
+    if (*end != '\0')
+        return false;
+    val = (size_t)v;
+    return true;
+}
+
+/**
+ * @brief Parses list of cores e.g. "0,2,4-7"
+ */
+static bool parseCpus(const char *str, vector<int> &cpus)
+{
+    string s(str);
+    size_t pos = 0;
+    while (pos <= s.size())
+    {
+        size_t comma = s.find(',', pos);
+        string tok = s.substr(pos, comma == string::npos ? string::npos : comma - pos);
+        int first, last;
+        char dash;
+        int n = sscanf(tok.c_str(), "%d%c%d", &first, &dash, &last);
+        if (n == 1)
+            last = first;
+        else if (n != 3 || dash != '-')
+            return false;
+        if (first < 0 || last < first)
+            return false;
+        for (int c = first; c <= last; c++)
+            cpus.push_back(c);
+        if (comma == string::npos)
+            break;
+        pos = comma + 1;
+    }
+    return !cpus.empty();
+}
+
+/**
+ * @brief Compiler barrier, keeps passes from being merged or hoisted
+ */
+static inline void clobberMemory()
+{
+    asm volatile("" ::: "memory");
+}
+
+/**
+ * @brief Touches every step-th word of buf iters times
+ *
+ * @return value folded from the loads so they are not optimized out
+ */
+template <Op OP>
+static uint64_t runLinear(uint64_t *buf, size_t words, size_t step, uint64_t iters)
+{
+    uint64_t sum = 0;
+    for (uint64_t it = 0; it < iters; it++)
+    {
+        for (size_t i = 0; i < words; i += step)
+        {
+            if (OP == READ)
+                sum += buf[i];
+            else if (OP == RW)
+                buf[i] += it;
+            else
+                buf[i] = it;
+        }
+        clobberMemory();
+    }
+    return sum + buf[0];
+}
+
+/**
+ * @brief Touches one word of each line in the order of idx iters times
+ */
+template <Op OP>
+static uint64_t runRandom(uint64_t *buf, const uint32_t *idx, size_t lines, uint64_t iters)
+{
+    const size_t wordsPerLine = LINE_SIZE / WORD_SIZE;
+    uint64_t sum = 0;
+    for (uint64_t it = 0; it < iters; it++)
+    {
+        for (size_t i = 0; i < lines; i++)
+        {
+            uint64_t &w = buf[(size_t)idx[i] * wordsPerLine];
+            if (OP == READ)
+                sum += w;
+            else if (OP == RW)
+                w += it;
+            else
+                w = it;
+        }
+        clobberMemory();
+    }
+    return sum + buf[0];
+}
+
+/**
+ * @brief Per thread state of one working set size
+ */
+struct Worker
+{
+    uint64_t *buf = NULL;
+    size_t bytes = 0;
+    vector<uint32_t> idx;         // line order for RANDOM
+    uint64_t cycles = 0;          // cycles of the last measurement
+    uint64_t sink = 0;
+};
+
+/**
+ * @brief Number of accesses of one pass over the buffer
+ */
+static uint64_t accessesPerPass(const Config &cfg, size_t bytes)
+{
+    switch (cfg.pattern)
+    {
+    case SEQ:
+        return bytes / WORD_SIZE;
+    case STRIDE:
+        return (bytes + cfg.stride - 1) / cfg.stride;
+    default:
+        return bytes / LINE_SIZE;
+    }
+}
+
+/**
+ * @brief Runs iters passes of the selected kernel over the worker buffer
+ */
+static void runPasses(const Config &cfg, Worker &w, uint64_t iters)
+{
+    const size_t words = w.bytes / WORD_SIZE;
+    const size_t step = cfg.pattern == SEQ ? 1 : cfg.stride / WORD_SIZE;
+
+    if (cfg.pattern == RANDOM)
+    {
+        if (cfg.op == READ)
+            w.sink += runRandom<READ>(w.buf, w.idx.data(), w.idx.size(), iters);
+        else if (cfg.op == RW)
+            w.sink += runRandom<RW>(w.buf, w.idx.data(), w.idx.size(), iters);
+        else
+            w.sink += runRandom<WRITE>(w.buf, w.idx.data(), w.idx.size(), iters);
+    }
+    else
+    {
+        if (cfg.op == READ)
+            w.sink += runLinear<READ>(w.buf, words, step, iters);
+        else if (cfg.op == RW)
+            w.sink += runLinear<RW>(w.buf, words, step, iters);
+        else
+            w.sink += runLinear<WRITE>(w.buf, words, step, iters);
+    }
+}
+
+/**
+ * @brief Spinning barrier, generation counted so it can be reused
+ */
+class Barrier
+{
+  public:
+    explicit Barrier(unsigned n) : count(n), waiting(0), generation(0) {}
+    void wait()
+    {
+        unsigned gen = generation.load();
+        if (waiting.fetch_add(1) + 1 == count)
+        {
+            waiting.store(0);
+            generation.fetch_add(1);
+            return;
+        }
+        while (generation.load() == gen)
+            ;
+    }
+
+  private:
+    const unsigned count;
+    atomic<unsigned> waiting;
+    atomic<unsigned> generation;
+};
+
+/**
+ * @brief Pins calling thread to cpu
+ */
+static void pinThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+        cerr << "Cannot pin thread to core " << cpu << endl;
+}
+
+/**
+ * @brief Measures one working set size
+ *
+ * Threads get equal private slices of the working set. Each pass count
+ * is calibrated on the first thread so a measurement takes at least
+ * minTime, then reps measurements start together on a barrier and the
+ * fastest one (slowest thread of it) is kept.
+ *
+ * @return cycles of the kept measurement and passes per measurement
+ */
+static pair<uint64_t, uint64_t> measure(const Config &cfg, vector<Worker> &workers,
+                                        double tscNs)
+{
+    const unsigned n = workers.size();
+    Barrier barrier(n);
+    uint64_t iters = 1, best = UINT64_MAX;
+
+    // warm up and calibrate on the first worker
+    runPasses(cfg, workers[0], 1);
+    for (;;)
+    {
+        uint64_t t0 = tsc_read();
+        runPasses(cfg, workers[0], iters);
+        uint64_t t = tsc_read() - t0;
+        if (t >= cfg.minTime * 1e9 * tscNs / 4 || iters >= (1ULL << 40))
+        {
+            iters = max<uint64_t>(1, (uint64_t)(iters * cfg.minTime * 1e9 * tscNs / t));
+            break;
+        }
+        iters *= 2;
+    }
+
+    vector<thread> threads;
+    for (unsigned t = 0; t < n; t++)
+    {
+        threads.emplace_back([&, t]() {
+            if (!cfg.cpus.empty())
+                pinThread(cfg.cpus[t % cfg.cpus.size()]);
+            runPasses(cfg, workers[t], 1);
+            for (unsigned r = 0; r < cfg.reps; r++)
+            {
+                barrier.wait();
+                uint64_t t0 = tsc_read();
+                runPasses(cfg, workers[t], iters);
+                workers[t].cycles = tsc_read() - t0;
+                barrier.wait();
+                if (t == 0)
+                {
+                    uint64_t slowest = 0;
+                    for (const Worker &w : workers)
+                        slowest = max(slowest, w.cycles);
+                    best = min(best, slowest);
+                }
+            }
+        });
+    }
+    for (thread &th : threads)
+        th.join();
+    return make_pair(best, iters);
+}
+
+/**
+ * @brief Prints help
+ */
+static void printHelp(const char *name)
+{
+    cout << "Usage: " << name << " [options]\n"
+         << "  -p, --pattern seq|stride|random  access pattern (default seq)\n"
+         << "  -o, --op read|rw|write           operation (default read)\n"
+         << "  -s, --stride <bytes>             distance of stride accesses (default 256)\n"
+         << "  -t, --threads <n>                threads (default 1)\n"
+         << "  -c, --cpus <list>                cores to pin threads to, e.g. 0,2,4-7\n"
+         << "  -m, --min <size>                 smallest working set (default 4k)\n"
+         << "  -M, --max <size>                 largest working set (default 4 x LLC)\n"
+         << "  -n, --steps <n>                  sizes per doubling (default 4)\n"
+         << "  -r, --reps <n>                   measurements per size (default 3)\n"
+         << "  -d, --duration <ms>              time per measurement (default 50)\n"
+         << "  -T, --tag <text>                 label of every record, e.g. COS name\n"
+         << "  -j, --json                       JSON lines instead of CSV\n"
+         << "  -S, --seed <n>                   random order seed (default 1)\n"
+         << "Working set is the total over threads, each thread gets a private slice.\n"
+         << "Random accesses one word per line in a random permutation of lines.\n";
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longOpts[] = {
+        {"pattern", required_argument, NULL, 'p'},
+        {"op", required_argument, NULL, 'o'},
+        {"stride", required_argument, NULL, 's'},
+        {"threads", required_argument, NULL, 't'},
+        {"cpus", required_argument, NULL, 'c'},
+        {"min", required_argument, NULL, 'm'},
+        {"max", required_argument, NULL, 'M'},
+        {"steps", required_argument, NULL, 'n'},
+        {"reps", required_argument, NULL, 'r'},
+        {"duration", required_argument, NULL, 'd'},
+        {"tag", required_argument, NULL, 'T'},
+        {"json", no_argument, NULL, 'j'},
+        {"seed", required_argument, NULL, 'S'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    Config cfg;
+    int opt;
+    bool ok = true;
+
+    while (ok && (opt = getopt_long(argc, argv, "p:o:s:t:c:m:M:n:r:d:T:jS:h", longOpts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            if (!strcmp(optarg, "seq"))
+                cfg.pattern = SEQ;
+            else if (!strcmp(optarg, "stride"))
+                cfg.pattern = STRIDE;
+            else if (!strcmp(optarg, "random"))
+                cfg.pattern = RANDOM;
+            else
+                ok = false;
+            break;
+        case 'o':
+            if (!strcmp(optarg, "read"))
+                cfg.op = READ;
+            else if (!strcmp(optarg, "rw"))
+                cfg.op = RW;
+            else if (!strcmp(optarg, "write"))
+                cfg.op = WRITE;
+            else
+                ok = false;
+            break;
+        case 's':
+            ok = parseSize(optarg, cfg.stride) && cfg.stride >= WORD_SIZE &&
+                 cfg.stride % WORD_SIZE == 0;
+            break;
+        case 't':
+            cfg.threads = atoi(optarg);
+            ok = cfg.threads > 0;
+            break;
+        case 'c':
+            ok = parseCpus(optarg, cfg.cpus);
+            break;
+        case 'm':
+            ok = parseSize(optarg, cfg.minWs);
+            break;
+        case 'M':
+            ok = parseSize(optarg, cfg.maxWs);
+            break;
+        case 'n':
+            cfg.steps = atoi(optarg);
+            ok = cfg.steps > 0;
+            break;
+        case 'r':
+            cfg.reps = atoi(optarg);
+            ok = cfg.reps > 0;
+            break;
+        case 'd':
+            cfg.minTime = atof(optarg) / 1000.0;
+            ok = cfg.minTime > 0;
+            break;
+        case 'T':
+            cfg.tag = optarg;
+            break;
+        case 'j':
+            cfg.json = true;
+            break;
+        case 'S':
+            cfg.seed = atoi(optarg);
+            break;
+        case 'h':
+            printHelp(argv[0]);
+            return 0;
+        default:
+            ok = false;
+        }
+    }
+    if (cfg.maxWs == 0)
+        cfg.maxWs = 4 * llcSize();
+    if (!ok || optind < argc || cfg.minWs > cfg.maxWs)
+    {
+        printHelp(argv[0]);
+        return 1;
+    }
+
+    const double tscNs = tscPerNs();
+    const size_t granule = cfg.threads * LINE_SIZE;
+    const size_t maxPerThread = (cfg.maxWs + granule - 1) / granule * LINE_SIZE;
+
+    // one buffer per thread for the largest size, smaller sizes use its start
+    vector<Worker> workers(cfg.threads);
+    for (Worker &w : workers)
+    {
+        void *p = NULL;
+        if (posix_memalign(&p, 2 << 20, maxPerThread) != 0)
+        {
+            cerr << "Cannot allocate " << maxPerThread << " bytes" << endl;
+            return 1;
+        }
+        memset(p, 1, maxPerThread);
+        w.buf = (uint64_t *)p;
+    }
+
+    if (!cfg.json)
+        cout << "tag,pattern,op,threads,ws_bytes,stride,accesses,cycles,"
+                "bytes_per_cycle,ns_per_access,gb_per_s" << endl;
+
+    mt19937_64 rng(cfg.seed);
+    size_t lastWs = 0;
+    for (unsigned k = 0;; k++)
+    {
+        double scale = pow(2.0, (double)k / cfg.steps);
+        size_t ws = (size_t)(cfg.minWs * scale) / granule * granule;
+        if (ws > cfg.maxWs)
+            break;
+        if (ws == lastWs || ws == 0)
+            continue;
+        lastWs = ws;
+
+        for (Worker &w : workers)
+        {
+            w.bytes = ws / cfg.threads;
+            if (cfg.pattern == RANDOM)
+            {
+                // random permutation, every line is visited once per pass
+                w.idx.resize(w.bytes / LINE_SIZE);
+                for (size_t i = 0; i < w.idx.size(); i++)
+                    w.idx[i] = i;
+                shuffle(w.idx.begin(), w.idx.end(), rng);
+            }
+        }
+
+        pair<uint64_t, uint64_t> r = measure(cfg, workers, tscNs);
+        uint64_t accesses = accessesPerPass(cfg, workers[0].bytes) * cfg.threads * r.second;
+        double bytes = (double)accesses * WORD_SIZE;
+        double ns = r.first / tscNs;
+        double bpc = bytes / r.first;
+        double nsPerAccess = ns * cfg.threads / accesses;
+        double gbps = bytes / ns;
+        size_t stride = cfg.pattern == SEQ ? WORD_SIZE : cfg.pattern == STRIDE ? cfg.stride : LINE_SIZE;
+
+        char line[512];
+        if (cfg.json)
+            snprintf(line, sizeof(line),
+                     "{\"tag\":\"%s\",\"pattern\":\"%s\",\"op\":\"%s\",\"threads\":%u,"
+                     "\"ws_bytes\":%zu,\"stride\":%zu,\"accesses\":%llu,\"cycles\":%llu,"
+                     "\"bytes_per_cycle\":%.4f,\"ns_per_access\":%.4f,\"gb_per_s\":%.3f}",
+                     cfg.tag.c_str(), patternNames[cfg.pattern], opNames[cfg.op], cfg.threads,
+                     ws, stride, (unsigned long long)accesses, (unsigned long long)r.first,
+                     bpc, nsPerAccess, gbps);
+        else
+            snprintf(line, sizeof(line), "%s,%s,%s,%u,%zu,%zu,%llu,%llu,%.4f,%.4f,%.3f",
+                     cfg.tag.c_str(), patternNames[cfg.pattern], opNames[cfg.op], cfg.threads,
+                     ws, stride, (unsigned long long)accesses, (unsigned long long)r.first,
+                     bpc, nsPerAccess, gbps);
+        cout << line << endl;
+    }
+
+    uint64_t sink = 0;
+    for (Worker &w : workers)
+    {
+        sink += w.sink;
+        free(w.buf);
+    }
+    return sink == 42 ? 2 : 0;
+}
@@ -0,0 +1,489 @@
+/**
+ * @file latbench.cpp
+ * @brief Pointer chasing latency benchmark
+ *
+ * Measures load-to-use latency over growing footprints with a chain of
+ * dependent loads through a random cyclic permutation of cache lines,
+ * so neither the prefetchers nor memory level parallelism hide misses.
+ * The footprint where latency starts rising from the LLC plateau towards
+ * the memory plateau is reported as the effective cache capacity and
+ * compared with popcount(mask) x way size of the class of service the
+ * benchmark runs in, e.g.
+ *     pqos -e "llc:1=0xf" -a "llc:1=2"
+ *     ./latbench -c 2 -k 0xf
+ * or for every mask size
+ *     pqos --sweep=core=2 -- ./latbench -c 2 -o lat.csv
+ * @version 0.1
+ * @date 2026-10-19
+ */
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <random>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <getopt.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#include "tsc.h"
+using namespace std;
+
+#define LINE_SIZE 64
+#define HUGE_PAGE_SIZE (2UL << 20)
+
+/**
+ * @brief One cache line of the chain
+ */
+struct Line
+{
+    Line *next;
+    char pad[LINE_SIZE - sizeof(Line *)];
+};
+
+/**
+ * @brief Benchmark parameters
+ */
+struct Config
+{
+    size_t minFp = 256 << 10;     // smallest footprint, bytes
+    size_t maxFp = 0;             // largest footprint, 0 = 2 x LLC
+    unsigned steps = 8;           // points per doubling of footprint
+    uint64_t loads = 1 << 24;     // dependent loads per measurement
+    unsigned reps = 3;            // measurements per point, best is kept
+    int cpu = -1;                 // core to pin to
+    bool huge = false;            // back the chain with huge pages
+    uint64_t mask = 0;            // COS ways mask, 0 = not known
+    size_t waySize = 0;           // bytes per way, 0 = from CPUID
+    double knee = 0.1;            // rise fraction marking the knee
+    bool json = false;
+    string tag;
+    string outFile;
+    unsigned seed = 1;
+};
+
+/**
+ * @brief One point of the latency curve
+ */
+struct Point
+{
+    size_t footprint;
+    double cycles;                // per load
+    double ns;                    // per load
+};
+
+/**
+ * @brief Calibrates time stamp counter against CLOCK_MONOTONIC
+ *
+ * @return TSC ticks per nanosecond
+ */
+static double tscPerNs()
+{
+    tsc_clock clk;
+    if (tsc_init(&clk, 100) != TSC_RETVAL_OK)
+    {
+        cerr << "TSC calibration failed" << endl;
+        exit(1);
+    }
+    if (!clk.invariant)
+        cerr << "TSC is not invariant, cycles follow frequency changes" << endl;
+    return clk.hz / 1e9;
+}
+
+/**
+ * @brief Reads LLC geometry from CPUID.0x4 the way host_cap.c does
+ *
+ * @param [out] size LLC size in bytes
+ * @param [out] ways number of ways
+ *
+ * @return true if the LLC was found
+ */
+static bool llcInfo(size_t &size, unsigned &ways)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+    if (__get_cpuid_max(0, NULL) < 4)
+        return false;
+    __cpuid_count(4, 3, eax, ebx, ecx, edx);
+    if ((eax & 0x1f) != 3 || ((eax >> 5) & 0x7) != 3)
+        return false;
+    ways = (ebx >> 22) + 1;
+    unsigned lineSize = (ebx & 0xfff) + 1;
+    unsigned partitions = ((ebx >> 12) & 0x3ff) + 1;
+    unsigned sets = ecx + 1;
+    size = (size_t)ways * partitions * lineSize * sets;
+    return true;
+#else
+    (void)size;
+    (void)ways;
+    return false;
+#endif
+}
+
+/**
+ * @brief Parses size with optional k, m or g suffix
+ */
+static bool parseSize(const char *str, size_t &val)
+{
+    char *end = NULL;
+    unsigned long long v = strtoull(str, &end, 0);
+    if (end == str)
+        return false;
+    switch (*end)
+    {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    }
+    if (*end != '\0')
+        return false;
+    val = (size_t)v;
+    return true;
+}
+
+/**
+ * @brief Allocates chain memory, huge pages if requested
+ *
+ * MAP_HUGETLB needs reserved huge pages, transparent huge pages are
+ * requested with madvise() when there are none.
+ */
+static void *allocChain(size_t bytes, bool huge)
+{
+    size_t len = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *p = MAP_FAILED;
+
+    if (huge)
+    {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED)
+        {
+            p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (p != MAP_FAILED && madvise(p, len, MADV_HUGEPAGE) != 0)
+                cerr << "Huge pages not available, using base pages" << endl;
+        }
+    }
+    else
+    {
+        p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p != MAP_FAILED)
+            madvise(p, len, MADV_NOHUGEPAGE);
+    }
+    if (p == MAP_FAILED)
+        return NULL;
+    memset(p, 0, len);
+    return p;
+}
+
+/**
+ * @brief Links the first n lines into one random cycle (Sattolo)
+ */
+static Line *buildChain(Line *lines, size_t n, mt19937_64 &rng)
+{
+    vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    for (size_t i = n - 1; i > 0; i--)
+    {
+        uniform_int_distribution<size_t> dist(0, i - 1);
+        swap(order[i], order[dist(rng)]);
+    }
+    for (size_t i = 0; i < n; i++)
+        lines[order[i]].next = &lines[order[(i + 1) % n]];
+    return &lines[order[0]];
+}
+
+/**
+ * @brief Follows the chain for the given number of loads
+ */
+static Line *chase(Line *p, uint64_t loads)
+{
+    // unrolled so loop overhead does not add to the load latency
+    for (uint64_t i = 0; i < loads; i += 8)
+    {
+        p = p->next; p = p->next; p = p->next; p = p->next;
+        p = p->next; p = p->next; p = p->next; p = p->next;
+    }
+    return p;
+}
+
+/**
+ * @brief Finds the footprint where latency has risen by the knee fraction
+ *
+ * The LLC plateau is the lowest latency above twice the L2 size and the
+ * memory plateau the latency of the largest footprint. The crossing of
+ * plateau + knee x rise is interpolated on a log scale of footprint.
+ *
+ * @return knee footprint in bytes, 0 if the curve has no knee
+ */
+static size_t findKnee(const vector<Point> &pts, size_t l2, double knee)
+{
+    size_t first = 0;
+    while (first < pts.size() && pts[first].footprint < 2 * l2)
+        first++;
+    if (pts.size() - first < 3)
+        return 0;
+
+    double low = pts[first].cycles;
+    size_t lowIdx = first;
+    for (size_t i = first; i < pts.size(); i++)
+        if (pts[i].cycles < low)
+        {
+            low = pts[i].cycles;
+            lowIdx = i;
+        }
+    double high = pts.back().cycles;
+    if (high < low * 1.5)
+        return 0;
+
+    double threshold = low + knee * (high - low);
+    for (size_t i = lowIdx + 1; i < pts.size(); i++)
+    {
+        if (pts[i].cycles < threshold)
+            continue;
+        const Point &a = pts[i - 1], &b = pts[i];
+        double f = (threshold - a.cycles) / (b.cycles - a.cycles);
+        return (size_t)exp(log((double)a.footprint) +
+                           f * (log((double)b.footprint) - log((double)a.footprint)));
+    }
+    return 0;
+}
+
+/**
+ * @brief Prints help
+ */
+static void printHelp(const char *name)
+{
+    cout << "Usage: " << name << " [options]\n"
+         << "  -m, --min <size>         smallest footprint (default 256k)\n"
+         << "  -M, --max <size>         largest footprint (default 2 x LLC)\n"
+         << "  -n, --steps <n>          footprints per doubling (default 8)\n"
+         << "  -l, --loads <n>          dependent loads per measurement (default 16M)\n"
+         << "  -r, --reps <n>           measurements per footprint (default 3)\n"
+         << "  -c, --cpu <core>         core to pin to\n"
+         << "  -H, --huge               use 2MB huge pages\n"
+         << "  -k, --mask <hex>         ways mask of the COS the core runs in\n"
+         << "                           (default $PQOS_SWEEP_MASK)\n"
+         << "  -w, --way-size <size>    bytes per way (default from CPUID)\n"
+         << "  -K, --knee <fraction>    latency rise marking the knee (default 0.1)\n"
+         << "  -T, --tag <text>         label of every record\n"
+         << "  -o, --output <file>      append records to file\n"
+         << "  -j, --json               JSON lines instead of CSV\n"
+         << "  -S, --seed <n>           permutation seed (default 1)\n"
+         << "Prints a record per footprint and a summary record with the knee\n"
+         << "(effective capacity) and the expected capacity of the mask. On\n"
+         << "non-inclusive LLCs the knee includes the private L2.\n";
+}
+
+int main(int argc, char **argv)
+{
+    static const struct option longOpts[] = {
+        {"min", required_argument, NULL, 'm'},
+        {"max", required_argument, NULL, 'M'},
+        {"steps", required_argument, NULL, 'n'},
+        {"loads", required_argument, NULL, 'l'},
+        {"reps", required_argument, NULL, 'r'},
+        {"cpu", required_argument, NULL, 'c'},
+        {"huge", no_argument, NULL, 'H'},
+        {"mask", required_argument, NULL, 'k'},
+        {"way-size", required_argument, NULL, 'w'},
+        {"knee", required_argument, NULL, 'K'},
+        {"tag", required_argument, NULL, 'T'},
+        {"output", required_argument, NULL, 'o'},
+        {"json", no_argument, NULL, 'j'},
+        {"seed", required_argument, NULL, 'S'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0}};
+    Config cfg;
+    int opt;
+    bool ok = true;
+    size_t loads;
+
+    // masks set by pqos --sweep for the current run
+    const char *env = getenv("PQOS_SWEEP_MASK");
+    if (env != NULL)
+        cfg.mask = strtoull(env, NULL, 0);
+    env = getenv("PQOS_SWEEP_WAY_SIZE");
+    if (env != NULL)
+        cfg.waySize = strtoull(env, NULL, 0);
+
+    while (ok && (opt = getopt_long(argc, argv, "m:M:n:l:r:c:Hk:w:K:T:o:jS:h", longOpts, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'm':
+            ok = parseSize(optarg, cfg.minFp);
+            break;
+        case 'M':
+            ok = parseSize(optarg, cfg.maxFp);
+            break;
+        case 'n':
+            cfg.steps = atoi(optarg);
+            ok = cfg.steps > 0;
+            break;
+        case 'l':
+            ok = parseSize(optarg, loads) && loads >= 8;
+            cfg.loads = loads / 8 * 8;
+            break;
+        case 'r':
+            cfg.reps = atoi(optarg);
+            ok = cfg.reps > 0;
+            break;
+        case 'c':
+            cfg.cpu = atoi(optarg);
+            ok = cfg.cpu >= 0;
+            break;
+        case 'H':
+            cfg.huge = true;
+            break;
+        case 'k':
+            cfg.mask = strtoull(optarg, NULL, 16);
+            break;
+        case 'w':
+            ok = parseSize(optarg, cfg.waySize);
+            break;
+        case 'K':
+            cfg.knee = atof(optarg);
+            ok = cfg.knee > 0 && cfg.knee < 1;
+            break;
+        case 'T':
+            cfg.tag = optarg;
+            break;
+        case 'o':
+            cfg.outFile = optarg;
+            break;
+        case 'j':
+            cfg.json = true;
+            break;
+        case 'S':
+            cfg.seed = atoi(optarg);
+            break;
+        case 'h':
+            printHelp(argv[0]);
+            return 0;
+        default:
+            ok = false;
+        }
+    }
+
+    size_t llc = 0;
+    unsigned llcWays = 0;
+    if (!llcInfo(llc, llcWays))
+    {
+        long s = sysconf(_SC_LEVEL3_CACHE_SIZE);
+        llc = s > 0 ? (size_t)s : (size_t)32 << 20;
+    }
+    if (cfg.waySize == 0 && llcWays > 0)
+        cfg.waySize = llc / llcWays;
+    if (cfg.maxFp == 0)
+        cfg.maxFp = 2 * llc;
+    if (!ok || optind < argc || cfg.minFp < 8 * LINE_SIZE || cfg.minFp > cfg.maxFp)
+    {
+        printHelp(argv[0]);
+        return 1;
+    }
+    long l2s = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    size_t l2 = l2s > 0 ? (size_t)l2s : 256 << 10;
+
+    if (cfg.cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cfg.cpu, &set);
+        if (sched_setaffinity(0, sizeof(set), &set) != 0)
+            cerr << "Cannot pin to core " << cfg.cpu << endl;
+    }
+
+    FILE *fp = stdout;
+    if (!cfg.outFile.empty())
+    {
+        fp = fopen(cfg.outFile.c_str(), "a");
+        if (fp == NULL)
+        {
+            perror(cfg.outFile.c_str());
+            return 1;
+        }
+    }
+    struct stat st;
+    bool header = !cfg.json && (fstat(fileno(fp), &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0);
+    if (header)
+        fprintf(fp, "tag,mask,footprint,cycles_per_load,ns_per_load,knee_bytes,expected_bytes\n");
+
+    Line *lines = (Line *)allocChain(cfg.maxFp, cfg.huge);
+    if (lines == NULL)
+    {
+        cerr << "Cannot allocate " << cfg.maxFp << " bytes" << endl;
+        return 1;
+    }
+
+    const double tscNs = tscPerNs();
+    mt19937_64 rng(cfg.seed);
+    vector<Point> pts;
+    Line *sink = NULL;
+    size_t last = 0;
+
+    for (unsigned k = 0;; k++)
+    {
+        size_t bytes = (size_t)(cfg.minFp * pow(2.0, (double)k / cfg.steps)) / LINE_SIZE * LINE_SIZE;
+        if (bytes > cfg.maxFp)
+            break;
+        if (bytes == last)
+            continue;
+        last = bytes;
+
+        Line *p = buildChain(lines, bytes / LINE_SIZE, rng);
+        // warm up: two rounds over the chain
+        p = chase(p, max<uint64_t>(8, 2 * bytes / LINE_SIZE));
+        double best = 1e30;
+        for (unsigned r = 0; r < cfg.reps; r++)
+        {
+            uint64_t t0 = tsc_read();
+            p = chase(p, cfg.loads);
+            uint64_t t = tsc_read() - t0;
+            best = min(best, (double)t / cfg.loads);
+        }
+        sink = p;
+
+        Point pt = {bytes, best, best / tscNs};
+        pts.push_back(pt);
+        if (cfg.json)
+            fprintf(fp, "{\"tag\":\"%s\",\"mask\":\"0x%llx\",\"footprint\":%zu,"
+                        "\"cycles_per_load\":%.2f,\"ns_per_load\":%.2f}\n",
+                    cfg.tag.c_str(), (unsigned long long)cfg.mask, pt.footprint, pt.cycles, pt.ns);
+        else
+            fprintf(fp, "%s,0x%llx,%zu,%.2f,%.2f,,\n", cfg.tag.c_str(),
+                    (unsigned long long)cfg.mask, pt.footprint, pt.cycles, pt.ns);
+        fflush(fp);
+    }
+
+    size_t kneeBytes = findKnee(pts, l2, cfg.knee);
+    size_t expected = cfg.mask != 0 ? (size_t)__builtin_popcountll(cfg.mask) * cfg.waySize : 0;
+    if (cfg.json)
+        fprintf(fp, "{\"tag\":\"%s\",\"mask\":\"0x%llx\",\"knee_bytes\":%zu,"
+                    "\"expected_bytes\":%zu,\"way_size\":%zu,\"ratio\":%.3f}\n",
+                cfg.tag.c_str(), (unsigned long long)cfg.mask, kneeBytes, expected, cfg.waySize,
+                expected ? (double)kneeBytes / expected : 0.0);
+    else
+        fprintf(fp, "%s,0x%llx,,,,%zu,%zu\n", cfg.tag.c_str(),
+                (unsigned long long)cfg.mask, kneeBytes, expected);
+
+    if (fp != stdout)
+    {
+        fclose(fp);
+        printf("mask 0x%llx knee %.1f kB expected %.1f kB\n", (unsigned long long)cfg.mask,
+               kneeBytes / 1024.0, expected / 1024.0);
+    }
+    munmap(lines, (cfg.maxFp + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE);
+    return sink == NULL ? 2 : 0;
+}
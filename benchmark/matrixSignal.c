@@ -15,15 +15,18 @@
 #include <signal.h>
 #include <sys/types.h>
 #include<time.h>
+#include "tsc.h"
 
 int NUM_ELE = 2 * 1024 * 1024;
 int *matrixA, *matrixB;
 static int times = 10000;
+static struct tsc_clock tscClock;
    
 // Signal Handler
 void sigHandler(int sig)
 {
     time_t my_time = time(NULL); 
+    uint64_t start = tsc_read();
   
 // ctime() used to give the present time 
 printf("%s", ctime(&my_time));  
@@ -37,10 +40,13 @@ printf("%s", ctime(&my_time));
         for (int i = 0; i < NUM_ELE; i++)
             matrixA[i];// = i * 2;
     }
+    uint64_t end = tsc_read();
     time_t my_time1 = time(NULL); 
   
 // ctime() used to give the present time 
 printf("%s", ctime(&my_time1)); 
+    // elapsed time from the calibrated TSC, ctime() has 1s resolution
+    printf("Elapsed %.6f s\n", tsc_cycles_to_ns(&tscClock, end - start) / 1e9);
     printf("SigHandler return");
     exit(0);
 }
@@ -49,6 +55,7 @@ int main(int argc, char **argv)
 {
 
     matrixA = (int *)malloc(NUM_ELE * sizeof(int));
+    tsc_init(&tscClock, 0);
     // matrixB = (int *)malloc(NUM_ELE * sizeof(int));
 
     // Initialize
@@ -0,0 +1,61 @@
+###
+# @file analyze_bench.sh
+# @brief Compare pqos-analyze with the grep/awk/stats.py pipeline of
+#        run_pqos.sh on a synthetic xml log
+# @args $1: Number of samples (default 100000)
+#	$2: Number of monitored cores (default 16)
+#	$3: Log file name (default /tmp/pqos_bench.xml)
+###
+
+SAMPLES=${1:-100000}
+CORES=${2:-16}
+LOG=${3:-/tmp/pqos_bench.xml}
+CORE1=0
+CORE2=$((CORES - 1))
+
+if [ ! -x ./pqos-analyze ] ; then
+	echo "Build pqos-analyze first (make)"
+	exit 1
+fi
+
+echo "Generating $SAMPLES samples x $CORES cores into $LOG"
+awk -v samples=$SAMPLES -v cores=$CORES 'BEGIN {
+	print "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+	print "<records>"
+	for (s = 0; s < samples; s++) {
+		t = s / 10
+		ts = sprintf("2024-01-01 %02d:%02d:%02d", int(t / 3600) % 24,
+			     int(t / 60) % 60, int(t) % 60)
+		for (c = 0; c < cores; c++) {
+			print "<record>"
+			print "\t<time>" ts "</time>"
+			print "\t<socket>" int(c / 32) "</socket>"
+			print "\t<core>" c "</core>"
+			print "\t<rmid>" (63 - c) "</rmid>"
+			printf "\t<l3_occupancy_kB>%.1f</l3_occupancy_kB>\n",
+				((s * 7 + c * 13) % 20000) * 1.0
+			print "</record>"
+		}
+	}
+	print "</records>"
+}' > $LOG
+ls -l $LOG
+
+OUT1=/tmp/pqos_bench_core$CORE1
+OUT2=/tmp/pqos_bench_core$CORE2
+
+echo "== run_pqos.sh pipeline (cores $CORE1 and $CORE2)"
+time (
+cat $LOG | grep -A 3 '<core>'$CORE1'</core>' | grep l3_occupancy_kB | awk -F ">" '{print $2}' | awk -F "<" '{print $1}' > $OUT1
+cat $LOG | grep -A 3 '<core>'$CORE2'</core>' | grep l3_occupancy_kB | awk -F ">" '{print $2}' | awk -F "<" '{print $1}' > $OUT2
+python3 stats.py $OUT1
+python3 stats.py $OUT2
+)
+
+echo "== pqos-analyze (cores $CORE1 and $CORE2)"
+time ./pqos-analyze -v -c $CORE1,$CORE2 $LOG
+
+echo "== pqos-analyze (all cores)"
+time ./pqos-analyze -v $LOG > /dev/null
+
+rm -f $OUT1 $OUT2
@@ -0,0 +1,796 @@
+/**
+ * @file apibench.c
+ * @brief PQoS library API cost benchmark
+ *
+ * Measures latency distribution and throughput of the library calls
+ * the utility and pqosd sit on:
+ * - pqos_init() and pqos_fini()
+ * - pqos_mon_start() and pqos_mon_stop()
+ * - pqos_mon_poll()
+ * - pqos_l3ca_assoc_set()
+ * - pqos_sampler_read()
+ * for a range of monitoring group counts and calling threads, against
+ * the hardware MSR driver and against the in-process simulated
+ * platform (sim.c), which leaves only the library cost. Every group
+ * monitors one core, threads work on interleaved slices of the groups.
+ * One CSV record is written per api, backend, group and thread count.
+ * The sampler is read from one thread over a subscription whose groups
+ * get stopped by their owner before unsubscribe, a run fails if
+ * samples stop coming or the groups are not released afterwards.
+ *
+ * Usage: apibench [-b <sim|real>[,...]] [-g <groups>[,...]]
+ *                 [-t <threads>[,...]] [-n <ops>] [-s <sim spec>]
+ *                 [-r] [-o <output file>]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+
+#include "pqos.h"
+#include "sim.h"
+
+#define BENCH_MAX_LIST    16            /**< max items of a -g or -t list */
+#define BENCH_DEF_SIM     "sockets=2;cores=64;rmids=256;cos=16"
+#define BENCH_SAMPLER_US    1000        /**< sampler interval */
+#define BENCH_SAMPLER_QUEUE 64          /**< sampler queue rows */
+#define BENCH_SAMPLER_TRIES 100         /**< intervals to wait for samples */
+
+/**
+ * Benchmark settings
+ */
+static struct {
+        unsigned groups[BENCH_MAX_LIST];        /**< group counts */
+        unsigned num_groups;
+        unsigned threads[BENCH_MAX_LIST];       /**< thread counts */
+        unsigned num_threads;
+        unsigned ops;                           /**< timed calls per thread */
+        const char *sim_spec;
+        int free_in_use_rmid;
+        FILE *fp;
+} m_bench;
+
+enum bench_api {
+        BENCH_MON_START = 0,
+        BENCH_MON_STOP,
+        BENCH_MON_POLL,
+        BENCH_ASSOC_SET,
+        BENCH_NUM_API
+};
+
+static const char * const m_api_name[BENCH_NUM_API] = {
+        "pqos_mon_start", "pqos_mon_stop", "pqos_mon_poll",
+        "pqos_l3ca_assoc_set"
+};
+
+/**
+ * Per thread state of one measurement
+ */
+struct bench_thread {
+        pthread_t id;
+        unsigned index;                 /**< slice of the groups */
+        unsigned stride;                /**< number of threads */
+        unsigned num;                   /**< groups in the slice */
+        struct pqos_mon_data *groups;   /**< shared group table */
+        unsigned *cores;                /**< core of each group */
+        enum bench_api api;
+        uint64_t *lat[2];               /**< latencies in ns, start/stop
+                                           use both */
+        unsigned n[2];
+        uint64_t start;                 /**< first call time */
+        uint64_t end;                   /**< last call return time */
+        int ret;
+        pthread_barrier_t *barrier;
+};
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+bench_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief qsort() comparator for latencies
+ */
+static int
+bench_cmp(const void *a, const void *b)
+{
+        const uint64_t x = *(const uint64_t *) a;
+        const uint64_t y = *(const uint64_t *) b;
+
+        return (x>y) - (x<y);
+}
+
+/**
+ * @brief Sorts latencies and writes result record
+ *
+ * @param [in] backend backend name
+ * @param [in] api API name
+ * @param [in] groups group count
+ * @param [in] threads thread count
+ * @param [in] items groups handled by one call
+ * @param [in,out] lat latencies in ns, sorted on return
+ * @param [in] n number of latencies
+ * @param [in] wall wall time of the measurement in ns
+ */
+static void
+bench_report(const char *backend, const char *api, const unsigned groups,
+             const unsigned threads, const unsigned items,
+             uint64_t *lat, const unsigned n, const uint64_t wall)
+{
+        uint64_t sum = 0;
+        unsigned i;
+
+        if (n==0)
+                return;
+        qsort(lat, n, sizeof(lat[0]), bench_cmp);
+        for (i=0;i<n;i++)
+                sum += lat[i];
+        fprintf(m_bench.fp, "%s,%s,%u,%u,%u,%u,%.6f,%.1f,"
+                "%llu,%llu,%llu,%llu,%llu,%.1f\n",
+                backend, api, groups, threads, items, n,
+                (double) wall / 1e9,
+                wall>0 ? (double) n * 1e9 / (double) wall : 0.0,
+                (unsigned long long) lat[0],
+                (unsigned long long) lat[n / 2],
+                (unsigned long long) lat[(n * 9) / 10],
+                (unsigned long long) lat[(n * 99) / 100],
+                (unsigned long long) lat[n - 1],
+                (double) sum / (double) n);
+        fflush(m_bench.fp);
+}
+
+/**
+ * @brief Thread body, times \a ops calls of the selected API
+ *        on the thread slice of the groups
+ */
+static void *
+bench_thread_fn(void *arg)
+{
+        struct bench_thread *t = (struct bench_thread *) arg;
+        struct pqos_mon_data *slice = NULL;
+        unsigned i, g, k = 0;
+        int ret = PQOS_RETVAL_OK;
+
+        /**
+         * Polled groups are copied to a private contiguous table
+         * so pqos_mon_poll() gets the slice in one call
+         */
+        if (t->api==BENCH_MON_POLL) {
+                slice = calloc(t->num, sizeof(*slice));
+                if (slice==NULL)
+                        ret = PQOS_RETVAL_RESOURCE;
+                for (g=t->index;slice!=NULL && k<t->num;g+=t->stride)
+                        slice[k++] = t->groups[g];
+        }
+
+        pthread_barrier_wait(t->barrier);
+
+        t->start = bench_ns();
+        for (i=0;i<m_bench.ops && ret==PQOS_RETVAL_OK;i++) {
+                uint64_t t0;
+
+                switch (t->api) {
+                case BENCH_MON_POLL:
+                        t0 = bench_ns();
+                        ret = pqos_mon_poll(slice, t->num);
+                        t->lat[0][t->n[0]++] = bench_ns() - t0;
+                        break;
+                case BENCH_ASSOC_SET:
+                        g = t->index + (i % t->num) * t->stride;
+                        t0 = bench_ns();
+                        ret = pqos_l3ca_assoc_set(t->cores[g],
+                                                  (i / t->num) & 1);
+                        t->lat[0][t->n[0]++] = bench_ns() - t0;
+                        break;
+                default:
+                        /**
+                         * One op starts all groups of the slice
+                         * one by one then stops them
+                         */
+                        for (k=0, g=t->index;k<t->num &&
+                                     ret==PQOS_RETVAL_OK;k++, g+=t->stride) {
+                                t0 = bench_ns();
+                                ret = pqos_mon_start(1, &t->cores[g],
+                                                     PQOS_MON_EVENT_L3_OCCUP,
+                                                     NULL, &t->groups[g]);
+                                t->lat[0][t->n[0]++] = bench_ns() - t0;
+                        }
+                        if (ret!=PQOS_RETVAL_OK) {
+                                /**
+                                 * Release groups started before the error
+                                 */
+                                for (g=t->index;k>1;k--, g+=t->stride)
+                                        (void) pqos_mon_stop(&t->groups[g]);
+                                break;
+                        }
+                        for (k=0, g=t->index;k<t->num &&
+                                     ret==PQOS_RETVAL_OK;k++, g+=t->stride) {
+                                t0 = bench_ns();
+                                ret = pqos_mon_stop(&t->groups[g]);
+                                t->lat[1][t->n[1]++] = bench_ns() - t0;
+                        }
+                        break;
+                }
+        }
+
+        t->end = bench_ns();
+        free(slice);
+        t->ret = ret;
+        return NULL;
+}
+
+/**
+ * @brief Runs one API with \a groups groups on \a threads threads
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+bench_run(const char *backend, const enum bench_api api,
+          const unsigned groups, const unsigned threads,
+          struct pqos_mon_data *table, unsigned *cores)
+{
+        struct bench_thread t[threads];
+        pthread_barrier_t barrier;
+        uint64_t *lat[2] = {NULL, NULL}, t0 = UINT64_MAX, t1 = 0, wall;
+        unsigned i, n[2] = {0, 0}, per_thread = m_bench.ops;
+        int ret = PQOS_RETVAL_OK;
+
+        /**
+         * Start/stop records every group of the slice per op
+         */
+        if (api==BENCH_MON_START)
+                per_thread *= (groups + threads - 1) / threads;
+
+        lat[0] = calloc((size_t) per_thread * threads, sizeof(uint64_t));
+        lat[1] = calloc((size_t) per_thread * threads, sizeof(uint64_t));
+        if (lat[0]==NULL || lat[1]==NULL) {
+                free(lat[0]);
+                free(lat[1]);
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        pthread_barrier_init(&barrier, NULL, threads + 1);
+        memset(t, 0, sizeof(t));
+        for (i=0;i<threads;i++) {
+                t[i].index = i;
+                t[i].stride = threads;
+                t[i].num = (groups - i + threads - 1) / threads;
+                t[i].groups = table;
+                t[i].cores = cores;
+                t[i].api = api;
+                t[i].lat[0] = &lat[0][(size_t) i * per_thread];
+                t[i].lat[1] = &lat[1][(size_t) i * per_thread];
+                t[i].barrier = &barrier;
+                if (pthread_create(&t[i].id, NULL, bench_thread_fn,
+                                   &t[i])!=0) {
+                        /**
+                         * Threads already started wait on the barrier,
+                         * there is no way to release them cleanly
+                         */
+                        fprintf(stderr, "Thread create error!\n");
+                        exit(EXIT_FAILURE);
+                }
+        }
+        pthread_barrier_wait(&barrier);
+        for (i=0;i<threads;i++) {
+                pthread_join(t[i].id, NULL);
+                if (t[i].ret!=PQOS_RETVAL_OK)
+                        ret = t[i].ret;
+                if (t[i].start<t0)
+                        t0 = t[i].start;
+                if (t[i].end>t1)
+                        t1 = t[i].end;
+        }
+        wall = t1 - t0;
+        pthread_barrier_destroy(&barrier);
+
+        /**
+         * Compact per thread latencies
+         */
+        for (i=0;i<threads;i++) {
+                memmove(&lat[0][n[0]], t[i].lat[0],
+                        t[i].n[0] * sizeof(uint64_t));
+                n[0] += t[i].n[0];
+                memmove(&lat[1][n[1]], t[i].lat[1],
+                        t[i].n[1] * sizeof(uint64_t));
+                n[1] += t[i].n[1];
+        }
+
+        if (ret!=PQOS_RETVAL_OK)
+                fprintf(stderr, "%s: %s failed with %d at %u groups, "
+                        "%u threads\n", backend, m_api_name[api], ret,
+                        groups, threads);
+        else if (api==BENCH_MON_START) {
+                bench_report(backend, m_api_name[BENCH_MON_START], groups,
+                             threads, 1, lat[0], n[0], wall);
+                bench_report(backend, m_api_name[BENCH_MON_STOP], groups,
+                             threads, 1, lat[1], n[1], wall);
+        } else
+                bench_report(backend, m_api_name[api], groups, threads,
+                             api==BENCH_MON_POLL ?
+                             (groups + threads - 1) / threads : 1,
+                             lat[0], n[0], wall);
+
+        free(lat[0]);
+        free(lat[1]);
+        return ret;
+}
+
+/**
+ * @brief Sleeps for \a us microseconds
+ */
+static void
+bench_sleep(const unsigned us)
+{
+        struct timespec ts;
+
+        ts.tv_sec = us / 1000000;
+        ts.tv_nsec = (long) (us % 1000000) * 1000L;
+        nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Times pqos_sampler_read() over a subscription life cycle
+ *
+ * The groups are subscribed with a queue and read while the sampler
+ * runs. Their owner then stops them while still subscribed, samples
+ * have to keep coming until unsubscribe, after which reads have to
+ * fail and the cores have to be free for new groups.
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+bench_sampler(const char *backend, const unsigned groups,
+              struct pqos_mon_data *table, unsigned *cores)
+{
+        struct pqos_sampler_sub sub;
+        uint64_t *lat = NULL, *ts = NULL, *values = NULL, t0, wall;
+        unsigned i, n = 0, num = 0, started = 0, after_stop = 0;
+        int ret = PQOS_RETVAL_OK, sub_id = -1;
+        const char *step = "pqos_mon_start";
+
+        lat = calloc(m_bench.ops, sizeof(uint64_t));
+        ts = calloc(BENCH_SAMPLER_QUEUE, sizeof(uint64_t));
+        values = calloc((size_t) BENCH_SAMPLER_QUEUE * groups,
+                        sizeof(uint64_t));
+        if (lat==NULL || ts==NULL || values==NULL) {
+                ret = PQOS_RETVAL_RESOURCE;
+                goto exit;
+        }
+
+        for (started=0;started<groups && ret==PQOS_RETVAL_OK;started++)
+                ret = pqos_mon_start(1, &cores[started],
+                                     PQOS_MON_EVENT_L3_OCCUP, NULL,
+                                     &table[started]);
+        if (ret!=PQOS_RETVAL_OK) {
+                started--;
+                goto exit;
+        }
+
+        memset(&sub, 0, sizeof(sub));
+        sub.groups = table;
+        sub.num_groups = groups;
+        sub.interval = BENCH_SAMPLER_US;
+        sub.queue_size = BENCH_SAMPLER_QUEUE;
+        step = "pqos_sampler_subscribe";
+        ret = pqos_sampler_subscribe(&sub, &sub_id);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+        step = "pqos_sampler_start";
+        ret = pqos_sampler_start(-1);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        step = "pqos_sampler_read";
+        t0 = bench_ns();
+        for (i=0;i<m_bench.ops && ret==PQOS_RETVAL_OK;i++) {
+                uint64_t t1 = bench_ns();
+
+                ret = pqos_sampler_read(sub_id, BENCH_SAMPLER_QUEUE, &num,
+                                        ts, values, NULL);
+                lat[n++] = bench_ns() - t1;
+                bench_sleep(BENCH_SAMPLER_US / 4);
+        }
+        wall = bench_ns() - t0;
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        /**
+         * Owner lets go of the groups, the subscription keeps them
+         */
+        step = "pqos_mon_stop";
+        for (;started>0 && ret==PQOS_RETVAL_OK;started--)
+                ret = pqos_mon_stop(&table[started - 1]);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+        step = "pqos_sampler_read after pqos_mon_stop";
+        for (i=0;i<BENCH_SAMPLER_TRIES && after_stop==0 &&
+                     ret==PQOS_RETVAL_OK;i++) {
+                bench_sleep(BENCH_SAMPLER_US);
+                ret = pqos_sampler_read(sub_id, BENCH_SAMPLER_QUEUE,
+                                        &after_stop, ts, values, NULL);
+        }
+        if (ret==PQOS_RETVAL_OK && after_stop==0)
+                ret = PQOS_RETVAL_ERROR;
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        step = "pqos_sampler_unsubscribe";
+        ret = pqos_sampler_unsubscribe(sub_id);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+        step = "pqos_sampler_read after unsubscribe";
+        i = (unsigned) sub_id;
+        sub_id = -1;
+        if (pqos_sampler_read((int) i, BENCH_SAMPLER_QUEUE, &num, ts, values,
+                              NULL)!=PQOS_RETVAL_PARAM) {
+                ret = PQOS_RETVAL_ERROR;
+                goto exit;
+        }
+
+        /**
+         * Released RMIDs and cores are available again
+         */
+        step = "pqos_mon_start after unsubscribe";
+        for (started=0;started<groups && ret==PQOS_RETVAL_OK;started++)
+                ret = pqos_mon_start(1, &cores[started],
+                                     PQOS_MON_EVENT_L3_OCCUP, NULL,
+                                     &table[started]);
+        if (ret!=PQOS_RETVAL_OK)
+                started--;
+        else
+                bench_report(backend, "pqos_sampler_read", groups, 1,
+                             groups, lat, n, wall);
+
+ exit:
+        if (ret!=PQOS_RETVAL_OK)
+                fprintf(stderr, "%s: %s failed with %d at %u groups\n",
+                        backend, step, ret, groups);
+        (void) pqos_sampler_stop();
+        if (sub_id>=0)
+                (void) pqos_sampler_unsubscribe(sub_id);
+        while (started>0)
+                (void) pqos_mon_stop(&table[--started]);
+        free(lat);
+        free(ts);
+        free(values);
+        return ret;
+}
+
+/**
+ * @brief Times pqos_init() and pqos_fini() pairs
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+bench_init(const char *backend, struct pqos_config *cfg)
+{
+        const unsigned n = (m_bench.ops>=10) ? m_bench.ops / 10 : 1;
+        uint64_t *lat_init, *lat_fini, t0, t1, wall = 0;
+        unsigned i;
+        int ret = PQOS_RETVAL_OK;
+
+        lat_init = calloc(n, sizeof(uint64_t));
+        lat_fini = calloc(n, sizeof(uint64_t));
+        if (lat_init==NULL || lat_fini==NULL) {
+                free(lat_init);
+                free(lat_fini);
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        for (i=0;i<n && ret==PQOS_RETVAL_OK;i++) {
+                /**
+                 * The library closes the log file on fini
+                 */
+                cfg->fd_log = dup(STDERR_FILENO);
+                t0 = bench_ns();
+                ret = pqos_init(cfg);
+                t1 = bench_ns();
+                if (ret!=PQOS_RETVAL_OK) {
+                        close(cfg->fd_log);
+                        break;
+                }
+                lat_init[i] = t1 - t0;
+                ret = pqos_fini();
+                lat_fini[i] = bench_ns() - t1;
+                wall += bench_ns() - t0;
+        }
+
+        if (ret==PQOS_RETVAL_OK) {
+                bench_report(backend, "pqos_init", 0, 1, 1, lat_init, n,
+                             wall);
+                bench_report(backend, "pqos_fini", 0, 1, 1, lat_fini, n,
+                             wall);
+        }
+        free(lat_init);
+        free(lat_fini);
+        return ret;
+}
+
+/**
+ * @brief Runs all benchmarks on one backend
+ *
+ * @param [in] backend "sim" or "real"
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+bench_backend(const char *backend)
+{
+        const struct pqos_cpuinfo *cpu = NULL;
+        const struct pqos_cap *cap = NULL;
+        struct pqos_config cfg;
+        struct pqos_mon_data *table = NULL;
+        unsigned *cores = NULL, *saved = NULL;
+        unsigned gi, ti, i, max_groups = 0;
+        int ret;
+
+        memset(&cfg, 0, sizeof(cfg));
+        cfg.free_in_use_rmid = m_bench.free_in_use_rmid;
+        if (strcasecmp(backend, "sim")==0) {
+                ret = sim_init(m_bench.sim_spec, &cfg);
+                if (ret!=PQOS_RETVAL_OK) {
+                        fprintf(stderr, "Invalid simulated platform "
+                                "specification '%s'!\n", m_bench.sim_spec);
+                        return ret;
+                }
+        } else if (strcasecmp(backend, "real")!=0) {
+                fprintf(stderr, "Unknown backend '%s'!\n", backend);
+                return PQOS_RETVAL_PARAM;
+        }
+
+        /**
+         * Missing MSR access only skips the hardware
+         */
+        ret = bench_init(backend, &cfg);
+        if (ret!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "%s: pqos_init() failed with %d, "
+                        "skipped\n", backend, ret);
+                if (strcasecmp(backend, "real")==0)
+                        ret = PQOS_RETVAL_OK;
+                goto bench_exit;
+        }
+
+        cfg.fd_log = dup(STDERR_FILENO);
+        ret = pqos_init(&cfg);
+        if (ret!=PQOS_RETVAL_OK) {
+                close(cfg.fd_log);
+                goto bench_exit;
+        }
+        ret = pqos_cap_get(&cap, &cpu);
+        if (ret!=PQOS_RETVAL_OK)
+                goto bench_fini;
+
+        for (gi=0;gi<m_bench.num_groups;gi++)
+                if (m_bench.groups[gi]>max_groups)
+                        max_groups = m_bench.groups[gi];
+        if (max_groups>cpu->num_cores)
+                max_groups = cpu->num_cores;
+
+        table = calloc(max_groups, sizeof(*table));
+        cores = calloc(max_groups, sizeof(*cores));
+        saved = calloc(max_groups, sizeof(*saved));
+        if (table==NULL || cores==NULL || saved==NULL) {
+                ret = PQOS_RETVAL_RESOURCE;
+                goto bench_fini;
+        }
+        for (i=0;i<max_groups && ret==PQOS_RETVAL_OK;i++) {
+                cores[i] = cpu->cores[i].lcore;
+                ret = pqos_l3ca_assoc_get(cores[i], &saved[i]);
+        }
+        if (ret!=PQOS_RETVAL_OK)
+                goto bench_fini;
+
+        for (gi=0;gi<m_bench.num_groups && ret==PQOS_RETVAL_OK;gi++) {
+                const unsigned groups = m_bench.groups[gi];
+
+                if (groups>cpu->num_cores) {
+                        fprintf(stderr, "%s: %u groups exceed %u cores, "
+                                "skipped\n", backend, groups,
+                                cpu->num_cores);
+                        continue;
+                }
+                for (ti=0;ti<m_bench.num_threads && ret==PQOS_RETVAL_OK;
+                     ti++) {
+                        const unsigned threads = m_bench.threads[ti];
+
+                        if (threads>groups)
+                                continue;
+                        ret = bench_run(backend, BENCH_MON_START, groups,
+                                        threads, table, cores);
+                        if (ret!=PQOS_RETVAL_OK)
+                                break;
+
+                        /**
+                         * Polling needs started groups
+                         */
+                        for (i=0;i<groups && ret==PQOS_RETVAL_OK;i++)
+                                ret = pqos_mon_start(1, &cores[i],
+                                                     PQOS_MON_EVENT_L3_OCCUP,
+                                                     NULL, &table[i]);
+                        if (ret==PQOS_RETVAL_OK)
+                                ret = bench_run(backend, BENCH_MON_POLL,
+                                                groups, threads, table,
+                                                cores);
+                        while (i>0)
+                                (void) pqos_mon_stop(&table[--i]);
+                        if (ret!=PQOS_RETVAL_OK)
+                                break;
+
+                        ret = bench_run(backend, BENCH_ASSOC_SET, groups,
+                                        threads, table, cores);
+                }
+                if (ret==PQOS_RETVAL_OK)
+                        ret = bench_sampler(backend, groups, table, cores);
+        }
+
+        /**
+         * Restore core associations changed by the benchmark
+         */
+        for (i=0;i<max_groups;i++)
+                if (pqos_l3ca_assoc_set(cores[i], saved[i])!=
+                    PQOS_RETVAL_OK) {
+                        fprintf(stderr, "%s: failed to restore core %u "
+                                "association!\n", backend, cores[i]);
+                        ret = PQOS_RETVAL_ERROR;
+                }
+
+ bench_fini:
+        (void) pqos_fini();
+ bench_exit:
+        free(table);
+        free(cores);
+        free(saved);
+        if (strcasecmp(backend, "sim")==0)
+                sim_fini();
+        return ret;
+}
+
+/**
+ * @brief Parses comma separated list of positive numbers
+ *
+ * @return Number of items or 0 on error
+ */
+static unsigned
+bench_parse_list(const char *str, unsigned *list, const unsigned max)
+{
+        unsigned n = 0;
+
+        while (*str!='\0' && n<max) {
+                char *end = NULL;
+                unsigned long v = strtoul(str, &end, 0);
+
+                if (end==str || v==0 || (*end!=',' && *end!='\0'))
+                        return 0;
+                list[n++] = (unsigned) v;
+                str = (*end==',') ? end + 1 : end;
+        }
+        return (*str=='\0') ? n : 0;
+}
+
+static void
+bench_usage(const char *name)
+{
+        printf("Usage: %s [-b <sim|real>[,...]] [-g <groups>[,...]] "
+               "[-t <threads>[,...]]\n"
+               "          [-n <ops>] [-s <sim spec>] [-r] "
+               "[-o <output file>]\n"
+               "\t-b\tbackends to measure (default sim,real, real is "
+               "skipped\n\t\twithout MSR access)\n"
+               "\t-g\tmonitoring group counts (default 1,8,64)\n"
+               "\t-t\tcalling thread counts (default 1,2,4)\n"
+               "\t-n\ttimed calls per thread and measurement "
+               "(default 1000)\n"
+               "\t-s\tsimulated platform (default \"%s\")\n"
+               "\t-r\tuse RMIDs in use by other processes\n"
+               "\t-o\toutput file (default stdout)\n"
+               "Records: backend,api,groups,threads,items,ops,seconds,"
+               "ops_per_s,\n"
+               "         min_ns,p50_ns,p90_ns,p99_ns,max_ns,mean_ns\n"
+               "items is the number of groups one pqos_mon_poll() or "
+               "pqos_sampler_read() call\nreads. Start/stop and init/fini "
+               "are timed in pairs and report the wall time\nof the "
+               "pairs.\n", name, BENCH_DEF_SIM);
+}
+
+int main(int argc, char **argv)
+{
+        char *backends = NULL, *tok, *saveptr = NULL;
+        const char *output = NULL;
+        int opt, exit_val = EXIT_SUCCESS;
+
+        m_bench.groups[0] = 1;
+        m_bench.groups[1] = 8;
+        m_bench.groups[2] = 64;
+        m_bench.num_groups = 3;
+        m_bench.threads[0] = 1;
+        m_bench.threads[1] = 2;
+        m_bench.threads[2] = 4;
+        m_bench.num_threads = 3;
+        m_bench.ops = 1000;
+        m_bench.sim_spec = BENCH_DEF_SIM;
+
+        while ((opt = getopt(argc, argv, "b:g:t:n:s:ro:h"))!=-1) {
+                switch (opt) {
+                case 'b':
+                        free(backends);
+                        backends = strdup(optarg);
+                        break;
+                case 'g':
+                        m_bench.num_groups = bench_parse_list(optarg,
+                                m_bench.groups, BENCH_MAX_LIST);
+                        break;
+                case 't':
+                        m_bench.num_threads = bench_parse_list(optarg,
+                                m_bench.threads, BENCH_MAX_LIST);
+                        break;
+                case 'n':
+                        m_bench.ops = (unsigned) strtoul(optarg, NULL, 0);
+                        break;
+                case 's':
+                        m_bench.sim_spec = optarg;
+                        break;
+                case 'r':
+                        m_bench.free_in_use_rmid = 1;
+                        break;
+                case 'o':
+                        output = optarg;
+                        break;
+                case 'h':
+                        bench_usage(argv[0]);
+                        return EXIT_SUCCESS;
+                default:
+                        bench_usage(argv[0]);
+                        return EXIT_FAILURE;
+                }
+        }
+        if (m_bench.num_groups==0 || m_bench.num_threads==0 ||
+            m_bench.ops==0 || optind<argc) {
+                bench_usage(argv[0]);
+                free(backends);
+                return EXIT_FAILURE;
+        }
+        if (backends==NULL)
+                backends = strdup("sim,real");
+        if (backends==NULL)
+                return EXIT_FAILURE;
+
+        m_bench.fp = stdout;
+        if (output!=NULL) {
+                m_bench.fp = fopen(output, "w");
+                if (m_bench.fp==NULL) {
+                        perror("Output file open error");
+                        free(backends);
+                        return EXIT_FAILURE;
+                }
+        }
+
+        fprintf(m_bench.fp, "backend,api,groups,threads,items,ops,seconds,"
+                "ops_per_s,min_ns,p50_ns,p90_ns,p99_ns,max_ns,mean_ns\n");
+        for (tok=strtok_r(backends, ",", &saveptr); tok!=NULL;
+             tok=strtok_r(NULL, ",", &saveptr)) {
+                if (bench_backend(tok)!=PQOS_RETVAL_OK)
+                        exit_val = EXIT_FAILURE;
+        }
+
+        if (m_bench.fp!=stdout)
+                fclose(m_bench.fp);
+        free(backends);
+        return exit_val;
+}
@@ -0,0 +1,341 @@
+/**
+ * @file binfmt.c
+ * @brief Compact binary monitoring output format
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "binfmt.h"
+
+#define BINFMT_MAX_VARINT  10                   /**< max bytes of 64-bit varint */
+#define BINFMT_MAX_ITEMS   (1U << 20)           /**< sanity limit of header lists */
+
+/**
+ * @brief Encodes \a v as unsigned LEB128 varint
+ *
+ * @param [out] p buffer, at least BINFMT_MAX_VARINT bytes
+ * @param [in] v value
+ *
+ * @return Number of bytes used
+ */
+static unsigned
+varint_encode(uint8_t *p, uint64_t v)
+{
+        unsigned n = 0;
+
+        while (v>=0x80) {
+                p[n++] = (uint8_t) (v | 0x80);
+                v >>= 7;
+        }
+        p[n++] = (uint8_t) v;
+        return n;
+}
+
+/**
+ * @brief Writes varint to stream
+ */
+static int
+varint_put(FILE *fp, const uint64_t v)
+{
+        uint8_t buf[BINFMT_MAX_VARINT];
+        const unsigned n = varint_encode(buf, v);
+
+        return (fwrite(buf, 1, n, fp)==n) ? 0 : -1;
+}
+
+/**
+ * @brief Reads varint from stream
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 end of stream or invalid varint
+ */
+static int
+varint_get(FILE *fp, uint64_t *v)
+{
+        unsigned shift = 0;
+        uint64_t r = 0;
+        int c;
+
+        do {
+                c = getc(fp);
+                if (c==EOF || shift>=64)
+                        return -1;
+                r |= ((uint64_t) (c & 0x7f)) << shift;
+                shift += 7;
+        } while (c & 0x80);
+
+        *v = r;
+        return 0;
+}
+
+/**
+ * @brief Reads 32-bit varint from stream
+ */
+static int
+varint_get32(FILE *fp, uint32_t *v)
+{
+        uint64_t r;
+
+        if (varint_get(fp, &r)!=0 || r>UINT32_MAX)
+                return -1;
+        *v = (uint32_t) r;
+        return 0;
+}
+
+/**
+ * @brief Maps signed difference onto unsigned value, small
+ *        magnitudes give small values
+ */
+static uint64_t
+zigzag_encode(const int64_t v)
+{
+        return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+/**
+ * @brief Reverts zigzag_encode()
+ */
+static int64_t
+zigzag_decode(const uint64_t v)
+{
+        return (int64_t) (v >> 1) ^ -((int64_t) (v & 1));
+}
+
+int
+binfmt_write_header(FILE *fp, struct binfmt_writer *w,
+                    const struct binfmt_header *hdr)
+{
+        int ret = 0;
+        uint32_t i, j;
+
+        if (fp==NULL || w==NULL || hdr==NULL)
+                return -1;
+
+        memset(w, 0, sizeof(*w));
+        w->fp = fp;
+        w->num_groups = hdr->num_groups;
+        w->last_time = hdr->start;
+        w->last_values = calloc(hdr->num_groups + 1, sizeof(uint64_t));
+        w->buf = malloc((hdr->num_groups + 2) * BINFMT_MAX_VARINT);
+        if (w->last_values==NULL || w->buf==NULL) {
+                binfmt_writer_fini(w);
+                return -1;
+        }
+
+        if (fwrite(BINFMT_MAGIC, 1, BINFMT_MAGIC_SIZE, fp)!=BINFMT_MAGIC_SIZE)
+                return -1;
+        ret |= varint_put(fp, BINFMT_VERSION);
+        ret |= varint_put(fp, hdr->start);
+        ret |= varint_put(fp, hdr->interval);
+        ret |= varint_put(fp, hdr->scale_factor);
+
+        ret |= varint_put(fp, hdr->num_cores);
+        for (i=0;i<hdr->num_cores;i++) {
+                ret |= varint_put(fp, hdr->cores[i].lcore);
+                ret |= varint_put(fp, hdr->cores[i].socket);
+                ret |= varint_put(fp, hdr->cores[i].cluster);
+        }
+
+        ret |= varint_put(fp, hdr->num_events);
+        for (i=0;i<hdr->num_events;i++)
+                ret |= varint_put(fp, hdr->events[i]);
+
+        ret |= varint_put(fp, hdr->num_groups);
+        for (i=0;i<hdr->num_groups;i++) {
+                const struct binfmt_group *g = &hdr->groups[i];
+
+                ret |= varint_put(fp, g->socket);
+                ret |= varint_put(fp, g->rmid);
+                ret |= varint_put(fp, g->event);
+                ret |= varint_put(fp, g->num_cores);
+                for (j=0;j<g->num_cores;j++)
+                        ret |= varint_put(fp, g->cores[j]);
+        }
+        return ret;
+}
+
+int
+binfmt_write_sample(struct binfmt_writer *w, const uint64_t time,
+                    const uint64_t *values)
+{
+        unsigned n = 0;
+        uint32_t i;
+
+        if (w==NULL || w->buf==NULL || values==NULL)
+                return -1;
+
+        w->buf[n++] = BINFMT_REC_SAMPLE;
+        n += varint_encode(&w->buf[n],
+                           (time>w->last_time) ? time - w->last_time : 0);
+        if (time>w->last_time)
+                w->last_time = time;
+
+        for (i=0;i<w->num_groups;i++) {
+                const int64_t d = (int64_t) (values[i] - w->last_values[i]);
+
+                n += varint_encode(&w->buf[n], zigzag_encode(d));
+                w->last_values[i] = values[i];
+        }
+
+        return (fwrite(w->buf, 1, n, w->fp)==n) ? 0 : -1;
+}
+
+void
+binfmt_writer_fini(struct binfmt_writer *w)
+{
+        if (w==NULL)
+                return;
+        free(w->last_values);
+        free(w->buf);
+        memset(w, 0, sizeof(*w));
+}
+
+/**
+ * @brief Releases header lists
+ */
+static void
+binfmt_header_free(struct binfmt_header *hdr)
+{
+        uint32_t i;
+
+        if (hdr->groups!=NULL)
+                for (i=0;i<hdr->num_groups;i++)
+                        free(hdr->groups[i].cores);
+        free(hdr->groups);
+        free(hdr->events);
+        free(hdr->cores);
+        memset(hdr, 0, sizeof(*hdr));
+}
+
+/**
+ * @brief Decodes header that follows the magic
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 corrupted header
+ */
+static int
+binfmt_read_header(struct binfmt_reader *r)
+{
+        struct binfmt_header *hdr = &r->hdr;
+        FILE *fp = r->fp;
+        uint32_t i, j;
+
+        binfmt_header_free(hdr);
+        free(r->values);
+        r->values = NULL;
+
+        if (varint_get32(fp, &hdr->version)!=0 ||
+            hdr->version!=BINFMT_VERSION ||
+            varint_get(fp, &hdr->start)!=0 ||
+            varint_get(fp, &hdr->interval)!=0 ||
+            varint_get32(fp, &hdr->scale_factor)!=0)
+                return -1;
+
+        if (varint_get32(fp, &hdr->num_cores)!=0 ||
+            hdr->num_cores>BINFMT_MAX_ITEMS)
+                return -1;
+        hdr->cores = calloc(hdr->num_cores + 1, sizeof(hdr->cores[0]));
+        if (hdr->cores==NULL)
+                return -1;
+        for (i=0;i<hdr->num_cores;i++)
+                if (varint_get32(fp, &hdr->cores[i].lcore)!=0 ||
+                    varint_get32(fp, &hdr->cores[i].socket)!=0 ||
+                    varint_get32(fp, &hdr->cores[i].cluster)!=0)
+                        return -1;
+
+        if (varint_get32(fp, &hdr->num_events)!=0 ||
+            hdr->num_events>BINFMT_MAX_ITEMS)
+                return -1;
+        hdr->events = calloc(hdr->num_events + 1, sizeof(hdr->events[0]));
+        if (hdr->events==NULL)
+                return -1;
+        for (i=0;i<hdr->num_events;i++)
+                if (varint_get32(fp, &hdr->events[i])!=0)
+                        return -1;
+
+        if (varint_get32(fp, &hdr->num_groups)!=0 ||
+            hdr->num_groups>BINFMT_MAX_ITEMS)
+                return -1;
+        hdr->groups = calloc(hdr->num_groups + 1, sizeof(hdr->groups[0]));
+        r->values = calloc(hdr->num_groups + 1, sizeof(r->values[0]));
+        if (hdr->groups==NULL || r->values==NULL)
+                return -1;
+        for (i=0;i<hdr->num_groups;i++) {
+                struct binfmt_group *g = &hdr->groups[i];
+
+                if (varint_get32(fp, &g->socket)!=0 ||
+                    varint_get32(fp, &g->rmid)!=0 ||
+                    varint_get32(fp, &g->event)!=0 ||
+                    varint_get32(fp, &g->num_cores)!=0 ||
+                    g->num_cores>BINFMT_MAX_ITEMS)
+                        return -1;
+                g->cores = calloc(g->num_cores + 1, sizeof(g->cores[0]));
+                if (g->cores==NULL)
+                        return -1;
+                for (j=0;j<g->num_cores;j++)
+                        if (varint_get32(fp, &g->cores[j])!=0)
+                                return -1;
+        }
+
+        r->time = hdr->start;
+        return 0;
+}
+
+void
+binfmt_reader_init(FILE *fp, struct binfmt_reader *r)
+{
+        memset(r, 0, sizeof(*r));
+        r->fp = fp;
+}
+
+int
+binfmt_read(struct binfmt_reader *r)
+{
+        char magic[BINFMT_MAGIC_SIZE];
+        uint64_t v;
+        uint32_t i;
+        int c;
+
+        c = getc(r->fp);
+        if (c==EOF)
+                return 0;
+
+        if (c==BINFMT_REC_HEADER) {
+                magic[0] = (char) c;
+                if (fread(&magic[1], 1, BINFMT_MAGIC_SIZE-1, r->fp)!=
+                    BINFMT_MAGIC_SIZE-1 ||
+                    memcmp(magic, BINFMT_MAGIC, BINFMT_MAGIC_SIZE)!=0)
+                        return -1;
+                return (binfmt_read_header(r)==0) ? BINFMT_REC_HEADER : -1;
+        }
+
+        /**
+         * Samples have to follow a header
+         */
+        if (c!=BINFMT_REC_SAMPLE || r->values==NULL)
+                return -1;
+
+        if (varint_get(r->fp, &v)!=0)
+                return -1;
+        r->time += v;
+        for (i=0;i<r->hdr.num_groups;i++) {
+                if (varint_get(r->fp, &v)!=0)
+                        return -1;
+                r->values[i] += (uint64_t) zigzag_decode(v);
+        }
+        return BINFMT_REC_SAMPLE;
+}
+
+void
+binfmt_reader_fini(struct binfmt_reader *r)
+{
+        if (r==NULL)
+                return;
+        binfmt_header_free(&r->hdr);
+        free(r->values);
+        r->values = NULL;
+}
@@ -0,0 +1,184 @@
+/**
+ * @file binfmt.h
+ * @brief Compact binary monitoring output format
+ *
+ * Stream is a sequence of records written append-only, it can go to
+ * a pipe and runs can be appended to an existing file.
+ *
+ * Header record starts every run:
+ *     "PQOSBIN1" magic, then unsigned LEB128 varints:
+ *     version, start time (CLOCK_REALTIME ns), interval (us),
+ *     scale factor (event value to bytes),
+ *     number of cores, per core: lcore, socket, cluster,
+ *     number of events, per event: event id,
+ *     number of groups, per group: socket, rmid, event,
+ *     number of cores, cores
+ *
+ * Sample record:
+ *     'S', varint time delta (ns) from the previous sample or from
+ *     the start time, then one zigzag varint per group in header order
+ *     holding difference of the raw event value from the previous
+ *     sample of the group (first sample holds differences from 0)
+ *
+ * A slowly changing occupancy value usually takes one or two bytes.
+ *
+ * Groups with core performance counter, frequency or power events
+ * are followed by extra groups of the same socket, RMID and cores
+ * with event BINFMT_EVENT_IPC, BINFMT_EVENT_MPKI, BINFMT_EVENT_FREQ,
+ * BINFMT_EVENT_PKG or BINFMT_EVENT_DRAM holding the metric
+ * in thousandths instead of a raw event value.
+ */
+
+#ifndef __BINFMT_H__
+#define __BINFMT_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BINFMT_MAGIC       "PQOSBIN1"
+#define BINFMT_MAGIC_SIZE  8
+#define BINFMT_VERSION     1
+
+#define BINFMT_EVENT_LLC   0x1                  /**< LLC occupancy, raw value */
+#define BINFMT_EVENT_MPKI  0x4000               /**< LLC misses per 1000
+                                                   instructions x 1000 */
+#define BINFMT_EVENT_IPC   0x8000               /**< instructions per cycle x 1000 */
+#define BINFMT_EVENT_FREQ  0x10000              /**< effective frequency in kHz */
+#define BINFMT_EVENT_PKG   0x20000              /**< package power in mW */
+#define BINFMT_EVENT_DRAM  0x40000              /**< DRAM power in mW */
+
+#define BINFMT_REC_HEADER  'P'                  /**< first magic character */
+#define BINFMT_REC_SAMPLE  'S'
+
+/**
+ * Core of the topology
+ */
+struct binfmt_core {
+        uint32_t lcore;
+        uint32_t socket;
+        uint32_t cluster;
+};
+
+/**
+ * Monitoring group
+ */
+struct binfmt_group {
+        uint32_t socket;
+        uint32_t rmid;
+        uint32_t event;
+        uint32_t num_cores;
+        uint32_t *cores;
+};
+
+/**
+ * Stream header
+ */
+struct binfmt_header {
+        uint32_t version;
+        uint64_t start;                         /**< CLOCK_REALTIME in ns */
+        uint64_t interval;                      /**< sampling interval in us */
+        uint32_t scale_factor;                  /**< event value to bytes */
+        uint32_t num_cores;
+        struct binfmt_core *cores;
+        uint32_t num_events;
+        uint32_t *events;
+        uint32_t num_groups;
+        struct binfmt_group *groups;
+};
+
+/**
+ * Encoder state
+ */
+struct binfmt_writer {
+        FILE *fp;
+        uint32_t num_groups;
+        uint64_t last_time;
+        uint64_t *last_values;
+        uint8_t *buf;                           /**< sample encoding buffer */
+};
+
+/**
+ * Decoder state
+ */
+struct binfmt_reader {
+        FILE *fp;
+        struct binfmt_header hdr;               /**< header of current run */
+        uint64_t time;                          /**< last sample time in ns */
+        uint64_t *values;                       /**< last sample raw values */
+};
+
+/**
+ * @brief Writes header record and resets encoder
+ *
+ * @param [in] fp output stream
+ * @param [out] w encoder state
+ * @param [in] hdr stream header
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int binfmt_write_header(FILE *fp, struct binfmt_writer *w,
+                        const struct binfmt_header *hdr);
+
+/**
+ * @brief Writes sample record
+ *
+ * @param [in,out] w encoder state
+ * @param [in] time CLOCK_REALTIME of the sample in ns
+ * @param [in] values raw event values, one per group
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int binfmt_write_sample(struct binfmt_writer *w, const uint64_t time,
+                        const uint64_t *values);
+
+/**
+ * @brief Releases encoder resources
+ *
+ * @param [in,out] w encoder state
+ */
+void binfmt_writer_fini(struct binfmt_writer *w);
+
+/**
+ * @brief Initializes decoder
+ *
+ * @param [in] fp input stream
+ * @param [out] r decoder state
+ */
+void binfmt_reader_init(FILE *fp, struct binfmt_reader *r);
+
+/**
+ * @brief Decodes next record
+ *
+ * After a header record \a r hdr describes the run, after a sample
+ * record \a r time and \a r values hold the decoded sample.
+ *
+ * @param [in,out] r decoder state
+ *
+ * @return Record type
+ * @retval BINFMT_REC_HEADER header decoded
+ * @retval BINFMT_REC_SAMPLE sample decoded
+ * @retval 0 end of stream
+ * @retval -1 corrupted stream
+ */
+int binfmt_read(struct binfmt_reader *r);
+
+/**
+ * @brief Releases decoder resources
+ *
+ * @param [in,out] r decoder state
+ */
+void binfmt_reader_fini(struct binfmt_reader *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BINFMT_H__ */
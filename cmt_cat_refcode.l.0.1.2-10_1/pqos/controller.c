@@ -0,0 +1,763 @@
+/**
+ * @file controller.c
+ * @brief Closed-loop dynamic cache partitioning controller
+ *
+ * Policy:
+ * - utility of an extra way for a class grows with its partition fill
+ *   level above the saturation point (class is capacity bound)
+ * - cost of taking a way away from a class is the part of its current
+ *   occupancy that would not fit into the smaller partition
+ * - where IPC is monitored, gain and cost are scaled by the cache
+ *   sensitivity of the class, its relative IPC change per way measured
+ *   since its last resize, a class below \a ipc_threshold neither needs
+ *   nor misses a way; occupancy alone is used until it is measured
+ * - one way at a time moves from the cheapest donor to the most
+ *   demanding receiver if the net gain exceeds the hysteresis
+ * - a move is not made if the same rule applied to the partitions after
+ *   it would move the way straight back, classes that are both capacity
+ *   bound keep their partitions instead of trading a way every period
+ * - the same decision has to be made for \a hold consecutive periods
+ *   and reconfigurations of a socket are at least \a period seconds apart
+ * - no class goes below its guaranteed number of ways
+ * - masks and core associations found at start are restored at exit
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+#include "controller.h"
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+#ifdef DEBUG
+#define ASSERT assert
+#else
+#define ASSERT(x)
+#endif
+
+/**
+ * Class of service managed by the controller
+ */
+struct ctrl_class {
+        unsigned class_id;
+        unsigned min_ways;                      /**< guaranteed ways */
+        unsigned ways;                          /**< currently assigned ways */
+        unsigned num_cores;
+        unsigned *cores;
+        struct pqos_mon_data group;             /**< occupancy monitoring group */
+        int mon_ok;                             /**< true if group is running */
+        double occupancy;                       /**< last sampled occupancy in bytes */
+        double ipc;                             /**< last sampled IPC, 0 if
+                                                   not monitored */
+        double ipc_ref;                         /**< IPC before the last resize,
+                                                   0 if not known */
+        unsigned ways_ref;                      /**< ways before the last resize */
+        double sensitivity;                     /**< relative IPC change per way,
+                                                   negative if not known */
+};
+
+/**
+ * Controller state of a single CPU socket
+ */
+struct ctrl_socket {
+        unsigned socket;
+        unsigned num_classes;
+        struct ctrl_class classes[PQOS_MAX_L3CA_COS];
+        int pending_donor;                      /**< last decision: donor class index */
+        int pending_recv;                       /**< last decision: receiver class index */
+        unsigned pending_count;                 /**< number of periods it persisted for */
+        double last_reconfig;                   /**< time of last reconfiguration */
+        unsigned num_reconfig;                  /**< number of reconfigurations made */
+        struct pqos_l3ca saved_ca[PQOS_MAX_L3CA_COS];   /**< masks at start */
+        unsigned saved_num_ca;
+        unsigned *saved_cores;                  /**< cores of the socket */
+        unsigned *saved_cos;                    /**< their classes at start */
+        unsigned saved_num_cores;
+};
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+ctrl_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+void
+ctrl_config_default(struct ctrl_config *cfg)
+{
+        unsigned i;
+
+        ASSERT(cfg!=NULL);
+        memset(cfg, 0, sizeof(*cfg));
+        for (i=0;i<DIM(cfg->min_ways);i++)
+                cfg->min_ways[i] = 1;
+        cfg->hysteresis = 0.25;
+        cfg->hold = 3;
+        cfg->period = 5;
+        cfg->step = 1;
+        cfg->saturation = 0.9;
+        cfg->ipc_threshold = 0.01;
+}
+
+int
+ctrl_config_parse(struct ctrl_config *cfg, const char *opts)
+{
+        char *cp = NULL, *tok = NULL, *saveptr = NULL;
+        int ret = PQOS_RETVAL_OK;
+
+        if (cfg==NULL)
+                return PQOS_RETVAL_PARAM;
+        if (opts==NULL)
+                return PQOS_RETVAL_OK;
+
+        cp = strdup(opts);
+        if (cp==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (tok=strtok_r(cp, ",", &saveptr); tok!=NULL;
+             tok=strtok_r(NULL, ",", &saveptr)) {
+                char *val = strchr(tok, '=');
+
+                if (val==NULL) {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+                *val++ = '\0';
+
+                if (strcasecmp(tok, "min")==0) {
+                        char *p = strchr(val, ':');
+                        unsigned i;
+
+                        if (p==NULL) {
+                                for (i=0;i<DIM(cfg->min_ways);i++)
+                                        cfg->min_ways[i] = (unsigned) strtoul(val, NULL, 0);
+                        } else {
+                                i = (unsigned) strtoul(val, NULL, 0);
+                                if (i>=DIM(cfg->min_ways)) {
+                                        ret = PQOS_RETVAL_PARAM;
+                                        break;
+                                }
+                                cfg->min_ways[i] = (unsigned) strtoul(p+1, NULL, 0);
+                        }
+                } else if (strcasecmp(tok, "hysteresis")==0) {
+                        cfg->hysteresis = strtod(val, NULL);
+                } else if (strcasecmp(tok, "hold")==0) {
+                        cfg->hold = (unsigned) strtoul(val, NULL, 0);
+                } else if (strcasecmp(tok, "period")==0) {
+                        cfg->period = (unsigned) strtoul(val, NULL, 0);
+                } else if (strcasecmp(tok, "step")==0) {
+                        cfg->step = (unsigned) strtoul(val, NULL, 0);
+                } else if (strcasecmp(tok, "saturation")==0) {
+                        cfg->saturation = strtod(val, NULL);
+                } else if (strcasecmp(tok, "ipc")==0) {
+                        cfg->ipc_threshold = strtod(val, NULL);
+                } else {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+        }
+
+        free(cp);
+
+        if (ret==PQOS_RETVAL_OK &&
+            (cfg->step==0 || cfg->saturation<=0.0 || cfg->saturation>=1.0 ||
+             cfg->hysteresis<0.0 || cfg->ipc_threshold<=0.0))
+                ret = PQOS_RETVAL_PARAM;
+
+        return ret;
+}
+
+/**
+ * @brief Weight of class \a c occupancy based gain and loss
+ *
+ * @return Measured cache sensitivity over \a threshold limited to 1,
+ *         1 if it is not known
+ */
+static double
+ctrl_weight(const struct ctrl_class *c, const double threshold)
+{
+        if (c->sensitivity<0.0)
+                return 1.0;
+        if (c->sensitivity>=threshold)
+                return 1.0;
+        return c->sensitivity / threshold;
+}
+
+/**
+ * @brief Value of one extra way for class \a c
+ *
+ * @return Expected number of extra ways of data the class would keep,
+ *         scaled by its cache sensitivity
+ */
+static double
+ctrl_gain(const struct ctrl_class *c,
+          const double way_size,
+          const struct ctrl_config *cfg)
+{
+        double fill;
+
+        if (!c->mon_ok || c->ways==0)
+                return 0.0;
+
+        fill = c->occupancy / (way_size * (double) c->ways);
+        if (fill<=cfg->saturation)
+                return 0.0;
+        if (fill>=1.0)
+                return ctrl_weight(c, cfg->ipc_threshold);
+        return ctrl_weight(c, cfg->ipc_threshold) *
+                (fill - cfg->saturation) / (1.0 - cfg->saturation);
+}
+
+/**
+ * @brief Cost of taking one way away from class \a c
+ *
+ * @return Number of ways of currently cached data that would not fit,
+ *         scaled by its cache sensitivity
+ */
+static double
+ctrl_loss(const struct ctrl_class *c,
+          const double way_size,
+          const struct ctrl_config *cfg)
+{
+        double excess;
+
+        if (!c->mon_ok)
+                return 1.0;
+
+        excess = c->occupancy - (way_size * (double) (c->ways - 1));
+        if (excess<=0.0)
+                return 0.0;
+        if (excess>=way_size)
+                return ctrl_weight(c, cfg->ipc_threshold);
+        return ctrl_weight(c, cfg->ipc_threshold) * excess / way_size;
+}
+
+/**
+ * @brief Selects best donor and receiver classes on socket \a s
+ *
+ * @return 1 if moving a way from donor to receiver is beneficial
+ */
+static int
+ctrl_select(const struct ctrl_socket *s,
+            const struct ctrl_config *cfg,
+            const double way_size,
+            int *p_donor,
+            int *p_recv)
+{
+        double best_gain = 0.0, best_loss = 0.0;
+        int donor = -1, recv = -1;
+        unsigned i;
+
+        for (i=0;i<s->num_classes;i++) {
+                double g = ctrl_gain(&s->classes[i], way_size, cfg);
+
+                if (recv<0 || g>best_gain) {
+                        best_gain = g;
+                        recv = (int) i;
+                }
+        }
+
+        for (i=0;i<s->num_classes;i++) {
+                const struct ctrl_class *c = &s->classes[i];
+                double l;
+
+                if ((int) i==recv || c->ways<=c->min_ways)
+                        continue;
+                l = ctrl_loss(c, way_size, cfg);
+                if (donor<0 || l<best_loss) {
+                        best_loss = l;
+                        donor = (int) i;
+                }
+        }
+
+        if (donor<0 || recv<0)
+                return 0;
+        if ((best_gain - best_loss) <= cfg->hysteresis)
+                return 0;
+
+        *p_donor = donor;
+        *p_recv = recv;
+        return 1;
+}
+
+/**
+ * @brief Selects a way move on socket \a s that is stable
+ *
+ * The move is checked against the partitions after it with the
+ * same occupancies, if it would then be reversed it is not made.
+ *
+ * @return 1 if moving a way from donor to receiver is beneficial
+ */
+static int
+ctrl_decide(const struct ctrl_socket *s,
+            const struct ctrl_config *cfg,
+            const double way_size,
+            int *p_donor,
+            int *p_recv)
+{
+        struct ctrl_socket after;
+        int donor = -1, recv = -1, back_donor = -1, back_recv = -1;
+
+        if (!ctrl_select(s, cfg, way_size, &donor, &recv))
+                return 0;
+
+        after = *s;
+        after.classes[donor].ways--;
+        after.classes[recv].ways++;
+        if (ctrl_select(&after, cfg, way_size, &back_donor, &back_recv) &&
+            back_donor==recv && back_recv==donor)
+                return 0;
+
+        *p_donor = donor;
+        *p_recv = recv;
+        return 1;
+}
+
+/**
+ * @brief Writes contiguous, back to back masks of socket \a s classes
+ */
+static int
+ctrl_apply(const struct ctrl_socket *s)
+{
+        struct pqos_l3ca tab[PQOS_MAX_L3CA_COS];
+        unsigned i, pos = 0;
+
+        for (i=0;i<s->num_classes;i++) {
+                const struct ctrl_class *c = &s->classes[i];
+
+                ASSERT(c->ways>0 && c->ways<64);
+                tab[i].class_id = c->class_id;
+                tab[i].ways_mask = ((1ULL << c->ways) - 1ULL) << pos;
+                pos += c->ways;
+        }
+
+        return pqos_l3ca_set(s->socket, s->num_classes, tab);
+}
+
+/**
+ * @brief Prints state of socket \a s classes
+ */
+static void
+ctrl_report(FILE *fp,
+            const struct ctrl_socket *s,
+            const double way_size,
+            const double t)
+{
+        unsigned i;
+
+        fprintf(fp, "%8.1f SOCKET %u:", t, s->socket);
+        for (i=0;i<s->num_classes;i++) {
+                const struct ctrl_class *c = &s->classes[i];
+
+                if (c->mon_ok && (c->group.event & PQOS_PERF_EVENT_IPC))
+                        fprintf(fp, " COS%u %2uw %9.1fkB (%3.0f%%) IPC %.2f",
+                                c->class_id, c->ways, c->occupancy / 1024.0,
+                                100.0 * c->occupancy / (way_size * (double) c->ways),
+                                c->ipc);
+                else if (c->mon_ok)
+                        fprintf(fp, " COS%u %2uw %9.1fkB (%3.0f%%)",
+                                c->class_id, c->ways, c->occupancy / 1024.0,
+                                100.0 * c->occupancy / (way_size * (double) c->ways));
+                else
+                        fprintf(fp, " COS%u %2uw       n/a", c->class_id, c->ways);
+        }
+        fputc('\n', fp);
+}
+
+/**
+ * @brief Discovers classes of service in use on \a socket,
+ *        saves their settings, assigns initial partitions
+ *        and starts monitoring
+ *
+ * IPC is monitored next to occupancy if \a ipc is set and
+ * the core performance counters can be started.
+ */
+static int
+ctrl_setup_socket(struct ctrl_socket *s,
+                  const unsigned socket,
+                  const struct pqos_cpuinfo *cpu,
+                  const struct ctrl_config *cfg,
+                  const struct pqos_cap_l3ca *l3ca,
+                  const int ipc)
+{
+        unsigned *cores = NULL, *cos = NULL;
+        unsigned i, j, n = 0, min_sum = 0, remain = 0;
+        int ret;
+
+        memset(s, 0, sizeof(*s));
+        s->socket = socket;
+        s->pending_donor = -1;
+        s->pending_recv = -1;
+
+        cores = (unsigned *) malloc(cpu->num_cores * sizeof(cores[0]));
+        cos = (unsigned *) malloc(cpu->num_cores * sizeof(cos[0]));
+        if (cores==NULL || cos==NULL) {
+                ret = PQOS_RETVAL_RESOURCE;
+                goto exit;
+        }
+
+        ret = pqos_cpu_get_cores(cpu, socket, cpu->num_cores, &n, cores);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        for (i=0;i<n;i++) {
+                ret = pqos_l3ca_assoc_get(cores[i], &cos[i]);
+                if (ret!=PQOS_RETVAL_OK)
+                        goto exit;
+        }
+
+        /**
+         * Masks and associations are restored by ctrl_cleanup_socket()
+         */
+        ret = pqos_l3ca_get(socket, DIM(s->saved_ca), &s->saved_num_ca,
+                            s->saved_ca);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+        s->saved_cores = cores;
+        s->saved_cos = cos;
+        s->saved_num_cores = n;
+
+        /**
+         * Classes with at least one core are managed
+         */
+        for (j=0;j<l3ca->num_classes && j<PQOS_MAX_L3CA_COS;j++) {
+                struct ctrl_class *c = &s->classes[s->num_classes];
+                unsigned k = 0;
+
+                for (i=0;i<n;i++)
+                        if (cos[i]==j)
+                                k++;
+                if (k==0)
+                        continue;
+
+                c->class_id = j;
+                c->min_ways = (cfg->min_ways[j]>0) ? cfg->min_ways[j] : 1;
+                c->cores = (unsigned *) malloc(k * sizeof(c->cores[0]));
+                if (c->cores==NULL) {
+                        ret = PQOS_RETVAL_RESOURCE;
+                        goto exit;
+                }
+                for (i=0;i<n;i++)
+                        if (cos[i]==j)
+                                c->cores[c->num_cores++] = cores[i];
+                min_sum += c->min_ways;
+                s->num_classes++;
+        }
+
+        if (s->num_classes==0 || min_sum>l3ca->num_ways) {
+                printf("Socket %u: cannot guarantee %u ways out of %u!\n",
+                       socket, min_sum, l3ca->num_ways);
+                ret = PQOS_RETVAL_PARAM;
+                goto exit;
+        }
+
+        /**
+         * Start from minimums and hand out remaining ways evenly
+         */
+        for (i=0;i<s->num_classes;i++)
+                s->classes[i].ways = s->classes[i].min_ways;
+        for (remain=l3ca->num_ways-min_sum; remain>0; remain--) {
+                unsigned m = 0;
+
+                for (i=1;i<s->num_classes;i++)
+                        if (s->classes[i].ways<s->classes[m].ways)
+                                m = i;
+                s->classes[m].ways++;
+        }
+
+        for (i=0;i<s->num_classes;i++) {
+                struct ctrl_class *c = &s->classes[i];
+
+                c->sensitivity = -1.0;
+                ret = PQOS_RETVAL_ERROR;
+                if (ipc)
+                        ret = pqos_mon_start(c->num_cores, c->cores,
+                                             (enum pqos_mon_event)
+                                             (PQOS_MON_EVENT_L3_OCCUP |
+                                              PQOS_PERF_EVENT_IPC),
+                                             c, &c->group);
+                if (ret!=PQOS_RETVAL_OK)
+                        ret = pqos_mon_start(c->num_cores, c->cores,
+                                             PQOS_MON_EVENT_L3_OCCUP, c,
+                                             &c->group);
+                if (ret!=PQOS_RETVAL_OK)
+                        printf("Socket %u: monitoring of COS%u failed, "
+                               "its partition will not change\n",
+                               socket, c->class_id);
+                c->mon_ok = (ret==PQOS_RETVAL_OK);
+        }
+
+        ret = ctrl_apply(s);
+
+ exit:
+        if (cores!=NULL && cores!=s->saved_cores)
+                free(cores);
+        if (cos!=NULL && cos!=s->saved_cos)
+                free(cos);
+        return ret;
+}
+
+/**
+ * @brief Stops monitoring, restores saved masks and associations
+ *        and frees resources of socket \a s
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+ctrl_cleanup_socket(struct ctrl_socket *s)
+{
+        unsigned i;
+        int ret = PQOS_RETVAL_OK;
+
+        for (i=0;i<s->num_classes;i++) {
+                struct ctrl_class *c = &s->classes[i];
+
+                if (c->mon_ok)
+                        (void) pqos_mon_stop(&c->group);
+                if (c->cores!=NULL)
+                        free(c->cores);
+                c->cores = NULL;
+                c->mon_ok = 0;
+        }
+        s->num_classes = 0;
+
+        if (s->saved_num_ca>0 &&
+            pqos_l3ca_set(s->socket, s->saved_num_ca,
+                          s->saved_ca)!=PQOS_RETVAL_OK) {
+                printf("Socket %u: failed to restore allocation masks!\n",
+                       s->socket);
+                ret = PQOS_RETVAL_ERROR;
+        }
+        for (i=0;i<s->saved_num_cores;i++)
+                if (pqos_l3ca_assoc_set(s->saved_cores[i],
+                                        s->saved_cos[i])!=PQOS_RETVAL_OK) {
+                        printf("Failed to restore core %u association!\n",
+                               s->saved_cores[i]);
+                        ret = PQOS_RETVAL_ERROR;
+                }
+        s->saved_num_ca = 0;
+        s->saved_num_cores = 0;
+        free(s->saved_cores);
+        free(s->saved_cos);
+        s->saved_cores = NULL;
+        s->saved_cos = NULL;
+        return ret;
+}
+
+/**
+ * @brief Runs single control period on socket \a s
+ */
+static void
+ctrl_step(FILE *fp,
+          struct ctrl_socket *s,
+          const struct ctrl_config *cfg,
+          const double way_size,
+          const uint32_t scale,
+          const double t)
+{
+        unsigned i, moved = 0;
+        int donor = -1, recv = -1;
+
+        for (i=0;i<s->num_classes;i++) {
+                struct ctrl_class *c = &s->classes[i];
+
+                if (!c->mon_ok)
+                        continue;
+                if (pqos_mon_poll(&c->group, 1)!=PQOS_RETVAL_OK)
+                        continue;
+                c->occupancy = (double) (c->group.value * scale);
+                if (!(c->group.event & PQOS_PERF_EVENT_IPC))
+                        continue;
+                c->ipc = c->group.ipc;
+
+                /**
+                 * Sensitivity follows the IPC at the current size
+                 * until the class is resized again
+                 */
+                if (c->ipc_ref>0.0 && c->ways!=c->ways_ref) {
+                        c->sensitivity = ((c->ipc - c->ipc_ref) / c->ipc_ref) /
+                                ((double) c->ways - (double) c->ways_ref);
+                        if (c->sensitivity<0.0)
+                                c->sensitivity = 0.0;
+                }
+        }
+
+        ctrl_report(fp, s, way_size, t);
+
+        if (!ctrl_decide(s, cfg, way_size, &donor, &recv)) {
+                s->pending_count = 0;
+                return;
+        }
+
+        if (donor==s->pending_donor && recv==s->pending_recv) {
+                s->pending_count++;
+        } else {
+                s->pending_donor = donor;
+                s->pending_recv = recv;
+                s->pending_count = 1;
+        }
+
+        if (s->pending_count<cfg->hold)
+                return;
+        if (s->num_reconfig>0 && (t - s->last_reconfig)<(double) cfg->period)
+                return;
+
+        /**
+         * IPC at the current sizes is the reference
+         * for the sensitivity after the move
+         */
+        for (i=0;i<s->num_classes;i++) {
+                s->classes[i].ipc_ref = s->classes[i].ipc;
+                s->classes[i].ways_ref = s->classes[i].ways;
+        }
+
+        /**
+         * Move ways one by one re-evaluating the decision
+         * with updated partition sizes
+         */
+        while (moved<cfg->step) {
+                s->classes[donor].ways--;
+                s->classes[recv].ways++;
+                fprintf(fp, "%8.1f SOCKET %u: COS%u -> COS%u 1 way\n", t,
+                        s->socket, s->classes[donor].class_id,
+                        s->classes[recv].class_id);
+                moved++;
+                if (!ctrl_decide(s, cfg, way_size, &donor, &recv))
+                        break;
+        }
+
+        if (ctrl_apply(s)!=PQOS_RETVAL_OK)
+                printf("Socket %u: cache allocation update failed!\n", s->socket);
+
+        s->last_reconfig = t;
+        s->num_reconfig++;
+        s->pending_count = 0;
+}
+
+int
+ctrl_run(FILE *fp,
+         const struct pqos_cap *cap,
+         const struct pqos_cpuinfo *cpu,
+         const struct ctrl_config *cfg,
+         const long interval,
+         const int sel_time,
+         const int *stop)
+{
+        const struct pqos_capability *cap_l3ca = NULL;
+        const struct pqos_monitor *l3mon = NULL, *ipcmon = NULL;
+        struct ctrl_socket *sockets = NULL;
+        unsigned *sock_ids = NULL;
+        unsigned sock_count = 0, i;
+        struct timespec next;
+        double t0, way_size;
+        int ret, ret2, ipc;
+
+        if (fp==NULL || cap==NULL || cpu==NULL || cfg==NULL ||
+            stop==NULL || interval<=0)
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqos_cap_get_type(cap, PQOS_CAP_TYPE_L3CA, &cap_l3ca);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("Allocation capability not detected!\n");
+                return ret;
+        }
+        ret = pqos_cap_get_event(cap, PQOS_MON_EVENT_L3_OCCUP, &l3mon);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("LLC occupancy monitoring not detected!\n");
+                return ret;
+        }
+        ipc = pqos_cap_get_event(cap, PQOS_PERF_EVENT_IPC,
+                                 &ipcmon)==PQOS_RETVAL_OK;
+        way_size = (double) cap_l3ca->u.l3ca->way_size;
+        if (way_size<=0.0) {
+                printf("Unknown cache way size!\n");
+                return PQOS_RETVAL_ERROR;
+        }
+
+        /**
+         * There are no more sockets than cores
+         */
+        sock_ids = (unsigned *) malloc(cpu->num_cores * sizeof(sock_ids[0]));
+        if (sock_ids==NULL)
+                return PQOS_RETVAL_RESOURCE;
+        ret = pqos_cpu_get_sockets(cpu, cpu->num_cores, &sock_count, sock_ids);
+        if (ret!=PQOS_RETVAL_OK) {
+                free(sock_ids);
+                return ret;
+        }
+
+        sockets = (struct ctrl_socket *) calloc(sock_count, sizeof(sockets[0]));
+        if (sockets==NULL) {
+                free(sock_ids);
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        for (i=0;i<sock_count;i++) {
+                ret = ctrl_setup_socket(&sockets[i], sock_ids[i], cpu, cfg,
+                                        cap_l3ca->u.l3ca, ipc);
+                if (ret!=PQOS_RETVAL_OK)
+                        goto exit;
+        }
+
+        fprintf(fp, "Controller: %u socket(s), way size %.0fkB, "
+                "hysteresis %.2f way, hold %u, period %us, step %u, %s\n",
+                sock_count, way_size / 1024.0, cfg->hysteresis,
+                cfg->hold, cfg->period, cfg->step,
+                ipc ? "occupancy and IPC" : "occupancy only");
+
+        t0 = ctrl_now();
+        clock_gettime(CLOCK_MONOTONIC, &next);
+
+        while (!(*stop)) {
+                double t = ctrl_now() - t0;
+
+                for (i=0;i<sock_count;i++)
+                        ctrl_step(fp, &sockets[i], cfg, way_size,
+                                  l3mon->scale_factor, t);
+                fflush(fp);
+
+                if (sel_time>=0 && t>=(double) sel_time)
+                        break;
+
+                /**
+                 * Sleep until the next period on absolute time scale
+                 */
+                next.tv_nsec += (interval % 1000000L) * 1000L;
+                next.tv_sec += interval / 1000000L + next.tv_nsec / 1000000000L;
+                next.tv_nsec %= 1000000000L;
+                while (!(*stop) &&
+                       clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+                                       &next, NULL)==EINTR)
+                        ;
+        }
+
+        for (i=0;i<sock_count;i++)
+                fprintf(fp, "Socket %u: %u reconfiguration(s)\n",
+                        sockets[i].socket, sockets[i].num_reconfig);
+        fflush(fp);
+
+ exit:
+        for (i=0;i<sock_count;i++) {
+                ret2 = ctrl_cleanup_socket(&sockets[i]);
+                if (ret==PQOS_RETVAL_OK)
+                        ret = ret2;
+        }
+        free(sockets);
+        free(sock_ids);
+        return ret;
+}
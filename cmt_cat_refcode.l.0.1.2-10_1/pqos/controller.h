@@ -0,0 +1,101 @@
+/**
+ * @file controller.h
+ * @brief Closed-loop dynamic cache partitioning controller
+ *
+ * The controller periodically reads LLC occupancy of every class of
+ * service that has cores associated with it, and their IPC where core
+ * performance counters are available, and moves cache ways between the
+ * classes. Each class owns a contiguous, non-overlapping range of ways
+ * and classes are laid out next to each other. Masks and associations
+ * are restored when the controller ends.
+ */
+
+#ifndef __CONTROLLER_H__
+#define __CONTROLLER_H__
+
+#include <stdio.h>
+#include "pqos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Controller configuration
+ */
+struct ctrl_config {
+        unsigned min_ways[PQOS_MAX_L3CA_COS];   /**< guaranteed number of ways per class */
+        double hysteresis;                      /**< net utility gain (in cache ways)
+                                                   required to move a way */
+        unsigned hold;                          /**< number of consecutive periods a
+                                                   decision has to persist for */
+        unsigned period;                        /**< minimum number of seconds between
+                                                   reconfigurations of a socket */
+        unsigned step;                          /**< maximum number of ways moved in
+                                                   a single reconfiguration */
+        double saturation;                      /**< fill level of a partition above which
+                                                   class is considered capacity bound */
+        double ipc_threshold;                   /**< relative IPC change per way above
+                                                   which class is cache sensitive */
+};
+
+/**
+ * @brief Fills \a cfg with default controller settings
+ *
+ * @param [out] cfg controller configuration
+ */
+void ctrl_config_default(struct ctrl_config *cfg);
+
+/**
+ * @brief Updates \a cfg with settings from \a opts string
+ *
+ * Options are separated with ',' and can be:
+ *     min=<ways>             guaranteed ways for all classes
+ *     min=<cos>:<ways>       guaranteed ways for selected class
+ *     hysteresis=<ways>      required net gain, fractional values accepted
+ *     hold=<n>               periods a decision has to persist for
+ *     period=<sec>           minimum time between reconfigurations
+ *     step=<ways>            maximum ways moved per reconfiguration
+ *     saturation=<0..1>      capacity bound fill level
+ *     ipc=<fraction>         IPC change per way of a cache sensitive class
+ *
+ * @param [in,out] cfg controller configuration
+ * @param [in] opts option string, NULL leaves \a cfg unchanged
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int ctrl_config_parse(struct ctrl_config *cfg, const char *opts);
+
+/**
+ * @brief Runs the controller loop
+ *
+ * Classes of service are discovered from current core associations.
+ * The loop ends after \a sel_time seconds or when \a stop becomes true,
+ * masks and associations found at start are restored then and on
+ * errors.
+ *
+ * @param [in] fp stream to report controller state and decisions to
+ * @param [in] cap detected PQoS capabilities
+ * @param [in] cpu detected CPU topology
+ * @param [in] cfg controller configuration
+ * @param [in] interval control period in microseconds
+ * @param [in] sel_time run time in seconds, negative for infinite
+ * @param [in] stop pointer to stop indicator
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int ctrl_run(FILE *fp,
+             const struct pqos_cap *cap,
+             const struct pqos_cpuinfo *cpu,
+             const struct ctrl_config *cfg,
+             const long interval,
+             const int sel_time,
+             const int *stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CONTROLLER_H__ */
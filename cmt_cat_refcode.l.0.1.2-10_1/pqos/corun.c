@@ -0,0 +1,701 @@
+/**
+ * @file corun.c
+ * @brief Co-runner interference experiment harness
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <linux/futex.h>
+#include <assert.h>
+
+#include "corun.h"
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+#ifdef DEBUG
+#define ASSERT assert
+#else
+#define ASSERT(x)
+#endif
+
+#define CORUN_MAX_ARGS 32               /**< max command arguments */
+
+/**
+ * Workload description and state
+ */
+struct corun_workload {
+        char name[32];
+        int victim;                     /**< measured as victim */
+        int aggressor;                  /**< run next to victims */
+        unsigned core;
+        unsigned socket;
+        unsigned class_id;
+        uint64_t mask;                  /**< 0 leaves the mask unchanged */
+        char *line;                     /**< command storage */
+        char *argv[CORUN_MAX_ARGS + 1];
+        struct pqos_mon_data group;
+        int mon;                        /**< group started */
+        pid_t pid;                      /**< running process or 0 */
+        double occ_sum;                 /**< occupancy samples of a run */
+        unsigned occ_num;
+};
+
+/**
+ * Start barrier shared with the workload processes
+ */
+struct corun_barrier {
+        int ready;                      /**< processes waiting */
+        int go;                         /**< set to release them */
+};
+
+/**
+ * @brief SIGCHLD handler, never runs during the runs as SIGCHLD
+ *        is blocked and taken by sigtimedwait() then
+ *
+ * @param signo signal number
+ */
+static void
+corun_sigchld(int signo)
+{
+        (void) signo;
+}
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+corun_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Futex wait or wake on a shared memory word
+ */
+static long
+corun_futex(int *addr, const int op, const int val)
+{
+        return syscall(SYS_futex, addr, op, val, NULL, NULL, 0);
+}
+
+void
+corun_config_default(struct corun_config *cfg)
+{
+        ASSERT(cfg!=NULL);
+        memset(cfg, 0, sizeof(*cfg));
+        cfg->repeat = 1;
+        cfg->all = 1;
+        cfg->interval = 100000L;
+}
+
+int
+corun_config_parse(struct corun_config *cfg, const char *opts)
+{
+        char *cp = NULL, *tok = NULL, *saveptr = NULL;
+        int ret = PQOS_RETVAL_OK;
+
+        if (cfg==NULL)
+                return PQOS_RETVAL_PARAM;
+        if (opts==NULL)
+                return PQOS_RETVAL_OK;
+
+        cp = strdup(opts);
+        if (cp==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (tok=strtok_r(cp, ",", &saveptr); tok!=NULL;
+             tok=strtok_r(NULL, ",", &saveptr)) {
+                char *val = strchr(tok, '=');
+
+                if (val==NULL) {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+                *val++ = '\0';
+
+                if (strcasecmp(tok, "file")==0) {
+                        if (strlen(val)>=sizeof(cfg->file)) {
+                                ret = PQOS_RETVAL_PARAM;
+                                break;
+                        }
+                        strcpy(cfg->file, val);
+                } else if (strcasecmp(tok, "repeat")==0)
+                        cfg->repeat = (unsigned) strtoul(val, NULL, 0);
+                else if (strcasecmp(tok, "all")==0)
+                        cfg->all = (int) strtol(val, NULL, 0);
+                else {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+        }
+
+        free(cp);
+
+        if (ret==PQOS_RETVAL_OK && (cfg->file[0]=='\0' || cfg->repeat==0))
+                ret = PQOS_RETVAL_PARAM;
+
+        return ret;
+}
+
+/**
+ * @brief Reads workload file
+ *
+ * @param [in] path workload file
+ * @param [in] cpu CPU topology
+ * @param [out] w workloads
+ * @param [in] max size of \a w
+ * @param [out] num number of workloads read
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+corun_load(const char *path, const struct pqos_cpuinfo *cpu,
+           struct corun_workload *w, const unsigned max, unsigned *num)
+{
+        char line[1024];
+        unsigned n = 0, lineno = 0;
+        int ret = PQOS_RETVAL_OK;
+        FILE *f;
+
+        f = fopen(path, "r");
+        if (f==NULL) {
+                printf("Error opening workload file '%s'!\n", path);
+                return PQOS_RETVAL_PARAM;
+        }
+
+        while (fgets(line, sizeof(line), f)!=NULL) {
+                char *saveptr = NULL, *name, *role, *core, *cos, *mask, *arg;
+                unsigned i = 0;
+
+                lineno++;
+                name = strtok_r(line, " \t\r\n", &saveptr);
+                if (name==NULL || name[0]=='#')
+                        continue;
+                role = strtok_r(NULL, " \t\r\n", &saveptr);
+                core = strtok_r(NULL, " \t\r\n", &saveptr);
+                cos = strtok_r(NULL, " \t\r\n", &saveptr);
+                mask = strtok_r(NULL, " \t\r\n", &saveptr);
+                if (n>=max || role==NULL || core==NULL || cos==NULL ||
+                    mask==NULL || strspn(role, "va")!=strlen(role)) {
+                        printf("Invalid workload in line %u!\n", lineno);
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+
+                memset(&w[n], 0, sizeof(w[n]));
+                strncpy(w[n].name, name, sizeof(w[n].name) - 1);
+                w[n].victim = strchr(role, 'v')!=NULL;
+                w[n].aggressor = strchr(role, 'a')!=NULL;
+                w[n].core = (unsigned) strtoul(core, NULL, 0);
+                w[n].class_id = (unsigned) strtoul(cos, NULL, 0);
+                if (strcmp(mask, "-")!=0)
+                        w[n].mask = strtoull(mask, NULL, 16);
+                if (pqos_cpu_get_socketid(cpu, w[n].core,
+                                          &w[n].socket)!=PQOS_RETVAL_OK) {
+                        printf("Invalid core %u in line %u!\n",
+                               w[n].core, lineno);
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+
+                /**
+                 * Rest of the line is the command
+                 */
+                arg = strtok_r(NULL, "\r\n", &saveptr);
+                w[n].line = (arg!=NULL) ? strdup(arg) : NULL;
+                if (w[n].line==NULL) {
+                        printf("No command in line %u!\n", lineno);
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+                saveptr = NULL;
+                for (arg=strtok_r(w[n].line, " \t", &saveptr);
+                     arg!=NULL && i<CORUN_MAX_ARGS;
+                     arg=strtok_r(NULL, " \t", &saveptr))
+                        w[n].argv[i++] = arg;
+                w[n].argv[i] = NULL;
+                n++;
+        }
+        fclose(f);
+
+        if (ret==PQOS_RETVAL_OK) {
+                unsigned v = 0, a = 0, i;
+
+                for (i=0;i<n;i++) {
+                        v += w[i].victim;
+                        a += w[i].aggressor;
+                }
+                if (v==0 || a==0) {
+                        printf("Workload file needs at least one victim "
+                               "and one aggressor!\n");
+                        ret = PQOS_RETVAL_PARAM;
+                }
+        }
+        if (ret!=PQOS_RETVAL_OK) {
+                while (n>0)
+                        free(w[--n].line);
+                return ret;
+        }
+        *num = n;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Starts workload process
+ *
+ * The process pins itself to the workload core and, if \a b is not
+ * NULL, waits on the barrier before executing the command.
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+corun_spawn(struct corun_workload *w, struct corun_barrier *b)
+{
+        pid_t pid = fork();
+
+        if (pid<0) {
+                perror("fork");
+                return PQOS_RETVAL_ERROR;
+        }
+
+        if (pid==0) {
+                cpu_set_t set;
+                sigset_t chld;
+
+                sigemptyset(&chld);
+                sigaddset(&chld, SIGCHLD);
+                sigprocmask(SIG_UNBLOCK, &chld, NULL);
+
+                CPU_ZERO(&set);
+                CPU_SET(w->core, &set);
+                if (sched_setaffinity(0, sizeof(set), &set)!=0)
+                        fprintf(stderr, "Failed to pin %s to core %u, "
+                                "running unpinned\n", w->name, w->core);
+                if (b!=NULL) {
+                        __atomic_add_fetch(&b->ready, 1, __ATOMIC_SEQ_CST);
+                        corun_futex(&b->ready, FUTEX_WAKE, 1);
+                        while (__atomic_load_n(&b->go, __ATOMIC_ACQUIRE)==0)
+                                corun_futex(&b->go, FUTEX_WAIT, 0);
+                }
+                execvp(w->argv[0], w->argv);
+                perror(w->argv[0]);
+                _exit(127);
+        }
+
+        w->pid = pid;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Stops running workload processes
+ */
+static void
+corun_kill(struct corun_workload *w, const unsigned num)
+{
+        unsigned i;
+
+        for (i=0;i<num;i++)
+                if (w[i].pid>0)
+                        kill(w[i].pid, SIGTERM);
+        for (i=0;i<num;i++)
+                if (w[i].pid>0) {
+                        (void) waitpid(w[i].pid, NULL, 0);
+                        w[i].pid = 0;
+                }
+}
+
+/**
+ * @brief Runs victim together with selected aggressors
+ *
+ * Aggressors that finish successfully before the victim are started
+ * again so that the victim sees interference for its whole run. They
+ * are stopped when the victim ends. SIGCHLD has to be blocked by
+ * the caller.
+ *
+ * @param [in,out] w workloads
+ * @param [in] num number of workloads
+ * @param [in] victim victim index
+ * @param [in] sel selected aggressors, sel[i]!=0 runs workload i
+ * @param [in] b barrier in shared memory
+ * @param [in] scale occupancy scale factor
+ * @param [in] interval sampling interval in microseconds
+ * @param [in] stop pointer to stop indicator
+ * @param [out] runtime victim runtime in seconds
+ * @param [out] occ victim average LLC occupancy in bytes
+ * @param [out] failed set if the victim exited non-zero or was killed
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+corun_exec(struct corun_workload *w, const unsigned num,
+           const unsigned victim, const int *sel,
+           struct corun_barrier *b, const uint32_t scale,
+           const long interval, const int *stop,
+           double *runtime, double *occ, int *failed)
+{
+        unsigned i, started = 0;
+        int ready, status = 0, vstatus = 0, ret = PQOS_RETVAL_OK;
+        sigset_t chld;
+        double t0;
+
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+
+        b->ready = 0;
+        b->go = 0;
+        for (i=0;i<num;i++) {
+                w[i].pid = 0;
+                w[i].occ_sum = 0.0;
+                w[i].occ_num = 0;
+        }
+
+        for (i=0;i<num && ret==PQOS_RETVAL_OK;i++)
+                if (i==victim || sel[i]) {
+                        ret = corun_spawn(&w[i], b);
+                        started++;
+                }
+        if (ret!=PQOS_RETVAL_OK) {
+                b->go = 1;
+                corun_futex(&b->go, FUTEX_WAKE, INT_MAX);
+                corun_kill(w, num);
+                return ret;
+        }
+
+        /**
+         * Release all processes once they wait on the barrier
+         */
+        while ((ready = __atomic_load_n(&b->ready, __ATOMIC_ACQUIRE)) <
+               (int) started)
+                corun_futex(&b->ready, FUTEX_WAIT, ready);
+        t0 = corun_now();
+        __atomic_store_n(&b->go, 1, __ATOMIC_RELEASE);
+        corun_futex(&b->go, FUTEX_WAKE, INT_MAX);
+
+        for (;;) {
+                struct timespec ts;
+                pid_t pid;
+
+                while ((pid = waitpid(-1, &status, WNOHANG))>0) {
+                        for (i=0;i<num;i++)
+                                if (w[i].pid==pid)
+                                        break;
+                        if (i>=num)
+                                continue;
+                        w[i].pid = 0;
+                        if (i==victim) {
+                                *runtime = corun_now() - t0;
+                                vstatus = status;
+                                break;
+                        }
+                        if (!WIFEXITED(status) || WEXITSTATUS(status)!=0)
+                                printf("%s exited with status %d, "
+                                       "not restarted\n", w[i].name,
+                                       WIFEXITED(status) ?
+                                       WEXITSTATUS(status) : -1);
+                        else if (!(*stop))
+                                (void) corun_spawn(&w[i], NULL);
+                }
+                if (w[victim].pid==0 || *stop)
+                        break;
+
+                for (i=0;i<num;i++) {
+                        double v;
+
+                        if (w[i].pid==0 || !w[i].mon ||
+                            pqos_mon_poll(&w[i].group, 1)!=PQOS_RETVAL_OK)
+                                continue;
+                        v = (double) (w[i].group.value * scale);
+                        w[i].occ_sum += v;
+                        w[i].occ_num++;
+                }
+
+                /**
+                 * Returns at once on a process exit, also when it
+                 * happened after the waitpid() loop above
+                 */
+                ts.tv_sec = interval / 1000000L;
+                ts.tv_nsec = (interval % 1000000L) * 1000L;
+                (void) sigtimedwait(&chld, NULL, &ts);
+        }
+
+        corun_kill(w, num);
+        if (*stop)
+                return PQOS_RETVAL_ERROR;
+        *failed = !WIFEXITED(vstatus) || WEXITSTATUS(vstatus)!=0;
+        if (WIFSIGNALED(vstatus))
+                fprintf(stderr, "Warning: %s killed by signal %d, "
+                        "run not reported\n", w[victim].name,
+                        WTERMSIG(vstatus));
+        else if (*failed)
+                fprintf(stderr, "Warning: %s exited with status %d, "
+                        "run not reported\n", w[victim].name,
+                        WEXITSTATUS(vstatus));
+        *occ = (w[victim].occ_num>0) ?
+                w[victim].occ_sum / (double) w[victim].occ_num : 0.0;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Prints victim x aggressor matrix
+ *
+ * Column 0 is the solo run, column c+1 the run with aggressor agg[c]
+ * and the optional last column the run with all aggressors. Cells
+ * of failed runs, and ratios against a failed solo run, are empty.
+ */
+static void
+corun_print(FILE *fp, const char *title, const char *solo,
+            const struct corun_workload *w,
+            const unsigned *vic, const unsigned nv,
+            const unsigned *agg, const unsigned na,
+            const unsigned cols, const double *val, const int *failed,
+            const int ratio)
+{
+        unsigned v, c;
+
+        fprintf(fp, "%s,%s", title, solo);
+        for (c=0;c<na;c++)
+                fprintf(fp, ",%s", w[agg[c]].name);
+        if (cols>na + 1)
+                fprintf(fp, ",all");
+        fprintf(fp, "\n");
+
+        for (v=0;v<nv;v++) {
+                const double *row = &val[v * cols];
+                const int *frow = &failed[v * cols];
+
+                fprintf(fp, "%s", w[vic[v]].name);
+                for (c=0;c<cols;c++) {
+                        if ((c>0 && c<=na && agg[c - 1]==vic[v]) ||
+                            frow[c] || (ratio && frow[0]))
+                                fprintf(fp, ",");
+                        else if (ratio && c>0)
+                                fprintf(fp, ",%.3f",
+                                        row[0]>0.0 ? row[c] / row[0] : 0.0);
+                        else
+                                fprintf(fp, ",%.*f", ratio ? 6 : 1, row[c]);
+                }
+                fprintf(fp, "\n");
+        }
+}
+
+int
+corun_run(FILE *fp,
+          const struct pqos_cap *cap,
+          const struct pqos_cpuinfo *cpu,
+          const struct corun_config *cfg,
+          const int *stop)
+{
+        struct corun_workload w[CORUN_MAX_WORKLOADS];
+        struct pqos_l3ca saved_ca[CORUN_MAX_WORKLOADS];
+        unsigned saved_cos[CORUN_MAX_WORKLOADS];
+        const struct pqos_monitor *l3mon = NULL;
+        struct corun_barrier *b = NULL;
+        struct sigaction sa, sa_old;
+        double *runtime = NULL, *occ = NULL;
+        int *failed = NULL;
+        sigset_t chld, mask_old;
+        int sel[CORUN_MAX_WORKLOADS];
+        unsigned vic[CORUN_MAX_WORKLOADS], agg[CORUN_MAX_WORKLOADS];
+        unsigned num = 0, nv = 0, na = 0, saved = 0, cols, v, c, i, r;
+        int ret, ret2;
+
+        if (fp==NULL || cap==NULL || cpu==NULL || cfg==NULL || stop==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        ret = corun_load(cfg->file, cpu, w, DIM(w), &num);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        for (i=0;i<num;i++) {
+                if (w[i].victim)
+                        vic[nv++] = i;
+                if (w[i].aggressor)
+                        agg[na++] = i;
+        }
+        cols = na + 1 + ((cfg->all && na>1) ? 1 : 0);
+        runtime = calloc((size_t) nv * cols, sizeof(*runtime));
+        occ = calloc((size_t) nv * cols, sizeof(*occ));
+        failed = calloc((size_t) nv * cols, sizeof(*failed));
+        b = mmap(NULL, sizeof(*b), PROT_READ|PROT_WRITE,
+                 MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+        if (runtime==NULL || occ==NULL || failed==NULL || b==MAP_FAILED) {
+                free(runtime);
+                free(occ);
+                free(failed);
+                if (b!=MAP_FAILED)
+                        munmap(b, sizeof(*b));
+                for (i=0;i<num;i++)
+                        free(w[i].line);
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        /**
+         * Save settings to be restored, then apply
+         * workload classes and masks
+         */
+        for (i=0;i<num && ret==PQOS_RETVAL_OK;i++) {
+                struct pqos_l3ca ca[PQOS_MAX_L3CA_COS];
+                unsigned n = 0, k;
+
+                ret = pqos_l3ca_assoc_get(w[i].core, &saved_cos[i]);
+                if (ret==PQOS_RETVAL_OK)
+                        ret = pqos_l3ca_get(w[i].socket, DIM(ca), &n, ca);
+                if (ret!=PQOS_RETVAL_OK)
+                        break;
+                saved_ca[i].class_id = w[i].class_id;
+                saved_ca[i].ways_mask = 0;
+                for (k=0;k<n;k++)
+                        if (ca[k].class_id==w[i].class_id)
+                                saved_ca[i] = ca[k];
+                saved++;
+        }
+        for (i=0;i<num && ret==PQOS_RETVAL_OK;i++) {
+                struct pqos_l3ca ca;
+
+                if (w[i].mask!=0) {
+                        ca.class_id = w[i].class_id;
+                        ca.ways_mask = w[i].mask;
+                        ret = pqos_l3ca_set(w[i].socket, 1, &ca);
+                        if (ret!=PQOS_RETVAL_OK) {
+                                printf("Failed to set COS%u mask 0x%llx!\n",
+                                       ca.class_id,
+                                       (unsigned long long) ca.ways_mask);
+                                break;
+                        }
+                }
+                ret = pqos_l3ca_assoc_set(w[i].core, w[i].class_id);
+                if (ret!=PQOS_RETVAL_OK)
+                        printf("Failed to associate core %u with COS%u!\n",
+                               w[i].core, w[i].class_id);
+        }
+
+        if (ret==PQOS_RETVAL_OK &&
+            pqos_cap_get_event(cap, PQOS_MON_EVENT_L3_OCCUP,
+                               &l3mon)==PQOS_RETVAL_OK) {
+                for (i=0;i<num;i++)
+                        w[i].mon = pqos_mon_start(1, &w[i].core,
+                                                  PQOS_MON_EVENT_L3_OCCUP,
+                                                  NULL, &w[i].group)==
+                                PQOS_RETVAL_OK;
+        } else if (ret==PQOS_RETVAL_OK) {
+                printf("LLC occupancy monitoring not available, "
+                       "occupancy will not be reported\n");
+        }
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = corun_sigchld;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGCHLD, &sa, &sa_old);
+
+        /**
+         * SIGCHLD stays pending until the sampling wait takes it,
+         * so an exit just after the waitpid() check is not missed
+         */
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, &mask_old);
+
+        /**
+         * Column 0 is the solo run, column c+1 runs aggressor agg[c]
+         * and the last one all aggressors
+         */
+        for (v=0;v<nv && ret==PQOS_RETVAL_OK && !(*stop);v++)
+                for (c=0;c<cols && ret==PQOS_RETVAL_OK && !(*stop);c++) {
+                        if (c>0 && c<=na && agg[c - 1]==vic[v])
+                                continue;
+                        memset(sel, 0, sizeof(sel));
+                        if (c>0 && c<=na)
+                                sel[agg[c - 1]] = 1;
+                        else if (c>na)
+                                for (i=0;i<na;i++)
+                                        sel[agg[i]] = (agg[i]!=vic[v]);
+
+                        for (r=0;r<cfg->repeat;r++) {
+                                double t = 0.0, o = 0.0;
+                                int f = 0;
+
+                                ret = corun_exec(w, num, vic[v], sel, b,
+                                                 (l3mon!=NULL) ?
+                                                 l3mon->scale_factor : 1,
+                                                 cfg->interval, stop,
+                                                 &t, &o, &f);
+                                if (ret!=PQOS_RETVAL_OK)
+                                        break;
+                                failed[v * cols + c] |= f;
+                                runtime[v * cols + c] += t / cfg->repeat;
+                                occ[v * cols + c] +=
+                                        o / 1024.0 / cfg->repeat;
+                                if (fp!=stdout)
+                                        printf("%s with %s run %u: %.3fs\n",
+                                               w[vic[v]].name,
+                                               c==0 ? "none" :
+                                               c>na ? "all" :
+                                               w[agg[c - 1]].name, r, t);
+                        }
+                }
+
+        sigprocmask(SIG_SETMASK, &mask_old, NULL);
+        sigaction(SIGCHLD, &sa_old, NULL);
+
+        if (ret==PQOS_RETVAL_OK) {
+                corun_print(fp, "victim_slowdown", "solo_s", w,
+                            vic, nv, agg, na, cols, runtime, failed, 1);
+                fprintf(fp, "\n");
+                corun_print(fp, "victim_llc_kb", "solo", w,
+                            vic, nv, agg, na, cols, occ, failed, 0);
+                fflush(fp);
+        }
+
+        /**
+         * Restore original settings
+         */
+        for (i=0;i<num;i++)
+                if (w[i].mon)
+                        (void) pqos_mon_stop(&w[i].group);
+        for (i=saved;i>0;i--) {
+                if (w[i - 1].mask!=0 && saved_ca[i - 1].ways_mask!=0) {
+                        ret2 = pqos_l3ca_set(w[i - 1].socket, 1,
+                                             &saved_ca[i - 1]);
+                        if (ret2!=PQOS_RETVAL_OK) {
+                                printf("Failed to restore COS%u mask!\n",
+                                       w[i - 1].class_id);
+                                ret = ret2;
+                        }
+                }
+                ret2 = pqos_l3ca_assoc_set(w[i - 1].core, saved_cos[i - 1]);
+                if (ret2!=PQOS_RETVAL_OK) {
+                        printf("Failed to restore core %u association!\n",
+                               w[i - 1].core);
+                        ret = ret2;
+                }
+        }
+
+        munmap(b, sizeof(*b));
+        free(runtime);
+        free(occ);
+        free(failed);
+        for (i=0;i<num;i++)
+                free(w[i].line);
+        return ret;
+}
@@ -0,0 +1,95 @@
+/**
+ * @file corun.h
+ * @brief Co-runner interference experiment harness
+ *
+ * The harness runs every victim workload of a workload file alone,
+ * next to each aggressor workload and optionally next to all of them. Workloads
+ * are pinned to their cores and classes of service and released
+ * together from a futex barrier in shared memory, so none of them
+ * starts early or spins while waiting. LLC occupancy of each workload
+ * core is sampled during the runs. The result is a matrix of victim
+ * slowdown (runtime over solo runtime) per aggressor followed by
+ * a matrix of victim LLC occupancy.
+ */
+
+#ifndef __CORUN_H__
+#define __CORUN_H__
+
+#include <stdio.h>
+#include "pqos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define CORUN_MAX_WORKLOADS 16          /**< max workloads in a file */
+#define CORUN_MAX_PATH      256         /**< max workload file path size */
+
+/**
+ * Harness configuration
+ */
+struct corun_config {
+        char file[CORUN_MAX_PATH];      /**< workload file */
+        unsigned repeat;                /**< runs per experiment */
+        int all;                        /**< also run each victim with
+                                           all aggressors */
+        long interval;                  /**< occupancy sampling interval
+                                           in microseconds */
+};
+
+/**
+ * @brief Fills \a cfg with default harness settings
+ *
+ * @param [out] cfg harness configuration
+ */
+void corun_config_default(struct corun_config *cfg);
+
+/**
+ * @brief Updates \a cfg with settings from \a opts string
+ *
+ * Options are separated with ',' and can be:
+ *     file=<path>    workload file (required)
+ *     repeat=<n>     runs per experiment, runtimes are averaged
+ *                    (default 1)
+ *     all=<0|1>      add a column with all aggressors running
+ *                    (default 1)
+ *
+ * Each line of the workload file describes one workload:
+ *     <name> <role> <core> <cos> <mask|-> <command> [<args>]
+ * Role is 'v' (victim), 'a' (aggressor) or 'va' (both), '-' leaves
+ * the class mask unchanged, lines starting with '#' are ignored.
+ *
+ * @param [in,out] cfg harness configuration
+ * @param [in] opts option string, NULL leaves \a cfg unchanged
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int corun_config_parse(struct corun_config *cfg, const char *opts);
+
+/**
+ * @brief Runs the experiments
+ *
+ * Class of service masks and core associations are restored
+ * when the experiments complete or get interrupted.
+ *
+ * @param [in] fp stream to write the matrices to
+ * @param [in] cap detected PQoS capabilities
+ * @param [in] cpu detected CPU topology
+ * @param [in] cfg harness configuration
+ * @param [in] stop pointer to stop indicator
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int corun_run(FILE *fp,
+              const struct pqos_cap *cap,
+              const struct pqos_cpuinfo *cpu,
+              const struct corun_config *cfg,
+              const int *stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __CORUN_H__ */
@@ -0,0 +1,124 @@
+/**
+ * @file fmtbench.c
+ * @brief Per sample output formatting cost benchmark
+ *
+ * Formats samples of 1000 monitoring groups (by default) the way
+ * the monitoring loop does and reports the time the sampling thread
+ * spends per sample and per group for:
+ * - fprintf() of CSV records to a stdio stream
+ * - CSV and JSON lines formatted into batch writer buffers
+ *
+ * Usage: fmtbench [<samples> [<groups> [<output file>]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+bench_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Prints result line
+ */
+static void
+bench_report(const char *name, const double t, const unsigned samples,
+             const unsigned groups)
+{
+        printf("%-16s %10.1f us/sample %8.1f ns/group\n", name,
+               t * 1e6 / (double) samples,
+               t * 1e9 / ((double) samples * (double) groups));
+}
+
+int main(int argc, char **argv)
+{
+        unsigned samples = 1000, groups = 1000, s, g;
+        const char *path = "/dev/null";
+        struct outbuf ob;
+        uint64_t time_us = 1700000000000000ULL;
+        double t0, t;
+        FILE *fp = NULL;
+        int fd, pass;
+
+        if (argc>1)
+                samples = (unsigned) strtoul(argv[1], NULL, 0);
+        if (argc>2)
+                groups = (unsigned) strtoul(argv[2], NULL, 0);
+        if (argc>3)
+                path = argv[3];
+        if (samples==0 || groups==0) {
+                printf("Usage: %s [<samples> [<groups> [<output file>]]]\n",
+                       argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        printf("%u samples x %u groups to %s\n", samples, groups, path);
+
+        fp = fopen(path, "w");
+        if (fp==NULL) {
+                perror("Output file open error");
+                return EXIT_FAILURE;
+        }
+        t0 = bench_now();
+        for (s=0;s<samples;s++, time_us += 100000)
+                for (g=0;g<groups;g++)
+                        fprintf(fp, "%llu.%06llu,%u,%u,%u,%s,%.1f\n",
+                                (unsigned long long) (time_us / 1000000ULL),
+                                (unsigned long long) (time_us % 1000000ULL),
+                                0, g, g, "llc",
+                                (double) ((uint64_t) g * 32768ULL *
+                                          (s + 1)) / 1024.0);
+        t = bench_now() - t0;
+        fclose(fp);
+        bench_report("fprintf csv", t, samples, groups);
+
+        for (pass=0;pass<2;pass++) {
+                fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd<0 || outbuf_init(&ob, fd, 0, 0)!=0) {
+                        perror("Output writer error");
+                        return EXIT_FAILURE;
+                }
+                t0 = bench_now();
+                for (s=0;s<samples;s++, time_us += 100000) {
+                        for (g=0;g<groups;g++) {
+                                char *p = outbuf_reserve(&ob,
+                                                         OUTBUF_MAX_RECORD);
+                                const uint64_t bytes =
+                                        (uint64_t) g * 32768ULL * (s + 1);
+
+                                outbuf_commit(&ob, pass==0 ?
+                                              outbuf_fmt_csv(p, time_us, 0,
+                                                             g, g, "llc",
+                                                             bytes, NULL) :
+                                              outbuf_fmt_json(p, time_us, 0,
+                                                              g, g, "llc",
+                                                              bytes, NULL));
+                        }
+                        outbuf_end_sample(&ob);
+                }
+                t = bench_now() - t0;
+                bench_report(pass==0 ? "outbuf csv" : "outbuf json", t,
+                             samples, groups);
+                outbuf_fini(&ob);
+                printf("%16s %llu bytes, %llu write(s), %llu stall(s)\n", "",
+                       (unsigned long long) ob.bytes,
+                       (unsigned long long) ob.writes,
+                       (unsigned long long) ob.stalls);
+                close(fd);
+        }
+        return EXIT_SUCCESS;
+}
@@ -0,0 +1,170 @@
+/**
+ * @file cpuid_cache.c
+ * @brief Cached CPUID leaves and table driven field decoding
+ */
+
+#include <string.h>
+
+#include "pqos.h"
+#include "cpuid_cache.h"
+#include "types.h"
+
+#define CPUID_CACHE_SIZE 32             /**< max number of cached leaves */
+
+#define CPUID_LEAF_BRAND_START 0x80000002U
+#define CPUID_LEAF_BRAND_END   0x80000004U
+
+/**
+ * Register of a CPUID field
+ */
+enum cpuid_reg {
+        CPUID_REG_EAX,
+        CPUID_REG_EBX,
+        CPUID_REG_ECX,
+        CPUID_REG_EDX
+};
+
+/**
+ * CPUID field description
+ */
+struct cpuid_field_desc {
+        unsigned leaf;
+        unsigned subleaf;
+        enum cpuid_reg reg;
+        unsigned lsb;
+        unsigned width;
+};
+
+/**
+ * Field descriptions, indexed by enum cpuid_field
+ */
+static const struct cpuid_field_desc m_fields[CPUID_F_NUM] = {
+#define CPUID_FIELD_DESC(name, leaf, subleaf, reg, lsb, width) \
+        { leaf, subleaf, CPUID_REG_##reg, lsb, width },
+        CPUID_FIELDS(CPUID_FIELD_DESC)
+#undef CPUID_FIELD_DESC
+};
+
+/**
+ * Cached leaf
+ */
+struct cpuid_entry {
+        unsigned leaf;
+        unsigned subleaf;
+        struct cpuid_out out;
+};
+
+static struct cpuid_entry m_cache[CPUID_CACHE_SIZE];
+static unsigned m_cache_num = 0;
+
+void
+cpuid_cache_reset(void)
+{
+        m_cache_num = 0;
+}
+
+int
+cpuid_leaf_get(const unsigned leaf,
+               const unsigned subleaf,
+               struct cpuid_out *out)
+{
+        unsigned i;
+        int ret;
+
+        ASSERT(out!=NULL);
+        if (out==NULL)
+                return MACHINE_RETVAL_PARAM;
+
+        for (i=0;i<m_cache_num;i++)
+                if (m_cache[i].leaf==leaf && m_cache[i].subleaf==subleaf) {
+                        *out = m_cache[i].out;
+                        return MACHINE_RETVAL_OK;
+                }
+
+        ret = lcpuid(leaf, subleaf, out);
+        if (ret!=MACHINE_RETVAL_OK)
+                return ret;
+
+        /**
+         * Leaves not fitting into the cache are read every time
+         */
+        if (m_cache_num<DIM(m_cache)) {
+                m_cache[m_cache_num].leaf = leaf;
+                m_cache[m_cache_num].subleaf = subleaf;
+                m_cache[m_cache_num].out = *out;
+                m_cache_num++;
+        }
+
+        return MACHINE_RETVAL_OK;
+}
+
+int
+cpuid_field_get(const enum cpuid_field field, uint32_t *val)
+{
+        const struct cpuid_field_desc *desc;
+        struct cpuid_out res;
+        uint32_t reg = 0;
+        int ret;
+
+        ASSERT(val!=NULL);
+        if (val==NULL || (unsigned) field>=CPUID_F_NUM)
+                return MACHINE_RETVAL_PARAM;
+
+        desc = &m_fields[field];
+        ret = cpuid_leaf_get(desc->leaf, desc->subleaf, &res);
+        if (ret!=MACHINE_RETVAL_OK)
+                return ret;
+
+        switch (desc->reg) {
+        case CPUID_REG_EAX:
+                reg = res.eax;
+                break;
+        case CPUID_REG_EBX:
+                reg = res.ebx;
+                break;
+        case CPUID_REG_ECX:
+                reg = res.ecx;
+                break;
+        case CPUID_REG_EDX:
+                reg = res.edx;
+                break;
+        }
+
+        reg >>= desc->lsb;
+        if (desc->width<32)
+                reg &= (1U << desc->width) - 1U;
+        *val = reg;
+        return MACHINE_RETVAL_OK;
+}
+
+int
+cpuid_brand_get(char *str)
+{
+        uint32_t max_ext = 0;
+        unsigned i;
+
+        ASSERT(str!=NULL);
+        if (str==NULL)
+                return MACHINE_RETVAL_PARAM;
+
+        if (cpuid_field_get(CPUID_F_MAX_EXT_LEAF, &max_ext)!=MACHINE_RETVAL_OK)
+                return MACHINE_RETVAL_ERROR;
+        if (max_ext<CPUID_LEAF_BRAND_END)
+                return MACHINE_RETVAL_ERROR;
+
+        for (i=0;i<=CPUID_LEAF_BRAND_END-CPUID_LEAF_BRAND_START;i++) {
+                struct cpuid_out res;
+                uint32_t regs[4];
+
+                if (cpuid_leaf_get(CPUID_LEAF_BRAND_START+i, 0,
+                                   &res)!=MACHINE_RETVAL_OK)
+                        return MACHINE_RETVAL_ERROR;
+                regs[0] = res.eax;
+                regs[1] = res.ebx;
+                regs[2] = res.ecx;
+                regs[3] = res.edx;
+                memcpy(&str[i*sizeof(regs)], regs, sizeof(regs));
+        }
+        str[CPUID_BRAND_LEN] = '\0';
+        return MACHINE_RETVAL_OK;
+}
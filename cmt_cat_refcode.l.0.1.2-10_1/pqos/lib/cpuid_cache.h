@@ -0,0 +1,80 @@
+/**
+ * @file cpuid_cache.h
+ * @brief Internal header file to cached CPUID leaves and fields
+ *
+ * Leaves are read once through lcpuid(), so they come from the machine
+ * operations passed to pqos_init() when there are any, and are kept
+ * until the machine module is reinitialized. Fields are decoded from
+ * the cached leaves as described in cpuid_fields.h.
+ */
+
+#ifndef __PQOS_CPUID_CACHE_H__
+#define __PQOS_CPUID_CACHE_H__
+
+#include <stdint.h>
+#include "machine.h"
+#include "cpuid_fields.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * CPUID fields, CPUID_F_<name> for every entry of CPUID_FIELDS
+ */
+enum cpuid_field {
+#define CPUID_FIELD_ENUM(name, leaf, subleaf, reg, lsb, width) \
+        CPUID_F_##name,
+        CPUID_FIELDS(CPUID_FIELD_ENUM)
+#undef CPUID_FIELD_ENUM
+        CPUID_F_NUM
+};
+
+#define CPUID_BRAND_LEN 48              /**< brand string length */
+
+/**
+ * @brief Drops all cached leaves
+ */
+void cpuid_cache_reset(void);
+
+/**
+ * @brief Reads CPUID leaf from the cache or the machine
+ *
+ * @param [in] leaf CPUID leaf
+ * @param [in] subleaf CPUID subleaf
+ * @param [out] out leaf registers
+ *
+ * @return Operation status
+ * @retval MACHINE_RETVAL_OK on success
+ */
+int cpuid_leaf_get(const unsigned leaf,
+                   const unsigned subleaf,
+                   struct cpuid_out *out);
+
+/**
+ * @brief Reads CPUID field
+ *
+ * @param [in] field field id
+ * @param [out] val field value
+ *
+ * @return Operation status
+ * @retval MACHINE_RETVAL_OK on success
+ */
+int cpuid_field_get(const enum cpuid_field field, uint32_t *val);
+
+/**
+ * @brief Reads processor brand string from leaves 0x80000002-4
+ *
+ * @param [out] str buffer of at least CPUID_BRAND_LEN + 1 bytes
+ *
+ * @return Operation status
+ * @retval MACHINE_RETVAL_OK on success
+ * @retval MACHINE_RETVAL_ERROR brand string leaves not supported
+ */
+int cpuid_brand_get(char *str);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PQOS_CPUID_CACHE_H__ */
@@ -0,0 +1,77 @@
+/**
+ * @file cpuid_fields.h
+ * @brief CPUID field table shared by the library and the probe programs
+ *
+ * Every field is described once as
+ *     X(name, leaf, subleaf, register, lowest bit, width)
+ * and expanded by the user of the table: cpuid_cache.h turns it into
+ * the field enumeration and lookup table of the library, cpuid.hpp
+ * into constexpr decoders. Adding a field is one line here.
+ *
+ * Fields hold the raw bit field, e.g. L3_WAYS is the number of ways
+ * minus one as reported by the CPU.
+ */
+
+#ifndef __PQOS_CPUID_FIELDS_H__
+#define __PQOS_CPUID_FIELDS_H__
+
+#define CPUID_FIELDS(X)                                                 \
+        /* basic information */                                         \
+        X(MAX_LEAF,       0x0,        0, EAX,  0, 32)                   \
+        X(STEPPING,       0x1,        0, EAX,  0,  4)                   \
+        X(MODEL,          0x1,        0, EAX,  4,  4)                   \
+        X(FAMILY,         0x1,        0, EAX,  8,  4)                   \
+        X(EXT_MODEL,      0x1,        0, EAX, 16,  4)                   \
+        X(EXT_FAMILY,     0x1,        0, EAX, 20,  8)                   \
+        X(APIC_ID,        0x1,        0, EBX, 24,  8)                   \
+        /* deterministic cache parameters of L3 */                      \
+        X(L3_LINE_SIZE,   0x4,        3, EBX,  0, 12)                   \
+        X(L3_PARTITIONS,  0x4,        3, EBX, 12, 10)                   \
+        X(L3_WAYS,        0x4,        3, EBX, 22, 10)                   \
+        X(L3_SETS,        0x4,        3, ECX,  0, 32)                   \
+        /* thermal and power management */                              \
+        X(APERFMPERF,     0x6,        0, ECX,  0,  1)                   \
+        /* structured extended features */                              \
+        X(RDT_M,          0x7,        0, EBX, 12,  1)                   \
+        X(RDT_A,          0x7,        0, EBX, 15,  1)                   \
+        /* RDT monitoring */                                            \
+        X(CMT_MAX_RMID,   0xf,        0, EBX,  0, 32)                   \
+        X(CMT_L3,         0xf,        0, EDX,  1,  1)                   \
+        X(L3MON_SCALE,    0xf,        1, EBX,  0, 32)                   \
+        X(L3MON_MAX_RMID, 0xf,        1, ECX,  0, 32)                   \
+        X(L3MON_OCCUP,    0xf,        1, EDX,  0,  1)                   \
+        X(L3MON_TOTAL_BW, 0xf,        1, EDX,  1,  1)                   \
+        X(L3MON_LOCAL_BW, 0xf,        1, EDX,  2,  1)                   \
+        /* RDT allocation */                                            \
+        X(RDTA_RES_IDS,   0x10,       0, EBX,  0, 32)                   \
+        X(RDTA_L3CA,      0x10,       0, EBX,  1,  1)                   \
+        X(RDTA_L2CA,      0x10,       0, EBX,  2,  1)                   \
+        X(RDTA_MBA,       0x10,       0, EBX,  3,  1)                   \
+        X(L3CA_CBM_LEN,   0x10,       1, EAX,  0,  5)                   \
+        X(L3CA_SHAREABLE, 0x10,       1, EBX,  0, 32)                   \
+        X(L3CA_CDP,       0x10,       1, ECX,  2,  1)                   \
+        X(L3CA_MAX_COS,   0x10,       1, EDX,  0, 16)                   \
+        X(L2CA_CBM_LEN,   0x10,       2, EAX,  0,  5)                   \
+        X(L2CA_SHAREABLE, 0x10,       2, EBX,  0, 32)                   \
+        X(L2CA_CDP,       0x10,       2, ECX,  2,  1)                   \
+        X(L2CA_MAX_COS,   0x10,       2, EDX,  0, 16)                   \
+        X(MBA_MAX_THRTL,  0x10,       3, EAX,  0, 12)                   \
+        X(MBA_LINEAR,     0x10,       3, ECX,  2,  1)                   \
+        X(MBA_MAX_COS,    0x10,       3, EDX,  0, 16)                   \
+        /* architectural performance monitoring */                      \
+        X(PMU_VERSION,    0xa,        0, EAX,  0,  8)                   \
+        X(PMU_NUM_GP,     0xa,        0, EAX,  8,  8)                   \
+        X(PMU_GP_WIDTH,   0xa,        0, EAX, 16,  8)                   \
+        X(PMU_EVT_LEN,    0xa,        0, EAX, 24,  8)                   \
+        X(PMU_NO_LLCMISS, 0xa,        0, EBX,  4,  1)                   \
+        X(PMU_NUM_FIXED,  0xa,        0, EDX,  0,  5)                   \
+        X(PMU_FIX_WIDTH,  0xa,        0, EDX,  5,  8)                   \
+        /* extended topology */                                         \
+        X(X2APIC_ID,      0xb,        0, EDX,  0, 32)                   \
+        /* processor frequency */                                       \
+        X(BASE_FREQ_MHZ,  0x16,       0, EAX,  0, 16)                   \
+        /* extended information */                                      \
+        X(MAX_EXT_LEAF,   0x80000000, 0, EAX,  0, 32)                   \
+        X(INVARIANT_TSC,  0x80000007, 0, EDX,  8,  1)
+
+#endif /* __PQOS_CPUID_FIELDS_H__ */
@@ -81,6 +81,23 @@
  * ---------------------------------------
  */
 
+/**
+ * Way allocator record of a class of service
+ */
+struct l3ca_alloc_entry {
+        int used;                               /**< allocated through allocator */
+        unsigned flags;                         /**< request flags */
+        unsigned overlap_class;                 /**< class the ways are shared with */
+        uint64_t mask;                          /**< allocated ways */
+};
+
+/**
+ * Way allocator state of a socket
+ */
+struct l3ca_alloc_socket {
+        struct l3ca_alloc_entry cos[PQOS_MAX_L3CA_COS];
+};
+
 /**
  * ---------------------------------------
  * Local data structures
@@ -89,6 +106,12 @@
 const struct pqos_cap *m_cap = NULL;
 const struct pqos_cpuinfo *m_cpu = NULL;
 
+/**
+ * Way allocator state indexed by socket id
+ */
+static struct l3ca_alloc_socket *m_alloc = NULL;
+static unsigned m_alloc_num = 0;
+
 /**
  * ---------------------------------------
  * External data
@@ -111,9 +134,22 @@ pqos_alloc_init(const struct pqos_cpuinfo *cpu,
                 const struct pqos_config *cfg)
 {
         int ret = PQOS_RETVAL_OK;
+        unsigned i, max_socket = 0;
+
         UNUSED_PARAM(cfg);
         m_cap = cap;
         m_cpu = cpu;
+
+        for (i=0;i<cpu->num_cores;i++)
+                if (cpu->cores[i].socket>max_socket)
+                        max_socket = cpu->cores[i].socket;
+
+        m_alloc = (struct l3ca_alloc_socket *)
+                calloc(max_socket+1, sizeof(m_alloc[0]));
+        if (m_alloc==NULL)
+                return PQOS_RETVAL_RESOURCE;
+        m_alloc_num = max_socket+1;
+
         return ret;
 }
 
@@ -123,9 +159,337 @@ pqos_alloc_fini(void)
         int ret = PQOS_RETVAL_OK;
         m_cap = NULL;
         m_cpu = NULL;
+        if (m_alloc!=NULL)
+                free(m_alloc);
+        m_alloc = NULL;
+        m_alloc_num = 0;
         return ret;
 }
 
+/**
+ * =======================================
+ * Internal helpers
+ * =======================================
+ */
+
+/**
+ * @brief Retrieves L3 cache allocation capability
+ *
+ * @return Pointer to capability structure or NULL if not supported
+ */
+static const struct pqos_cap_l3ca *
+get_l3ca_cap(void)
+{
+        const struct pqos_capability *cap = NULL;
+
+        ASSERT(m_cap!=NULL);
+        if (pqos_cap_get_type(m_cap,PQOS_CAP_TYPE_L3CA,&cap)!=PQOS_RETVAL_OK)
+                return NULL;
+        return cap->u.l3ca;
+}
+
+/**
+ * @brief Validates and writes classes of service on \a socket
+ *
+ * All classes are validated before any MSR is written.
+ * Allocator records of written classes are updated.
+ *
+ * @param socket CPU socket id
+ * @param num_ca number of classes of service at \a ca
+ * @param ca table with class of service definitions
+ *
+ * @return Operation status
+ */
+static int
+l3ca_write(const unsigned socket,
+           const unsigned num_ca,
+           const struct pqos_l3ca *ca)
+{
+        const struct pqos_cap_l3ca *l3ca = NULL;
+        unsigned i = 0, count = 0, core = 0;
+        int ret = PQOS_RETVAL_OK;
+
+        l3ca = get_l3ca_cap();
+        if (l3ca==NULL)
+                return PQOS_RETVAL_RESOURCE;            /**< no L3CA capability */
+
+        if (num_ca > l3ca->num_classes)
+                return PQOS_RETVAL_ERROR;
+
+        for (i=0; i<num_ca; i++) {
+                if (ca[i].class_id>=l3ca->num_classes) {
+                        LOG_ERROR("Invalid class of service %u\n",
+                                  ca[i].class_id);
+                        return PQOS_RETVAL_PARAM;
+                }
+                if (pqos_l3ca_mask_check(l3ca,ca[i].ways_mask)!=PQOS_RETVAL_OK) {
+                        LOG_ERROR("Invalid COS%u ways mask 0x%llx\n",
+                                  ca[i].class_id,
+                                  (unsigned long long) ca[i].ways_mask);
+                        return PQOS_RETVAL_PARAM;
+                }
+                if (ca[i].ways_mask & l3ca->shareable_mask)
+                        LOG_INFO("COS%u ways mask 0x%llx overlaps shareable "
+                                 "ways 0x%llx\n", ca[i].class_id,
+                                 (unsigned long long) ca[i].ways_mask,
+                                 (unsigned long long) l3ca->shareable_mask);
+                if (ca[i].ways_mask & l3ca->io_mask)
+                        LOG_INFO("COS%u ways mask 0x%llx overlaps I/O "
+                                 "ways 0x%llx\n", ca[i].class_id,
+                                 (unsigned long long) ca[i].ways_mask,
+                                 (unsigned long long) l3ca->io_mask);
+        }
+
+        ASSERT(m_cpu!=NULL);
+        ret = pqos_cpu_get_cores(m_cpu,socket,1,&count,&core);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        for (i=0; i<num_ca; i++) {
+                uint32_t reg = ca[i].class_id + PQOS_MSR_L3CA_MASK_START;
+                uint64_t val = ca[i].ways_mask;
+                int retval = MACHINE_RETVAL_OK;
+                retval = msr_write(core,reg,val);
+                if (retval!=MACHINE_RETVAL_OK)
+                        return PQOS_RETVAL_ERROR;
+
+                if (socket<m_alloc_num &&
+                    ca[i].class_id<PQOS_MAX_L3CA_COS &&
+                    m_alloc[socket].cos[ca[i].class_id].used)
+                        m_alloc[socket].cos[ca[i].class_id].mask = val;
+        }
+
+        return ret;
+}
+
+/**
+ * @brief Returns index of the lowest bit set in \a mask
+ */
+static unsigned
+mask_first(uint64_t mask)
+{
+        unsigned i = 0;
+
+        ASSERT(mask!=0);
+        while (mask!=0 && !(mask&1)) {
+                mask >>= 1;
+                i++;
+        }
+        return i;
+}
+
+/**
+ * @brief Returns number of bits set in \a mask
+ */
+static unsigned
+mask_count(uint64_t mask)
+{
+        unsigned n = 0;
+
+        for (;mask!=0;mask>>=1)
+                n += (unsigned) (mask&1);
+        return n;
+}
+
+/**
+ * @brief Builds mask of \a len bits starting from bit \a start
+ */
+static uint64_t
+mask_range(const unsigned start, const unsigned len)
+{
+        uint64_t m = (len>=64) ? ~0ULL : ((1ULL << len) - 1ULL);
+
+        return m << start;
+}
+
+/**
+ * @brief Returns ways allowed by placement \a flags
+ *
+ * @param l3ca L3 cache allocation capability
+ * @param flags PQOS_L3CA_ALLOC_ flags
+ *
+ * @return Mask of allowed ways
+ */
+static uint64_t
+alloc_flags_avail(const struct pqos_cap_l3ca *l3ca,
+                  const unsigned flags)
+{
+        uint64_t avail = mask_range(0, l3ca->num_ways);
+
+        if (flags & PQOS_L3CA_ALLOC_NO_SHARED)
+                avail &= ~l3ca->shareable_mask;
+        if (flags & PQOS_L3CA_ALLOC_NO_IO)
+                avail &= ~l3ca->io_mask;
+        if (flags & PQOS_L3CA_ALLOC_IO)
+                avail &= l3ca->io_mask;
+
+        return avail;
+}
+
+/**
+ * @brief Returns ways available for placement of \a req
+ *
+ * @param l3ca L3 cache allocation capability
+ * @param as allocator state of the socket
+ * @param req allocation request
+ *
+ * @return Mask of available ways, 0 if request can't be satisfied
+ */
+static uint64_t
+alloc_avail(const struct pqos_cap_l3ca *l3ca,
+            const struct l3ca_alloc_socket *as,
+            const struct pqos_l3ca_req *req)
+{
+        uint64_t avail = mask_range(0, l3ca->num_ways);
+        unsigned i;
+
+        avail &= alloc_flags_avail(l3ca, req->flags);
+
+        if (req->flags & PQOS_L3CA_ALLOC_OVERLAP) {
+                const struct l3ca_alloc_entry *e =
+                        &as->cos[req->overlap_class];
+
+                if (!e->used || (e->flags & (PQOS_L3CA_ALLOC_ISOLATE |
+                                             PQOS_L3CA_ALLOC_OVERLAP)))
+                        return 0;
+                return avail & e->mask;
+        }
+
+        for (i=0;i<PQOS_MAX_L3CA_COS;i++)
+                if (as->cos[i].used)
+                        avail &= ~as->cos[i].mask;
+
+        return avail;
+}
+
+/**
+ * @brief Finds the smallest range of \a avail ways that fits \a len ways
+ *
+ * @param avail mask of available ways
+ * @param num_ways number of cache ways
+ * @param len requested number of ways
+ *
+ * @return Mask of selected ways, 0 if no range fits
+ */
+static uint64_t
+alloc_best_fit(const uint64_t avail,
+               const unsigned num_ways,
+               const unsigned len)
+{
+        unsigned i = 0, best_start = 0, best_len = 0;
+
+        while (i<num_ways) {
+                unsigned start, n = 0;
+
+                if (!(avail & (1ULL << i))) {
+                        i++;
+                        continue;
+                }
+                for (start=i; i<num_ways && (avail & (1ULL << i)); i++)
+                        n++;
+                if (n>=len && (best_len==0 || n<best_len)) {
+                        best_start = start;
+                        best_len = n;
+                }
+        }
+
+        if (best_len==0)
+                return 0;
+        return mask_range(best_start, len);
+}
+
+/**
+ * @brief Relocates allocated classes of \a socket towards way 0
+ *
+ * Classes keep their order and classes sharing ways of another
+ * class move together with it.
+ *
+ * @param l3ca L3 cache allocation capability
+ * @param socket CPU socket id
+ *
+ * @return Operation status
+ */
+static int
+alloc_compact(const struct pqos_cap_l3ca *l3ca,
+              const unsigned socket)
+{
+        struct l3ca_alloc_socket *as = &m_alloc[socket];
+        uint64_t new_mask[PQOS_MAX_L3CA_COS];
+        struct pqos_l3ca tab[PQOS_MAX_L3CA_COS];
+        unsigned order[PQOS_MAX_L3CA_COS];
+        unsigned i, j, n = 0, num = 0, pos = 0;
+
+        /**
+         * Sort classes owning their ways by position
+         */
+        for (i=0;i<PQOS_MAX_L3CA_COS;i++) {
+                const struct l3ca_alloc_entry *e = &as->cos[i];
+
+                new_mask[i] = e->mask;
+                if (!e->used || (e->flags & PQOS_L3CA_ALLOC_OVERLAP))
+                        continue;
+                for (j=n; j>0 &&
+                     mask_first(as->cos[order[j-1]].mask)>mask_first(e->mask);
+                     j--)
+                        order[j] = order[j-1];
+                order[j] = i;
+                n++;
+        }
+
+        for (i=0;i<n;i++) {
+                const struct l3ca_alloc_entry *e = &as->cos[order[i]];
+                unsigned start = mask_first(e->mask);
+                unsigned len = mask_count(e->mask);
+                uint64_t avail = mask_range(0, l3ca->num_ways) &
+                        ~mask_range(0, pos);
+
+                avail &= alloc_flags_avail(l3ca, e->flags);
+
+                /**
+                 * Lowest position that fits; current position
+                 * always does as classes don't overlap
+                 */
+                for (j=pos; j<=start; j++)
+                        if ((mask_range(j, len) & avail)==mask_range(j, len))
+                                break;
+                ASSERT(j<=start);
+                if (j>start)
+                        j = start;
+
+                new_mask[order[i]] = mask_range(j, len);
+                pos = j + len;
+
+                /**
+                 * Classes sharing ways move by the same offset
+                 */
+                for (j=0;j<PQOS_MAX_L3CA_COS;j++) {
+                        const struct l3ca_alloc_entry *c = &as->cos[j];
+
+                        if (c->used && (c->flags & PQOS_L3CA_ALLOC_OVERLAP) &&
+                            c->overlap_class==order[i])
+                                new_mask[j] = (c->mask >> start) <<
+                                        mask_first(new_mask[order[i]]);
+                }
+        }
+
+        for (i=0;i<PQOS_MAX_L3CA_COS;i++) {
+                if (!as->cos[i].used || new_mask[i]==as->cos[i].mask)
+                        continue;
+                LOG_INFO("Socket %u: relocating COS%u from 0x%llx to 0x%llx\n",
+                         socket, i, (unsigned long long) as->cos[i].mask,
+                         (unsigned long long) new_mask[i]);
+                tab[num].class_id = i;
+                tab[num].ways_mask = new_mask[i];
+                num++;
+        }
+
+        if (num==0)
+                return PQOS_RETVAL_OK;
+
+        return l3ca_write(socket, num, tab);
+}
+
+
 /**
  * =======================================
  * L3 cache allocation
@@ -138,7 +502,6 @@ pqos_l3ca_set(const unsigned socket,
               const struct pqos_l3ca *ca)
 {
         int ret = PQOS_RETVAL_OK;
-        unsigned i = 0, count = 0, core = 0;
 
         _pqos_api_lock();
 
@@ -153,35 +516,7 @@ pqos_l3ca_set(const unsigned socket,
                 return PQOS_RETVAL_PARAM;
         }
 
-        ASSERT(m_cap!=NULL);
-        ret = pqos_l3ca_get_cos_num(m_cap,&count);
-        if (ret!=PQOS_RETVAL_OK) {
-                _pqos_api_unlock();
-                return ret;                             /**< perhaps no L3CA capability */
-        }
-
-        if (num_ca > count) {
-                _pqos_api_unlock();
-                return PQOS_RETVAL_ERROR;
-        }
-
-        ASSERT(m_cpu!=NULL);
-        ret = pqos_cpu_get_cores(m_cpu,socket,1,&count,&core);
-        if (ret!=PQOS_RETVAL_OK) {
-                _pqos_api_unlock();
-                return ret;
-        }
-
-        for (i=0; i<num_ca; i++) {
-                uint32_t reg = ca[i].class_id + PQOS_MSR_L3CA_MASK_START;
-                uint64_t val = ca[i].ways_mask;
-                int retval = MACHINE_RETVAL_OK;
-                retval = msr_write(core,reg,val);
-                if (retval!=MACHINE_RETVAL_OK) {
-                        _pqos_api_unlock();
-                        return PQOS_RETVAL_ERROR;
-                }
-        }
+        ret = l3ca_write(socket,num_ca,ca);
 
         _pqos_api_unlock();
         return ret;
@@ -353,3 +688,154 @@ pqos_l3ca_assoc_get(const unsigned lcore,
         _pqos_api_unlock();
         return ret;
 }
+
+int
+pqos_l3ca_alloc(const unsigned socket,
+                const struct pqos_l3ca_req *req,
+                struct pqos_l3ca *ca)
+{
+        const struct pqos_cap_l3ca *l3ca = NULL;
+        struct l3ca_alloc_entry *e = NULL;
+        uint64_t mask = 0;
+        int ret = PQOS_RETVAL_OK;
+
+        _pqos_api_lock();
+
+        ret = _pqos_check_init(1);
+        if (ret!=PQOS_RETVAL_OK) {
+                _pqos_api_unlock();
+                return ret;
+        }
+
+        l3ca = get_l3ca_cap();
+        if (l3ca==NULL) {
+                _pqos_api_unlock();
+                return PQOS_RETVAL_RESOURCE;            /**< no L3CA capability */
+        }
+
+        if (req==NULL || ca==NULL || socket>=m_alloc_num ||
+            req->class_id>=l3ca->num_classes ||
+            req->class_id>=PQOS_MAX_L3CA_COS ||
+            req->num_ways==0 || req->num_ways>l3ca->num_ways ||
+            req->num_ways<l3ca->min_cbm_bits ||
+            ((req->flags & PQOS_L3CA_ALLOC_OVERLAP) &&
+             (req->overlap_class>=PQOS_MAX_L3CA_COS ||
+              req->overlap_class==req->class_id))) {
+                _pqos_api_unlock();
+                return PQOS_RETVAL_PARAM;
+        }
+
+        e = &m_alloc[socket].cos[req->class_id];
+        if (e->used) {
+                LOG_ERROR("COS%u already allocated on socket %u\n",
+                          req->class_id, socket);
+                _pqos_api_unlock();
+                return PQOS_RETVAL_PARAM;
+        }
+
+        mask = alloc_best_fit(alloc_avail(l3ca, &m_alloc[socket], req),
+                              l3ca->num_ways, req->num_ways);
+        if (mask==0 && !(req->flags & PQOS_L3CA_ALLOC_OVERLAP)) {
+                /**
+                 * Free ways may be fragmented - compact and retry
+                 */
+                ret = alloc_compact(l3ca, socket);
+                if (ret==PQOS_RETVAL_OK)
+                        mask = alloc_best_fit(alloc_avail(l3ca,
+                                                          &m_alloc[socket],
+                                                          req),
+                                              l3ca->num_ways,
+                                              req->num_ways);
+        }
+
+        if (ret==PQOS_RETVAL_OK && mask==0) {
+                LOG_ERROR("Not enough free ways for COS%u on socket %u\n",
+                          req->class_id, socket);
+                ret = PQOS_RETVAL_RESOURCE;
+        }
+
+        if (ret==PQOS_RETVAL_OK) {
+                ca->class_id = req->class_id;
+                ca->ways_mask = mask;
+                ret = l3ca_write(socket, 1, ca);
+        }
+
+        if (ret==PQOS_RETVAL_OK) {
+                e->used = 1;
+                e->flags = req->flags;
+                e->overlap_class = req->overlap_class;
+                e->mask = mask;
+        }
+
+        _pqos_api_unlock();
+        return ret;
+}
+
+int
+pqos_l3ca_free(const unsigned socket,
+               const unsigned class_id)
+{
+        unsigned i;
+        int ret = PQOS_RETVAL_OK;
+
+        _pqos_api_lock();
+
+        ret = _pqos_check_init(1);
+        if (ret!=PQOS_RETVAL_OK) {
+                _pqos_api_unlock();
+                return ret;
+        }
+
+        if (socket>=m_alloc_num || class_id>=PQOS_MAX_L3CA_COS ||
+            !m_alloc[socket].cos[class_id].used) {
+                _pqos_api_unlock();
+                return PQOS_RETVAL_PARAM;
+        }
+
+        for (i=0;i<PQOS_MAX_L3CA_COS;i++) {
+                const struct l3ca_alloc_entry *e = &m_alloc[socket].cos[i];
+
+                if (e->used && (e->flags & PQOS_L3CA_ALLOC_OVERLAP) &&
+                    e->overlap_class==class_id) {
+                        _pqos_api_unlock();
+                        return PQOS_RETVAL_RESOURCE;
+                }
+        }
+
+        memset(&m_alloc[socket].cos[class_id], 0,
+               sizeof(m_alloc[socket].cos[class_id]));
+
+        _pqos_api_unlock();
+        return ret;
+}
+
+int
+pqos_l3ca_compact(const unsigned socket)
+{
+        const struct pqos_cap_l3ca *l3ca = NULL;
+        int ret = PQOS_RETVAL_OK;
+
+        _pqos_api_lock();
+
+        ret = _pqos_check_init(1);
+        if (ret!=PQOS_RETVAL_OK) {
+                _pqos_api_unlock();
+                return ret;
+        }
+
+        l3ca = get_l3ca_cap();
+        if (l3ca==NULL) {
+                _pqos_api_unlock();
+                return PQOS_RETVAL_RESOURCE;            /**< no L3CA capability */
+        }
+
+        if (socket>=m_alloc_num) {
+                _pqos_api_unlock();
+                return PQOS_RETVAL_PARAM;
+        }
+
+        ret = alloc_compact(l3ca, socket);
+
+        _pqos_api_unlock();
+        return ret;
+}
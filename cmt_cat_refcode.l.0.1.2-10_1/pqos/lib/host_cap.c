@@ -60,10 +60,12 @@
 
 #include "host_cap.h"
 #include "host_allocation.h"
+#include "host_sampler.h"
 #include "host_monitoring.h"
 
 #include "cpuinfo.h"
 #include "machine.h"
+#include "cpuid_cache.h"
 #include "types.h"
 #include "log.h"
 
@@ -79,6 +81,25 @@
  */
 #define PQOS_RES_ID_L3_ALLOCATION    1              /**< L3 cache allocation */
 
+/**
+ * IIO LLC ways register - ways used by Data Direct I/O
+ */
+#define PQOS_MSR_IIO_LLC_WAYS        0xC8B
+
+/**
+ * Platform information register, bits 15:8 hold the maximum
+ * non-turbo ratio in units of 100MHz
+ */
+#define PQOS_MSR_PLATFORM_INFO       0xCE
+#define PQOS_MSR_PLATFORM_INFO_RATIO(val) (((val) >> 8) & 0xffULL)
+
+/**
+ * RAPL power unit and energy status registers
+ */
+#define PQOS_MSR_RAPL_POWER_UNIT     0x606
+#define PQOS_MSR_PKG_ENERGY_STATUS   0x611
+#define PQOS_MSR_DRAM_ENERGY_STATUS  0x619
+
 
 /**
  * ---------------------------------------
@@ -106,6 +127,12 @@ static struct pqos_cap *m_cap = NULL;
  */
 static struct pqos_cpuinfo *m_cpu = NULL;
 
+/**
+ * Indicates CPU topology was discovered by cpuinfo module
+ * rather than provided by the application.
+ */
+static int m_cpuinfo_used = 0;
+
 /**
  * Library initialization status.
  */
@@ -175,7 +202,7 @@ int _pqos_check_init(const int expect)
  * @brief Detects LLC size nad number of ways
  * 
  * Retrieves information about L3 cache
- * and calculates its size. Uses CPUID.0x04.0x03
+ * and calculates its size. Uses CPUID.0x04.0x03 fields
  *
  * @param p_num_ways place to store number of detected cache ways
  * @param p_size_in_bytes place to store size of LLC in bytes
@@ -187,24 +214,30 @@ static int
 get_l3_cache_info(unsigned *p_num_ways,
                   unsigned *p_size_in_bytes)
 {
-        unsigned num_ways = 0, line_size = 0, num_partitions = 0,
+        uint32_t num_ways = 0, line_size = 0, num_partitions = 0,
                 num_sets = 0, size_in_bytes = 0;
-        struct cpuid_out res;
         int ret = PQOS_RETVAL_OK;
 
         if (p_num_ways==NULL && p_size_in_bytes==NULL)
                 return PQOS_RETVAL_PARAM;
 
-        ret = lcpuid(0x4, 0x3, &res);
-        if (ret!=MACHINE_RETVAL_OK)
+        if (cpuid_field_get(CPUID_F_L3_WAYS, &num_ways)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_L3_LINE_SIZE,
+                            &line_size)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_L3_PARTITIONS,
+                            &num_partitions)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_L3_SETS, &num_sets)!=MACHINE_RETVAL_OK)
                 return PQOS_RETVAL_ERROR;
-        
-        num_ways = (res.ebx>>22) + 1;
+
+        /**
+         * All four fields are reported minus one
+         */
+        num_ways++;
+        line_size++;
+        num_partitions++;
+        num_sets++;
         if (p_num_ways!=NULL)
                 *p_num_ways = num_ways;
-        line_size = (res.ebx & 0xfff) + 1;
-        num_partitions = ((res.ebx >> 12) & 0x3ff) + 1;
-        num_sets = res.ecx + 1;
         size_in_bytes = num_ways*num_partitions*line_size*num_sets;
         if (p_size_in_bytes!=NULL)
                 *p_size_in_bytes = size_in_bytes;
@@ -245,6 +278,130 @@ add_monitoring_event(struct pqos_cap_mon *mon,
         mon->num_events++;
 }
 
+/**
+ * @brief Discovers core performance counter events
+ *
+ * Architectural performance monitoring (CPUID.0xa) version 2 or later
+ * is needed to enable counters through IA32_PERF_GLOBAL_CTRL.
+ * IPC uses fixed counters 0 and 1, LLC misses use the architectural
+ * event on general purpose counter 0.
+ *
+ * @return Mask of supported PQOS_PERF_EVENT_* events
+ */
+static unsigned
+discover_perf_events(void)
+{
+        uint32_t max_leaf = 0, version = 0, num_gp = 0, evt_len = 0,
+                no_llc_miss = 0, num_fixed = 0;
+        unsigned events = 0;
+
+        if (cpuid_field_get(CPUID_F_MAX_LEAF, &max_leaf)!=MACHINE_RETVAL_OK ||
+            max_leaf<0xa)
+                return 0;
+
+        if (cpuid_field_get(CPUID_F_PMU_VERSION, &version)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_PMU_NUM_GP, &num_gp)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_PMU_EVT_LEN, &evt_len)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_PMU_NO_LLCMISS,
+                            &no_llc_miss)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_PMU_NUM_FIXED,
+                            &num_fixed)!=MACHINE_RETVAL_OK)
+                return 0;
+
+        if (version<2)
+                return 0;
+        if (num_fixed>=2)
+                events |= PQOS_PERF_EVENT_IPC;
+        if (num_gp>=1 && evt_len>4 && !no_llc_miss)
+                events |= PQOS_PERF_EVENT_LLC_MISS;
+
+        LOG_INFO("Performance monitoring version %u, %u fixed and "
+                 "%u general purpose counters\n", version, num_fixed, num_gp);
+        return events;
+}
+
+/**
+ * @brief Discovers frequency and energy events
+ *
+ * Effective frequency needs APERF/MPERF (CPUID.0x6:ECX[0]) and the rate
+ * MPERF counts at, which is the base frequency of CPUID.0x16 or
+ * the non-turbo ratio of MSR_PLATFORM_INFO. RAPL is not enumerated
+ * by CPUID, its energy status registers are probed by reading them
+ * without logging failures. Energy events are reported only if the
+ * power unit register reads on every socket, as monitoring needs it.
+ *
+ * @param [out] base_mhz MPERF rate in MHz
+ *
+ * @return Mask of supported PQOS_PERF_EVENT_FREQ and
+ *         PQOS_PWR_EVENT_* events
+ */
+static unsigned
+discover_power_events(uint32_t *base_mhz)
+{
+        uint32_t max_leaf = 0, aperfmperf = 0;
+        unsigned lcore, events = 0, i, j;
+        uint64_t val = 0;
+
+        ASSERT(base_mhz!=NULL);
+        ASSERT(m_cpu!=NULL);
+        *base_mhz = 0;
+        lcore = m_cpu->cores[0].lcore;
+
+        if (cpuid_field_get(CPUID_F_MAX_LEAF, &max_leaf)!=MACHINE_RETVAL_OK)
+                return 0;
+
+        if (max_leaf>=0x6 &&
+            cpuid_field_get(CPUID_F_APERFMPERF,
+                            &aperfmperf)==MACHINE_RETVAL_OK && aperfmperf) {
+                if (max_leaf>=0x16 &&
+                    cpuid_field_get(CPUID_F_BASE_FREQ_MHZ,
+                                    base_mhz)!=MACHINE_RETVAL_OK)
+                        *base_mhz = 0;
+                if (*base_mhz==0 &&
+                    msr_probe(lcore, PQOS_MSR_PLATFORM_INFO,
+                              &val)==MACHINE_RETVAL_OK)
+                        *base_mhz = (uint32_t)
+                                PQOS_MSR_PLATFORM_INFO_RATIO(val) * 100;
+                if (*base_mhz>0)
+                        events |= PQOS_PERF_EVENT_FREQ;
+                else
+                        LOG_INFO("APERF/MPERF present but base "
+                                 "frequency unknown\n");
+        }
+
+        if (msr_probe(lcore, PQOS_MSR_PKG_ENERGY_STATUS,
+                      &val)==MACHINE_RETVAL_OK) {
+                events |= PQOS_PWR_EVENT_PKG_ENERGY;
+                if (msr_probe(lcore, PQOS_MSR_DRAM_ENERGY_STATUS,
+                              &val)==MACHINE_RETVAL_OK)
+                        events |= PQOS_PWR_EVENT_DRAM_ENERGY;
+        }
+        for (i=0;i<m_cpu->num_cores &&
+                    (events & PQOS_PWR_EVENT_PKG_ENERGY);i++) {
+                for (j=0;j<i;j++)
+                        if (m_cpu->cores[j].socket==m_cpu->cores[i].socket)
+                                break;
+                if (j<i)
+                        continue;               /**< socket already seen */
+                if (msr_probe(m_cpu->cores[i].lcore,
+                              PQOS_MSR_RAPL_POWER_UNIT,
+                              &val)!=MACHINE_RETVAL_OK) {
+                        LOG_INFO("RAPL power unit not readable on "
+                                 "socket %u\n", m_cpu->cores[i].socket);
+                        events &= ~(PQOS_PWR_EVENT_PKG_ENERGY |
+                                    PQOS_PWR_EVENT_DRAM_ENERGY);
+                }
+        }
+
+        if (events & PQOS_PERF_EVENT_FREQ)
+                LOG_INFO("APERF/MPERF at %u MHz\n", *base_mhz);
+        if (events & PQOS_PWR_EVENT_PKG_ENERGY)
+                LOG_INFO("RAPL package%s energy counters\n",
+                         (events & PQOS_PWR_EVENT_DRAM_ENERGY) ?
+                         " and DRAM" : "");
+        return events;
+}
+
 /** 
  * @brief Discovers monitoring capabilities 
  * 
@@ -261,23 +418,21 @@ add_monitoring_event(struct pqos_cap_mon *mon,
 static int
 discover_monitoring(struct pqos_cap_mon **r_mon)
 {
-        struct cpuid_out res;
         int ret = PQOS_RETVAL_OK;
-        unsigned sz = 0, max_rmid = 0,
-                l3_size = 0, num_events = 0;
+        unsigned sz = 0, l3_size = 0, num_events = 0, perf_events = 0;
+        uint32_t rdt_m = 0, max_rmid = 0, cmt_l3 = 0, l3_occup = 0,
+                l3_max_rmid = 0, l3_scale = 0, base_mhz = 0;
         struct pqos_cap_mon *mon=NULL;
 
         ASSERT(r_mon!=NULL);
 
         /**
-         * Run CPUID.0x7.0 to check
-         * for quality monitoring capability (bit 12 of ebx)
+         * CPUID.0x7.0 reports quality monitoring capability
          */
-        ret = lcpuid(0x7, 0x0, &res);
-        if (ret!=MACHINE_RETVAL_OK)
+        if (cpuid_field_get(CPUID_F_RDT_M, &rdt_m)!=MACHINE_RETVAL_OK)
                 return PQOS_RETVAL_ERROR;
 
-        if (!(res.ebx&(1<<12))) {
+        if (!rdt_m) {
                 LOG_WARN("Cache monitoring "
                           "capability not supported!\n");
                 return PQOS_RETVAL_ERROR;
@@ -287,14 +442,15 @@ discover_monitoring(struct pqos_cap_mon **r_mon)
          * We can go to CPUID.0xf.0 for further
          * exploration of monitoring capabilities
          */
-        ret = lcpuid(0xf, 0x0, &res);
-        if (ret!=MACHINE_RETVAL_OK)
+        if (cpuid_field_get(CPUID_F_CMT_MAX_RMID,
+                            &max_rmid)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_CMT_L3, &cmt_l3)!=MACHINE_RETVAL_OK)
                 return PQOS_RETVAL_ERROR;
 
         /**
          * MAX_RMID for the socket
          */
-        max_rmid = (unsigned) res.ebx + 1;         
+        max_rmid++;
         ret = get_l3_cache_info(NULL, &l3_size);   /**< L3 cache size */
         if (ret!=PQOS_RETVAL_OK)
                 return ret;
@@ -302,21 +458,41 @@ discover_monitoring(struct pqos_cap_mon **r_mon)
         /**
          * Check number of monitoring events to allocate memory for
          */
-        if (res.edx&(1<<1)) {
+        if (cmt_l3) {
                 /**
-                 * Bit 1 resource (LLC) monitoring available
+                 * Resource (LLC) monitoring available,
+                 * query it through CPUID.0xf.1
                  */
-                struct cpuid_out tmp_res;
-                ret = lcpuid(0xf, 1, &tmp_res); /**< query resource (LLC) monitoring for bit 1 */
-                if (ret!=MACHINE_RETVAL_OK)
+                if (cpuid_field_get(CPUID_F_L3MON_OCCUP,
+                                    &l3_occup)!=MACHINE_RETVAL_OK ||
+                    cpuid_field_get(CPUID_F_L3MON_MAX_RMID,
+                                    &l3_max_rmid)!=MACHINE_RETVAL_OK ||
+                    cpuid_field_get(CPUID_F_L3MON_SCALE,
+                                    &l3_scale)!=MACHINE_RETVAL_OK)
                         return PQOS_RETVAL_ERROR;
-                if (tmp_res.edx&1)
+                if (l3_occup)
                         num_events++; /**< LLC occupancy */
         }
 
         if (!num_events)
                 return PQOS_RETVAL_ERROR;
 
+        /**
+         * Core performance counters are reported next to LLC occupancy
+         */
+        perf_events = discover_perf_events();
+        if (perf_events & PQOS_PERF_EVENT_IPC)
+                num_events++;
+        if (perf_events & PQOS_PERF_EVENT_LLC_MISS)
+                num_events++;
+        perf_events |= discover_power_events(&base_mhz);
+        if (perf_events & PQOS_PERF_EVENT_FREQ)
+                num_events++;
+        if (perf_events & PQOS_PWR_EVENT_PKG_ENERGY)
+                num_events++;
+        if (perf_events & PQOS_PWR_EVENT_DRAM_ENERGY)
+                num_events++;
+
         sz = (num_events * sizeof(struct pqos_monitor)) + sizeof(*mon);
         mon = (struct pqos_cap_mon*) malloc(sz);
         if (mon==NULL)
@@ -327,25 +503,37 @@ discover_monitoring(struct pqos_cap_mon **r_mon)
         mon->max_rmid = max_rmid;
         mon->l3_size = l3_size;
 
-        if (res.edx&(1<<1)) {
-                /**
-                 * Bit 1 resource (LLC) monitoring available
-                 */
-                struct cpuid_out tmp_res;
-
-                ret = lcpuid(0xf, 1, &tmp_res); /**< query resource (LLC) monitoring for bit 1 */
-                if (ret!=MACHINE_RETVAL_OK) {
-                        free(mon);
-                        return PQOS_RETVAL_ERROR;
-                }
-
-                if (tmp_res.edx&1)
-                        add_monitoring_event( mon, 1,
-                                              PQOS_MON_EVENT_L3_OCCUP,
-                                              tmp_res.ecx+1,
-                                              tmp_res.ebx,
-                                              num_events );
-        }
+        if (cmt_l3 && l3_occup)
+                add_monitoring_event( mon, 1,
+                                      PQOS_MON_EVENT_L3_OCCUP,
+                                      l3_max_rmid+1,
+                                      l3_scale,
+                                      num_events );
+        if (perf_events & PQOS_PERF_EVENT_IPC)
+                add_monitoring_event( mon, 0,
+                                      PQOS_PERF_EVENT_IPC,
+                                      l3_max_rmid+1, 1,
+                                      num_events );
+        if (perf_events & PQOS_PERF_EVENT_LLC_MISS)
+                add_monitoring_event( mon, 0,
+                                      PQOS_PERF_EVENT_LLC_MISS,
+                                      l3_max_rmid+1, 1,
+                                      num_events );
+        if (perf_events & PQOS_PERF_EVENT_FREQ)
+                add_monitoring_event( mon, 0,
+                                      PQOS_PERF_EVENT_FREQ,
+                                      l3_max_rmid+1, base_mhz,
+                                      num_events );
+        if (perf_events & PQOS_PWR_EVENT_PKG_ENERGY)
+                add_monitoring_event( mon, 0,
+                                      PQOS_PWR_EVENT_PKG_ENERGY,
+                                      l3_max_rmid+1, 1,
+                                      num_events );
+        if (perf_events & PQOS_PWR_EVENT_DRAM_ENERGY)
+                add_monitoring_event( mon, 0,
+                                      PQOS_PWR_EVENT_DRAM_ENERGY,
+                                      l3_max_rmid+1, 1,
+                                      num_events );
 
         (*r_mon) = mon;
         return PQOS_RETVAL_OK;
@@ -367,20 +555,14 @@ discover_monitoring(struct pqos_cap_mon **r_mon)
 static int
 discover_alloc_llc_brandstr(struct pqos_cap_l3ca *cap)
 {
-#define CPUID_LEAF_BRAND_START 0x80000002UL
-#define CPUID_LEAF_BRAND_END   0x80000004UL
-#define CPUID_LEAF_BRAND_NUM   (CPUID_LEAF_BRAND_END-CPUID_LEAF_BRAND_START+1)
-#define MAX_BRAND_STRING_LEN   (CPUID_LEAF_BRAND_NUM*4*sizeof(uint32_t))
        const char *supported_brands[] = {
                 "E5-2658 v3",
                 "E5-2648L v3", "E5-2628L v3",
                 "E5-2618L v3", "E5-2608L v3"
         };
-        struct cpuid_out res;
         int ret = PQOS_RETVAL_OK,
                 match_found = 0;
-        char brand_str[MAX_BRAND_STRING_LEN+1];
-        uint32_t *brand_u32 = (uint32_t*)brand_str;
+        char brand_str[CPUID_BRAND_LEN+1];
         unsigned i = 0;
 
         /**
@@ -389,28 +571,13 @@ discover_alloc_llc_brandstr(struct pqos_cap_l3ca *cap)
          */
         ASSERT(cap!=NULL);
 
-        ret = lcpuid(0x80000000, 0, &res);
-        if (ret!=MACHINE_RETVAL_OK)
-                return PQOS_RETVAL_ERROR;
-
-        if (res.eax < CPUID_LEAF_BRAND_END) {
+        memset(brand_str, 0, sizeof(brand_str));
+        if (cpuid_brand_get(brand_str)!=MACHINE_RETVAL_OK) {
                 LOG_ERROR("Brand string CPU-ID extended functions "
                            "not supported\n");
                 return PQOS_RETVAL_ERROR;
         }
 
-        memset(brand_str, 0, sizeof(brand_str));
-        
-        for (i=0;i<CPUID_LEAF_BRAND_NUM;i++) {
-                ret = lcpuid((unsigned) CPUID_LEAF_BRAND_START+i, 0, &res);
-                if (ret!=MACHINE_RETVAL_OK)
-                        return PQOS_RETVAL_ERROR;
-                *brand_u32++ = res.eax;
-                *brand_u32++ = res.ebx;
-                *brand_u32++ = res.ecx;
-                *brand_u32++ = res.edx;
-        }
-
         LOG_INFO("CPU brand string '%s'\n", brand_str);
 
         /**
@@ -435,6 +602,7 @@ discover_alloc_llc_brandstr(struct pqos_cap_l3ca *cap)
          * using CPUID.0x4.0x3
          */
         cap->num_classes = 4;
+        cap->min_cbm_bits = 2;                  /**< at least 2 ways per mask */
         ret = get_l3_cache_info(&cap->num_ways,&cap->way_size);
 
         /**
@@ -447,6 +615,60 @@ discover_alloc_llc_brandstr(struct pqos_cap_l3ca *cap)
         return ret;
 }
 
+/**
+ * @brief Detects LLC ways used by Data Direct I/O
+ *
+ * IIO LLC ways register is read on server models known to have it.
+ * I/O ways mask stays 0 if they are not known.
+ *
+ * @param cap CAT capability structure to update
+ */
+static void
+discover_alloc_llc_io(struct pqos_cap_l3ca *cap)
+{
+        static const unsigned models[] = {
+                0x55,                           /**< Skylake/Cascade Lake SP */
+                0x6A, 0x6C,                     /**< Ice Lake SP/D */
+                0x8F,                           /**< Sapphire Rapids */
+                0xCF,                           /**< Emerald Rapids */
+        };
+        uint32_t family = 0, model = 0, ext_model = 0;
+        uint64_t val = 0;
+        unsigned i;
+
+        ASSERT(cap!=NULL);
+        ASSERT(m_cpu!=NULL);
+
+        if (cpuid_field_get(CPUID_F_FAMILY, &family)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_MODEL, &model)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_EXT_MODEL,
+                            &ext_model)!=MACHINE_RETVAL_OK)
+                return;
+
+        model |= ext_model << 4;
+        if (family!=6)
+                return;
+
+        for (i=0;i<DIM(models);i++)
+                if (models[i]==model)
+                        break;
+        if (i>=DIM(models)) {
+                LOG_INFO("I/O LLC ways unknown on CPU model 0x%x\n", model);
+                return;
+        }
+
+        if (msr_read(m_cpu->cores[0].lcore, PQOS_MSR_IIO_LLC_WAYS,
+                     &val)!=MACHINE_RETVAL_OK) {
+                LOG_WARN("Failed to read IIO LLC ways register\n");
+                return;
+        }
+
+        if (cap->num_ways<64)
+                val &= (1ULL << cap->num_ways) - 1ULL;
+        cap->io_mask = val;
+        LOG_INFO("I/O LLC ways mask 0x%llx\n", (unsigned long long) val);
+}
+
 /** 
  * @brief Discovers CAT
  * 
@@ -464,9 +686,9 @@ discover_alloc_llc_brandstr(struct pqos_cap_l3ca *cap)
 static int
 discover_alloc_llc(struct pqos_cap_l3ca **r_cap)
 {
-        struct cpuid_out res;
         struct pqos_cap_l3ca *cap = NULL;
         const unsigned sz = sizeof(*cap);
+        uint32_t rdt_a = 0;
         int ret = PQOS_RETVAL_OK;
 
         cap = (struct pqos_cap_l3ca *)malloc(sz);
@@ -479,14 +701,14 @@ discover_alloc_llc(struct pqos_cap_l3ca **r_cap)
         cap->mem_size = sz;
 
         /**
-         * Run CPUID.0x7.0 to check
-         * for allocation capability (bit 15 of ebx)
+         * CPUID.0x7.0 reports allocation capability
          */
-        ret = lcpuid(0x7, 0x0, &res);
-        if (ret!=MACHINE_RETVAL_OK)
+        if (cpuid_field_get(CPUID_F_RDT_A, &rdt_a)!=MACHINE_RETVAL_OK) {
+                free(cap);
                 return PQOS_RETVAL_ERROR;
+        }
 
-        if (res.ebx&(1<<15)) {
+        if (rdt_a) {
                 uint32_t res_id = 0;
                 int i = 0, detected = 0;
 
@@ -495,27 +717,46 @@ discover_alloc_llc(struct pqos_cap_l3ca **r_cap)
                  * We can go to CPUID.0x10.0 to explore
                  * allocation capabilities
                  */
-                ret = lcpuid(0x10, 0x0, &res);
-                if (ret!=MACHINE_RETVAL_OK)
+                if (cpuid_field_get(CPUID_F_RDTA_RES_IDS,
+                                    &res_id)!=MACHINE_RETVAL_OK) {
+                        free(cap);
                         return PQOS_RETVAL_ERROR;
-                
-                for (res_id=res.ebx>>1, i=1; i<32 && res_id!=0;
+                }
+
+                for (res_id>>=1, i=1; i<32 && res_id!=0;
                      i++, res_id>>=1) {
+                        struct cpuid_out res;
+
                         if (!(res_id&1))
                                 continue;
-                        
-                        ret = lcpuid(0x10, (unsigned)i, &res);
-                        if (ret!=MACHINE_RETVAL_OK)
-                                return PQOS_RETVAL_ERROR;
-                        
+
                         if (i==PQOS_RES_ID_L3_ALLOCATION) {
                                 /**
-                                 * L3 CQE
+                                 * L3 CQE, all counts reported minus one
                                  */
-                                cap->num_classes = res.edx;
-                                cap->num_ways = res.eax+1;
+                                uint32_t max_cos = 0, cbm_len = 0,
+                                        shareable = 0;
+
+                                if (cpuid_field_get(CPUID_F_L3CA_MAX_COS,
+                                                    &max_cos)!=MACHINE_RETVAL_OK ||
+                                    cpuid_field_get(CPUID_F_L3CA_CBM_LEN,
+                                                    &cbm_len)!=MACHINE_RETVAL_OK ||
+                                    cpuid_field_get(CPUID_F_L3CA_SHAREABLE,
+                                                    &shareable)!=MACHINE_RETVAL_OK) {
+                                        free(cap);
+                                        return PQOS_RETVAL_ERROR;
+                                }
+                                cap->num_classes = max_cos + 1;
+                                cap->num_ways = cbm_len + 1;
+                                cap->shareable_mask = (uint64_t) shareable;
+                                cap->min_cbm_bits = 1;
                                 detected = 1;
                         } else {
+                                if (cpuid_leaf_get(0x10, (unsigned)i,
+                                                   &res)!=MACHINE_RETVAL_OK) {
+                                        free(cap);
+                                        return PQOS_RETVAL_ERROR;
+                                }
                                 LOG_INFO("Unsupported allocation resource ID "
                                           "%u (eax=0x%x,ebx=0x%x,"
                                           "ecx=0x%x,edx=0x%x)\n",
@@ -526,6 +767,19 @@ discover_alloc_llc(struct pqos_cap_l3ca **r_cap)
 
                 if (!detected)
                         ret = PQOS_RETVAL_ERROR;
+
+                if (ret==PQOS_RETVAL_OK) {
+                        /**
+                         * Calculate byte size of one cache way
+                         * from CPUID.0x4.0x3 cache size
+                         */
+                        unsigned l3_size = 0;
+
+                        ret = get_l3_cache_info(NULL, &l3_size);
+                        ASSERT(cap->num_ways>0);
+                        if (ret==PQOS_RETVAL_OK && cap->num_ways>0)
+                                cap->way_size = l3_size / cap->num_ways;
+                }
                 
         } else {
                 /**
@@ -534,8 +788,13 @@ discover_alloc_llc(struct pqos_cap_l3ca **r_cap)
                 ret = discover_alloc_llc_brandstr(cap);
         }
 
+        if (ret==PQOS_RETVAL_OK)
+                discover_alloc_llc_io(cap);
+
         if (ret==PQOS_RETVAL_OK)
                 (*r_cap) = cap;
+        else
+                free(cap);
 
         return ret;
 }
@@ -686,6 +945,7 @@ pqos_init(const struct pqos_config *config)
                         ret = PQOS_RETVAL_ERROR;
                         goto log_init_error;
                 }
+                m_cpuinfo_used = 1;
                 ASSERT(topology!=NULL);
                 ms = pqos_cpuinfo_get_memsize(topology->num_cores);
                 m_cpu = (struct pqos_cpuinfo*)malloc(ms);
@@ -730,7 +990,7 @@ pqos_init(const struct pqos_config *config)
                 if (m_cpu->cores[i].lcore>max_core)
                         max_core = m_cpu->cores[i].lcore;
 
-        ret = machine_init(max_core);
+        ret = machine_init(max_core, config->machine);
         if (ret!=PQOS_RETVAL_OK) {
                 LOG_ERROR("machine_init() error %d\n", ret);
                 goto cpuinfo_init_error;
@@ -764,8 +1024,10 @@ pqos_init(const struct pqos_config *config)
         if (ret!=PQOS_RETVAL_OK)
                 (void) machine_fini();
  cpuinfo_init_error:
-        if (ret!=PQOS_RETVAL_OK)
+        if (ret!=PQOS_RETVAL_OK && m_cpuinfo_used) {
                 (void) cpuinfo_fini();
+                m_cpuinfo_used = 0;
+        }
  log_init_error:
         if (ret!=PQOS_RETVAL_OK)
                 (void) log_fini();
@@ -794,6 +1056,11 @@ pqos_fini(void)
         int retval = PQOS_RETVAL_OK;
         unsigned i = 0;
 
+        /**
+         * Sampler thread takes API lock, stop it first
+         */
+        pqos_sampler_fini();
+
         _pqos_api_lock();
 
         ret = _pqos_check_init(1);
@@ -805,10 +1072,13 @@ pqos_fini(void)
         pqos_mon_fini();
         pqos_alloc_fini();
 
-        ret = cpuinfo_fini();
-        if (ret!=CPUINFO_RETVAL_OK) {
-                retval = PQOS_RETVAL_ERROR;
-                LOG_ERROR("cpuinfo_fini() error %d\n", ret);
+        if (m_cpuinfo_used) {
+                ret = cpuinfo_fini();
+                if (ret!=CPUINFO_RETVAL_OK) {
+                        retval = PQOS_RETVAL_ERROR;
+                        LOG_ERROR("cpuinfo_fini() error %d\n", ret);
+                }
+                m_cpuinfo_used = 0;
         }
 
         ret = machine_fini();
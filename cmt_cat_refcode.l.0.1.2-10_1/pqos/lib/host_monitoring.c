@@ -42,6 +42,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <pthread.h>
 
 #include "pqos.h"
@@ -50,6 +51,7 @@
 #include "host_monitoring.h"
 
 #include "machine.h"
+#include "cpuid_cache.h"
 #include "types.h"
 #include "log.h"
 
@@ -93,6 +95,72 @@
 #define PQOS_MSR_L3CA_MASK_END   0xD8F
 #define PQOS_MSR_L3CA_MASK_NUMOF (PQOS_MSR_L3CA_MASK_END-PQOS_MSR_L3CA_MASK_START+1)
 
+/**
+ * Core performance monitoring MSR registers
+ */
+#define PQOS_MSR_PERF_FIXED_CTR0     0x309      /**< instructions retired */
+#define PQOS_MSR_PERF_FIXED_CTR1     0x30A      /**< unhalted core cycles */
+#define PQOS_MSR_PERF_FIXED_CTR_CTRL 0x38D
+#define PQOS_MSR_PERF_GLOBAL_CTRL    0x38F
+#define PQOS_MSR_PERFEVTSEL0         0x186
+#define PQOS_MSR_PMC0                0xC1
+
+/**
+ * Fixed counter control, 4 bits per counter
+ * [7..<CTR1 PMI,ANY,USR,OS>..4][3..<CTR0 PMI,ANY,USR,OS>..0]
+ * Counters 0 and 1 count in user and kernel mode.
+ */
+#define PQOS_MSR_PERF_FIXED_CTR_CTRL_MASK 0xffULL
+#define PQOS_MSR_PERF_FIXED_CTR_CTRL_EN   0x33ULL
+
+/**
+ * Global counter enable bits
+ */
+#define PQOS_MSR_PERF_GLOBAL_CTRL_PMC0  (1ULL<<0)
+#define PQOS_MSR_PERF_GLOBAL_CTRL_FIXED ((1ULL<<32)|(1ULL<<33))
+
+/**
+ * Architectural LLC misses event (event 0x2E, umask 0x41)
+ * counted in user and kernel mode
+ * [22<EN>][17<OS>][16<USR>][15..<UMASK>..8][7..<EVENT>..0]
+ */
+#define PQOS_PERF_EVTSEL_LLC_MISS 0x43412EULL
+
+#define PQOS_PERF_DEF_WIDTH 48                  /**< counter width if not enumerated */
+
+/**
+ * Performance counter events of a monitoring group
+ */
+#define PQOS_PERF_EVENTS (PQOS_PERF_EVENT_IPC | PQOS_PERF_EVENT_LLC_MISS)
+
+/**
+ * Free running effective frequency counters, 64 bit wide
+ * MPERF counts at the base frequency and APERF at the actual
+ * frequency while the core is not halted.
+ */
+#define PQOS_MSR_MPERF 0xE7
+#define PQOS_MSR_APERF 0xE8
+
+/**
+ * RAPL registers
+ *
+ * Energy status registers are 32 bit counters in units of 1/2^ESU
+ * Joules, ESU is taken from the power unit register
+ * [12..<ESU>..8]
+ */
+#define PQOS_MSR_RAPL_POWER_UNIT    0x606
+#define PQOS_MSR_RAPL_ESU(val)      (((val) >> 8) & 0x1fULL)
+#define PQOS_MSR_PKG_ENERGY_STATUS  0x611
+#define PQOS_MSR_DRAM_ENERGY_STATUS 0x619
+#define PQOS_MSR_ENERGY_MASK        0xffffffffULL
+
+#define PQOS_RAPL_DRAM_SERVER_ESU   16          /**< fixed DRAM ESU of server parts */
+
+/**
+ * RAPL energy events of a monitoring group
+ */
+#define PQOS_PWR_EVENTS (PQOS_PWR_EVENT_PKG_ENERGY | PQOS_PWR_EVENT_DRAM_ENERGY)
+
 /**
  * Special RMID - after reset all cores are associated with it.
  *
@@ -120,6 +188,25 @@ enum rmid_state {
                                                            another process for monitoring */
 };
 
+/**
+ * Started monitoring group as tracked by the library
+ *
+ * The group is referenced by its owner until pqos_mon_stop() and by
+ * every sampler subscription polling it. RMID, core association and
+ * counters are released when the last reference is dropped, so copies
+ * of the group stay valid while they are referenced.
+ */
+struct mon_group {
+        unsigned refs;                                  /**< owner and subscription references */
+        int stopped;                                    /**< owner called pqos_mon_stop() */
+        pqos_rmid_t rmid;                               /**< RMID allocated for the group */
+        unsigned cluster;                               /**< cluster id of the group */
+        unsigned socket;                                /**< socket id of the group */
+        enum pqos_mon_event event;                      /**< monitored events */
+        unsigned num_cores;                             /**< number of cores in the group */
+        unsigned *cores;                                /**< library copy of the core list */
+};
+
 /**
  * Per logical core entry to track monitoring processes
  */
@@ -127,7 +214,29 @@ struct mon_entry {
         pqos_rmid_t rmid;                               /**< current RMID association */
         int unavailable;                                /**< if true then core is subject of
                                                            monitoring by another process */
-        struct pqos_mon_data *grp;                      /**< monitoring group the core belongs to */
+        struct mon_group *grp;                          /**< monitoring group the core belongs to */
+        unsigned perf;                                  /**< performance counter events
+                                                           programmed on the core */
+        uint64_t fixed_ctrl;                            /**< saved fixed counter control */
+        uint64_t global_ctrl;                           /**< saved global counter control */
+        uint64_t evtsel;                                /**< saved event select 0 */
+};
+
+/**
+ * Per socket RAPL counters, shared by all groups of the socket
+ */
+struct mon_socket {
+        unsigned lcore;                                 /**< core to access socket registers on */
+        unsigned users;                                 /**< number of groups reading energy */
+        unsigned pass;                                  /**< poll pass of the last read */
+        double pkg_unit;                                /**< package energy unit in Joules */
+        double dram_unit;                               /**< DRAM energy unit in Joules */
+        uint64_t pkg_energy;                            /**< last package energy count */
+        uint64_t dram_energy;                           /**< last DRAM energy count */
+        uint64_t timestamp;                             /**< CLOCK_MONOTONIC time of the last
+                                                           read in nanoseconds */
+        double pkg_power;                               /**< package power in Joules/s */
+        double dram_power;                              /**< DRAM power in Joules/s */
 };
 
 /**
@@ -145,6 +254,15 @@ static unsigned m_dim_cores = 0;                        /**< max coreid in the t
 
 static struct mon_entry *m_core_map = NULL;             /**< map of core states */
 
+static uint64_t m_fixed_mask = 0;                       /**< fixed counter value mask */
+static uint64_t m_gp_mask = 0;                          /**< general purpose counter value mask */
+
+static unsigned m_base_mhz = 0;                         /**< MPERF rate in MHz */
+static unsigned m_pwr_events = 0;                       /**< RAPL events discovered */
+static struct mon_socket *m_socket_map = NULL;          /**< map of socket RAPL states */
+static unsigned m_num_sockets = 0;                      /**< max socket id in the topology */
+static unsigned m_poll_pass = 0;                        /**< pqos_mon_poll() call counter */
+
 /**
  * ---------------------------------------
  * Local Functions
@@ -157,6 +275,9 @@ cpu_get_num_clusters(const struct pqos_cpuinfo *cpu);
 static unsigned
 cpu_get_num_cores(const struct pqos_cpuinfo *cpu);
 
+static unsigned
+cpu_get_num_sockets(const struct pqos_cpuinfo *cpu);
+
 static int
 mon_assoc_set_nocheck(const unsigned lcore,
                       const pqos_rmid_t rmid );
@@ -185,6 +306,25 @@ static int
 rmid_free( const unsigned cluster,
            const pqos_rmid_t rmid );
 
+static uint64_t
+perf_width_mask(const enum cpuid_field field);
+
+static int
+perf_start(const unsigned lcore,
+           const unsigned events);
+
+static int
+perf_stop(const unsigned lcore);
+
+static int
+rapl_init(void);
+
+static void
+mon_group_free(struct mon_group *g);
+
+static uint64_t
+mon_now(void);
+
 /**
  * =======================================
  * =======================================
@@ -202,6 +342,7 @@ pqos_mon_init(const struct pqos_cpuinfo *cpu,
               const struct pqos_config *cfg)
 {
         const struct pqos_capability *item = NULL;
+        const struct pqos_monitor *p_mon = NULL;
         unsigned i=0, fails=0;
         int ret = PQOS_RETVAL_OK;
 
@@ -240,6 +381,19 @@ pqos_mon_init(const struct pqos_cpuinfo *cpu,
         }
         memset(m_core_map, 0, m_dim_cores*sizeof(m_core_map[0]));
 
+        m_fixed_mask = perf_width_mask(CPUID_F_PMU_FIX_WIDTH);
+        m_gp_mask = perf_width_mask(CPUID_F_PMU_GP_WIDTH);
+
+        if (pqos_cap_get_event(cap, PQOS_PERF_EVENT_FREQ,
+                               &p_mon)==PQOS_RETVAL_OK)
+                m_base_mhz = p_mon->scale_factor;
+
+        ret = rapl_init();
+        if (ret!=PQOS_RETVAL_OK) {
+                pqos_mon_fini();
+                return ret;
+        }
+
         m_rmid_cluster_map = (enum rmid_state**) malloc(m_num_clusters*sizeof(m_rmid_cluster_map[0]));
         ASSERT(m_rmid_cluster_map!=NULL);
         if (m_rmid_cluster_map==NULL) {
@@ -334,8 +488,13 @@ pqos_mon_fini(void)
         if (m_core_map!=NULL && m_cpu!=NULL) {
                 /**
                  * Assign monitored cores back to RMID0
+                 * and restore their performance counters
                  */
                 unsigned i;
+                for (i=0;i<m_dim_cores;i++)
+                        if (m_core_map[i].perf && perf_stop(i)!=PQOS_RETVAL_OK)
+                                LOG_ERROR("Failed to restore performance "
+                                          "counters of core %u!\n", i);
                 for (i=0;i<m_cpu->num_cores;i++) {
                         if (m_core_map[i].rmid != RMID0 &&
                             m_core_map[i].unavailable==0) {
@@ -372,11 +531,33 @@ pqos_mon_fini(void)
          * core <=> RMID assignment
          */
         if (m_core_map!=NULL) {
+                unsigned i, j;
+
+                /**
+                 * Groups left started are freed through their first core
+                 */
+                for (i=0;i<m_dim_cores;i++) {
+                        struct mon_group *g = m_core_map[i].grp;
+
+                        if (g==NULL)
+                                continue;
+                        for (j=0;j<g->num_cores;j++)
+                                m_core_map[g->cores[j]].grp = NULL;
+                        mon_group_free(g);
+                }
                 free(m_core_map);
                 m_core_map = NULL;
         }
         m_dim_cores = 0;
 
+        if (m_socket_map!=NULL) {
+                free(m_socket_map);
+                m_socket_map = NULL;
+        }
+        m_num_sockets = 0;
+        m_pwr_events = 0;
+        m_base_mhz = 0;
+
         m_cpu = NULL;
         m_cap = NULL;
 
@@ -785,6 +966,478 @@ mon_read( const unsigned lcore,
         return retval;
 }
 
+/**
+ * @brief Programs performance counters of \a lcore for \a events
+ *
+ * Current counter control registers are saved and restored
+ * by perf_stop(). Fixed counters are programmed for any of
+ * the events so that LLC misses can be related to instructions.
+ *
+ * @param lcore logical core id
+ * @param events PQOS_PERF_EVENT_* mask
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+perf_start(const unsigned lcore,
+           const unsigned events)
+{
+        struct mon_entry *e = &m_core_map[lcore];
+        uint64_t fixed_ctrl = 0, global_ctrl = 0;
+
+        ASSERT(e->perf==0);
+        if (msr_read(lcore, PQOS_MSR_PERF_FIXED_CTR_CTRL,
+                     &e->fixed_ctrl)!=MACHINE_RETVAL_OK ||
+            msr_read(lcore, PQOS_MSR_PERF_GLOBAL_CTRL,
+                     &e->global_ctrl)!=MACHINE_RETVAL_OK)
+                return PQOS_RETVAL_ERROR;
+        if ((events & PQOS_PERF_EVENT_LLC_MISS) &&
+            msr_read(lcore, PQOS_MSR_PERFEVTSEL0,
+                     &e->evtsel)!=MACHINE_RETVAL_OK)
+                return PQOS_RETVAL_ERROR;
+
+        e->perf = events;
+
+        fixed_ctrl = e->fixed_ctrl & ~PQOS_MSR_PERF_FIXED_CTR_CTRL_MASK;
+        fixed_ctrl |= PQOS_MSR_PERF_FIXED_CTR_CTRL_EN;
+        global_ctrl = e->global_ctrl | PQOS_MSR_PERF_GLOBAL_CTRL_FIXED;
+        if (events & PQOS_PERF_EVENT_LLC_MISS)
+                global_ctrl |= PQOS_MSR_PERF_GLOBAL_CTRL_PMC0;
+
+        if (msr_write(lcore, PQOS_MSR_PERF_FIXED_CTR_CTRL,
+                      fixed_ctrl)!=MACHINE_RETVAL_OK ||
+            ((events & PQOS_PERF_EVENT_LLC_MISS) &&
+             msr_write(lcore, PQOS_MSR_PERFEVTSEL0,
+                       PQOS_PERF_EVTSEL_LLC_MISS)!=MACHINE_RETVAL_OK) ||
+            msr_write(lcore, PQOS_MSR_PERF_GLOBAL_CTRL,
+                      global_ctrl)!=MACHINE_RETVAL_OK)
+                goto error;
+
+        return PQOS_RETVAL_OK;
+
+ error:
+        (void) perf_stop(lcore);
+        return PQOS_RETVAL_ERROR;
+}
+
+/**
+ * @brief Restores performance counter control registers of \a lcore
+ *
+ * @param lcore logical core id
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+perf_stop(const unsigned lcore)
+{
+        struct mon_entry *e = &m_core_map[lcore];
+        int ret = PQOS_RETVAL_OK;
+
+        if (!e->perf)
+                return PQOS_RETVAL_OK;
+
+        if (msr_write(lcore, PQOS_MSR_PERF_GLOBAL_CTRL,
+                      e->global_ctrl)!=MACHINE_RETVAL_OK)
+                ret = PQOS_RETVAL_ERROR;
+        if (msr_write(lcore, PQOS_MSR_PERF_FIXED_CTR_CTRL,
+                      e->fixed_ctrl)!=MACHINE_RETVAL_OK)
+                ret = PQOS_RETVAL_ERROR;
+        if ((e->perf & PQOS_PERF_EVENT_LLC_MISS) &&
+            msr_write(lcore, PQOS_MSR_PERFEVTSEL0,
+                      e->evtsel)!=MACHINE_RETVAL_OK)
+                ret = PQOS_RETVAL_ERROR;
+
+        e->perf = 0;
+        return ret;
+}
+
+/**
+ * @brief Reads performance counters of \a cores and sums them up
+ *
+ * Sums are kept modulo counter width, so the difference of two sums
+ * modulo counter width is the sum of per core increments, with
+ * counter wraps between the two reads accounted for.
+ *
+ * @param cores list of logical core ids
+ * @param num_cores number of cores
+ * @param events PQOS_PERF_EVENT_* mask programmed on the cores
+ * @param cnt place to store the sums
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+perf_counters(const unsigned *cores,
+              const unsigned num_cores,
+              const unsigned events,
+              struct pqos_mon_counters *cnt)
+{
+        unsigned i;
+
+        cnt->instructions = 0;
+        cnt->cycles = 0;
+        cnt->llc_misses = 0;
+        for (i=0;i<num_cores;i++) {
+                const unsigned lcore = cores[i];
+                uint64_t instructions = 0, cycles = 0, llc_misses = 0;
+
+                if (msr_read(lcore, PQOS_MSR_PERF_FIXED_CTR0,
+                             &instructions)!=MACHINE_RETVAL_OK ||
+                    msr_read(lcore, PQOS_MSR_PERF_FIXED_CTR1,
+                             &cycles)!=MACHINE_RETVAL_OK ||
+                    ((events & PQOS_PERF_EVENT_LLC_MISS) &&
+                     msr_read(lcore, PQOS_MSR_PMC0,
+                              &llc_misses)!=MACHINE_RETVAL_OK)) {
+                        LOG_WARN("Failed to read performance counters "
+                                 "on core %u\n", lcore);
+                        return PQOS_RETVAL_ERROR;
+                }
+                cnt->instructions = (cnt->instructions + instructions) &
+                        m_fixed_mask;
+                cnt->cycles = (cnt->cycles + cycles) & m_fixed_mask;
+                cnt->llc_misses = (cnt->llc_misses + llc_misses) & m_gp_mask;
+        }
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Reads APERF/MPERF of \a cores and sums them up
+ *
+ * The counters are 64 bit wide, the difference of two sums
+ * taken with unsigned arithmetic accounts for a wrap.
+ *
+ * @param cores list of logical core ids
+ * @param num_cores number of cores
+ * @param cnt place to store the sums
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+freq_counters(const unsigned *cores,
+              const unsigned num_cores,
+              struct pqos_mon_counters *cnt)
+{
+        unsigned i;
+
+        cnt->aperf = 0;
+        cnt->mperf = 0;
+        for (i=0;i<num_cores;i++) {
+                uint64_t aperf = 0, mperf = 0;
+
+                if (msr_read(cores[i], PQOS_MSR_MPERF,
+                             &mperf)!=MACHINE_RETVAL_OK ||
+                    msr_read(cores[i], PQOS_MSR_APERF,
+                             &aperf)!=MACHINE_RETVAL_OK) {
+                        LOG_WARN("Failed to read APERF/MPERF "
+                                 "on core %u\n", cores[i]);
+                        return PQOS_RETVAL_ERROR;
+                }
+                cnt->aperf += aperf;
+                cnt->mperf += mperf;
+        }
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Checks if DRAM energy is counted in fixed units
+ *
+ * Server parts ignore the power unit register for DRAM
+ * and count it in 1/2^16 Joules.
+ *
+ * @return 1 if DRAM energy unit is fixed, 0 otherwise
+ */
+static int
+rapl_dram_unit_fixed(void)
+{
+        static const unsigned models[] = {
+                0x3F,                           /**< Haswell SP */
+                0x4F, 0x56,                     /**< Broadwell SP/DE */
+                0x55,                           /**< Skylake/Cascade Lake SP */
+                0x57, 0x85,                     /**< Knights Landing/Mill */
+                0x6A, 0x6C,                     /**< Ice Lake SP/D */
+                0x8F,                           /**< Sapphire Rapids */
+                0xCF,                           /**< Emerald Rapids */
+        };
+        uint32_t family = 0, model = 0, ext_model = 0;
+        unsigned i;
+
+        if (cpuid_field_get(CPUID_F_FAMILY, &family)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_MODEL, &model)!=MACHINE_RETVAL_OK ||
+            cpuid_field_get(CPUID_F_EXT_MODEL,
+                            &ext_model)!=MACHINE_RETVAL_OK)
+                return 0;
+
+        model |= ext_model << 4;
+        if (family!=6)
+                return 0;
+
+        for (i=0;i<DIM(models);i++)
+                if (models[i]==model)
+                        return 1;
+        return 0;
+}
+
+/**
+ * @brief Sets up per socket RAPL state
+ *
+ * Energy units are read from the power unit register of
+ * every socket. Capability discovery reports energy events
+ * only if the register reads, if it fails here anyway
+ * pqos_mon_start() rejects the events.
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+rapl_init(void)
+{
+        const struct pqos_monitor *p_mon = NULL;
+        unsigned i;
+        int dram_fixed;
+
+        if (pqos_cap_get_event(m_cap, PQOS_PWR_EVENT_PKG_ENERGY,
+                               &p_mon)==PQOS_RETVAL_OK)
+                m_pwr_events |= PQOS_PWR_EVENT_PKG_ENERGY;
+        if (pqos_cap_get_event(m_cap, PQOS_PWR_EVENT_DRAM_ENERGY,
+                               &p_mon)==PQOS_RETVAL_OK)
+                m_pwr_events |= PQOS_PWR_EVENT_DRAM_ENERGY;
+        if (!m_pwr_events)
+                return PQOS_RETVAL_OK;
+
+        m_num_sockets = cpu_get_num_sockets(m_cpu);
+        m_socket_map = (struct mon_socket *) calloc(m_num_sockets,
+                                                    sizeof(m_socket_map[0]));
+        if (m_socket_map==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        dram_fixed = rapl_dram_unit_fixed();
+        for (i=0;i<m_num_sockets;i++) {
+                struct mon_socket *sock = &m_socket_map[i];
+                unsigned count = 0;
+                uint64_t val = 0;
+
+                if (pqos_cpu_get_cores(m_cpu, i, 1, &count,
+                                       &sock->lcore)!=PQOS_RETVAL_OK)
+                        continue;               /**< no cores on the socket */
+
+                if (msr_read(sock->lcore, PQOS_MSR_RAPL_POWER_UNIT,
+                             &val)!=MACHINE_RETVAL_OK) {
+                        LOG_WARN("Failed to read RAPL power unit "
+                                 "on socket %u, energy events "
+                                 "disabled\n", i);
+                        m_pwr_events = 0;
+                        return PQOS_RETVAL_OK;
+                }
+                sock->pkg_unit = 1.0 / (double) (1ULL << PQOS_MSR_RAPL_ESU(val));
+                sock->dram_unit = dram_fixed ?
+                        1.0 / (double) (1ULL << PQOS_RAPL_DRAM_SERVER_ESU) :
+                        sock->pkg_unit;
+        }
+
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Reads RAPL energy counters of \a sock
+ *
+ * @param sock socket RAPL state
+ * @param pkg place to store package energy count
+ * @param dram place to store DRAM energy count, 0 if not available
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+rapl_counters(const struct mon_socket *sock,
+              uint64_t *pkg,
+              uint64_t *dram)
+{
+        *dram = 0;
+        if (msr_read(sock->lcore, PQOS_MSR_PKG_ENERGY_STATUS,
+                     pkg)!=MACHINE_RETVAL_OK)
+                return PQOS_RETVAL_ERROR;
+        if ((m_pwr_events & PQOS_PWR_EVENT_DRAM_ENERGY) &&
+            msr_read(sock->lcore, PQOS_MSR_DRAM_ENERGY_STATUS,
+                     dram)!=MACHINE_RETVAL_OK)
+                return PQOS_RETVAL_ERROR;
+
+        *pkg &= PQOS_MSR_ENERGY_MASK;
+        *dram &= PQOS_MSR_ENERGY_MASK;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Takes reference RAPL counts of \a socket for a new group
+ *
+ * Counters are shared by all groups of the socket, the first
+ * group to start takes the reference.
+ *
+ * @param socket socket id
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+rapl_start(const unsigned socket)
+{
+        struct mon_socket *sock = &m_socket_map[socket];
+
+        ASSERT(socket<m_num_sockets);
+        if (sock->users==0) {
+                if (rapl_counters(sock, &sock->pkg_energy,
+                                  &sock->dram_energy)!=PQOS_RETVAL_OK)
+                        return PQOS_RETVAL_ERROR;
+                sock->timestamp = mon_now();
+                sock->pass = m_poll_pass;
+                sock->pkg_power = 0.0;
+                sock->dram_power = 0.0;
+        }
+        sock->users++;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Updates power of \a socket, once per poll pass
+ *
+ * Energy increments are taken modulo 2^32, so one wrap
+ * between two reads is accounted for.
+ *
+ * @param socket socket id
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+rapl_read(const unsigned socket)
+{
+        struct mon_socket *sock = &m_socket_map[socket];
+        uint64_t pkg = 0, dram = 0, now;
+        double dt;
+
+        ASSERT(socket<m_num_sockets);
+        if (sock->pass==m_poll_pass)
+                return PQOS_RETVAL_OK;
+
+        if (rapl_counters(sock, &pkg, &dram)!=PQOS_RETVAL_OK)
+                return PQOS_RETVAL_ERROR;
+
+        now = mon_now();
+        dt = (double) (now - sock->timestamp) / 1e9;
+        if (dt>0.0) {
+                sock->pkg_power = (double) ((pkg - sock->pkg_energy) &
+                                            PQOS_MSR_ENERGY_MASK) *
+                        sock->pkg_unit / dt;
+                sock->dram_power = (double) ((dram - sock->dram_energy) &
+                                             PQOS_MSR_ENERGY_MASK) *
+                        sock->dram_unit / dt;
+        }
+        sock->pkg_energy = pkg;
+        sock->dram_energy = dram;
+        sock->timestamp = now;
+        sock->pass = m_poll_pass;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Frees library copy of a monitoring group
+ *
+ * @param g group to free, can be NULL
+ */
+static void
+mon_group_free(struct mon_group *g)
+{
+        if (g==NULL)
+                return;
+        free(g->cores);
+        free(g);
+}
+
+/**
+ * @brief Finds library copy of a started monitoring group
+ *
+ * All cores of \a group have to belong to the same tracked group
+ * and its RMID has to match.
+ *
+ * @param group monitoring group as returned by pqos_mon_start()
+ *
+ * @return Tracked group or NULL if \a group is not started
+ */
+static struct mon_group *
+mon_group_find(const struct pqos_mon_data *group)
+{
+        struct mon_group *g = NULL;
+        unsigned i;
+
+        for (i=0;i<group->num_cores;i++) {
+                const unsigned lcore = group->cores[i];
+
+                if (lcore>=m_dim_cores || m_core_map[lcore].grp==NULL)
+                        return NULL;
+                if (i==0)
+                        g = m_core_map[lcore].grp;
+                else if (m_core_map[lcore].grp!=g)
+                        return NULL;
+        }
+
+        if (g==NULL || g->rmid!=group->rmid ||
+            g->num_cores!=group->num_cores)
+                return NULL;
+        return g;
+}
+
+/**
+ * @brief Drops reference to monitoring group \a g
+ *
+ * The last reference restores performance counters, associates
+ * the cores back with RMID0 and frees the RMID.
+ *
+ * @param g tracked monitoring group
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+mon_group_put(struct mon_group *g)
+{
+        int ret = PQOS_RETVAL_OK;
+        unsigned i;
+
+        ASSERT(g->refs>0);
+        if (--g->refs>0)
+                return PQOS_RETVAL_OK;
+
+        for (i=0;i<g->num_cores;i++) {
+                /**
+                 * Associate cores from the group back with RMID0
+                 */
+                unsigned lcore = g->cores[i];
+                if (perf_stop(lcore)!=PQOS_RETVAL_OK)
+                        LOG_WARN("Failed to restore performance counters "
+                                 "of core %u\n", lcore);
+                m_core_map[lcore].grp = NULL;
+                m_core_map[lcore].rmid = 0;
+                if (mon_assoc_set_nocheck(lcore,RMID0)!=PQOS_RETVAL_OK)
+                        ret = PQOS_RETVAL_RESOURCE;
+        }
+
+        if (g->event & PQOS_PWR_EVENTS) {
+                ASSERT(m_socket_map[g->socket].users>0);
+                m_socket_map[g->socket].users--;
+        }
+
+        /**
+         * Free previously allocated RMID
+         */
+        if (rmid_free(g->cluster,g->rmid)!=PQOS_RETVAL_OK)
+                ret = PQOS_RETVAL_RESOURCE;
+
+        mon_group_free(g);
+        return ret;
+}
+
 int
 pqos_mon_start( const unsigned num_cores,
                 const unsigned *cores,
@@ -792,6 +1445,12 @@ pqos_mon_start( const unsigned num_cores,
                 void *context,
                 struct pqos_mon_data *group)
 {
+        static const enum pqos_mon_event opt_events[] = {
+                PQOS_PERF_EVENT_IPC, PQOS_PERF_EVENT_LLC_MISS,
+                PQOS_PERF_EVENT_FREQ, PQOS_PWR_EVENT_PKG_ENERGY,
+                PQOS_PWR_EVENT_DRAM_ENERGY
+        };
+        struct mon_group *g = NULL;
         unsigned cluster = 0, socket = 0;
         unsigned i = 0;
         int ret = PQOS_RETVAL_OK;
@@ -877,15 +1536,25 @@ pqos_mon_start( const unsigned num_cores,
         }
 
         /**
-         * Validate event parameter
+         * Validate event parameter, LLC occupancy is always monitored
+         * and performance counter events have to be discovered
          */
-        switch (event) {
-        case PQOS_MON_EVENT_L3_OCCUP:
-                break;
-        default:
+        if (!(event & PQOS_MON_EVENT_L3_OCCUP) ||
+            (event & ~(PQOS_MON_EVENT_L3_OCCUP | PQOS_PERF_EVENTS |
+                       PQOS_PERF_EVENT_FREQ | PQOS_PWR_EVENTS)) ||
+            (event & PQOS_PWR_EVENTS & ~m_pwr_events)) {
                 _pqos_api_unlock();
                 return PQOS_RETVAL_PARAM;
-                break;
+        }
+        for (i=0;i<DIM(opt_events);i++) {
+                const struct pqos_monitor *p_mon = NULL;
+
+                if ((event & opt_events[i]) &&
+                    pqos_cap_get_event(m_cap, opt_events[i],
+                                       &p_mon)!=PQOS_RETVAL_OK) {
+                        _pqos_api_unlock();
+                        return PQOS_RETVAL_PARAM;
+                }
         }
 
         /**
@@ -893,14 +1562,22 @@ pqos_mon_start( const unsigned num_cores,
          */
         memset(group, 0, sizeof(*group));
         group->cores = (unsigned *) malloc(sizeof(group->cores[0])*num_cores);
-        if (group->cores==NULL) {
+        g = (struct mon_group *) calloc(1, sizeof(*g));
+        if (g!=NULL)
+                g->cores = (unsigned *) malloc(sizeof(g->cores[0])*num_cores);
+        if (group->cores==NULL || g==NULL || g->cores==NULL) {
+                free(group->cores);
+                group->cores = NULL;
+                mon_group_free(g);
                 _pqos_api_unlock();
                 return PQOS_RETVAL_RESOURCE;
         }
 
-        ret = rmid_alloc(cluster, event, &rmid);
+        ret = rmid_alloc(cluster, PQOS_MON_EVENT_L3_OCCUP, &rmid);
         if (ret!=PQOS_RETVAL_OK) {
                 free(group->cores);
+                group->cores = NULL;
+                mon_group_free(g);
                 _pqos_api_unlock();
                 return PQOS_RETVAL_RESOURCE;
         }
@@ -912,11 +1589,45 @@ pqos_mon_start( const unsigned num_cores,
         group->num_cores = num_cores;
         for (i=0;i<num_cores;i++) {
                 group->cores[i] = cores[i];
+                g->cores[i] = cores[i];
                 ret = mon_assoc_set(cores[i], cluster, rmid);
+                if (ret!=PQOS_RETVAL_OK)
+                        goto error;
+        }
+
+        /**
+         * Program performance counters of the cores and take
+         * reference frequency and energy counts,
+         * on failure the group is released
+         */
+        for (i=0;(event & PQOS_PERF_EVENTS) && i<num_cores;i++) {
+                ret = perf_start(cores[i], event & PQOS_PERF_EVENTS);
                 if (ret!=PQOS_RETVAL_OK) {
-                        free(group->cores);
-                        _pqos_api_unlock();
-                        return ret;
+                        LOG_ERROR("Failed to program performance counters "
+                                  "of core %u!\n", cores[i]);
+                        goto error;
+                }
+        }
+        if (event & PQOS_PERF_EVENTS) {
+                /**
+                 * Initial counts, deltas are reported from the first poll
+                 */
+                ret = perf_counters(cores, num_cores,
+                                    event & PQOS_PERF_EVENTS, &group->last);
+                if (ret!=PQOS_RETVAL_OK)
+                        goto error;
+        }
+        if (event & PQOS_PERF_EVENT_FREQ) {
+                ret = freq_counters(cores, num_cores, &group->last);
+                if (ret!=PQOS_RETVAL_OK)
+                        goto error;
+        }
+        if (event & PQOS_PWR_EVENTS) {
+                ret = rapl_start(socket);
+                if (ret!=PQOS_RETVAL_OK) {
+                        LOG_ERROR("Failed to read RAPL energy counters "
+                                  "of socket %u!\n", socket);
+                        goto error;
                 }
         }
 
@@ -925,25 +1636,46 @@ pqos_mon_start( const unsigned num_cores,
         group->cluster = cluster;
         group->socket = socket;
         group->context = context;
+
+        g->refs = 1;
+        g->event = event;
+        g->rmid = rmid;
+        g->cluster = cluster;
+        g->socket = socket;
+        g->num_cores = num_cores;
         
         for (i=0;i<num_cores;i++) {
                 /**
                  * Mark monitoring activity in the core map
                  */
                 unsigned lcore = cores[i];
-                m_core_map[lcore].grp = group;
+                m_core_map[lcore].grp = g;
         }
 
         _pqos_api_unlock();
         return ret;
+
+ error:
+        for (i=0;i<num_cores;i++) {
+                (void) perf_stop(cores[i]);
+                m_core_map[cores[i]].rmid = RMID0;
+                (void) mon_assoc_set_nocheck(cores[i], RMID0);
+        }
+        (void) rmid_free(cluster, rmid);
+        mon_group_free(g);
+        free(group->cores);
+        group->cores = NULL;
+        group->num_cores = 0;
+        _pqos_api_unlock();
+        return ret;
 }
 
 int
 pqos_mon_stop( struct pqos_mon_data *group )
 {
+        struct mon_group *g = NULL;
         int ret = PQOS_RETVAL_OK;
         unsigned i = 0;
-        unsigned cluster = 0;
 
         if (group==NULL)
                 return PQOS_RETVAL_PARAM;
@@ -970,47 +1702,21 @@ pqos_mon_stop( struct pqos_mon_data *group )
                         _pqos_api_unlock();
                         return PQOS_RETVAL_PARAM;
                 }
-                if (m_core_map[lcore].grp==NULL) {
-                        _pqos_api_unlock();
-                        return PQOS_RETVAL_RESOURCE;
-                }
         }
 
-        /**
-         * add check for the same cluster id
-         */
-        ret = pqos_cpu_get_clusterid(m_cpu,group->cores[0],&cluster);
-        if (ret!=PQOS_RETVAL_OK) {
-                _pqos_api_unlock();
-                return PQOS_RETVAL_PARAM;
-        }
-
-        for (i=0;i<group->num_cores;i++) {
-                /**
-                 * Associate cores from the group back with RMID0
-                 */
-                unsigned lcore = group->cores[i];
-                m_core_map[lcore].grp = NULL;
-                m_core_map[lcore].rmid = 0;
-                ret = mon_assoc_set_nocheck(lcore,RMID0);
-                if (ret!=PQOS_RETVAL_OK) {
-                        _pqos_api_unlock();
-                        return PQOS_RETVAL_RESOURCE;
-                }
-        }
-
-        /**
-         * Free previously allocated RMID
-         */
-        ret = rmid_free(cluster,group->rmid);
-        if (ret!=PQOS_RETVAL_OK) {
+        g = mon_group_find(group);
+        if (g==NULL || g->stopped) {
                 _pqos_api_unlock();
                 return PQOS_RETVAL_RESOURCE;
         }
 
         /**
-         * Free the core list and clear the group structure
+         * Hardware is released with the last reference,
+         * the caller's copy of the group goes now
          */
+        g->stopped = 1;
+        ret = mon_group_put(g);
+
         free(group->cores);
         memset(group,0,sizeof(*group));
 
@@ -1018,6 +1724,39 @@ pqos_mon_stop( struct pqos_mon_data *group )
         return ret;
 }
 
+int
+_pqos_mon_group_get(const struct pqos_mon_data *group)
+{
+        struct mon_group *g = NULL;
+
+        ASSERT(group!=NULL);
+        if (group==NULL || group->num_cores==0 || group->cores==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        g = mon_group_find(group);
+        if (g==NULL || g->stopped)
+                return PQOS_RETVAL_PARAM;
+
+        g->refs++;
+        return PQOS_RETVAL_OK;
+}
+
+int
+_pqos_mon_group_put(const struct pqos_mon_data *group)
+{
+        struct mon_group *g = NULL;
+
+        ASSERT(group!=NULL);
+        if (group==NULL || group->num_cores==0 || group->cores==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        g = mon_group_find(group);
+        if (g==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        return mon_group_put(g);
+}
+
 int
 pqos_mon_poll(struct pqos_mon_data *groups,
               const unsigned num_groups)
@@ -1038,14 +1777,84 @@ pqos_mon_poll(struct pqos_mon_data *groups,
                 return ret;
         }
 
+        /**
+         * New pass, socket energy counters get read once
+         */
+        m_poll_pass++;
+
         for (i=0;i<num_groups;i++) {
-                ret = mon_read(groups[i].cores[0], groups[i].rmid,
-                               groups[i].event, &groups[i].value);
+                struct pqos_mon_data *grp = &groups[i];
+
+                ret = mon_read(grp->cores[0], grp->rmid,
+                               PQOS_MON_EVENT_L3_OCCUP, &grp->value);
 
                 if (ret != PQOS_RETVAL_OK) {
                         LOG_WARN("Failed to read monitoring data for event %u on core %u (RMID%u)\n",
-                                 groups[i].event, groups[i].cores[0], groups[i].rmid);
-                        continue;
+                                 grp->event, grp->cores[0], grp->rmid);
+                }
+
+                /**
+                 * Performance counters are read in the same pass
+                 * so that they cover the same interval as occupancy.
+                 * Increments are taken against the group's own previous
+                 * counts, other pollers of the cores don't affect them.
+                 */
+                if (grp->event & PQOS_PERF_EVENTS) {
+                        struct pqos_mon_counters cnt;
+
+                        grp->instructions = 0;
+                        grp->cycles = 0;
+                        grp->llc_misses = 0;
+                        if (perf_counters(grp->cores, grp->num_cores,
+                                          grp->event & PQOS_PERF_EVENTS,
+                                          &cnt)==PQOS_RETVAL_OK) {
+                                grp->instructions = (cnt.instructions -
+                                                     grp->last.instructions) &
+                                        m_fixed_mask;
+                                grp->cycles = (cnt.cycles - grp->last.cycles) &
+                                        m_fixed_mask;
+                                grp->llc_misses = (cnt.llc_misses -
+                                                   grp->last.llc_misses) &
+                                        m_gp_mask;
+                                grp->last.instructions = cnt.instructions;
+                                grp->last.cycles = cnt.cycles;
+                                grp->last.llc_misses = cnt.llc_misses;
+                        }
+                        grp->ipc = (grp->cycles>0) ?
+                                (double) grp->instructions /
+                                (double) grp->cycles : 0.0;
+                }
+
+                if (grp->event & PQOS_PERF_EVENT_FREQ) {
+                        struct pqos_mon_counters cnt;
+
+                        grp->aperf = 0;
+                        grp->mperf = 0;
+                        if (freq_counters(grp->cores, grp->num_cores,
+                                          &cnt)==PQOS_RETVAL_OK) {
+                                grp->aperf = cnt.aperf - grp->last.aperf;
+                                grp->mperf = cnt.mperf - grp->last.mperf;
+                                grp->last.aperf = cnt.aperf;
+                                grp->last.mperf = cnt.mperf;
+                        }
+                        grp->freq = (grp->mperf>0) ?
+                                (double) m_base_mhz * (double) grp->aperf /
+                                (double) grp->mperf : 0.0;
+                }
+
+                if (grp->event & PQOS_PWR_EVENTS) {
+                        const struct mon_socket *sock =
+                                &m_socket_map[grp->socket];
+
+                        if (rapl_read(grp->socket)!=PQOS_RETVAL_OK)
+                                LOG_WARN("Failed to read RAPL energy counters "
+                                         "on socket %u\n", grp->socket);
+                        grp->pkg_power =
+                                (grp->event & PQOS_PWR_EVENT_PKG_ENERGY) ?
+                                sock->pkg_power : 0.0;
+                        grp->dram_power =
+                                (grp->event & PQOS_PWR_EVENT_DRAM_ENERGY) ?
+                                sock->dram_power : 0.0;
                 }
         }
 
@@ -1063,6 +1872,38 @@ pqos_mon_poll(struct pqos_mon_data *groups,
  * =======================================
  */
 
+/**
+ * @brief Returns value mask of performance counters
+ *        whose width is reported by CPUID \a field
+ *
+ * @param field counter width field
+ *
+ * @return Counter value mask
+ */
+static uint64_t
+perf_width_mask(const enum cpuid_field field)
+{
+        uint32_t width = 0;
+
+        if (cpuid_field_get(field, &width)!=MACHINE_RETVAL_OK ||
+            width==0 || width>=64)
+                width = PQOS_PERF_DEF_WIDTH;
+
+        return (1ULL << width) - 1ULL;
+}
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+mon_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
 /** 
  * @brief Finds maximum number of clusters in the topology
  *
@@ -1106,3 +1947,25 @@ cpu_get_num_cores(const struct pqos_cpuinfo *cpu)
 
         return n+1;
 }
+
+/**
+ * @brief Finds maximum number of sockets in the topology
+ *
+ * @param cpu cpu topology structure
+ *
+ * @return Max socket id (plus one) in the topology.
+ *         This indicates how big the look up table has to be if socket id is an index.
+ */
+static unsigned
+cpu_get_num_sockets(const struct pqos_cpuinfo *cpu)
+{
+        unsigned i=0, n=0;
+
+        ASSERT(cpu!=NULL);
+
+        for (i=0;i<cpu->num_cores;i++)
+                if (cpu->cores[i].socket>n)
+                        n = cpu->cores[i].socket;
+
+        return n+1;
+}
@@ -65,6 +65,35 @@ int pqos_mon_init(const struct pqos_cpuinfo *cpu,
  */
 int pqos_mon_fini(void);
 
+/**
+ * @brief Takes a reference to a started monitoring group
+ *
+ * RMID, core association and counters of the group stay in place
+ * until pqos_mon_stop() has been called and all references are
+ * dropped, so a copy of \a group with its own core list can be
+ * polled after the owner stopped it. Has to be called with API
+ * lock held.
+ *
+ * @param group started monitoring group
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK success
+ * @retval PQOS_RETVAL_PARAM group not started
+ */
+int _pqos_mon_group_get(const struct pqos_mon_data *group);
+
+/**
+ * @brief Drops reference taken by _pqos_mon_group_get()
+ *
+ * Has to be called with API lock held.
+ *
+ * @param group started monitoring group or its copy
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK success
+ */
+int _pqos_mon_group_put(const struct pqos_mon_data *group);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,625 @@
+/**
+ * @file host_sampler.c
+ * @brief Implementation of PQoS background sampler API
+ *
+ * Single thread polls all subscriptions. Due times of a subscription
+ * are multiples of its interval counted from a common epoch, so
+ * subscriptions with related intervals fall onto the same wake ups.
+ * Groups of all subscriptions due on a wake up are polled together
+ * with a single pqos_mon_poll() call.
+ *
+ * Sampler state is protected by its own mutex. The thread holds it
+ * while polling and takes the API lock inside pqos_mon_poll(), API
+ * functions must never take the sampler mutex with API lock held.
+ *
+ * Sample queues are single producer, single consumer rings. The
+ * sampler thread only advances head and the reader only advances tail.
+ * The reader takes the queue lock only, which the sampler thread never
+ * holds, so reading does not wait for a poll in progress. Unsubscribe
+ * takes both locks before the queue is freed.
+ *
+ * Subscriptions keep their own copies of the groups, each with its own
+ * core list and counter baselines, and hold a library reference to
+ * every group. A group stopped by its owner keeps being polled until
+ * it is unsubscribed.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "pqos.h"
+
+#include "host_cap.h"
+#include "host_monitoring.h"
+#include "host_sampler.h"
+
+#include "types.h"
+#include "log.h"
+
+/**
+ * ---------------------------------------
+ * Local data structures
+ * ---------------------------------------
+ */
+
+/**
+ * Subscription
+ */
+struct sampler_sub {
+        int used;
+        struct pqos_mon_data *groups;           /**< referenced copies of subscribed groups */
+        unsigned num_groups;
+        uint64_t interval;                      /**< interval in nanoseconds */
+        uint64_t next;                          /**< next due time */
+        pqos_sampler_cb_t callback;
+        void *context;
+        unsigned queue_size;                    /**< number of queue rows */
+        uint64_t *queue;                        /**< rows of timestamp and values */
+        uint64_t head;                          /**< rows written, sampler only */
+        uint64_t tail;                          /**< rows read, reader only */
+        uint64_t dropped;                       /**< rows that did not fit */
+};
+
+static struct sampler_sub m_subs[PQOS_SAMPLER_MAX_SUBS];
+static pthread_mutex_t m_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t m_read_lock = PTHREAD_MUTEX_INITIALIZER;  /**< queue lifetime */
+static pthread_cond_t m_cond;
+static int m_cond_init = 0;
+static pthread_t m_thread;
+static int m_running = 0;
+static int m_stop = 0;
+static uint64_t m_epoch = 0;                    /**< start of the common schedule */
+static struct pqos_mon_data *m_poll_groups = NULL;      /**< groups polled on a wake up */
+static unsigned m_poll_size = 0;                /**< number of entries in m_poll_groups */
+
+/**
+ * ---------------------------------------
+ * Local functions
+ * ---------------------------------------
+ */
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+sampler_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Checks library is initialized
+ *
+ * @return Operation status
+ */
+static int
+sampler_check_init(void)
+{
+        int ret;
+
+        _pqos_api_lock();
+        ret = _pqos_check_init(1);
+        _pqos_api_unlock();
+        return ret;
+}
+
+/**
+ * @brief Initializes condition variable on CLOCK_MONOTONIC
+ *
+ * Has to be called with sampler mutex held.
+ *
+ * @return Operation status
+ */
+static int
+sampler_cond_init(void)
+{
+        pthread_condattr_t attr;
+        int ret = PQOS_RETVAL_OK;
+
+        if (m_cond_init)
+                return PQOS_RETVAL_OK;
+
+        if (pthread_condattr_init(&attr)!=0)
+                return PQOS_RETVAL_ERROR;
+        if (pthread_condattr_setclock(&attr, CLOCK_MONOTONIC)!=0 ||
+            pthread_cond_init(&m_cond, &attr)!=0)
+                ret = PQOS_RETVAL_ERROR;
+        else
+                m_cond_init = 1;
+        pthread_condattr_destroy(&attr);
+        return ret;
+}
+
+/**
+ * @brief Makes poll table big enough for groups of all subscriptions
+ *
+ * Has to be called with sampler mutex held.
+ *
+ * @param extra number of groups of a subscription being added
+ *
+ * @return Operation status
+ */
+static int
+sampler_poll_resize(const unsigned extra)
+{
+        struct pqos_mon_data *groups = NULL;
+        unsigned i, n = extra;
+
+        for (i=0;i<DIM(m_subs);i++)
+                if (m_subs[i].used)
+                        n += m_subs[i].num_groups;
+        if (n<=m_poll_size)
+                return PQOS_RETVAL_OK;
+
+        groups = realloc(m_poll_groups, n * sizeof(groups[0]));
+        if (groups==NULL)
+                return PQOS_RETVAL_RESOURCE;
+        m_poll_groups = groups;
+        m_poll_size = n;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Delivers polled sample of subscription groups
+ *
+ * @param s subscription
+ * @param timestamp time of the poll
+ */
+static void
+sampler_deliver(struct sampler_sub *s, const uint64_t timestamp)
+{
+        uint64_t head, tail;
+
+        if (s->callback!=NULL)
+                s->callback(s->context, s->groups, s->num_groups, timestamp);
+
+        if (s->queue==NULL)
+                return;
+
+        head = s->head;
+        tail = __atomic_load_n(&s->tail, __ATOMIC_ACQUIRE);
+        if (head - tail >= s->queue_size) {
+                __atomic_store_n(&s->dropped, s->dropped + 1,
+                                 __ATOMIC_RELAXED);
+        } else {
+                uint64_t *row = &s->queue[(head % s->queue_size) *
+                                          (s->num_groups + 1)];
+                unsigned i;
+
+                row[0] = timestamp;
+                for (i=0;i<s->num_groups;i++)
+                        row[i+1] = s->groups[i].value;
+                __atomic_store_n(&s->head, head + 1, __ATOMIC_RELEASE);
+        }
+}
+
+/**
+ * @brief Sampler thread
+ *
+ * @param arg not used
+ *
+ * @return NULL
+ */
+static void *
+sampler_thread(void *arg)
+{
+        UNUSED_PARAM(arg);
+
+        pthread_mutex_lock(&m_lock);
+        while (!m_stop) {
+                const uint64_t now = sampler_now();
+                uint64_t next = UINT64_MAX, timestamp = 0;
+                unsigned i, n = 0;
+                int ret = PQOS_RETVAL_OK;
+
+                /**
+                 * Collect groups of all due subscriptions
+                 */
+                for (i=0;i<DIM(m_subs);i++) {
+                        struct sampler_sub *s = &m_subs[i];
+
+                        if (!s->used || s->next>now)
+                                continue;
+                        ASSERT(n + s->num_groups<=m_poll_size);
+                        memcpy(&m_poll_groups[n], s->groups,
+                               s->num_groups * sizeof(s->groups[0]));
+                        n += s->num_groups;
+                }
+                if (n>0) {
+                        ret = pqos_mon_poll(m_poll_groups, n);
+                        if (ret!=PQOS_RETVAL_OK)
+                                LOG_WARN("Sampler failed to poll monitoring "
+                                         "groups\n");
+                        timestamp = sampler_now();
+                }
+
+                n = 0;
+                for (i=0;i<DIM(m_subs);i++) {
+                        struct sampler_sub *s = &m_subs[i];
+
+                        if (!s->used)
+                                continue;
+                        if (s->next<=now) {
+                                memcpy(s->groups, &m_poll_groups[n],
+                                       s->num_groups * sizeof(s->groups[0]));
+                                n += s->num_groups;
+                                if (ret==PQOS_RETVAL_OK)
+                                        sampler_deliver(s, timestamp);
+                                /**
+                                 * Skip periods missed while busy
+                                 */
+                                s->next += ((now - s->next) / s->interval + 1) *
+                                        s->interval;
+                        }
+                        if (s->next<next)
+                                next = s->next;
+                }
+
+                if (next==UINT64_MAX) {
+                        pthread_cond_wait(&m_cond, &m_lock);
+                } else {
+                        struct timespec ts;
+
+                        ts.tv_sec = (time_t) (next / 1000000000ULL);
+                        ts.tv_nsec = (long) (next % 1000000000ULL);
+                        pthread_cond_timedwait(&m_cond, &m_lock, &ts);
+                }
+        }
+        pthread_mutex_unlock(&m_lock);
+        return NULL;
+}
+
+/**
+ * @brief Releases subscription resources
+ *
+ * Drops library references of the groups that were taken. Has to be
+ * called with sampler mutex held and the subscription not visible to
+ * readers.
+ *
+ * @param s subscription
+ * @param num_refs number of groups referenced
+ */
+static void
+sampler_sub_free(struct sampler_sub *s, const unsigned num_refs)
+{
+        unsigned i;
+
+        if (num_refs>0) {
+                _pqos_api_lock();
+                for (i=0;i<num_refs;i++)
+                        if (_pqos_mon_group_put(&s->groups[i])!=
+                            PQOS_RETVAL_OK)
+                                LOG_WARN("Failed to release sampled "
+                                         "monitoring group\n");
+                _pqos_api_unlock();
+        }
+        if (s->groups!=NULL)
+                for (i=0;i<s->num_groups;i++)
+                        free(s->groups[i].cores);
+        free(s->groups);
+        free(s->queue);
+        memset(s, 0, sizeof(*s));
+}
+
+/**
+ * @brief Takes subscription copies of \a groups
+ *
+ * Core lists are duplicated so the copies outlive the caller's
+ * groups, every group gets a library reference.
+ *
+ * @param s subscription, groups table allocated
+ * @param groups caller's started groups
+ * @param num_refs place to store number of groups referenced
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+sampler_sub_copy(struct sampler_sub *s,
+                 const struct pqos_mon_data *groups,
+                 unsigned *num_refs)
+{
+        unsigned i;
+        int ret = PQOS_RETVAL_OK;
+
+        *num_refs = 0;
+        for (i=0;i<s->num_groups;i++) {
+                struct pqos_mon_data *grp = &s->groups[i];
+
+                *grp = groups[i];
+                grp->cores = NULL;
+                if (groups[i].cores==NULL || groups[i].num_cores==0)
+                        return PQOS_RETVAL_PARAM;
+                grp->cores = malloc(grp->num_cores * sizeof(grp->cores[0]));
+                if (grp->cores==NULL)
+                        return PQOS_RETVAL_RESOURCE;
+                memcpy(grp->cores, groups[i].cores,
+                       grp->num_cores * sizeof(grp->cores[0]));
+        }
+
+        _pqos_api_lock();
+        for (i=0;i<s->num_groups && ret==PQOS_RETVAL_OK;i++) {
+                ret = _pqos_mon_group_get(&s->groups[i]);
+                if (ret==PQOS_RETVAL_OK)
+                        (*num_refs)++;
+        }
+        _pqos_api_unlock();
+        return ret;
+}
+
+/**
+ * =======================================
+ * =======================================
+ *
+ * initialize and shutdown
+ *
+ * =======================================
+ * =======================================
+ */
+
+void
+pqos_sampler_fini(void)
+{
+        unsigned i;
+
+        pqos_sampler_stop();
+
+        pthread_mutex_lock(&m_lock);
+        for (i=0;i<DIM(m_subs);i++) {
+                struct sampler_sub *s = &m_subs[i];
+
+                if (!s->used)
+                        continue;
+                pthread_mutex_lock(&m_read_lock);
+                s->used = 0;
+                pthread_mutex_unlock(&m_read_lock);
+                sampler_sub_free(s, s->num_groups);
+        }
+        free(m_poll_groups);
+        m_poll_groups = NULL;
+        m_poll_size = 0;
+        m_epoch = 0;
+        pthread_mutex_unlock(&m_lock);
+}
+
+/**
+ * =======================================
+ * =======================================
+ *
+ * API
+ *
+ * =======================================
+ * =======================================
+ */
+
+int
+pqos_sampler_start(const int lcore)
+{
+        pthread_attr_t attr;
+        int ret;
+
+        ret = sampler_check_init();
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        if (lcore>=CPU_SETSIZE)
+                return PQOS_RETVAL_PARAM;
+        if (pthread_attr_init(&attr)!=0)
+                return PQOS_RETVAL_ERROR;
+        if (lcore>=0) {
+                cpu_set_t cpuset;
+
+                CPU_ZERO(&cpuset);
+                CPU_SET(lcore, &cpuset);
+                if (pthread_attr_setaffinity_np(&attr, sizeof(cpuset),
+                                                &cpuset)!=0) {
+                        pthread_attr_destroy(&attr);
+                        return PQOS_RETVAL_PARAM;
+                }
+        }
+
+        pthread_mutex_lock(&m_lock);
+        if (m_running) {
+                ret = PQOS_RETVAL_INIT;
+                goto exit;
+        }
+        ret = sampler_cond_init();
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        if (m_epoch==0)
+                m_epoch = sampler_now();
+        m_stop = 0;
+        if (pthread_create(&m_thread, &attr, sampler_thread, NULL)!=0) {
+                LOG_ERROR("Failed to start sampler thread on core %d\n",
+                          lcore);
+                ret = PQOS_RETVAL_ERROR;
+                goto exit;
+        }
+        m_running = 1;
+        LOG_INFO("Sampler thread started\n");
+
+ exit:
+        pthread_mutex_unlock(&m_lock);
+        pthread_attr_destroy(&attr);
+        return ret;
+}
+
+int
+pqos_sampler_stop(void)
+{
+        pthread_mutex_lock(&m_lock);
+        if (!m_running) {
+                pthread_mutex_unlock(&m_lock);
+                return PQOS_RETVAL_OK;
+        }
+        m_stop = 1;
+        pthread_cond_signal(&m_cond);
+        pthread_mutex_unlock(&m_lock);
+
+        pthread_join(m_thread, NULL);
+
+        pthread_mutex_lock(&m_lock);
+        m_running = 0;
+        pthread_mutex_unlock(&m_lock);
+        return PQOS_RETVAL_OK;
+}
+
+int
+pqos_sampler_subscribe(const struct pqos_sampler_sub *sub,
+                       int *sub_id)
+{
+        struct sampler_sub *s = NULL;
+        uint64_t now;
+        unsigned i, num_refs = 0;
+        int ret;
+
+        ASSERT(sub!=NULL);
+        ASSERT(sub_id!=NULL);
+        if (sub==NULL || sub_id==NULL || sub->groups==NULL ||
+            sub->num_groups==0 || sub->interval==0 ||
+            (sub->callback==NULL && sub->queue_size==0))
+                return PQOS_RETVAL_PARAM;
+
+        ret = sampler_check_init();
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        pthread_mutex_lock(&m_lock);
+        ret = sampler_cond_init();
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        for (i=0;i<DIM(m_subs);i++)
+                if (!m_subs[i].used)
+                        break;
+        if (i>=DIM(m_subs)) {
+                LOG_ERROR("No free sampler subscription slot\n");
+                ret = PQOS_RETVAL_RESOURCE;
+                goto exit;
+        }
+        s = &m_subs[i];
+
+        ret = sampler_poll_resize(sub->num_groups);
+        if (ret!=PQOS_RETVAL_OK)
+                goto exit;
+
+        s->num_groups = sub->num_groups;
+        s->groups = calloc(sub->num_groups, sizeof(s->groups[0]));
+        if (sub->queue_size>0)
+                s->queue = calloc((size_t) sub->queue_size *
+                                  (sub->num_groups + 1), sizeof(uint64_t));
+        if (s->groups==NULL || (sub->queue_size>0 && s->queue==NULL)) {
+                sampler_sub_free(s, 0);
+                ret = PQOS_RETVAL_RESOURCE;
+                goto exit;
+        }
+        ret = sampler_sub_copy(s, sub->groups, &num_refs);
+        if (ret!=PQOS_RETVAL_OK) {
+                LOG_ERROR("Failed to take subscribed monitoring groups\n");
+                sampler_sub_free(s, num_refs);
+                goto exit;
+        }
+        s->interval = (uint64_t) sub->interval * 1000ULL;
+        s->callback = sub->callback;
+        s->context = sub->context;
+        s->queue_size = sub->queue_size;
+
+        /**
+         * Align first due time to the common schedule
+         */
+        now = sampler_now();
+        if (m_epoch==0)
+                m_epoch = now;
+        s->next = m_epoch + ((now - m_epoch) / s->interval + 1) * s->interval;
+        pthread_mutex_lock(&m_read_lock);
+        s->used = 1;
+        pthread_mutex_unlock(&m_read_lock);
+        *sub_id = (int) i;
+        pthread_cond_signal(&m_cond);
+
+ exit:
+        pthread_mutex_unlock(&m_lock);
+        return ret;
+}
+
+int
+pqos_sampler_unsubscribe(const int sub_id)
+{
+        int ret = PQOS_RETVAL_OK;
+
+        if (sub_id<0 || sub_id>=(int) DIM(m_subs))
+                return PQOS_RETVAL_PARAM;
+
+        pthread_mutex_lock(&m_lock);
+        if (!m_subs[sub_id].used) {
+                ret = PQOS_RETVAL_PARAM;
+        } else {
+                struct sampler_sub *s = &m_subs[sub_id];
+
+                /**
+                 * Readers see the subscription gone before
+                 * the queue is freed
+                 */
+                pthread_mutex_lock(&m_read_lock);
+                s->used = 0;
+                pthread_mutex_unlock(&m_read_lock);
+                sampler_sub_free(s, s->num_groups);
+        }
+        pthread_mutex_unlock(&m_lock);
+        return ret;
+}
+
+int
+pqos_sampler_read(const int sub_id,
+                  const unsigned max_num,
+                  unsigned *p_num,
+                  uint64_t *timestamps,
+                  uint64_t *values,
+                  uint64_t *p_dropped)
+{
+        struct sampler_sub *s = NULL;
+        uint64_t head, tail;
+        unsigned i, n;
+
+        ASSERT(p_num!=NULL);
+        if (sub_id<0 || sub_id>=(int) DIM(m_subs) || p_num==NULL ||
+            (max_num>0 && (timestamps==NULL || values==NULL)))
+                return PQOS_RETVAL_PARAM;
+
+        s = &m_subs[sub_id];
+        pthread_mutex_lock(&m_read_lock);
+        if (!s->used || s->queue==NULL) {
+                pthread_mutex_unlock(&m_read_lock);
+                return PQOS_RETVAL_PARAM;
+        }
+
+        head = __atomic_load_n(&s->head, __ATOMIC_ACQUIRE);
+        tail = s->tail;
+        n = (head - tail > max_num) ? max_num : (unsigned) (head - tail);
+
+        for (i=0;i<n;i++) {
+                const uint64_t *row = &s->queue[((tail + i) % s->queue_size) *
+                                                (s->num_groups + 1)];
+
+                timestamps[i] = row[0];
+                memcpy(&values[i * s->num_groups], &row[1],
+                       s->num_groups * sizeof(values[0]));
+        }
+        __atomic_store_n(&s->tail, tail + n, __ATOMIC_RELEASE);
+
+        *p_num = n;
+        if (p_dropped!=NULL)
+                *p_dropped = __atomic_load_n(&s->dropped, __ATOMIC_RELAXED);
+        pthread_mutex_unlock(&m_read_lock);
+        return PQOS_RETVAL_OK;
+}
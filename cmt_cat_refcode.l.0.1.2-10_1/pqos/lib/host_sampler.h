@@ -0,0 +1,25 @@
+/**
+ * @file host_sampler.h
+ * @brief Internal header file to PQoS background sampler
+ */
+
+#ifndef __PQOS_HOSTSAMPLER_H__
+#define __PQOS_HOSTSAMPLER_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Stops sampler thread and removes all subscriptions
+ *
+ * Has to be called without API lock held as the sampler thread
+ * takes it to poll monitoring groups.
+ */
+void pqos_sampler_fini(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PQOS_HOSTSAMPLER_H__ */
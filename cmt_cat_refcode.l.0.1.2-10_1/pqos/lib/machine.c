@@ -47,22 +47,33 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 
+#include "pqos.h"
 #include "machine.h"
+#include "cpuid_cache.h"
 #include "log.h"
 
 static int *m_msr_fd = NULL;                            /**< MSR driver file descriptors table */
 static unsigned m_maxcores = 0;                         /**< max number of cores (size of the
                                                            table above too) */
+static const struct pqos_machine_ops *m_ops = NULL;     /**< machine operations passed by
+                                                           application (if any) */
 
 int
-machine_init(const unsigned max_core_id)
+machine_init(const unsigned max_core_id,
+             const struct pqos_machine_ops *ops)
 {
         unsigned i;
 
         if (max_core_id==0)
                 return MACHINE_RETVAL_PARAM;
 
+        if (ops!=NULL &&
+            (ops->cpuid==NULL || ops->msr_read==NULL || ops->msr_write==NULL))
+                return MACHINE_RETVAL_PARAM;
+
         m_maxcores = max_core_id + 1;
+        m_ops = ops;
+        cpuid_cache_reset();
 
         /**
          * Allocate table to hold MSR driver file descriptors
@@ -102,6 +113,8 @@ machine_fini(void)
         free(m_msr_fd);
         m_msr_fd = NULL;
         m_maxcores = 0;
+        m_ops = NULL;
+        cpuid_cache_reset();
 
         return MACHINE_RETVAL_OK;
 }
@@ -139,6 +152,42 @@ cpuid(const unsigned lcore,
         return ret;
 }
 
+int
+lcpuid(const unsigned leaf,
+       const unsigned subleaf,
+       struct cpuid_out *out)
+{
+        ASSERT(out!=NULL);
+        if (out==NULL)
+                return MACHINE_RETVAL_PARAM;
+
+        if (m_ops!=NULL) {
+                struct pqos_cpuid_out res;
+
+                memset(&res,0,sizeof(res));
+                if (m_ops->cpuid(m_ops->context, leaf, subleaf, &res)!=0)
+                        return MACHINE_RETVAL_ERROR;
+                out->eax = res.eax;
+                out->ebx = res.ebx;
+                out->ecx = res.ecx;
+                out->edx = res.edx;
+                return MACHINE_RETVAL_OK;
+        }
+
+        asm volatile("mov %4, %%eax\n\t"
+                     "mov %5, %%ecx\n\t"
+                     "cpuid\n\t"
+                     "mov %%eax, %0\n\t"
+                     "mov %%ebx, %1\n\t"
+                     "mov %%ecx, %2\n\t"
+                     "mov %%edx, %3\n\t"
+                     : "=g" (out->eax), "=g" (out->ebx), "=g" (out->ecx), "=g" (out->edx)
+                     : "g" (leaf), "g" (subleaf)
+                     : "%eax", "%ebx", "%ecx", "%edx");
+
+        return MACHINE_RETVAL_OK;
+}
+
 /** 
  * @brief Returns MSR driver file descriptor for given core id
  *
@@ -174,10 +223,22 @@ msr_file_open(const unsigned lcore)
         return fd;
 }
 
-int
-msr_read(const unsigned lcore,
-         const uint32_t reg,
-         uint64_t *value)
+/**
+ * @brief Executes RDMSR on \a lcore logical core
+ *
+ * @param [in] lcore logical core id
+ * @param [in] reg MSR to read from
+ * @param [out] value place to store MSR value at
+ * @param [in] log log an error if the read fails
+ *
+ * @return Operation status
+ * @retval MACHINE_RETVAL_OK on success
+ */
+static int
+msr_read_log(const unsigned lcore,
+             const uint32_t reg,
+             uint64_t *value,
+             const int log)
 {
         int ret = MACHINE_RETVAL_OK;
         int fd = -1;
@@ -195,20 +256,48 @@ msr_read(const unsigned lcore,
         if(m_msr_fd==NULL)
                 return MACHINE_RETVAL_ERROR;
 
+        if (m_ops!=NULL) {
+                if (m_ops->msr_read(m_ops->context, lcore, reg, value)!=0) {
+                        if (log)
+                                LOG_ERROR("RDMSR failed for reg[0x%x] "
+                                          "on lcore %u\n",
+                                          (unsigned) reg, lcore );
+                        ret = MACHINE_RETVAL_ERROR;
+                }
+                return ret;
+        }
+
         fd = msr_file_open(lcore);
         if (fd<0)
                 return MACHINE_RETVAL_ERROR;
 
         read_ret = pread(fd, value, sizeof(value[0]), (off_t)reg);
         if (read_ret!=sizeof(value[0])) {
-                LOG_ERROR("RDMSR failed for reg[0x%x] on lcore %u\n",
-                          (unsigned) reg, lcore );
+                if (log)
+                        LOG_ERROR("RDMSR failed for reg[0x%x] on lcore %u\n",
+                                  (unsigned) reg, lcore );
                 ret = MACHINE_RETVAL_ERROR;
         }
 
         return ret;
 }
 
+int
+msr_read(const unsigned lcore,
+         const uint32_t reg,
+         uint64_t *value)
+{
+        return msr_read_log(lcore, reg, value, 1);
+}
+
+int
+msr_probe(const unsigned lcore,
+          const uint32_t reg,
+          uint64_t *value)
+{
+        return msr_read_log(lcore, reg, value, 0);
+}
+
 int
 msr_write(const unsigned lcore,
           const uint32_t reg,
@@ -226,6 +315,15 @@ msr_write(const unsigned lcore,
         if(m_msr_fd==NULL)
                 return MACHINE_RETVAL_ERROR;
 
+        if (m_ops!=NULL) {
+                if (m_ops->msr_write(m_ops->context, lcore, reg, value)!=0) {
+                        LOG_ERROR("WRMSR failed for reg[0x%x] <- value[0x%llx] on lcore %u\n",
+                                  (unsigned) reg, (long long unsigned) value, lcore );
+                        ret = MACHINE_RETVAL_ERROR;
+                }
+                return ret;
+        }
+
         fd = msr_file_open(lcore);
         if (fd<0)
                 return MACHINE_RETVAL_ERROR;
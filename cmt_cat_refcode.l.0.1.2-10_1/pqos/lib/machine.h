@@ -65,16 +65,21 @@ struct cpuid_out {
         uint32_t edx;
 };
 
+struct pqos_machine_ops;
+
 /** 
  * @brief Initializes machine module
  * 
  * @param [in] max_core_id maximum logical core id to be handled by machine module
  *             If zero then defualt value assumed \a MACHINE_DEFAULT_MAX_COREID
+ * @param [in] ops optional machine access operations,
+ *             if NULL then CPUID instruction and MSR driver are used
  *
  * @return Operation status
  * @retval MACHINE_RETVAL_OK on success
  */
-int machine_init(const unsigned max_core_id);
+int machine_init(const unsigned max_core_id,
+                 const struct pqos_machine_ops *ops);
 
 /** 
  * @brief Shuts down machine module
@@ -103,6 +108,9 @@ cpuid(const unsigned lcore,
 
 /** 
  * @brief Executes CPUID.leaf.sbuleaf on current core 
+ *
+ * If machine operations were passed at init time
+ * then CPUID is executed through them.
  * 
  * @param [in] leaf CPUID leaf number
  * @param [in] subleaf CPUID sub-leaf number
@@ -111,28 +119,10 @@ cpuid(const unsigned lcore,
  * @return Operation status
  * @retval MACHINE_RETVAL_OK on success
  */
-static inline int
+int
 lcpuid(const unsigned leaf,
        const unsigned subleaf,
-       struct cpuid_out *out)
-{
-        ASSERT(out!=NULL);
-        if (out==NULL)
-                return MACHINE_RETVAL_PARAM;
-
-        asm volatile("mov %4, %%eax\n\t"
-                     "mov %5, %%ecx\n\t"
-                     "cpuid\n\t"
-                     "mov %%eax, %0\n\t"
-                     "mov %%ebx, %1\n\t"
-                     "mov %%ecx, %2\n\t"
-                     "mov %%edx, %3\n\t"
-                     : "=g" (out->eax), "=g" (out->ebx), "=g" (out->ecx), "=g" (out->edx)
-                     : "g" (leaf), "g" (subleaf)
-                     : "%eax", "%ebx", "%ecx", "%edx");
-
-        return MACHINE_RETVAL_OK;
-}
+       struct cpuid_out *out);
 
 /** 
  * @brief Executes RDMSR on \a lcore logical core
@@ -149,6 +139,25 @@ msr_read(const unsigned lcore,
          const uint32_t reg,
          uint64_t *value);
 
+/**
+ * @brief Executes RDMSR on \a lcore logical core without
+ *        logging a failure
+ *
+ * Used to probe registers that are not enumerated by CPUID
+ * and may be missing on the platform.
+ *
+ * @param [in] lcore logical core id
+ * @param [in] reg MSR to read from
+ * @param [out] value place to store MSR value at
+ *
+ * @return Operation status
+ * @retval MACHINE_RETVAL_OK on success
+ */
+int
+msr_probe(const unsigned lcore,
+          const uint32_t reg,
+          uint64_t *value);
+
 /** 
  * @brief Executes WRMSR on \a lcore logical core
  * 
@@ -58,7 +58,7 @@ extern "C" {
 
 #define PQOS_VERSION        100                         /**< version 1.00 */
 
-#define PQOS_MAX_L3CA_COS  4                            /**< 4xCOS */
+#define PQOS_MAX_L3CA_COS  16                           /**< 16xCOS */
 
 /*
  * =======================================
@@ -78,6 +78,39 @@ extern "C" {
  * =======================================
  */
 
+/**
+ * Results of CPUID instruction returned by machine operations
+ */
+struct pqos_cpuid_out {
+        uint32_t eax;
+        uint32_t ebx;
+        uint32_t ecx;
+        uint32_t edx;
+};
+
+/**
+ * Machine access operations.
+ *
+ * Application may pass these to the library in order to redirect
+ * CPUID and MSR accesses, for example, to a simulated platform.
+ * All callbacks return 0 on success.
+ */
+struct pqos_machine_ops {
+        int (*cpuid)(void *context,
+                     const unsigned leaf,
+                     const unsigned subleaf,
+                     struct pqos_cpuid_out *out);       /**< executes CPUID.leaf.subleaf */
+        int (*msr_read)(void *context,
+                        const unsigned lcore,
+                        const uint32_t reg,
+                        uint64_t *value);               /**< executes RDMSR on lcore */
+        int (*msr_write)(void *context,
+                         const unsigned lcore,
+                         const uint32_t reg,
+                         const uint64_t value);         /**< executes WRMSR on lcore */
+        void *context;                                  /**< passed to all callbacks */
+};
+
 /**
  * PQoS library configuration structure
  */
@@ -92,6 +125,10 @@ struct pqos_config {
                                                            cores and RMIDs in the system even
                                                            if cores may seem to be subject of
                                                            monitoring activity */
+        const struct pqos_machine_ops *machine;         /**< application may pass machine
+                                                           access operations to the library,
+                                                           NULL selects host CPUID and
+                                                           MSR driver */
 };
 
 /** 
@@ -139,14 +176,28 @@ struct pqos_cap_l3ca {
         unsigned num_classes;                   /**< number of classes of service */
         unsigned num_ways;                      /**< number of cache ways */
         unsigned way_size;                      /**< way size in bytes */
+        unsigned min_cbm_bits;                  /**< minimum number of bits
+                                                   set in a ways mask */
+        uint64_t shareable_mask;                /**< ways shared with other
+                                                   entities e.g. I/O */
+        uint64_t io_mask;                       /**< ways used by Data Direct I/O,
+                                                   0 if not known */
 };
 
 /**
  * Available types of monitored events
- * (matches CPUID enumeration)
+ * (RDT events match CPUID enumeration)
+ *
+ * Events form a bit mask, core performance counter, frequency
+ * and energy events can be requested together with LLC occupancy.
  */
 enum pqos_mon_event {
         PQOS_MON_EVENT_L3_OCCUP = 1,            /**< LLC occupancy event */
+        PQOS_PERF_EVENT_LLC_MISS = 0x4000,      /**< LLC misses */
+        PQOS_PERF_EVENT_IPC = 0x8000,           /**< instructions per cycle */
+        PQOS_PERF_EVENT_FREQ = 0x10000,         /**< effective frequency (APERF/MPERF) */
+        PQOS_PWR_EVENT_PKG_ENERGY = 0x20000,    /**< package energy (RAPL) */
+        PQOS_PWR_EVENT_DRAM_ENERGY = 0x40000,   /**< DRAM energy (RAPL) */
 };
 
 /**
@@ -163,7 +214,9 @@ enum pqos_mon_event {
 struct pqos_monitor {
         enum pqos_mon_event type;
         unsigned max_rmid;              /**< max RMID supported for this event */
-        uint32_t scale_factor;          /**< factor to scale RMID value to bytes */
+        uint32_t scale_factor;          /**< factor to scale RMID value to bytes,
+                                           MPERF rate in MHz for
+                                           PQOS_PERF_EVENT_FREQ */
 };
 
 struct pqos_cap_mon {
@@ -241,6 +294,18 @@ int pqos_cap_get(const struct pqos_cap **cap,
  */
 typedef uint32_t pqos_rmid_t;
 
+/**
+ * Performance and frequency counter counts of a monitoring group
+ * summed over its cores, taken at the previous poll
+ */
+struct pqos_mon_counters {
+        uint64_t instructions;                          /**< instructions retired */
+        uint64_t cycles;                                /**< unhalted core cycles */
+        uint64_t llc_misses;                            /**< LLC misses */
+        uint64_t aperf;                                 /**< APERF count */
+        uint64_t mperf;                                 /**< MPERF count */
+};
+
 /**
  * Monitoring group data structure
  */
@@ -253,6 +318,25 @@ struct pqos_mon_data {
         unsigned num_cores;                             /**< number of cores in the group */
         unsigned *cores;                                /**< list of cores in the group */
         uint64_t value;                                 /**< RMID event value */
+        uint64_t instructions;                          /**< instructions retired since
+                                                           previous poll */
+        uint64_t cycles;                                /**< unhalted core cycles since
+                                                           previous poll */
+        uint64_t llc_misses;                            /**< LLC misses since previous poll */
+        double ipc;                                     /**< instructions per cycle */
+        uint64_t aperf;                                 /**< APERF increments since
+                                                           previous poll */
+        uint64_t mperf;                                 /**< MPERF increments since
+                                                           previous poll */
+        double freq;                                    /**< effective frequency of unhalted
+                                                           cores in MHz */
+        double pkg_power;                               /**< package power of the group
+                                                           socket in Joules/s */
+        double dram_power;                              /**< DRAM power of the group
+                                                           socket in Joules/s */
+        struct pqos_mon_counters last;                  /**< counts at the previous poll,
+                                                           kept by the library, every
+                                                           copy of the group has its own */
 };
 
 /** 
@@ -269,6 +353,16 @@ int pqos_mon_assoc_get( const unsigned lcore,
 /** 
  * @brief Starts resource monitoring data logging on \a lcore
  *
+ * \a event has to include PQOS_MON_EVENT_L3_OCCUP. PQOS_PERF_EVENT_IPC
+ * and PQOS_PERF_EVENT_LLC_MISS program fixed and general purpose core
+ * performance counters of the cores, these have to be free
+ * (e.g. not used by perf or the NMI watchdog). PQOS_PERF_EVENT_FREQ
+ * reads free running APERF/MPERF counters and the PQOS_PWR_EVENT_*
+ * events read RAPL energy counters of the group socket, these
+ * do not program anything. Events the library could not set up,
+ * e.g. RAPL with unreadable energy units, are rejected with
+ * PQOS_RETVAL_PARAM.
+ *
  * @param [in] lcore CPU logical core id
  * @param [in] event monitoring event id
  * @param [in] context application dependent context pointer
@@ -283,6 +377,9 @@ int pqos_mon_start( const unsigned num_cores,
 
 /** 
  * @brief Stops resource monitoring data for selected monitoring group
+ *
+ * If the group is subscribed to the background sampler its cores stay
+ * associated with the RMID until the subscription is removed.
  * 
  * @param [in] group monitoring context for selected number of cores
  * 
@@ -292,6 +389,14 @@ int pqos_mon_stop( struct pqos_mon_data *group );
 
 /** 
  * @brief Polls monitoring data from requested cores
+ *
+ * Performance counters of all cores of a group are read in the same
+ * pass as the occupancy and summed up into the group deltas.
+ * RAPL counters of a socket are read once per call, power is the
+ * energy used since the socket was last read divided by the elapsed
+ * time, so groups of one socket polled in one call report the same
+ * value. 32 bit energy counters wrap after about a minute at full
+ * load on large parts, the socket has to be polled more often.
  * 
  * @param [in] groups pointer to monitoring groups to be be updated
  * @param [in] num_groups number of monitoring groups to be updated
@@ -301,6 +406,128 @@ int pqos_mon_stop( struct pqos_mon_data *group );
 int pqos_mon_poll( struct pqos_mon_data *groups,
                    const unsigned num_groups );
 
+/*
+ * =======================================
+ * Background sampler
+ * =======================================
+ */
+
+#define PQOS_SAMPLER_MAX_SUBS 32                /**< max number of subscriptions */
+
+/**
+ * @brief Sampler subscription callback
+ *
+ * Called from the sampler thread. Sampler API must not be
+ * called from the callback.
+ *
+ * @param [in] context subscription context pointer
+ * @param [in] groups subscription groups with updated values
+ * @param [in] num_groups number of groups
+ * @param [in] timestamp CLOCK_MONOTONIC time of the sample in nanoseconds
+ */
+typedef void (*pqos_sampler_cb_t)(void *context,
+                                  const struct pqos_mon_data *groups,
+                                  const unsigned num_groups,
+                                  const uint64_t timestamp);
+
+/**
+ * Sampler subscription
+ */
+struct pqos_sampler_sub {
+        const struct pqos_mon_data *groups;     /**< started groups to poll */
+        unsigned num_groups;                    /**< number of groups */
+        unsigned interval;                      /**< polling interval in microseconds */
+        pqos_sampler_cb_t callback;             /**< callback, can be NULL */
+        void *context;                          /**< callback context pointer */
+        unsigned queue_size;                    /**< number of samples kept for
+                                                   pqos_sampler_read(), 0 for none */
+};
+
+/**
+ * @brief Starts background sampler thread
+ *
+ * Sampler polls subscribed groups at their intervals. Subscriptions
+ * share one schedule, intervals are aligned to a common start time so
+ * that subscriptions due at the same time get polled on one wake up
+ * with a single pqos_mon_poll() call.
+ *
+ * @param [in] lcore core to pin the thread to, negative value
+ *             leaves the thread unpinned
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_PARAM \a lcore out of range
+ * @retval PQOS_RETVAL_INIT sampler already running
+ */
+int pqos_sampler_start(const int lcore);
+
+/**
+ * @brief Stops background sampler thread
+ *
+ * Subscriptions are kept and get polled again after
+ * pqos_sampler_start(). pqos_fini() stops the sampler and
+ * removes all subscriptions.
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int pqos_sampler_stop(void);
+
+/**
+ * @brief Subscribes monitoring groups for background sampling
+ *
+ * Groups are copied together with their core lists and the library
+ * keeps them started for the subscription: pqos_mon_stop() of a
+ * subscribed group returns at once, its RMID and counters are released
+ * when the subscription is removed.
+ *
+ * @param [in] sub subscription parameters
+ * @param [out] sub_id subscription id
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_PARAM group not started
+ * @retval PQOS_RETVAL_RESOURCE no free subscription slot
+ */
+int pqos_sampler_subscribe(const struct pqos_sampler_sub *sub,
+                           int *sub_id);
+
+/**
+ * @brief Removes subscription
+ *
+ * @param [in] sub_id subscription id
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int pqos_sampler_unsubscribe(const int sub_id);
+
+/**
+ * @brief Reads queued samples of a subscription
+ *
+ * The queue is lock free with a single reader, the call never waits
+ * for a poll in progress, only for pqos_sampler_unsubscribe().
+ * Samples that did not fit into a full queue are dropped and counted.
+ *
+ * @param [in] sub_id subscription id
+ * @param [in] max_num max number of samples to read
+ * @param [out] p_num number of samples read
+ * @param [out] timestamps CLOCK_MONOTONIC sample times in nanoseconds,
+ *              \a max_num entries
+ * @param [out] values group values, \a max_num times number of
+ *              groups entries, groups of a sample are next to each other
+ * @param [out] p_dropped number of samples dropped so far, can be NULL
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int pqos_sampler_read(const int sub_id,
+                      const unsigned max_num,
+                      unsigned *p_num,
+                      uint64_t *timestamps,
+                      uint64_t *values,
+                      uint64_t *p_dropped);
+
 /*
  * =======================================
  * L3 cache allocation
@@ -365,6 +592,77 @@ int pqos_l3ca_assoc_set(const unsigned lcore,
 int pqos_l3ca_assoc_get(const unsigned lcore,
                         unsigned *class_id);
 
+/**
+ * L3 cache way allocator request flags
+ */
+#define PQOS_L3CA_ALLOC_ISOLATE   0x1   /**< no other class may overlap */
+#define PQOS_L3CA_ALLOC_NO_SHARED 0x2   /**< avoid shareable ways */
+#define PQOS_L3CA_ALLOC_OVERLAP   0x4   /**< share ways of \a overlap_class */
+#define PQOS_L3CA_ALLOC_NO_IO     0x8   /**< avoid I/O ways */
+#define PQOS_L3CA_ALLOC_IO        0x10  /**< place within I/O ways */
+
+/**
+ * L3 cache way allocator request
+ */
+struct pqos_l3ca_req {
+        unsigned class_id;                      /**< class of service */
+        unsigned num_ways;                      /**< number of contiguous ways */
+        unsigned flags;                         /**< PQOS_L3CA_ALLOC_ flags */
+        unsigned overlap_class;                 /**< class to share ways with,
+                                                   used with PQOS_L3CA_ALLOC_OVERLAP */
+};
+
+/**
+ * @brief Allocates contiguous range of cache ways on \a socket
+ *
+ * Ways allocated to classes through the allocator don't overlap unless
+ * PQOS_L3CA_ALLOC_OVERLAP is requested, in which case the range is placed
+ * within ways of \a overlap_class. Classes allocated with
+ * PQOS_L3CA_ALLOC_ISOLATE can't be overlapped. The smallest free range
+ * that fits the request is used. If free ways are fragmented, classes
+ * are relocated towards way 0 to make space.
+ * Classes of service not allocated through the allocator are not
+ * taken into account.
+ *
+ * @param [in] socket CPU socket id
+ * @param [in] req allocation request
+ * @param [out] ca class of service definition written to the socket
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_RESOURCE not enough free ways
+ */
+int pqos_l3ca_alloc(const unsigned socket,
+                    const struct pqos_l3ca_req *req,
+                    struct pqos_l3ca *ca);
+
+/**
+ * @brief Releases ways allocated to \a class_id on \a socket
+ *
+ * Class of service mask is not changed until its ways get
+ * allocated to other classes.
+ *
+ * @param [in] socket CPU socket id
+ * @param [in] class_id class of service to release
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_RESOURCE other classes still overlap \a class_id
+ */
+int pqos_l3ca_free(const unsigned socket,
+                   const unsigned class_id);
+
+/**
+ * @brief Relocates allocated classes on \a socket towards way 0
+ *        so that free ways form a single range
+ *
+ * @param [in] socket CPU socket id
+ *
+ * @return Operations status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int pqos_l3ca_compact(const unsigned socket);
+
 /*
  * =======================================
  * PQoS utility API
@@ -497,6 +795,23 @@ int
 pqos_l3ca_get_cos_num(const struct pqos_cap *cap,
                       unsigned *cos_num);
 
+/**
+ * @brief Checks \a mask against cache allocation constraints
+ *
+ * Mask has to be non-zero, contiguous, fit into number of ways
+ * and have at least minimum number of bits set.
+ *
+ * @param [in] l3ca L3 cache allocation capability structure
+ * @param [in] mask ways mask to check
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK mask is valid
+ * @retval PQOS_RETVAL_PARAM mask is invalid
+ */
+int
+pqos_l3ca_mask_check(const struct pqos_cap_l3ca *l3ca,
+                     const uint64_t mask);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,121 @@
+/**
+ * @file tsc.c
+ * @brief Calibrated time stamp counter clock
+ *
+ * Kept valid C++ so the benchmarks can compile it in with g++.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "tsc.h"
+
+#define TSC_PAIR_TRIES 8                /**< reads to find a tight pair */
+
+/**
+ * @brief Returns \a id clock time in nanoseconds
+ */
+static uint64_t
+tsc_clock_ns(const clockid_t id)
+{
+        struct timespec ts;
+
+        clock_gettime(id, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Reads TSC together with CLOCK_MONOTONIC and CLOCK_REALTIME
+ *
+ * TSC is read between two CLOCK_MONOTONIC reads a few times and
+ * the pair with the shortest window is kept, its midpoint is
+ * the CLOCK_MONOTONIC time of the TSC read.
+ *
+ * @param [out] tsc TSC value
+ * @param [out] mono CLOCK_MONOTONIC time in ns
+ * @param [out] real CLOCK_REALTIME time in ns
+ */
+static void
+tsc_pair(uint64_t *tsc, uint64_t *mono, uint64_t *real)
+{
+        uint64_t best = UINT64_MAX;
+        unsigned i;
+
+        for (i=0;i<TSC_PAIR_TRIES;i++) {
+                const uint64_t a = tsc_clock_ns(CLOCK_MONOTONIC);
+                const uint64_t r = tsc_clock_ns(CLOCK_REALTIME);
+                const uint64_t t = tsc_read();
+                const uint64_t b = tsc_clock_ns(CLOCK_MONOTONIC);
+
+                if (b - a<best) {
+                        best = b - a;
+                        *tsc = t;
+                        *mono = a + (b - a) / 2;
+                        *real = r + (b - a) / 2;
+                }
+        }
+}
+
+/**
+ * @brief Checks CPUID.80000007H:EDX[8] invariant TSC flag
+ */
+static int
+tsc_invariant(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+        unsigned eax, ebx, ecx, edx;
+
+        if (__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx)==0 ||
+            eax<0x80000007)
+                return 0;
+        if (__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx)==0)
+                return 0;
+        return (edx >> 8) & 1;
+#else
+        return 0;
+#endif
+}
+
+int
+tsc_init(struct tsc_clock *clk, const unsigned calib_ms)
+{
+        const unsigned ms = (calib_ms>0) ? calib_ms : TSC_DEF_CALIB_MS;
+        uint64_t tsc1, mono1, real1;
+        struct timespec ts;
+
+        if (clk==NULL)
+                return TSC_RETVAL_PARAM;
+
+        memset(clk, 0, sizeof(*clk));
+        clk->invariant = tsc_invariant();
+
+        tsc_pair(&clk->tsc0, &clk->mono0, &clk->real0);
+        ts.tv_sec = (time_t) (ms / 1000);
+        ts.tv_nsec = (long) (ms % 1000) * 1000000L;
+        while (nanosleep(&ts, &ts)!=0)
+                if (errno!=EINTR)
+                        return TSC_RETVAL_ERROR;
+        tsc_pair(&tsc1, &mono1, &real1);
+
+        if (tsc1<=clk->tsc0 || mono1<=clk->mono0)
+                return TSC_RETVAL_ERROR;
+
+        clk->hz = (uint64_t) ((double) (tsc1 - clk->tsc0) * 1e9 /
+                              (double) (mono1 - clk->mono0) + 0.5);
+        clk->mult = (uint64_t) (1e9 * (double) (1ULL << TSC_SHIFT) /
+                                (double) clk->hz + 0.5);
+
+        /**
+         * Later end of the calibration is the reference point,
+         * conversions near it are the most accurate
+         */
+        clk->tsc0 = tsc1;
+        clk->mono0 = mono1;
+        clk->real0 = real1;
+        return TSC_RETVAL_OK;
+}
@@ -0,0 +1,186 @@
+/**
+ * @file tsc.h
+ * @brief Calibrated time stamp counter clock
+ *
+ * Reads of the time stamp counter are inline and serialized with
+ * LFENCE, so a read is not reordered with the code being timed.
+ * tsc_init() checks for invariant TSC (CPUID.80000007H:EDX[8]) and
+ * calibrates the TSC frequency against CLOCK_MONOTONIC. Cycles are
+ * converted to nanoseconds with a 32.32 fixed point multiplier, which
+ * suits interval measurement. TSC reads can also be mapped onto
+ * CLOCK_MONOTONIC and CLOCK_REALTIME, but only by extrapolation from
+ * the calibration point: NTP slewing and steps after tsc_init() are not
+ * followed, so long running wall clock timestamps should come from
+ * clock_gettime() instead.
+ *
+ * The header has no dependencies on the rest of the library, so it can
+ * be used by the benchmarks with tsc.c compiled in.
+ */
+
+#ifndef __PQOS_TSC_H__
+#define __PQOS_TSC_H__
+
+#include <stdint.h>
+#if !defined(__x86_64__) && !defined(__i386__)
+#include <time.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TSC_RETVAL_OK           0       /**< everything OK */
+#define TSC_RETVAL_ERROR        1       /**< generic error */
+#define TSC_RETVAL_PARAM        2       /**< parameter error */
+
+#define TSC_SHIFT               32      /**< fraction bits of tsc_clock.mult */
+#define TSC_DEF_CALIB_MS        50      /**< default calibration time */
+
+/**
+ * Calibrated clock
+ */
+struct tsc_clock {
+        uint64_t hz;                    /**< TSC frequency */
+        int invariant;                  /**< TSC runs at constant rate in
+                                           all C, P and T states */
+        uint64_t mult;                  /**< nanoseconds per cycle,
+                                           TSC_SHIFT fraction bits */
+        uint64_t tsc0;                  /**< TSC at the reference point */
+        uint64_t mono0;                 /**< CLOCK_MONOTONIC at tsc0 in ns */
+        uint64_t real0;                 /**< CLOCK_REALTIME at tsc0 in ns */
+};
+
+/**
+ * @brief Detects invariant TSC and calibrates \a clk
+ *
+ * The frequency is measured over \a calib_ms milliseconds from
+ * the tightest TSC/CLOCK_MONOTONIC pairs at both ends. The clock
+ * is usable also without invariant TSC, but then the rate changes
+ * with frequency scaling and the caller should prefer clock_gettime().
+ *
+ * @param [out] clk clock to calibrate
+ * @param [in] calib_ms calibration time, 0 selects TSC_DEF_CALIB_MS
+ *
+ * @return Operation status
+ * @retval TSC_RETVAL_OK on success
+ */
+int tsc_init(struct tsc_clock *clk, const unsigned calib_ms);
+
+#if defined(__x86_64__) || defined(__i386__)
+
+/**
+ * @brief Reads TSC, serialized with surrounding instructions
+ *
+ * @return TSC value
+ */
+static inline uint64_t
+tsc_read(void)
+{
+        uint32_t lo, hi;
+
+        __asm__ __volatile__ ("lfence\n\t"
+                              "rdtsc\n\t"
+                              "lfence"
+                              : "=a" (lo), "=d" (hi) : : "memory");
+        return ((uint64_t) hi << 32) | (uint64_t) lo;
+}
+
+/**
+ * @brief Reads TSC and the core it was read on
+ *
+ * RDTSCP waits for earlier instructions to complete and returns
+ * IA32_TSC_AUX, which Linux sets to (node << 12) | cpu. LFENCE keeps
+ * later instructions from starting before the read.
+ *
+ * @param [out] cpu logical core id, can be NULL
+ *
+ * @return TSC value
+ */
+static inline uint64_t
+tsc_read_cpu(unsigned *cpu)
+{
+        uint32_t lo, hi, aux;
+
+        __asm__ __volatile__ ("rdtscp\n\t"
+                              "lfence"
+                              : "=a" (lo), "=d" (hi), "=c" (aux) : : "memory");
+        if (cpu!=NULL)
+                *cpu = aux & 0xfffU;
+        return ((uint64_t) hi << 32) | (uint64_t) lo;
+}
+
+#else
+
+/**
+ * Without TSC the clock counts CLOCK_MONOTONIC nanoseconds
+ */
+static inline uint64_t
+tsc_read(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+static inline uint64_t
+tsc_read_cpu(unsigned *cpu)
+{
+        if (cpu!=NULL)
+                *cpu = 0;
+        return tsc_read();
+}
+
+#endif
+
+/**
+ * @brief Converts TSC cycles to nanoseconds
+ *
+ * @param [in] clk calibrated clock
+ * @param [in] cycles number of cycles
+ *
+ * @return Nanoseconds
+ */
+static inline uint64_t
+tsc_cycles_to_ns(const struct tsc_clock *clk, const uint64_t cycles)
+{
+#ifdef __SIZEOF_INT128__
+        return (uint64_t) (((unsigned __int128) cycles * clk->mult) >>
+                           TSC_SHIFT);
+#else
+        return (cycles >> TSC_SHIFT) * clk->mult +
+                (((cycles & 0xffffffffULL) * clk->mult) >> TSC_SHIFT);
+#endif
+}
+
+/**
+ * @brief Converts TSC value to CLOCK_MONOTONIC nanoseconds
+ */
+static inline uint64_t
+tsc_mono_ns(const struct tsc_clock *clk, const uint64_t tsc)
+{
+        return (tsc>=clk->tsc0) ?
+                clk->mono0 + tsc_cycles_to_ns(clk, tsc - clk->tsc0) :
+                clk->mono0 - tsc_cycles_to_ns(clk, clk->tsc0 - tsc);
+}
+
+/**
+ * @brief Converts TSC value to CLOCK_REALTIME nanoseconds
+ *
+ * Wall clock adjustments made after tsc_init() are not followed and
+ * the calibration error accumulates, the result drifts from
+ * CLOCK_REALTIME the further \a tsc is from the reference point.
+ */
+static inline uint64_t
+tsc_real_ns(const struct tsc_clock *clk, const uint64_t tsc)
+{
+        return (tsc>=clk->tsc0) ?
+                clk->real0 + tsc_cycles_to_ns(clk, tsc - clk->tsc0) :
+                clk->real0 - tsc_cycles_to_ns(clk, clk->tsc0 - tsc);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PQOS_TSC_H__ */
@@ -263,3 +263,34 @@ pqos_l3ca_get_cos_num(const struct pqos_cap *cap,
         return ret;
 }
 
+int
+pqos_l3ca_mask_check(const struct pqos_cap_l3ca *l3ca,
+                     const uint64_t mask)
+{
+        uint64_t m = mask;
+        unsigned bits = 0;
+
+        ASSERT(l3ca!=NULL);
+        if (l3ca==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        if (m==0)
+                return PQOS_RETVAL_PARAM;
+
+        if (l3ca->num_ways<64 && (m >> l3ca->num_ways)!=0)
+                return PQOS_RETVAL_PARAM;
+
+        while (!(m&1))
+                m >>= 1;
+
+        if ((m & (m+1))!=0)
+                return PQOS_RETVAL_PARAM;               /**< not contiguous */
+
+        for (;m!=0;m>>=1)
+                bits++;
+
+        if (bits<l3ca->min_cbm_bits)
+                return PQOS_RETVAL_PARAM;
+
+        return PQOS_RETVAL_OK;
+}
@@ -42,13 +42,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <signal.h>
 
 #include <ctype.h>                                      /**< isspace() */
 
 #include <sys/types.h>                                  /**< open() */
 #include <sys/stat.h>
-#include <sys/ioctl.h>                                  /**< terminal ioctl */
 
 #include <sys/time.h>                                   /** gettimeofday() */
 #include <time.h>                                       /** localtime() */
@@ -56,6 +56,17 @@
 
 #include "pqos.h"
 #include "profiles.h"
+#include "controller.h"
+#include "sim.h"
+#include "sweep.h"
+#include "corun.h"
+#include "tick.h"
+#include "shmring.h"
+#include "binfmt.h"
+#include "outbuf.h"
+#include "stats.h"
+#include "screen.h"
+#include "metrics.h"
 
 #ifdef DEBUG
 #include <assert.h>
@@ -78,7 +89,7 @@
 #define PQOS_MAX_SOCKETS      2
 #define PQOS_MAX_SOCKET_CORES 64
 #define PQOS_MAX_CORES        (PQOS_MAX_SOCKET_CORES*PQOS_MAX_SOCKETS)
-#define PQOS_MAX_MON_EVENTS   1
+#define PQOS_MAX_MON_EVENTS   5
 
 /**
  * Local data structures
@@ -126,6 +137,16 @@ static int sel_l3ca_cos_num = 0;
  */
 static struct pqos_l3ca sel_l3ca_cos_tab[PQOS_MAX_L3CA_COS];
 
+/**
+ * Maintains number of way allocation requests
+ */
+static int sel_l3ca_req_num = 0;
+
+/**
+ * Maintains table of way allocation requests
+ */
+static struct pqos_l3ca_req sel_l3ca_req_tab[PQOS_MAX_L3CA_COS];
+
 /**
  * Number of cores selected for cache allocation association
  */
@@ -144,7 +165,7 @@ static struct {
  * Maintains monitoring interval that is selected in config string for
  * monitoring L3 occupancy
  */
-static int sel_mon_interval = 10; /**< 10 = 10x100ms = 1s */
+static long sel_mon_interval = 1000000L; /**< in microseconds, 1s */
 
 /**
  * Maintains TOP like output that is selected in config string for
@@ -193,6 +214,76 @@ static char *sel_allocation_profile = NULL;
  */
 static int sel_verbose_mode = 0;
 
+/**
+ * Enables per sample timing and jitter report of the monitoring loop
+ */
+static int sel_mon_jitter = 0;
+
+/**
+ * Enables publishing samples into shared memory ring
+ */
+static int sel_shm = 0;
+
+/**
+ * Maintains shared memory ring specification
+ */
+static char *sel_shm_spec = NULL;
+
+/**
+ * Maintains metrics endpoint address, NULL if disabled
+ */
+static char *sel_prom_spec = NULL;
+
+/**
+ * Enables online statistics of monitoring groups
+ */
+static int sel_stats = 0;
+
+/**
+ * Maintains file name for JSON statistics
+ */
+static char *sel_stats_file = NULL;
+
+/**
+ * Enables closed-loop cache partitioning controller
+ */
+static int sel_controller = 0;
+
+/**
+ * Maintains controller options string
+ */
+static char *sel_controller_opts = NULL;
+
+/**
+ * Enables cache allocation sensitivity profiler
+ */
+static int sel_sweep = 0;
+
+/**
+ * Maintains profiler options string
+ */
+static char *sel_sweep_opts = NULL;
+
+/**
+ * Enables co-runner interference harness
+ */
+static int sel_corun = 0;
+
+/**
+ * Maintains harness options string
+ */
+static char *sel_corun_opts = NULL;
+
+/**
+ * Enables simulated platform
+ */
+static int sel_sim = 0;
+
+/**
+ * Maintains simulated platform specification
+ */
+static char *sel_sim_spec = NULL;
+
 /** 
  * @brief Converts string into 64-bit unsigned number.
  * 
@@ -330,12 +421,27 @@ parse_error(const char *arg, const char *note)
 static void
 parse_monitor_event(char *str)
 {
+        static const struct {
+                const char *name;
+                enum pqos_mon_event event;
+        } evttab[] = {
+                { "llc:",     PQOS_MON_EVENT_L3_OCCUP },
+                { "ipc:",     PQOS_PERF_EVENT_IPC },
+                { "llcmiss:", PQOS_PERF_EVENT_LLC_MISS },
+                { "freq:",    PQOS_PERF_EVENT_FREQ },
+                { "power:",   PQOS_PWR_EVENT_PKG_ENERGY },
+        };
         uint64_t cores[PQOS_MAX_CORES];
         unsigned i = 0, n = 0;
         enum pqos_mon_event evt = PQOS_MON_EVENT_L3_OCCUP;
 
-        if (strncasecmp(str,"llc:",4)!=0)
+        for (i=0;i<DIM(evttab);i++)
+                if (strncasecmp(str,evttab[i].name,
+                                strlen(evttab[i].name))==0)
+                        break;
+        if (i>=DIM(evttab))
                 parse_error(str,"Unrecognized monitoring event type");
+        evt = evttab[i].event;
 
         n = strlisttotab( strchr(str,':') + 1, cores, DIM(cores) );
 
@@ -431,6 +537,7 @@ selfn_monitor_events(const char *arg)
 /** 
  * @brief Starts monitoring on selected cores
  * 
+ * @param cap detected PQoS capabilities
  * @param cpu_info cpu information structure
  *
  * @return Operation status
@@ -438,7 +545,8 @@ selfn_monitor_events(const char *arg)
  * @retval -1 error
  */
 static int
-setup_monitoring(const struct pqos_cpuinfo *cpu_info )
+setup_monitoring(const struct pqos_cap *cap,
+                 const struct pqos_cpuinfo *cpu_info )
 {
         unsigned i, fails = 0;
         int ret;
@@ -460,17 +568,45 @@ setup_monitoring(const struct pqos_cpuinfo *cpu_info )
                 }
         }
 
+        /**
+         * Core performance counter, frequency and
+         * energy events need to be discovered
+         */
+        for (i=0; i<(unsigned) sel_monitor_num;i++) {
+                const struct pqos_monitor *p_mon = NULL;
+                unsigned j;
+
+                for (j=0;j<sel_monitor_tab[i].event_num;j++)
+                        if (pqos_cap_get_event(cap,
+                                               sel_monitor_tab[i].events[j],
+                                               &p_mon)!=PQOS_RETVAL_OK) {
+                                printf("Monitoring event 0x%x not "
+                                       "supported!\n",
+                                       (unsigned) sel_monitor_tab[i].events[j]);
+                                return -1;
+                        }
+        }
+
         for (i=0; i<(unsigned) sel_monitor_num;i++) {
+                const struct pqos_monitor *p_mon = NULL;
                 unsigned lcore = sel_monitor_tab[i].core;
+                unsigned j, events = PQOS_MON_EVENT_L3_OCCUP;
 
                 /**
-                 * @todo only 1 event expected as of today
+                 * Every group monitors LLC occupancy,
+                 * selected core performance counter events
+                 * are read along with it. Package power comes
+                 * with DRAM power where it is counted.
                  */
-                ASSERT(sel_monitor_tab[i].event_num==1);
-                ASSERT(sel_monitor_tab[i].events[0]==PQOS_MON_EVENT_L3_OCCUP);
+                for (j=0;j<sel_monitor_tab[i].event_num;j++)
+                        events |= sel_monitor_tab[i].events[j];
+                if ((events & PQOS_PWR_EVENT_PKG_ENERGY) &&
+                    pqos_cap_get_event(cap, PQOS_PWR_EVENT_DRAM_ENERGY,
+                                       &p_mon)==PQOS_RETVAL_OK)
+                        events |= PQOS_PWR_EVENT_DRAM_ENERGY;
 
                 ret = pqos_mon_start(1, &lcore,
-                                     sel_monitor_tab[i].events[0],
+                                     (enum pqos_mon_event) events,
                                      NULL,
                                      sel_monitor_tab[i].pgrp );
                 ASSERT(ret==PQOS_RETVAL_OK);
@@ -516,6 +652,7 @@ stop_monitoring(void)
 /** 
  * @brief Sets up allocation classes of service on selected CPU sockets
  * 
+ * @param l3ca L3 cache allocation capability
  * @param sock_count number of CPU sockets
  * @param sockets arrays with CPU socket id's
  *
@@ -525,10 +662,44 @@ stop_monitoring(void)
  * @retval positive success
  */
 static int
-set_allocation_class(unsigned sock_count,
+set_allocation_class(const struct pqos_cap_l3ca *l3ca,
+                     unsigned sock_count,
                      const unsigned *sockets )
 {
-        int ret;
+        int ret, i;
+
+        /**
+         * Validate all masks before any of them gets applied
+         */
+        for (i=0;i<sel_l3ca_cos_num;i++) {
+                const struct pqos_l3ca *ca = &sel_l3ca_cos_tab[i];
+
+                if (ca->class_id>=l3ca->num_classes) {
+                        printf("Invalid class of service %u, "
+                               "%u classes supported!\n",
+                               ca->class_id, l3ca->num_classes);
+                        return -1;
+                }
+                if (pqos_l3ca_mask_check(l3ca,ca->ways_mask)!=PQOS_RETVAL_OK) {
+                        printf("Invalid COS%u mask 0x%llx: it has to be "
+                               "contiguous, at least %u bit(s) long and "
+                               "fit into %u ways!\n",
+                               ca->class_id,
+                               (unsigned long long) ca->ways_mask,
+                               l3ca->min_cbm_bits, l3ca->num_ways);
+                        return -1;
+                }
+                if (ca->ways_mask & l3ca->shareable_mask)
+                        printf("warn: COS%u mask 0x%llx overlaps shareable "
+                               "ways 0x%llx\n", ca->class_id,
+                               (unsigned long long) ca->ways_mask,
+                               (unsigned long long) l3ca->shareable_mask);
+                if (ca->ways_mask & l3ca->io_mask)
+                        printf("warn: COS%u mask 0x%llx overlaps I/O (DDIO) "
+                               "ways 0x%llx\n", ca->class_id,
+                               (unsigned long long) ca->ways_mask,
+                               (unsigned long long) l3ca->io_mask);
+        }
 
         while(sock_count>0 && sel_l3ca_cos_num>0) {
                 ret = pqos_l3ca_set(*sockets,
@@ -547,29 +718,20 @@ set_allocation_class(unsigned sock_count,
         return sel_l3ca_cos_num;
 }
 
-/** 
- * @brief Verifies and translates definition of single
- *        allocation class of service
- *        from text string into internal configuration.
- * 
- * @param str fragment of string passed to -e command line option
+/**
+ * @brief Adds class of service definition to the selected ones
+ *
+ * @param str string the definition comes from, used in error messages
+ * @param class_id class of service
+ * @param mask ways mask
  */
 static void
-parse_allocation_cos(char *str)
+select_allocation_cos(const char *str,
+                      const unsigned class_id,
+                      const uint64_t mask)
 {
-        char *p = NULL;
-        unsigned class_id = 0;
-        uint64_t mask = 0;
         int j = 0;
 
-        p = strchr(str,'=');
-        if (p==NULL)
-                parse_error(str,"invalid class of service definition");
-        *p = '\0';
-        
-        class_id = (unsigned) strtouint64(str);
-        mask = strtouint64(p+1);
-
         if (sel_l3ca_cos_num<=0) {
                 sel_l3ca_cos_tab[0].class_id = class_id;
                 sel_l3ca_cos_tab[0].ways_mask = mask;
@@ -608,6 +770,32 @@ parse_allocation_cos(char *str)
         }
 }
 
+/** 
+ * @brief Verifies and translates definition of single
+ *        allocation class of service
+ *        from text string into internal configuration.
+ * 
+ * @param str fragment of string passed to -e command line option
+ */
+static void
+parse_allocation_cos(char *str)
+{
+        char *p = NULL;
+        unsigned class_id = 0;
+        uint64_t mask = 0;
+
+        p = strchr(str,'=');
+        if (p==NULL)
+                parse_error(str,"invalid class of service definition");
+        *p = '\0';
+        
+        class_id = (unsigned) strtouint64(str);
+        mask = strtouint64(p+1);
+
+        select_allocation_cos(str, class_id, mask);
+}
+
+
 /** 
  * @brief Verifies and translates definition of allocation class of service
  *        from text string into internal configuration.
@@ -663,6 +851,138 @@ selfn_allocation_class(const char *arg)
         free(cp);
 }
 
+/**
+ * @brief Allocates cache ways for selected classes of service
+ *        on selected CPU sockets
+ *
+ * @param sock_count number of CPU sockets
+ * @param sockets arrays with CPU socket id's
+ *
+ * @return Number of classes of service allocated
+ * @retval 0 no way allocation requested
+ * @retval negative error
+ * @retval positive success
+ */
+static int
+set_allocation_ways(unsigned sock_count,
+                    const unsigned *sockets)
+{
+        unsigned i;
+        int j, ret;
+
+        for (i=0;i<sock_count && sel_l3ca_req_num>0;i++)
+                for (j=0;j<sel_l3ca_req_num;j++) {
+                        struct pqos_l3ca ca;
+
+                        ret = pqos_l3ca_alloc(sockets[i],
+                                              &sel_l3ca_req_tab[j], &ca);
+                        if (ret!=PQOS_RETVAL_OK) {
+                                printf("Allocating %u ways for COS%u on "
+                                       "socket %u failed!\n",
+                                       sel_l3ca_req_tab[j].num_ways,
+                                       sel_l3ca_req_tab[j].class_id,
+                                       sockets[i]);
+                                return -1;
+                        }
+                        printf("Socket %u: COS%u => MASK 0x%llx\n",
+                               sockets[i], ca.class_id,
+                               (unsigned long long) ca.ways_mask);
+                }
+
+        return sel_l3ca_req_num;
+}
+
+/**
+ * @brief Parses way allocation request of a class of service
+ *
+ * @param str string in "<cos>=<ways>[:<flag>...]" format, flags are
+ *        "isolate", "noshared", "noio", "io" and "overlap<cos>"
+ */
+static void
+parse_allocation_req(char *str)
+{
+        struct pqos_l3ca_req req;
+        char *p = NULL, *flag = NULL, *saveptr = NULL;
+        int j;
+
+        memset(&req,0,sizeof(req));
+
+        p = strchr(str,'=');
+        if (p==NULL)
+                parse_error(str,"invalid way allocation request");
+        *p++ = '\0';
+
+        req.class_id = (unsigned) strtouint64(str);
+        flag = strtok_r(p, ":", &saveptr);
+        if (flag==NULL)
+                parse_error(str,"missing number of ways");
+        req.num_ways = (unsigned) strtouint64(flag);
+
+        while ((flag = strtok_r(NULL, ":", &saveptr))!=NULL) {
+                if (strcasecmp(flag,"isolate")==0) {
+                        req.flags |= PQOS_L3CA_ALLOC_ISOLATE;
+                } else if (strcasecmp(flag,"noshared")==0) {
+                        req.flags |= PQOS_L3CA_ALLOC_NO_SHARED;
+                } else if (strcasecmp(flag,"noio")==0) {
+                        req.flags |= PQOS_L3CA_ALLOC_NO_IO;
+                } else if (strcasecmp(flag,"io")==0) {
+                        req.flags |= PQOS_L3CA_ALLOC_IO;
+                } else if (strncasecmp(flag,"overlap",7)==0 &&
+                           flag[7]!='\0') {
+                        req.flags |= PQOS_L3CA_ALLOC_OVERLAP;
+                        req.overlap_class = (unsigned) strtouint64(flag+7);
+                } else {
+                        parse_error(flag,"unrecognized way allocation flag");
+                }
+        }
+
+        for (j=0;j<sel_l3ca_req_num;j++)
+                if (sel_l3ca_req_tab[j].class_id==req.class_id)
+                        parse_error(str,"class of service requested twice");
+
+        if (sel_l3ca_req_num>=(int) DIM(sel_l3ca_req_tab))
+                parse_error(str,"too many way allocation requests");
+
+        sel_l3ca_req_tab[sel_l3ca_req_num++] = req;
+}
+
+/**
+ * @brief Selects way allocation requests
+ *
+ * @param arg string passed to --alloc-ways command line option
+ */
+static void
+selfn_allocation_ways(const char *arg)
+{
+        char *cp = NULL, *str = NULL;
+        char *saveptr = NULL;
+
+        if (arg==NULL || strlen(arg)<=0)
+                parse_error(arg,"Empty string!");
+
+        cp = strdup(arg);
+        ASSERT(cp!=NULL);
+
+        for (str=cp;;str=NULL) {
+                char *token = NULL, *p = NULL, *saveptr2 = NULL;
+
+                token = strtok_r(str, ";", &saveptr);
+                if (token == NULL)
+                        break;
+                if (strncasecmp(token,"llc:",4)!=0)
+                        parse_error(token,"Unrecognized allocation type");
+                for (p=token+strlen("llc:");;p=NULL) {
+                        char *req = strtok_r(p, ",", &saveptr2);
+
+                        if (req==NULL)
+                                break;
+                        parse_allocation_req(req);
+                }
+        }
+
+        free(cp);
+}
+
 /** 
  * @brief Sets up association between cores and allocation classes of service
  * 
@@ -815,6 +1135,14 @@ print_allocation_config(const struct pqos_capability *cap_mon,
         unsigned i;
 
 	if (cap_l3ca!=NULL) {
+                const struct pqos_cap_l3ca *l3ca = cap_l3ca->u.l3ca;
+
+                printf("L3CA: %u classes, %u ways x %ukB, min mask %u bit(s), "
+                       "shareable ways 0x%llx, I/O (DDIO) ways 0x%llx\n",
+                       l3ca->num_classes, l3ca->num_ways,
+                       l3ca->way_size / 1024, l3ca->min_cbm_bits,
+                       (unsigned long long) l3ca->shareable_mask,
+                       (unsigned long long) l3ca->io_mask);
 		for (i=0;i<sock_count;i++) {
 			struct pqos_l3ca tab[PQOS_MAX_L3CA_COS];
 			unsigned num = 0;
@@ -934,7 +1262,8 @@ selfn_monitor_file_type(const char *arg)
 static void
 selfn_monitor_interval(const char *arg)
 {
-        sel_mon_interval = (int) strtouint64(arg);
+        if (tick_parse_interval(arg,&sel_mon_interval)!=0)
+                parse_error(arg,"invalid monitoring interval");
 }
 
 /** 
@@ -995,6 +1324,106 @@ selfn_show_allocation(const char *arg)
         sel_show_allocation_config = 1;
 }
 
+/**
+ * @brief Selects monitoring loop jitter report
+ *
+ * @param arg not used
+ */
+static void
+selfn_monitor_jitter(const char *arg)
+{
+        arg = arg;
+        sel_mon_jitter = 1;
+}
+
+/**
+ * @brief Selects publishing samples into shared memory ring
+ *
+ * @param arg "<name>[:<capacity>]" string, can be NULL
+ */
+static void
+selfn_shm(const char *arg)
+{
+        sel_shm = 1;
+        if (arg!=NULL && arg[0]!='\0')
+                selfn_strdup(&sel_shm_spec,arg);
+}
+
+/**
+ * @brief Selects Prometheus metrics endpoint
+ *
+ * @param arg "unix:<path>", "<port>" or "localhost:<port>" string
+ */
+static void
+selfn_prom(const char *arg)
+{
+        selfn_strdup(&sel_prom_spec,arg);
+}
+
+/**
+ * @brief Selects online statistics of monitoring groups
+ *
+ * @param arg JSON statistics file name, can be NULL
+ */
+static void
+selfn_stats(const char *arg)
+{
+        sel_stats = 1;
+        if (arg!=NULL && arg[0]!='\0')
+                selfn_strdup(&sel_stats_file,arg);
+}
+
+/**
+ * @brief Selects controller mode
+ *
+ * @param arg controller options string, can be NULL
+ */
+static void
+selfn_controller(const char *arg)
+{
+        sel_controller = 1;
+        if (arg!=NULL && arg[0]!='\0')
+                selfn_strdup(&sel_controller_opts,arg);
+}
+
+/**
+ * @brief Selects cache allocation sensitivity profiler
+ *
+ * @param arg profiler options string, can be NULL
+ */
+static void
+selfn_sweep(const char *arg)
+{
+        sel_sweep = 1;
+        if (arg!=NULL && arg[0]!='\0')
+                selfn_strdup(&sel_sweep_opts,arg);
+}
+
+/**
+ * @brief Selects co-runner interference harness
+ *
+ * @param arg harness options string
+ */
+static void
+selfn_corun(const char *arg)
+{
+        sel_corun = 1;
+        selfn_strdup(&sel_corun_opts,arg);
+}
+
+/**
+ * @brief Selects simulated platform
+ *
+ * @param arg platform specification string, can be NULL
+ */
+static void
+selfn_sim(const char *arg)
+{
+        sel_sim = 1;
+        if (arg!=NULL && arg[0]!='\0')
+                selfn_strdup(&sel_sim_spec,arg);
+}
+
 /** 
  * @brief Opens configuration file and parses its contents
  * 
@@ -1013,12 +1442,19 @@ parse_config_file( const char *fname )
                 { "alloc-class-set:",       selfn_allocation_class }, /**< -e */
                 { "alloc-assoc-set:",       selfn_allocation_assoc }, /**< -a */
                 { "alloc-class-select:",    selfn_allocation_select },/**< -c */
+                { "alloc-ways:",            selfn_allocation_ways },  /**< --alloc-ways */
                 { "monitor-select-events:", selfn_monitor_events },   /**< -m */
                 { "monitor-time:",          selfn_monitor_time },     /**< -t */
                 { "monitor-interval:",      selfn_monitor_interval }, /**< -i */
                 { "monitor-file:",          selfn_monitor_file },     /**< -o */
                 { "monitor-file-type:",     selfn_monitor_file_type },/**< -u */
                 { "monitor-top-like:",      selfn_monitor_top_like }, /**< -T */
+                { "monitor-jitter:",        selfn_monitor_jitter },   /**< --jitter */
+                { "monitor-shm:",           selfn_shm },              /**< --shm */
+                { "monitor-stats:",         selfn_stats },            /**< --stats */
+                { "monitor-prom:",          selfn_prom },             /**< --prom */
+                { "controller:",            selfn_controller },       /**< --controller */
+                { "sim:",                   selfn_sim },              /**< --sim */
         };
         FILE *fp = NULL;
         char cb[256];
@@ -1083,63 +1519,628 @@ parse_config_file( const char *fname )
 }
 
 
-static int 
-mon_qsort_cmp_desc( const void *a, const void *b )
+/**
+ * @brief Tells if group \a a goes before group \a b in top mode
+ *
+ * Larger values go first, equal values keep group order.
+ */
+static int
+mon_top_before(const struct pqos_mon_data *data,
+               const unsigned a, const unsigned b)
 {
-        const struct pqos_mon_data *ap = (const struct pqos_mon_data *)a;
-        const struct pqos_mon_data *bp = (const struct pqos_mon_data *)b;
-        /**
-         * This (b-a) is to get descending order
-         * otherwise it would be (a-b)
-         */
-        return (int) (((int64_t)bp->value) - ((int64_t)ap->value));
+        if (data[a].value!=data[b].value)
+                return data[a].value>data[b].value;
+        return a<b;
 }
 
 /**
- * Stop monitoring indicator for infinite monitoring loop
+ * @brief Restores heap of top groups below \a pos, the root holds
+ *        the group that goes last
  */
-static int stop_monitoring_loop = 0;
+static void
+mon_top_sift_down(const struct pqos_mon_data *data, unsigned *heap,
+                  const unsigned num, unsigned pos)
+{
+        for (;;) {
+                const unsigned l = (2 * pos) + 1, r = l + 1;
+                unsigned last = pos, tmp;
+
+                if (l<num && mon_top_before(data, heap[last], heap[l]))
+                        last = l;
+                if (r<num && mon_top_before(data, heap[last], heap[r]))
+                        last = r;
+                if (last==pos)
+                        return;
+                tmp = heap[pos];
+                heap[pos] = heap[last];
+                heap[last] = tmp;
+                pos = last;
+        }
+}
 
-/** 
- * @brief CTRL-C handler for infinite monitoring loop
- * 
- * @param signo signal number
+/**
+ * @brief Selects \a k groups with highest values in descending order
+ *
+ * Only the \a k best groups seen so far are kept in a heap, so the
+ * cost is O(n log k) rather than sorting all groups every sample.
+ *
+ * @param data monitoring groups
+ * @param n number of groups
+ * @param k number of groups to select
+ * @param order selected group indexes, at least \a k entries
+ *
+ * @return Number of selected groups
  */
-static void monitoring_ctrlc(int signo)
+static unsigned
+mon_top_select(const struct pqos_mon_data *data, const unsigned n,
+               const unsigned k, unsigned *order)
 {
-        if (signo==SIGINT)
-                stop_monitoring_loop = 1;
-}
+        unsigned i, num = 0, tmp;
 
-/** 
+        for (i=0;i<n;i++) {
+                if (num<k) {
+                        unsigned pos = num++, parent;
+
+                        order[pos] = i;
+                        while (pos>0) {
+                                parent = (pos - 1) / 2;
+                                if (!mon_top_before(data, order[parent],
+                                                    order[pos]))
+                                        break;
+                                tmp = order[pos];
+                                order[pos] = order[parent];
+                                order[parent] = tmp;
+                                pos = parent;
+                        }
+                } else if (k>0 && mon_top_before(data, i, order[0])) {
+                        order[0] = i;
+                        mon_top_sift_down(data, order, num, 0);
+                }
+        }
+
+        /**
+         * Heap sort, groups going last are moved to the end
+         */
+        for (i=num;i>1;i--) {
+                tmp = order[0];
+                order[0] = order[i - 1];
+                order[i - 1] = tmp;
+                mon_top_sift_down(data, order, i - 1, 0);
+        }
+        return num;
+}
+
+/**
+ * Core performance counter, frequency and power metrics published
+ * as extra groups of binary output and extra records of shared
+ * memory ring
+ */
+static const enum pqos_mon_event mon_perf_metrics[] = {
+        PQOS_PERF_EVENT_IPC,
+        PQOS_PERF_EVENT_LLC_MISS,
+        PQOS_PERF_EVENT_FREQ,
+        PQOS_PWR_EVENT_PKG_ENERGY,
+        PQOS_PWR_EVENT_DRAM_ENERGY
+};
+
+/**
+ * Events reported in the extra columns of text, CSV and JSON output
+ */
+#define MON_PERF_EVENTS (PQOS_PERF_EVENT_IPC | PQOS_PERF_EVENT_LLC_MISS | \
+                         PQOS_PERF_EVENT_FREQ | PQOS_PWR_EVENT_PKG_ENERGY | \
+                         PQOS_PWR_EVENT_DRAM_ENERGY)
+
+/**
+ * @brief Returns LLC misses per 1000 instructions of group \a g
+ */
+static double
+mon_mpki(const struct pqos_mon_data *g)
+{
+        if (g->instructions==0)
+                return 0.0;
+        return ((double) g->llc_misses * 1000.0) / (double) g->instructions;
+}
+
+/**
+ * @brief Returns metric of group \a g for one of mon_perf_metrics,
+ *        IPC, MPKI, frequency in MHz or power in Joules/s
+ */
+static double
+mon_perf_value(const struct pqos_mon_data *g,
+               const enum pqos_mon_event event)
+{
+        switch (event) {
+        case PQOS_PERF_EVENT_IPC:
+                return g->ipc;
+        case PQOS_PERF_EVENT_LLC_MISS:
+                return mon_mpki(g);
+        case PQOS_PERF_EVENT_FREQ:
+                return g->freq;
+        case PQOS_PWR_EVENT_PKG_ENERGY:
+                return g->pkg_power;
+        case PQOS_PWR_EVENT_DRAM_ENERGY:
+                return g->dram_power;
+        default:
+                return 0.0;
+        }
+}
+
+/**
+ * @brief Returns metric of group \a g in thousandths
+ */
+static uint64_t
+mon_perf_milli(const struct pqos_mon_data *g,
+               const enum pqos_mon_event event)
+{
+        return (uint64_t) ((mon_perf_value(g, event) * 1000.0) + 0.5);
+}
+
+/**
+ * @brief Fills CSV and JSON performance counter columns of group \a g
+ */
+static void
+mon_perf_fill(const struct pqos_mon_data *g, struct outbuf_perf *perf)
+{
+        perf->has_ipc = (g->event & PQOS_PERF_EVENT_IPC)!=0;
+        perf->has_mpki = (g->event & PQOS_PERF_EVENT_LLC_MISS)!=0;
+        perf->has_freq = (g->event & PQOS_PERF_EVENT_FREQ)!=0;
+        perf->has_pkg = (g->event & PQOS_PWR_EVENT_PKG_ENERGY)!=0;
+        perf->has_dram = (g->event & PQOS_PWR_EVENT_DRAM_ENERGY)!=0;
+        perf->ipc = g->ipc;
+        perf->llc_misses = g->llc_misses;
+        perf->mpki = mon_mpki(g);
+        perf->freq = g->freq;
+        perf->pkg_power = g->pkg_power;
+        perf->dram_power = g->dram_power;
+}
+
+/**
+ * @brief Checks if text column of \a event is shown for \a perf
+ *        events monitored by any group
+ *
+ * IPC and MPKI as well as package and DRAM power
+ * are shown in pairs.
+ */
+static int
+mon_perf_shown(const unsigned perf, const enum pqos_mon_event event)
+{
+        static const unsigned pairs[] = {
+                PQOS_PERF_EVENT_IPC | PQOS_PERF_EVENT_LLC_MISS,
+                PQOS_PWR_EVENT_PKG_ENERGY | PQOS_PWR_EVENT_DRAM_ENERGY
+        };
+        unsigned i;
+
+        for (i=0;i<DIM(pairs);i++)
+                if (event & pairs[i])
+                        return (perf & pairs[i])!=0;
+        return (perf & event)!=0;
+}
+
+/**
+ * @brief Returns text column header for \a perf events,
+ *        see mon_perf_text()
+ */
+static const char *
+mon_perf_header(const unsigned perf)
+{
+        static const char * const names[DIM(mon_perf_metrics)] = {
+                "IPC", "MPKI", "MHz", "PKG[W]", "DRAM[W]"
+        };
+        static char buf[64];
+        unsigned k;
+        size_t n = 0;
+
+        buf[0] = '\0';
+        for (k=0;k<DIM(mon_perf_metrics);k++)
+                if (mon_perf_shown(perf, mon_perf_metrics[k]))
+                        n += (size_t) snprintf(&buf[n], sizeof(buf) - n,
+                                               " %8s", names[k]);
+        return buf;
+}
+
+/**
+ * @brief Formats text columns of group \a g for \a perf events
+ *        monitored by any group, "-" stands for an event not
+ *        monitored in the group
+ *
+ * @return \a buf
+ */
+static const char *
+mon_perf_text(char *buf, const size_t len, const struct pqos_mon_data *g,
+              const unsigned perf)
+{
+        unsigned k;
+        size_t n = 0;
+
+        buf[0] = '\0';
+        for (k=0;k<DIM(mon_perf_metrics) && n<len;k++) {
+                const enum pqos_mon_event evt = mon_perf_metrics[k];
+                char col[16] = "-";
+                int r;
+
+                if (!mon_perf_shown(perf, evt))
+                        continue;
+                if (g->event & evt)
+                        snprintf(col, sizeof(col),
+                                 (evt==PQOS_PERF_EVENT_FREQ) ?
+                                 "%.0f" : "%.2f", mon_perf_value(g, evt));
+                r = snprintf(&buf[n], len - n, " %8s", col);
+                if (r>0)
+                        n += (size_t) r;
+        }
+        return buf;
+}
+
+/**
+ * @brief Publishes polled monitoring groups into shared memory ring
+ *
+ * @param ring shared memory ring
+ * @param groups monitoring groups
+ * @param num_groups number of groups
+ * @param llc_factor LLC occupancy scale factor
+ * @param tv time of the sample
+ */
+static void
+publish_samples(struct shmring *ring,
+                const struct pqos_mon_data *groups,
+                const unsigned num_groups,
+                const uint32_t llc_factor,
+                const struct timeval *tv)
+{
+        struct shmring_record rec;
+        unsigned i, j, k;
+
+        memset(&rec,0,sizeof(rec));
+        rec.timestamp = ((uint64_t) tv->tv_sec * 1000000000ULL) +
+                ((uint64_t) tv->tv_usec * 1000ULL);
+
+        for (i=0;i<num_groups;i++) {
+                rec.socket = groups[i].socket;
+                rec.rmid = groups[i].rmid;
+                rec.event = (uint32_t) groups[i].event;
+                rec.num_cores = groups[i].num_cores;
+                for (j=0;j<SHMRING_MAX_CORES;j++)
+                        rec.cores[j] = (j<groups[i].num_cores) ?
+                                groups[i].cores[j] : 0;
+                rec.value = groups[i].value * llc_factor;
+                shmring_write(ring, &rec);
+
+                for (k=0;k<DIM(mon_perf_metrics);k++) {
+                        if (!(groups[i].event & mon_perf_metrics[k]))
+                                continue;
+                        rec.event = (uint32_t) mon_perf_metrics[k];
+                        rec.value = mon_perf_milli(&groups[i],
+                                                   mon_perf_metrics[k]);
+                        shmring_write(ring, &rec);
+                }
+        }
+}
+
+/**
+ * Max number of binary output groups, LLC occupancy and
+ * each of mon_perf_metrics for every monitoring group
+ */
+#define BIN_MAX_VALUES (PQOS_MAX_CORES * (DIM(mon_perf_metrics) + 1))
+
+/**
+ * @brief Returns values of binary output groups, LLC occupancy
+ *        of all monitoring groups followed by performance counter
+ *        metrics in the order of bin_start() header
+ *
+ * @param values place to store values, NULL to count the groups only
+ * @param max size of \a values
+ *
+ * @return Number of binary output groups
+ */
+static unsigned
+bin_values(uint64_t *values, const unsigned max)
+{
+        unsigned i, k, n = 0;
+
+        for (i=0;i<(unsigned)sel_monitor_num;i++, n++) {
+                ASSERT(values==NULL || n<max);
+                if (values!=NULL && n<max)
+                        values[n] = m_mon_grps[i].value;
+        }
+
+        for (k=0;k<DIM(mon_perf_metrics);k++)
+                for (i=0;i<(unsigned)sel_monitor_num;i++) {
+                        if (!(m_mon_grps[i].event & mon_perf_metrics[k]))
+                                continue;
+                        ASSERT(values==NULL || n<max);
+                        if (values!=NULL && n<max)
+                                values[n] = mon_perf_milli(&m_mon_grps[i],
+                                                           mon_perf_metrics[k]);
+                        n++;
+                }
+        return n;
+}
+
+/**
+ * @brief Starts binary output run with a header describing
+ *        topology, events and monitoring groups
+ *
+ * @param fp output stream
+ * @param w binary encoder to initialize
+ * @param cpu CPU topology
+ * @param cap detected PQoS capabilities
+ * @param llc_factor LLC occupancy scale factor
+ * @param interval sampling interval in microseconds
+ *
+ * @return Operation status
+ * @retval 0 on success
+ */
+static int
+bin_start(FILE *fp,
+          struct binfmt_writer *w,
+          const struct pqos_cpuinfo *cpu,
+          const struct pqos_cap *cap,
+          const uint32_t llc_factor,
+          const long interval)
+{
+        const struct pqos_capability *cap_mon = NULL;
+        struct binfmt_header hdr;
+        struct timeval tv;
+        uint32_t events[8];
+        unsigned i, j, k, n;
+        int ret = -1;
+
+        memset(&hdr,0,sizeof(hdr));
+        gettimeofday(&tv, NULL);
+        hdr.version = BINFMT_VERSION;
+        hdr.start = ((uint64_t) tv.tv_sec * 1000000000ULL) +
+                ((uint64_t) tv.tv_usec * 1000ULL);
+        hdr.interval = (uint64_t) interval;
+        hdr.scale_factor = llc_factor;
+
+        hdr.num_cores = cpu->num_cores;
+        hdr.cores = calloc(cpu->num_cores + 1, sizeof(hdr.cores[0]));
+        hdr.num_groups = bin_values(NULL, 0);
+        hdr.groups = calloc(hdr.num_groups + 1, sizeof(hdr.groups[0]));
+        if (hdr.cores==NULL || hdr.groups==NULL)
+                goto exit;
+
+        for (i=0;i<cpu->num_cores;i++) {
+                hdr.cores[i].lcore = cpu->cores[i].lcore;
+                hdr.cores[i].socket = cpu->cores[i].socket;
+                hdr.cores[i].cluster = cpu->cores[i].cluster;
+        }
+
+        if (pqos_cap_get_type(cap, PQOS_CAP_TYPE_MON, &cap_mon)==
+            PQOS_RETVAL_OK)
+                for (i=0;i<cap_mon->u.mon->num_events &&
+                             i<DIM(events);i++)
+                        events[hdr.num_events++] =
+                                cap_mon->u.mon->events[i].type;
+        hdr.events = events;
+
+        /**
+         * LLC occupancy groups followed by performance counter
+         * metrics, see bin_values()
+         */
+        for (k=0, n=0;k<=DIM(mon_perf_metrics);k++)
+                for (i=0;i<(unsigned)sel_monitor_num;i++) {
+                        struct binfmt_group *g = &hdr.groups[n];
+
+                        if (k>0 &&
+                            !(m_mon_grps[i].event & mon_perf_metrics[k-1]))
+                                continue;
+                        n++;
+                        g->socket = m_mon_grps[i].socket;
+                        g->rmid = m_mon_grps[i].rmid;
+                        g->event = (k==0) ? BINFMT_EVENT_LLC :
+                                (uint32_t) mon_perf_metrics[k-1];
+                        g->num_cores = m_mon_grps[i].num_cores;
+                        g->cores = calloc(g->num_cores + 1,
+                                          sizeof(g->cores[0]));
+                        if (g->cores==NULL)
+                                goto exit;
+                        for (j=0;j<g->num_cores;j++)
+                                g->cores[j] = m_mon_grps[i].cores[j];
+                }
+
+        ret = binfmt_write_header(fp, w, &hdr);
+        fflush(fp);
+
+ exit:
+        if (hdr.groups!=NULL)
+                for (i=0;i<hdr.num_groups;i++)
+                        free(hdr.groups[i].cores);
+        free(hdr.groups);
+        free(hdr.cores);
+        return ret;
+}
+
+/**
+ * Stop monitoring indicator for infinite monitoring loop
+ */
+static int stop_monitoring_loop = 0;
+
+/** 
+ * @brief CTRL-C handler for infinite monitoring loop
+ * 
+ * @param signo signal number
+ */
+static void monitoring_ctrlc(int signo)
+{
+        if (signo==SIGINT)
+                stop_monitoring_loop = 1;
+}
+
+/**
+ * Statistics report request indicator
+ */
+static volatile sig_atomic_t stats_report_request = 0;
+
+/**
+ * @brief SIGUSR1 handler requesting statistics report
+ *
+ * @param signo signal number
+ */
+static void monitoring_sigusr1(int signo)
+{
+        if (signo==SIGUSR1)
+                stats_report_request = 1;
+}
+
+/**
+ * Statistics rows of mon_perf_metrics, metrics below 1 are
+ * accumulated in thousandths
+ */
+static const struct {
+        const char *event;
+        const char *unit;
+        double scale;
+} mon_stats_metrics[DIM(mon_perf_metrics)] = {
+        { "ipc",  "-",   1000.0 },
+        { "mpki", "-",   1000.0 },
+        { "freq", "MHz", 1.0 },
+        { "pkg",  "W",   1000.0 },
+        { "dram", "W",   1000.0 }
+};
+
+/**
+ * @brief Sets up statistics rows of monitoring groups
+ *
+ * Every group gets LLC occupancy row followed by a row
+ * for each of mon_perf_metrics it monitors.
+ *
+ * @param rows statistics rows, room for
+ *        num * (DIM(mon_perf_metrics) + 1) entries
+ * @param g monitoring groups
+ * @param num number of groups
+ *
+ * @return Number of rows
+ */
+static unsigned
+stats_rows_init(struct stats_group *rows, const struct pqos_mon_data *g,
+                const unsigned num)
+{
+        unsigned i, k, n = 0;
+
+        for (i=0;i<num;i++)
+                for (k=0;k<=DIM(mon_perf_metrics);k++) {
+                        if (k>0 && !(g[i].event & mon_perf_metrics[k - 1]))
+                                continue;
+                        rows[n].socket = g[i].socket;
+                        rows[n].core = g[i].cores[0];
+                        rows[n].rmid = g[i].rmid;
+                        if (k==0) {
+                                rows[n].event = "llc";
+                                rows[n].unit = "KB";
+                                rows[n].scale = 1.0;
+                        } else {
+                                rows[n].event = mon_stats_metrics[k - 1].event;
+                                rows[n].unit = mon_stats_metrics[k - 1].unit;
+                                rows[n].scale = mon_stats_metrics[k - 1].scale;
+                        }
+                        stats_init(&rows[n].acc);
+                        n++;
+                }
+        return n;
+}
+
+/**
+ * @brief Adds sample of monitoring groups to rows set up
+ *        by stats_rows_init()
+ */
+static void
+stats_rows_add(struct stats_group *rows, const struct pqos_mon_data *g,
+               const unsigned num, const uint32_t llc_factor)
+{
+        unsigned i, k, n = 0;
+
+        for (i=0;i<num;i++) {
+                stats_add(&rows[n++].acc,
+                          (double) (g[i].value * llc_factor) / 1024.0);
+                for (k=0;k<DIM(mon_perf_metrics);k++) {
+                        if (!(g[i].event & mon_perf_metrics[k]))
+                                continue;
+                        stats_add(&rows[n].acc,
+                                  mon_perf_value(&g[i], mon_perf_metrics[k]) *
+                                  rows[n].scale);
+                        n++;
+                }
+        }
+}
+
+/**
+ * @brief Reports online statistics of monitoring groups
+ *
+ * Text report goes to \a fp for text output and to stderr otherwise,
+ * JSON report replaces \a file if selected.
+ *
+ * @param fp monitoring output stream
+ * @param istext text output selected
+ * @param groups statistics rows
+ * @param num number of rows
+ * @param file JSON statistics file, can be NULL
+ * @param duration monitoring time in seconds
+ */
+static void
+stats_report(FILE *fp, const int istext, const struct stats_group *groups,
+             const unsigned num, const char *file, const double duration)
+{
+        if (istext)
+                fputc('\n',fp);
+        stats_report_text(istext ? fp : stderr, groups, num, duration);
+        if (file!=NULL && stats_save_json(file, groups, num, duration)!=0)
+                printf("Failed to write statistics to '%s'!\n", file);
+}
+
+/** 
  * @brief Reads monitoring event data at given \a interval for \a sel_time time span
  * 
  * @param fp FILE to be used for storing monitored data
  * @param sel_time time span to monitor data for, negative value indicates infinite time
- * @param interval time interavl to gather data and print to the file, this is in 100ms units
+ * @param interval time interavl to gather data and print to the file, this is in microseconds
  * @param top_mode output style similar to top utility
+ * @param jitter adds scheduled and actual sample times to the output and
+ *        prints jitter report at the end
  * @param cap detected PQoS capabilites
- * @param output_type text or xml output file
+ * @param cpu detected CPU topology
+ * @param output_type text, xml, csv, json or bin output file
+ * @param ring shared memory ring to publish samples into, can be NULL
+ * @param stats maintain online statistics of groups
+ * @param stats_file JSON statistics file, can be NULL
+ * @param prom metrics endpoint to publish samples to, can be NULL
  */
 static void 
 monitoring_loop( FILE *fp,
                  const int sel_time,
-                 long interval,
+                 const long interval,
                  const int top_mode,
+                 const int jitter,
                  const struct pqos_cap *cap,
-                 const char *output_type)
+                 const struct pqos_cpuinfo *cpu,
+                 const char *output_type,
+                 struct shmring *ring,
+                 const int stats,
+                 const char *stats_file,
+                 struct metrics *prom)
 {
-#define TERM_MIN_NUM_LINES 3
-
         uint32_t llc_factor = 1;
-        struct timeval tv_start;
+        struct tick_timer timer;
+        struct tick_sample tick;
         int ret = PQOS_RETVAL_OK;
         const struct pqos_monitor *l3mon = NULL;
         int istty = 0;
-        unsigned max_lines = 0;
+        unsigned i;
+        unsigned order[PQOS_MAX_CORES];
+        struct screen scr;
         const int istext = !strcasecmp(output_type,"text");
-
-        if((!istext)  && (strcasecmp(output_type,"xml")!=0)) {
+        const int isxml = !strcasecmp(output_type,"xml");
+        const int isbin = !strcasecmp(output_type,"bin");
+        const int iscsv = !strcasecmp(output_type,"csv");
+        const int isjson = !strcasecmp(output_type,"json");
+        struct binfmt_writer bin_writer;
+        struct outbuf ob;
+        struct stats_group *groups = NULL;
+        unsigned num_stats = 0;
+        unsigned perf = 0;
+        char perf_col[64];
+
+        if((!istext) && (!isxml) && (!isbin) && (!iscsv) && (!isjson)) {
                 printf("Invalid selection of output file type '%s'!\n", output_type);
                 return;
         }
@@ -1152,6 +2153,13 @@ monitoring_loop( FILE *fp,
 
         llc_factor = l3mon->scale_factor;
 
+        /**
+         * IPC/MPKI, frequency and power columns are added
+         * if any group monitors these events
+         */
+        for (i=0;i<(unsigned)sel_monitor_num;i++)
+                perf |= m_mon_grps[i].event & MON_PERF_EVENTS;
+
         /**
          * capture ctrl-c to gracefully stop the infinite loop 
          */
@@ -1160,86 +2168,274 @@ monitoring_loop( FILE *fp,
                         printf("Failed to catch CTRL-C SIGINT!\n");
         }
 
-        istty = isatty(fileno(fp));
+        /**
+         * Samples are taken on absolute time scale so that
+         * processing time does not shift the following ones
+         */
+        if (tick_init(&timer, interval, &tick)!=0) {
+                printf("Failed to start sampling timer!\n");
+                return;
+        }
+
+        memset(&bin_writer,0,sizeof(bin_writer));
+        if (isbin && bin_start(fp, &bin_writer, cpu, cap, llc_factor,
+                               interval)!=0) {
+                printf("Failed to write binary output header!\n");
+                binfmt_writer_fini(&bin_writer);
+                tick_fini(&timer);
+                return;
+        }
 
-        if (istty) {
-                struct winsize w;
-                if (ioctl(fileno(fp), TIOCGWINSZ, &w)!=-1) {
-                        max_lines = w.ws_row;
-                        if (max_lines < TERM_MIN_NUM_LINES)
-                                max_lines = TERM_MIN_NUM_LINES;
+        /**
+         * CSV and JSON records are formatted into buffers
+         * written out by a separate thread
+         */
+        if (iscsv || isjson) {
+                fflush(fp);
+                if (outbuf_init(&ob, fileno(fp), 0, 0)!=0) {
+                        printf("Failed to start output writer!\n");
+                        binfmt_writer_fini(&bin_writer);
+                        tick_fini(&timer);
+                        return;
+                }
+                if (iscsv && ftell(fp)<=0) {
+                        static const char hdr[] =
+                                "time,socket,core,rmid,event,value_kb\n";
+                        static const char hdr_perf[] =
+                                "time,socket,core,rmid,event,value_kb,"
+                                "ipc,llc_misses,mpki,freq_mhz,pkg_watts,"
+                                "dram_watts\n";
+                        const char *h = perf ? hdr_perf : hdr;
+                        const size_t len = strlen(h);
+
+                        memcpy(outbuf_reserve(&ob, len), h, len);
+                        outbuf_commit(&ob, len);
                 }
         }
 
         /**
-         * Interval is passed in  100[ms] units
-         * This converts interval to microseconds
+         * Statistics of every reported metric are kept for
+         * the whole run and reported on request with the next sample
          */
-        interval = interval * 100000LL;
+        if (stats) {
+                groups = calloc((size_t) sel_monitor_num *
+                                (DIM(mon_perf_metrics) + 1),
+                                sizeof(groups[0]));
+                if (groups==NULL)
+                        printf("Failed to allocate statistics!\n");
+                else
+                        num_stats = stats_rows_init(groups, m_mon_grps,
+                                                    (unsigned) sel_monitor_num);
+                if (groups!=NULL &&
+                    signal(SIGUSR1,monitoring_sigusr1)==SIG_ERR)
+                        printf("Failed to catch SIGUSR1!\n");
+        }
 
-        gettimeofday (&tv_start, NULL);
+        /**
+         * Text output on a terminal is redrawn in place
+         */
+        istty = istext && isatty(fileno(fp));
+        if (istty && screen_init(&scr, fp)!=0) {
+                printf("Failed to initialize terminal output!\n");
+                istty = 0;
+        }
 
         while (!stop_monitoring_loop) {
-                struct pqos_mon_data mon_data[PQOS_MAX_CORES];
-                unsigned mon_number = (unsigned) sel_monitor_num;
-                struct timeval tv_s, tv_e;
+                const struct pqos_mon_data *mon_data = m_mon_grps;
+                const unsigned mon_number = (unsigned) sel_monitor_num;
+                struct timespec ts_s;
+                struct timeval tv_s;
                 struct tm* ptm = NULL;
-                unsigned i = 0;
-                struct timespec req, rem;
-                long usec_start = 0, usec_end = 0, usec_diff = 0;
+                const double sched_s =
+                        (double) (tick.sched_ns - timer.start_ns) / 1e9;
+                const double actual_s =
+                        (double) (tick.actual_ns - timer.start_ns) / 1e9;
                 char cb_time[64];
 
-                gettimeofday (&tv_s, NULL);
+                /**
+                 * Wall clock timestamps follow NTP adjustments,
+                 * clock_gettime() is served from the vDSO
+                 */
+                clock_gettime(CLOCK_REALTIME, &ts_s);
+                tv_s.tv_sec = ts_s.tv_sec;
+                tv_s.tv_usec = (suseconds_t) (ts_s.tv_nsec / 1000L);
 
                 ret = pqos_mon_poll(m_mon_grps, (unsigned) sel_monitor_num);
                 if (ret!=PQOS_RETVAL_OK) {
                         printf("Failed to poll monitoring data!\n");
-                        return;
+                        break;
                 }
 
-                memcpy(mon_data, m_mon_grps, sel_monitor_num * sizeof(m_mon_grps[0]));
-
-                if (istty)
-                        fprintf(fp,"\033[2J");   /**< clear screen */
-
-                ptm = localtime (&tv_s.tv_sec);
-                if (ptm!=NULL) {
-                        /**
-                         * Print time
-                         */
-                        strftime(cb_time, DIM(cb_time)-1,
-                                 "%Y-%m-%d %H:%M:%S", ptm);
+                if (groups!=NULL)
+                        stats_rows_add(groups, mon_data,
+                                       (unsigned) sel_monitor_num,
+                                       llc_factor);
 
+                if (groups!=NULL && stats_report_request) {
+                        stats_report_request = 0;
+                        stats_report(fp, istext, groups, num_stats,
+                                     stats_file, actual_s);
                         if (istty)
-                                fprintf(fp,"\033[0;0H"); /**< Move to position 0:0 and print
-                                                              time  */
-                        if (istext)
-                                fprintf(fp,"TIME %s\n",cb_time);
-                } else {
-                        strncpy(cb_time, "error", DIM(cb_time)-1);
+                                scr.full = 1;
                 }
 
-                if (top_mode)
-                        qsort( mon_data, mon_number, sizeof(mon_data[0]),
-                               mon_qsort_cmp_desc );
+                if (ring!=NULL)
+                        publish_samples(ring, mon_data,
+                                        (unsigned) sel_monitor_num,
+                                        llc_factor, &tv_s);
+
+                if (prom!=NULL)
+                        metrics_publish(prom, mon_data,
+                                        (unsigned) sel_monitor_num,
+                                        llc_factor, &tv_s);
+
+                if (isbin) {
+                        uint64_t values[BIN_MAX_VALUES];
+
+                        (void) bin_values(values, DIM(values));
+                        if (binfmt_write_sample(&bin_writer,
+                                                ((uint64_t) tv_s.tv_sec *
+                                                 1000000000ULL) +
+                                                ((uint64_t) tv_s.tv_usec *
+                                                 1000ULL),
+                                                values)!=0) {
+                                printf("Failed to write binary output!\n");
+                                break;
+                        }
+                        fflush(fp);
+                }
 
-                if (max_lines>0) {
-                        if ((mon_number+TERM_MIN_NUM_LINES-1)>max_lines)
-                                mon_number = max_lines - TERM_MIN_NUM_LINES + 1;
+                if (iscsv || isjson) {
+                        const uint64_t time_us =
+                                ((uint64_t) tv_s.tv_sec * 1000000ULL) +
+                                (uint64_t) tv_s.tv_usec;
+
+                        for (i=0;i<(unsigned)sel_monitor_num;i++) {
+                                const struct pqos_mon_data *g = &mon_data[i];
+                                char *p = outbuf_reserve(&ob,
+                                                         OUTBUF_MAX_RECORD);
+                                struct outbuf_perf pc;
+
+                                if (perf)
+                                        mon_perf_fill(g, &pc);
+                                outbuf_commit(&ob, (iscsv ?
+                                                    outbuf_fmt_csv :
+                                                    outbuf_fmt_json)
+                                              (p, time_us, g->socket,
+                                               g->cores[0], g->rmid, "llc",
+                                               g->value * llc_factor,
+                                               perf ? &pc : NULL));
+                        }
+                        outbuf_end_sample(&ob);
                 }
 
-                if (istext)
-                        fprintf(fp,"SOCKET     CORE     RMID    LLC[KB]");
+                ptm = localtime (&tv_s.tv_sec);
+                if (ptm==NULL ||
+                    strftime(cb_time, DIM(cb_time)-1,
+                             "%Y-%m-%d %H:%M:%S", ptm)==0)
+                        strncpy(cb_time, "error", DIM(cb_time)-1);
+
+                if (istty) {
+                        /**
+                         * Only groups fitting the terminal are selected
+                         * and only changed cells get redrawn
+                         */
+                        const unsigned hdr = jitter ? 3 : 2;
+                        unsigned row = 0, num;
+
+                        ret = screen_begin(&scr);
+                        if (ret<0) {
+                                printf("Terminal output error!\n");
+                                break;
+                        }
+                        if (ret==0) {
+                                const unsigned k = (scr.rows>hdr) ?
+                                        scr.rows - hdr : 0;
+
+                                if (top_mode) {
+                                        num = mon_top_select(mon_data,
+                                                             mon_number, k,
+                                                             order);
+                                } else {
+                                        num = (mon_number<k) ? mon_number : k;
+                                        for (i=0;i<num;i++)
+                                                order[i] = i;
+                                }
+                                screen_printf(&scr, row++, "TIME %s", cb_time);
+                                if (jitter)
+                                        screen_printf(&scr, row++,
+                                                      "TICK %llu SCHED %.6f "
+                                                      "ACTUAL %.6f MISSED %llu",
+                                                      (unsigned long long)
+                                                      tick.seq, sched_s,
+                                                      actual_s,
+                                                      (unsigned long long)
+                                                      tick.missed);
+                                screen_printf(&scr, row++,
+                                              "SOCKET     CORE     RMID    "
+                                              "LLC[KB]%s",
+                                              mon_perf_header(perf));
+                                for (i=0;i<num;i++) {
+                                        const struct pqos_mon_data *g =
+                                                &mon_data[order[i]];
+
+                                        screen_printf(&scr, row++,
+                                                      "%6u %8u %8u %10.1f%s",
+                                                      g->socket, g->cores[0],
+                                                      g->rmid,
+                                                      (double) (g->value *
+                                                                llc_factor) /
+                                                      1024.0,
+                                                      perf ?
+                                                      mon_perf_text(perf_col,
+                                                                    sizeof(perf_col),
+                                                                    g, perf) :
+                                                      "");
+                                }
+                                screen_flush(&scr);
+                        }
+                } else if (istext || isxml) {
+                        unsigned num = mon_number;
+
+                        if (top_mode)
+                                num = mon_top_select(mon_data, mon_number,
+                                                     mon_number, order);
+                        else
+                                for (i=0;i<num;i++)
+                                        order[i] = i;
 
-                for (i=0;i<mon_number;i++) {
-                        double kb = ((double)(mon_data[i].value*llc_factor)) / 1024.0;
                         if (istext) {
-                                fprintf(fp, "\n%6u %8u %8u %10.1f",
-                                        mon_data[i].socket,
-                                        mon_data[i].cores[0],
-                                        mon_data[i].rmid,
-                                        kb );
-                        } else {
+                                fprintf(fp,"TIME %s\n",cb_time);
+                                if (jitter)
+                                        fprintf(fp,"TICK %llu SCHED %.6f "
+                                                "ACTUAL %.6f MISSED %llu\n",
+                                                (unsigned long long) tick.seq,
+                                                sched_s, actual_s,
+                                                (unsigned long long)
+                                                tick.missed);
+                                fprintf(fp,"SOCKET     CORE     RMID    "
+                                        "LLC[KB]%s",
+                                        mon_perf_header(perf));
+                        }
+
+                        for (i=0;i<num;i++) {
+                                const struct pqos_mon_data *g =
+                                        &mon_data[order[i]];
+                                double kb = ((double)(g->value*llc_factor)) /
+                                        1024.0;
+
+                                if (istext) {
+                                        fprintf(fp, "\n%6u %8u %8u %10.1f%s",
+                                                g->socket,
+                                                g->cores[0],
+                                                g->rmid,
+                                                kb,
+                                                perf ?
+                                                mon_perf_text(perf_col,
+                                                              sizeof(perf_col),
+                                                              g, perf) : "");
+                                        continue;
+                                }
                                 /* XML */
                                 fprintf(fp,
                                         "%s\n"
@@ -1247,63 +2443,89 @@ monitoring_loop( FILE *fp,
                                         "\t<socket>%u</socket>\n"
                                         "\t<core>%u</core>\n"
                                         "\t<rmid>%u</rmid>\n"
-                                        "\t<l3_occupancy_kB>%.1f</l3_occupancy_kB>\n"
-                                        "%s\n"
-                                        "%s",
+                                        "\t<l3_occupancy_kB>%.1f</l3_occupancy_kB>\n",
                                         xml_child_open,
                                         cb_time,
-                                        mon_data[i].socket,
-                                        mon_data[i].cores[0],
-                                        mon_data[i].rmid,
-                                        kb,
+                                        g->socket,
+                                        g->cores[0],
+                                        g->rmid,
+                                        kb);
+                                if (g->event & PQOS_PERF_EVENT_IPC)
+                                        fprintf(fp, "\t<ipc>%.2f</ipc>\n",
+                                                g->ipc);
+                                if (g->event & PQOS_PERF_EVENT_LLC_MISS)
+                                        fprintf(fp,
+                                                "\t<llc_misses>%llu"
+                                                "</llc_misses>\n"
+                                                "\t<mpki>%.2f</mpki>\n",
+                                                (unsigned long long)
+                                                g->llc_misses,
+                                                mon_mpki(g));
+                                if (g->event & PQOS_PERF_EVENT_FREQ)
+                                        fprintf(fp, "\t<freq_mhz>%.0f"
+                                                "</freq_mhz>\n", g->freq);
+                                if (g->event & PQOS_PWR_EVENT_PKG_ENERGY)
+                                        fprintf(fp, "\t<pkg_watts>%.2f"
+                                                "</pkg_watts>\n",
+                                                g->pkg_power);
+                                if (g->event & PQOS_PWR_EVENT_DRAM_ENERGY)
+                                        fprintf(fp, "\t<dram_watts>%.2f"
+                                                "</dram_watts>\n",
+                                                g->dram_power);
+                                if (jitter)
+                                        fprintf(fp,
+                                                "\t<tick>%llu</tick>\n"
+                                                "\t<sched_s>%.6f</sched_s>\n"
+                                                "\t<actual_s>%.6f</actual_s>\n"
+                                                "\t<missed>%llu</missed>\n",
+                                                (unsigned long long) tick.seq,
+                                                sched_s, actual_s,
+                                                (unsigned long long)
+                                                tick.missed);
+                                fprintf(fp, "%s\n%s",
                                         xml_child_close,
                                         xml_root_close);
                                 fseek(fp,-xml_root_close_size,SEEK_CUR);
                         }
                 }
-                
-                /**
-                 * Move to position 0:0
-                 */
-                if (istty)
-                        fputs("\033[0;0",fp);
-
-                gettimeofday (&tv_e, NULL);
 
                 if (stop_monitoring_loop)
                         break;
 
-                /**
-                 * Calculate microseconds to the nearest measurement interval
-                 */
-                usec_start = ((long)tv_s.tv_usec) + ((long)tv_s.tv_sec*1000000L);
-                usec_end = ((long)tv_e.tv_usec) + ((long)tv_e.tv_sec*1000000L);
-                usec_diff = usec_end - usec_start;
-
-                if (usec_diff < interval) {
-                        memset(&rem,0,sizeof(rem));
-                        memset(&req,0,sizeof(req));
-
-                        req.tv_sec = (interval - usec_diff) / 1000000L;
-                        req.tv_nsec = ((interval - usec_diff)%1000000L) * 1000L;
-                        if (nanosleep(&req,&rem)==-1) {
-                                /**
-                                 * nanosleep interrupted by a signal
-                                 */
-                                req = rem;
-                                memset(&rem,0,sizeof(rem));
-                                nanosleep(&req,&rem);
-                        }
-                }
-                
-                if(sel_time>=0) {
-                        gettimeofday (&tv_e, NULL);
-                        if ((tv_e.tv_sec - tv_start.tv_sec) > sel_time)
-                                break;
-                }
+                ret = tick_wait(&timer, &tick, &stop_monitoring_loop);
+                if (ret<0)
+                        printf("Sampling timer error!\n");
+                if (ret!=0)
+                        break;
 
+                if (sel_time>=0 &&
+                    (tick.sched_ns - timer.start_ns) >
+                    (uint64_t) sel_time * 1000000000ULL)
+                        break;
         }
 
+        if (istty)
+                screen_fini(&scr);
+        if (jitter) {
+                if (istext)
+                        fputc('\n',fp);
+                tick_report(istext ? fp : stderr, &timer);
+        }
+        if (groups!=NULL) {
+                stats_report(fp, istext, groups, num_stats, stats_file,
+                             (double) (tick.actual_ns - timer.start_ns) / 1e9);
+                signal(SIGUSR1,SIG_DFL);
+                free(groups);
+        }
+        if (iscsv || isjson) {
+                if (ob.stalls>0)
+                        printf("Output writer stalled sampling %llu time(s)\n",
+                               (unsigned long long) ob.stalls);
+                if (outbuf_fini(&ob)!=0)
+                        printf("Failed to write monitoring output!\n");
+        }
+        binfmt_writer_fini(&bin_writer);
+        tick_fini(&timer);
 }
 
 
@@ -1319,14 +2541,25 @@ static void print_help(void)
                "       %s [-f <config_file_name>]\n"
                "       %s [-m <event_type>:<list_of_cores>;...] "
                "[-t <time in sec>]\n"
-               "          [-i <interval in 100ms>] [-T]\n"
+               "          [-i <interval>] [-T] [--jitter]\n"
+               "          [--shm[=<name>[:<records>]]] [--stats[=<file>]]\n"
+               "          [--prom <unix:<path>|[localhost:]<port>>]\n"
                "          [-o <output_file>] [-u <output_type>] [-r]\n"
                "       %s [-e <allocation_type>:<class_num>=<class_definiton>;"
                "...]\n"
                "          [-c <allocation_type>:<profile_name>;...]\n"
                "          [-a <allocation_type>:<class_num>=<list_of_cores>;"
                "...]\n"
+               "          [--alloc-ways <allocation_type>:<class_num>="
+               "<num_ways>[:<flag>];...]\n"
                "       %s [-s]\n"
+               "       %s --controller[=<options>] [-a ...] [-t <time in sec>]"
+               " [-i <interval>]\n"
+               "       %s --sweep[=<options>] [-o <output_file>] "
+               "-- <command> [<args>]\n"
+               "       %s --corun=file=<workloads>[,<options>] "
+               "[-o <output_file>]\n"
+               "       %s --sim[=<spec>] ...\n"
                "Notes:\n"
                "\t-h\thelp\n"
                "\t-v\tverbose mode\n"
@@ -1338,20 +2571,57 @@ static void print_help(void)
                "see -H to list available profiles\n"
                "\t-a\tassociate cores with allocation classes, example: "
                "\"llc:0=0,2,4,6-10;llc:1=1\"\n"
+               "\t--alloc-ways\tallocate contiguous, non-overlapping ways "
+               "to classes,\n\t\tflags: isolate, noshared, noio, io, "
+               "overlap<class_num>, example:\n"
+               "\t\t\"llc:0=4,1=8:isolate,2=2:overlap1,3=2:io\"\n"
                "\t-r\tuses all RMID's and cores in the system\n"
                "\t-s\tshow current cache allocation configuration\n"
                "\t-m\tselect cores and events for monitoring, example: "
-               "\"llc:0,2,4-10\"\n"
+               "\"llc:0,2,4-10\",\n\t\t\"ipc:\" and \"llcmiss:\" add "
+               "instructions per cycle and LLC\n\t\tmisses per 1000 "
+               "instructions, example: \"llc:0-7;ipc:0-7;llcmiss:0-3\"\n"
+               "\t\t\"freq:\" adds effective frequency (APERF/MPERF) and "
+               "\"power:\" RAPL\n\t\tpackage and DRAM power of the core "
+               "socket, example: \"llc:0-7;freq:0-7;power:0\"\n"
                "\t-o\tselect output file to store monitored data in. "
                "stdout by default.\n"
                "\t-u\tselect output format type for monitored data. "
-               "\"text\" (defualt) and \"xml\" are the options.\n"
+               "\"text\" (defualt), \"xml\", \"csv\", \"json\" "
+               "(JSON lines) and \"bin\" are the options.\n"
                "\t-i\tdefine monitoring sampling interval, 1=100ms, "
-               "default 10=10x100ms=1s\n"
+               "default 10=10x100ms=1s,\n\t\t\"s\", \"ms\" and \"us\" "
+               "suffixes select other units, example: \"500us\"\n"
+               "\t--jitter\tadd scheduled and actual sample times to the "
+               "output and\n\t\treport sampling jitter at the end\n"
+               "\t--shm\tpublish samples into shared memory ring for "
+               "reader processes,\n\t\tdefault \"/pqos:65536\"\n"
+               "\t--stats\tkeep min, max, mean, stddev and p50/p90/p99 "
+               "of every group,\n\t\treport them on exit and on SIGUSR1, "
+               "optionally also as JSON\n\t\tinto selected file\n"
+               "\t--prom\tserve latest sample in Prometheus text format "
+               "on a unix socket\n\t\tor loopback TCP port, example: "
+               "\"9100\", \"unix:/run/pqos.sock\"\n"
                "\t-T\ttop like monitoring output\n"
                "\t-t\tdefine monitoring time (use 'inf' or 'infinite' for "
-               "inifinite loop monitoring loop)\n",
-               m_cmd_name, m_cmd_name, m_cmd_name, m_cmd_name, m_cmd_name);
+               "inifinite loop monitoring loop)\n"
+               "\t--controller\tresize allocation classes of cores associated "
+               "with -a\n\t\tfollowing LLC occupancy and IPC, options "
+               "example: \"min=2,min=1:4,\n\t\thysteresis=0.25,hold=3,"
+               "period=5,step=1,saturation=0.9,ipc=0.01\"\n"
+               "\t--sim\trun on simulated platform instead of hardware, "
+               "example:\n\t\t\"sockets=1;cores=8;ways=20;cos=4;"
+               "load=0-3:20000;load=4-7:2000@10\"\n"
+               "\t--sweep\trun command with 1 to all cache ways and record "
+               "runtime, LLC occupancy\n\t\tand, where core performance "
+               "counters are available, IPC and\n\t\tLLC MPKI as CSV, "
+               "options example: \"core=2,cos=3,min=1,max=20,repeat=3\"\n"
+               "\t--corun\trun workloads alone and pairwise from a "
+               "synchronized start and\n\t\twrite victim slowdown and "
+               "LLC occupancy per aggressor,\n\t\toptions example: "
+               "\"file=workloads.txt,repeat=3,all=1\"\n",
+               m_cmd_name, m_cmd_name, m_cmd_name, m_cmd_name, m_cmd_name,
+               m_cmd_name, m_cmd_name, m_cmd_name, m_cmd_name);
 }
 
 int main(int argc, char **argv)
@@ -1363,6 +2633,24 @@ int main(int argc, char **argv)
         unsigned sock_count, sockets[PQOS_MAX_SOCKETS];
         int cmd, ret, exit_val = EXIT_SUCCESS;
         FILE *fp_monitor = NULL;
+        struct ctrl_config ctrl_cfg;
+        struct sweep_config sweep_cfg;
+        struct corun_config corun_cfg;
+        struct shmring shm_ring;
+        struct metrics prom;
+        static const struct option long_opts[] = {
+                { "controller", optional_argument, NULL, 'C' },
+                { "sim",        optional_argument, NULL, 'S' },
+                { "sweep",      optional_argument, NULL, 'W' },
+                { "corun",      required_argument, NULL, 'R' },
+                { "alloc-ways", required_argument, NULL, 'A' },
+                { "jitter",     no_argument,       NULL, 'J' },
+                { "shm",        optional_argument, NULL, 'M' },
+                { "stats",      optional_argument, NULL, 'Q' },
+                { "prom",       required_argument, NULL, 'P' },
+                { "help",       no_argument,       NULL, 'h' },
+                { NULL, 0, NULL, 0 }
+        };
 
 	// Added code to store pid in a file which can be read by other process	
 	FILE *fp_pid = NULL;
@@ -1372,7 +2660,8 @@ int main(int argc, char **argv)
 
         m_cmd_name = argv[0];
 
-        while ((cmd = getopt(argc, argv, "Hhf:i:m:Tt:l:o:u:e:c:a:srv")) != -1) {
+        while ((cmd = getopt_long(argc, argv, "Hhf:i:m:Tt:l:o:u:e:c:a:srv",
+                                  long_opts, NULL)) != -1) {
                 switch (cmd) {
                 case 'h':
                         print_help();
@@ -1392,6 +2681,18 @@ int main(int argc, char **argv)
                 case 'i':
                         selfn_monitor_interval(optarg);
                         break;
+                case 'J':
+                        selfn_monitor_jitter(NULL);
+                        break;
+                case 'M':
+                        selfn_shm(optarg);
+                        break;
+                case 'Q':
+                        selfn_stats(optarg);
+                        break;
+                case 'P':
+                        selfn_prom(optarg);
+                        break;
                 case 'm':
                         selfn_monitor_events(optarg);
                         break;
@@ -1428,6 +2729,21 @@ int main(int argc, char **argv)
                 case 'v':
                         selfn_verbose_mode(NULL);
                         break;
+                case 'C':
+                        selfn_controller(optarg);
+                        break;
+                case 'S':
+                        selfn_sim(optarg);
+                        break;
+                case 'W':
+                        selfn_sweep(optarg);
+                        break;
+                case 'R':
+                        selfn_corun(optarg);
+                        break;
+                case 'A':
+                        selfn_allocation_ways(optarg);
+                        break;
                 default:
                         printf("Unsupported option: %c\n", optopt);
                 case '?':
@@ -1440,6 +2756,46 @@ int main(int argc, char **argv)
         cfg.verbose = sel_verbose_mode;
         cfg.free_in_use_rmid = sel_free_in_use_rmid;
 
+        ctrl_config_default(&ctrl_cfg);
+        if (sel_controller &&
+            ctrl_config_parse(&ctrl_cfg, sel_controller_opts)!=PQOS_RETVAL_OK) {
+                printf("Invalid controller options '%s'!\n",
+                       sel_controller_opts);
+                exit_val = EXIT_FAILURE;
+                goto error_exit_1;
+        }
+
+        sweep_config_default(&sweep_cfg);
+        if (sel_sweep) {
+                if (sweep_config_parse(&sweep_cfg,
+                                       sel_sweep_opts)!=PQOS_RETVAL_OK) {
+                        printf("Invalid sweep options '%s'!\n",
+                               sel_sweep_opts);
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_1;
+                }
+                if (optind>=argc) {
+                        printf("Sweep requires a command to run!\n");
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_1;
+                }
+        }
+
+        corun_config_default(&corun_cfg);
+        if (sel_corun &&
+            corun_config_parse(&corun_cfg, sel_corun_opts)!=PQOS_RETVAL_OK) {
+                printf("Invalid co-run options '%s'!\n", sel_corun_opts);
+                exit_val = EXIT_FAILURE;
+                goto error_exit_1;
+        }
+
+        if (sel_sim && sim_init(sel_sim_spec, &cfg)!=PQOS_RETVAL_OK) {
+                printf("Invalid simulated platform specification '%s'!\n",
+                       sel_sim_spec);
+                exit_val = EXIT_FAILURE;
+                goto error_exit_1;
+        }
+
         /**
          * Check output file type
          */
@@ -1453,7 +2809,10 @@ int main(int argc, char **argv)
         }
 
         if (strcasecmp(sel_output_type,"text")!=0 &&
-            strcasecmp(sel_output_type,"xml")!=0) {
+            strcasecmp(sel_output_type,"xml")!=0 &&
+            strcasecmp(sel_output_type,"csv")!=0 &&
+            strcasecmp(sel_output_type,"json")!=0 &&
+            strcasecmp(sel_output_type,"bin")!=0) {
                 printf("Invalid selection of file output type'%s'!\n",
                        sel_output_type);
                 exit_val = EXIT_FAILURE;
@@ -1533,32 +2892,21 @@ int main(int argc, char **argv)
                 /**
                  * Allocation profile selected
                  */
-                unsigned cnum = 0;
-                const char **cptr = NULL;
+                unsigned cnum = 0, i = 0;
+                struct pqos_l3ca ptab[PQOS_MAX_L3CA_COS];
+
                 if (cap_l3ca!=NULL &&
 		    profile_l3ca_get( sel_allocation_profile,
-                                      cap_l3ca->u.l3ca,
-                                      &cnum, &cptr ) == PQOS_RETVAL_OK ) {
+                                      cap_l3ca->u.l3ca, DIM(ptab),
+                                      &cnum, ptab ) == PQOS_RETVAL_OK ) {
                         /**
-                         * All profile classes are defined as strings
-                         * in format that is friendly with command line
-                         * options.
-                         * This effectively simulates series of -e command
-                         * line options. "llc:" is glued to each of the strings
-                         * so that profile class definitions don't have to
-                         * include it.
+                         * Profile classes are added as if they were
+                         * selected with -e command line option
                          */
-                        char cb[64];
-                        unsigned i=0, offset=0;
-
-                        memset(cb,0,sizeof(cb));
-                        strcpy(cb,"llc:");
-                        offset = (unsigned) strlen("llc:");
-
-                        for (i=0;i<cnum;i++) {
-                                strncpy(cb+offset,cptr[i],sizeof(cb)-1-offset); 
-                                selfn_allocation_class(cb);
-                        }
+                        for (i=0;i<cnum;i++)
+                                select_allocation_cos(sel_allocation_profile,
+                                                      ptab[i].class_id,
+                                                      ptab[i].ways_mask);
                 } else {
                         printf("Allocation profile '%s' not found or cache allocaton not supported!\n",
                                sel_allocation_profile);
@@ -1581,26 +2929,36 @@ int main(int argc, char **argv)
                  * For monitoring, start the program again unless
                  * config file was provided
                  */
-                int ret_assoc = 0, ret_cos = 0;
+                int ret_assoc = 0, ret_cos = 0, ret_ways = 0;
 
-                ret_cos = set_allocation_class(sock_count, sockets);
+                ret_cos = set_allocation_class(cap_l3ca->u.l3ca,
+                                               sock_count, sockets);
                 if (ret_cos<0) {
                         printf("Allocation configuration error!\n");
                         goto error_exit_2;
                 }
 
+                ret_ways = set_allocation_ways(sock_count, sockets);
+                if (ret_ways<0) {
+                        printf("Way allocation error!\n");
+                        goto error_exit_2;
+                }
+
                 ret_assoc = set_allocation_assoc();
                 if (ret_assoc<0) {
                         printf("CAT association error!\n");
                         goto error_exit_2;
                 }
 
-                if ((ret_assoc>0 || ret_cos>0) && sel_config_file==NULL) {
+                if ((ret_assoc>0 || ret_cos>0 || ret_ways>0) &&
+                    sel_config_file==NULL &&
+                    !sel_controller && !sel_sweep && !sel_corun) {
                         printf("Allocation configuration altered.\n");
                         goto allocation_exit;
                 }
         } else {
                 if (sel_l3ca_assoc_num>0 || sel_l3ca_cos_num>0 ||
+                    sel_l3ca_req_num>0 ||
                     sel_config_file!=NULL || sel_allocation_profile!=NULL) {
                         printf("Allocation capability not detected!\n");
                         exit_val = EXIT_FAILURE;
@@ -1608,6 +2966,62 @@ int main(int argc, char **argv)
                 }
         }
 
+        if (sel_sweep) {
+                if (cap_l3ca==NULL) {
+                        printf("Allocation capability not detected!\n");
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_2;
+                }
+                if (signal(SIGINT,monitoring_ctrlc)==SIG_ERR)
+                        printf("Failed to catch CTRL-C SIGINT!\n");
+                ret = sweep_run(fp_monitor, p_cap, p_cpu, &sweep_cfg,
+                                &argv[optind], &stop_monitoring_loop);
+                if (ret!=PQOS_RETVAL_OK) {
+                        printf("Sweep error!\n");
+                        exit_val = EXIT_FAILURE;
+                }
+                goto allocation_exit;
+        }
+
+        if (sel_corun) {
+                if (cap_l3ca==NULL) {
+                        printf("Allocation capability not detected!\n");
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_2;
+                }
+                if (signal(SIGINT,monitoring_ctrlc)==SIG_ERR)
+                        printf("Failed to catch CTRL-C SIGINT!\n");
+                ret = corun_run(fp_monitor, p_cap, p_cpu, &corun_cfg,
+                                &stop_monitoring_loop);
+                if (ret!=PQOS_RETVAL_OK) {
+                        printf("Co-run error!\n");
+                        exit_val = EXIT_FAILURE;
+                }
+                goto allocation_exit;
+        }
+
+        if (sel_controller) {
+                /**
+                 * Controller takes over monitoring and allocation
+                 */
+                if (cap_mon==NULL || cap_l3ca==NULL) {
+                        printf("Controller requires monitoring and "
+                               "allocation capabilities!\n");
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_2;
+                }
+                if (signal(SIGINT,monitoring_ctrlc)==SIG_ERR)
+                        printf("Failed to catch CTRL-C SIGINT!\n");
+                ret = ctrl_run(fp_monitor, p_cap, p_cpu, &ctrl_cfg,
+                               sel_mon_interval,
+                               sel_timeout, &stop_monitoring_loop);
+                if (ret!=PQOS_RETVAL_OK) {
+                        printf("Controller error!\n");
+                        exit_val = EXIT_FAILURE;
+                }
+                goto allocation_exit;
+        }
+
         /**
          * Just monitoring option left on the table now
          */
@@ -1617,11 +3031,55 @@ int main(int argc, char **argv)
                 goto error_exit_2;
         }
 
-        if (setup_monitoring(p_cpu)!=0)
+        if (setup_monitoring(p_cap, p_cpu)!=0) {
+                exit_val = EXIT_FAILURE;
+                goto error_exit_2;
+        }
+
+        if (sel_shm) {
+                const char *name = SHMRING_DEF_NAME;
+                uint64_t capacity = SHMRING_DEF_SIZE;
+                char *p = NULL;
+
+                if (sel_shm_spec!=NULL) {
+                        p = strchr(sel_shm_spec,':');
+                        if (p!=NULL) {
+                                *p++ = '\0';
+                                capacity = strtouint64(p);
+                        }
+                        if (sel_shm_spec[0]!='\0')
+                                name = sel_shm_spec;
+                }
+                if (shmring_create(name, capacity, &shm_ring)!=0) {
+                        printf("Failed to create shared memory ring '%s'!\n",
+                               name);
+                        stop_monitoring();
+                        exit_val = EXIT_FAILURE;
+                        goto error_exit_2;
+                }
+        }
+
+        if (sel_prom_spec!=NULL &&
+            metrics_start(&prom, sel_prom_spec)!=0) {
+                printf("Failed to start metrics endpoint '%s'!\n",
+                       sel_prom_spec);
+                if (sel_shm)
+                        shmring_destroy(&shm_ring);
+                stop_monitoring();
+                exit_val = EXIT_FAILURE;
                 goto error_exit_2;
+        }
 
         monitoring_loop( fp_monitor, sel_timeout, sel_mon_interval,
-                         sel_mon_top_like, p_cap, sel_output_type );
+                         sel_mon_top_like, sel_mon_jitter, p_cap, p_cpu,
+                         sel_output_type, sel_shm ? &shm_ring : NULL,
+                         sel_stats, sel_stats_file,
+                         sel_prom_spec!=NULL ? &prom : NULL );
+
+        if (sel_prom_spec!=NULL)
+                metrics_stop(&prom);
+        if (sel_shm)
+                shmring_destroy(&shm_ring);
 
         stop_monitoring();
 
@@ -1659,6 +3117,23 @@ int main(int argc, char **argv)
                 free(sel_log_file);
         if (sel_config_file!=NULL)
                 free(sel_config_file);
+        if (sel_controller_opts!=NULL)
+                free(sel_controller_opts);
+        if (sel_sim_spec!=NULL)
+                free(sel_sim_spec);
+        if (sel_shm_spec!=NULL)
+                free(sel_shm_spec);
+        if (sel_stats_file!=NULL)
+                free(sel_stats_file);
+        if (sel_prom_spec!=NULL)
+                free(sel_prom_spec);
+        if (sel_sweep_opts!=NULL)
+                free(sel_sweep_opts);
+        if (sel_corun_opts!=NULL)
+                free(sel_corun_opts);
+
+        if (sel_sim)
+                sim_fini();
 
         return exit_val;
 }
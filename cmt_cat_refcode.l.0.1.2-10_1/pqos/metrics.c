@@ -0,0 +1,502 @@
+/**
+ * @file metrics.c
+ * @brief Prometheus metrics endpoint
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "metrics.h"
+
+#define METRICS_REQ_SIZE    4096                /**< max request size read */
+#define METRICS_TIMEOUT_MS  1000                /**< client I/O timeout */
+
+/**
+ * Metric families, one per monitoring event
+ */
+static const struct {
+        enum pqos_mon_event event;
+        const char *name;
+        const char *help;
+} metrics_events[] = {
+        { PQOS_MON_EVENT_L3_OCCUP, "pqos_llc_occupancy_bytes",
+          "LLC occupancy of the monitoring group" },
+        { PQOS_PERF_EVENT_IPC, "pqos_ipc",
+          "Instructions retired per core cycle of the monitoring group" },
+        { PQOS_PERF_EVENT_LLC_MISS, "pqos_llc_misses_per_kilo_instructions",
+          "LLC misses per 1000 instructions of the monitoring group" },
+        { PQOS_PERF_EVENT_FREQ, "pqos_core_frequency_mhz",
+          "Effective frequency of unhalted cores of the monitoring group" },
+        { PQOS_PWR_EVENT_PKG_ENERGY, "pqos_package_power_watts",
+          "RAPL package power of the monitoring group socket" },
+        { PQOS_PWR_EVENT_DRAM_ENERGY, "pqos_dram_power_watts",
+          "RAPL DRAM power of the monitoring group socket" },
+};
+
+/**
+ * @brief Appends formatted text to snapshot buffer
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 out of memory
+ */
+static int
+metrics_append(struct metrics_buf *b, const char *fmt, ...)
+{
+        va_list ap;
+        int n;
+
+        for (;;) {
+                va_start(ap, fmt);
+                n = vsnprintf(b->data + b->len, b->cap - b->len, fmt, ap);
+                va_end(ap);
+                if (n<0)
+                        return -1;
+                if ((size_t) n < b->cap - b->len)
+                        break;
+                {
+                        const size_t cap = (b->cap * 2) + (size_t) n;
+                        char *p = realloc(b->data, cap);
+
+                        if (p==NULL)
+                                return -1;
+                        b->data = p;
+                        b->cap = cap;
+                }
+        }
+        b->len += (size_t) n;
+        return 0;
+}
+
+/**
+ * @brief Writes whole buffer to client
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error or timeout
+ */
+static int
+metrics_send(const int fd, const char *p, size_t len)
+{
+        while (len>0) {
+                const ssize_t n = send(fd, p, len, MSG_NOSIGNAL);
+
+                if (n<0 && errno==EINTR)
+                        continue;
+                if (n<=0)
+                        return -1;
+                p += n;
+                len -= (size_t) n;
+        }
+        return 0;
+}
+
+/**
+ * @brief Reads request head and returns HTTP status to answer with
+ */
+static int
+metrics_read_request(const int fd)
+{
+        char req[METRICS_REQ_SIZE];
+        size_t len = 0;
+
+        while (len<sizeof(req)-1) {
+                struct pollfd pfd;
+                ssize_t n;
+
+                pfd.fd = fd;
+                pfd.events = POLLIN;
+                pfd.revents = 0;
+                if (poll(&pfd, 1, METRICS_TIMEOUT_MS)<=0)
+                        return -1;
+                n = recv(fd, req + len, sizeof(req) - 1 - len, 0);
+                if (n<=0)
+                        return -1;
+                len += (size_t) n;
+                req[len] = '\0';
+                if (strstr(req, "\r\n\r\n")!=NULL ||
+                    strstr(req, "\n\n")!=NULL)
+                        break;
+        }
+        req[len] = '\0';
+
+        if (strncmp(req, "GET ", 4)!=0)
+                return 405;
+        if (strncmp(req + 4, "/metrics", 8)==0 &&
+            (req[12]==' ' || req[12]=='?' || req[12]=='\r' || req[12]=='\n'))
+                return 200;
+        if (strncmp(req + 4, "/ ", 2)==0)
+                return 200;
+        return 404;
+}
+
+/**
+ * @brief Answers single request with the current snapshot
+ */
+static void
+metrics_serve(struct metrics *m, const int fd)
+{
+        struct metrics_buf *b = NULL;
+        struct timeval tv;
+        char hdr[256], trailer[256];
+        int status, hdr_len, trailer_len = 0;
+
+        tv.tv_sec = METRICS_TIMEOUT_MS / 1000;
+        tv.tv_usec = (METRICS_TIMEOUT_MS % 1000) * 1000;
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        status = metrics_read_request(fd);
+        if (status<0)
+                return;
+
+        pthread_mutex_lock(&m->lock);
+        if (status==200 && m->cur>=0) {
+                b = &m->bufs[m->cur];
+                b->refs++;
+                m->scrapes++;
+                trailer_len = snprintf(trailer, sizeof(trailer),
+                                       "# HELP pqos_scrapes_total Metrics "
+                                       "requests served\n"
+                                       "# TYPE pqos_scrapes_total counter\n"
+                                       "pqos_scrapes_total %llu\n"
+                                       "# HELP pqos_samples_skipped_total "
+                                       "Samples not published\n"
+                                       "# TYPE pqos_samples_skipped_total "
+                                       "counter\n"
+                                       "pqos_samples_skipped_total %llu\n",
+                                       (unsigned long long) m->scrapes,
+                                       (unsigned long long) m->skipped);
+                if (trailer_len<0 || trailer_len>=(int) sizeof(trailer))
+                        trailer_len = 0;
+        }
+        pthread_mutex_unlock(&m->lock);
+
+        if (status==200 && b==NULL)
+                status = 503;                   /**< no sample yet */
+
+        if (status==200)
+                hdr_len = snprintf(hdr, sizeof(hdr),
+                                   "HTTP/1.0 200 OK\r\n"
+                                   "Content-Type: text/plain; version=0.0.4\r\n"
+                                   "Content-Length: %zu\r\n"
+                                   "Connection: close\r\n\r\n",
+                                   b->len + (size_t) trailer_len);
+        else
+                hdr_len = snprintf(hdr, sizeof(hdr),
+                                   "HTTP/1.0 %d %s\r\n"
+                                   "Content-Length: 0\r\n"
+                                   "Connection: close\r\n\r\n", status,
+                                   status==404 ? "Not Found" :
+                                   status==405 ? "Method Not Allowed" :
+                                   "Service Unavailable");
+
+        if (metrics_send(fd, hdr, (size_t) hdr_len)==0 && b!=NULL &&
+            metrics_send(fd, b->data, b->len)==0)
+                metrics_send(fd, trailer, (size_t) trailer_len);
+
+        if (b!=NULL) {
+                pthread_mutex_lock(&m->lock);
+                b->refs--;
+                pthread_mutex_unlock(&m->lock);
+        }
+}
+
+/**
+ * @brief Server thread, accepts and serves one connection at a time
+ */
+static void *
+metrics_thread(void *arg)
+{
+        struct metrics *m = (struct metrics *) arg;
+
+        for (;;) {
+                struct pollfd pfd[2];
+                int fd;
+
+                pfd[0].fd = m->fd;
+                pfd[0].events = POLLIN;
+                pfd[0].revents = 0;
+                pfd[1].fd = m->wake[0];
+                pfd[1].events = POLLIN;
+                pfd[1].revents = 0;
+                if (poll(pfd, 2, -1)<0) {
+                        if (errno==EINTR)
+                                continue;
+                        break;
+                }
+                if (pfd[1].revents)
+                        break;
+                if (!(pfd[0].revents & POLLIN))
+                        continue;
+
+                fd = accept(m->fd, NULL, NULL);
+                if (fd<0)
+                        continue;
+                metrics_serve(m, fd);
+                close(fd);
+        }
+        return NULL;
+}
+
+/**
+ * @brief Opens listening socket according to \a spec
+ *
+ * @return Socket or -1 on error
+ */
+static int
+metrics_listen(struct metrics *m, const char *spec)
+{
+        const char *port = spec;
+        int fd = -1, one = 1;
+
+        if (strncmp(spec, "unix:", 5)==0) {
+                struct sockaddr_un sa;
+                struct stat st;
+                int probe, ret;
+
+                if (strlen(spec + 5)==0 ||
+                    strlen(spec + 5)>=sizeof(sa.sun_path))
+                        return -1;
+                memset(&sa, 0, sizeof(sa));
+                sa.sun_family = AF_UNIX;
+                strncpy(sa.sun_path, spec + 5, sizeof(sa.sun_path) - 1);
+
+                /**
+                 * Only a stale socket is removed, a path another
+                 * endpoint answers on or that is not a socket fails
+                 * the bind below
+                 */
+                probe = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (probe<0)
+                        return -1;
+                ret = connect(probe, (struct sockaddr *) &sa, sizeof(sa));
+                if (ret!=0 && errno==ECONNREFUSED &&
+                    lstat(sa.sun_path, &st)==0 && S_ISSOCK(st.st_mode))
+                        unlink(sa.sun_path);
+                close(probe);
+                if (ret==0)
+                        return -1;
+
+                fd = socket(AF_UNIX, SOCK_STREAM, 0);
+                if (fd<0)
+                        return -1;
+                if (bind(fd, (struct sockaddr *) &sa, sizeof(sa))!=0 ||
+                    listen(fd, 16)!=0) {
+                        close(fd);
+                        return -1;
+                }
+                memcpy(m->path, sa.sun_path, sizeof(m->path));
+                return fd;
+        }
+
+        /**
+         * TCP endpoint is bound to loopback only
+         */
+        if (strchr(spec, ':')!=NULL) {
+                const size_t hlen = (size_t) (strchr(spec, ':') - spec);
+
+                if (!((hlen==9 && strncasecmp(spec, "localhost", 9)==0) ||
+                      (hlen==9 && strncmp(spec, "127.0.0.1", 9)==0)))
+                        return -1;
+                port = spec + hlen + 1;
+        }
+        {
+                struct sockaddr_in sa;
+                char *end = NULL;
+                const unsigned long p = strtoul(port, &end, 10);
+
+                if (end==port || *end!='\0' || p==0 || p>65535)
+                        return -1;
+                memset(&sa, 0, sizeof(sa));
+                sa.sin_family = AF_INET;
+                sa.sin_port = htons((uint16_t) p);
+                sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+                fd = socket(AF_INET, SOCK_STREAM, 0);
+                if (fd<0)
+                        return -1;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+                if (bind(fd, (struct sockaddr *) &sa, sizeof(sa))!=0 ||
+                    listen(fd, 16)!=0) {
+                        close(fd);
+                        return -1;
+                }
+        }
+        return fd;
+}
+
+int
+metrics_start(struct metrics *m, const char *spec)
+{
+        if (m==NULL || spec==NULL)
+                return -1;
+
+        memset(m, 0, sizeof(*m));
+        m->cur = -1;
+        m->wake[0] = m->wake[1] = -1;
+
+        m->fd = metrics_listen(m, spec);
+        if (m->fd<0)
+                return -1;
+        if (pipe(m->wake)!=0) {
+                close(m->fd);
+                return -1;
+        }
+        pthread_mutex_init(&m->lock, NULL);
+        if (pthread_create(&m->thread, NULL, metrics_thread, m)!=0) {
+                pthread_mutex_destroy(&m->lock);
+                close(m->wake[0]);
+                close(m->wake[1]);
+                close(m->fd);
+                if (m->path[0]!='\0')
+                        unlink(m->path);
+                return -1;
+        }
+        return 0;
+}
+
+void
+metrics_publish(struct metrics *m, const struct pqos_mon_data *groups,
+                const unsigned num, const uint32_t scale_factor,
+                const struct timeval *tv)
+{
+        struct metrics_buf *b = NULL;
+        unsigned i, j, e;
+        int idx = -1, ret = 0;
+
+        /**
+         * Pick a buffer no scrape is sending
+         */
+        pthread_mutex_lock(&m->lock);
+        for (i=0;i<METRICS_NUM_BUFS;i++)
+                if ((int) i!=m->cur && m->bufs[i].refs==0) {
+                        idx = (int) i;
+                        break;
+                }
+        if (idx<0)
+                m->skipped++;
+        pthread_mutex_unlock(&m->lock);
+        if (idx<0)
+                return;
+
+        b = &m->bufs[idx];
+        b->len = 0;
+        if (b->cap==0) {
+                b->cap = 4096;
+                b->data = malloc(b->cap);
+                if (b->data==NULL) {
+                        b->cap = 0;
+                        return;
+                }
+        }
+
+        for (e=0;e<sizeof(metrics_events)/sizeof(metrics_events[0]);e++) {
+                int header = 0;
+
+                for (i=0;i<num && ret==0;i++) {
+                        const struct pqos_mon_data *g = &groups[i];
+
+                        if (!(g->event & metrics_events[e].event))
+                                continue;
+                        if (!header) {
+                                ret |= metrics_append(b, "# HELP %s %s\n"
+                                                      "# TYPE %s gauge\n",
+                                                      metrics_events[e].name,
+                                                      metrics_events[e].help,
+                                                      metrics_events[e].name);
+                                header = 1;
+                        }
+                        ret |= metrics_append(b, "%s{socket=\"%u\",rmid=\"%u\","
+                                              "core=\"%u\",cores=\"",
+                                              metrics_events[e].name,
+                                              g->socket, (unsigned) g->rmid,
+                                              g->num_cores>0 ?
+                                              g->cores[0] : 0);
+                        for (j=0;j<g->num_cores && ret==0;j++)
+                                ret |= metrics_append(b, "%s%u", j ? "," : "",
+                                                      g->cores[j]);
+                        switch (metrics_events[e].event) {
+                        case PQOS_PERF_EVENT_IPC:
+                                ret |= metrics_append(b, "\"} %.3f\n",
+                                                      g->ipc);
+                                break;
+                        case PQOS_PERF_EVENT_LLC_MISS:
+                                ret |= metrics_append(b, "\"} %.3f\n",
+                                                      g->instructions ?
+                                                      ((double) g->llc_misses *
+                                                       1000.0) /
+                                                      (double) g->instructions :
+                                                      0.0);
+                                break;
+                        case PQOS_PERF_EVENT_FREQ:
+                                ret |= metrics_append(b, "\"} %.0f\n",
+                                                      g->freq);
+                                break;
+                        case PQOS_PWR_EVENT_PKG_ENERGY:
+                                ret |= metrics_append(b, "\"} %.3f\n",
+                                                      g->pkg_power);
+                                break;
+                        case PQOS_PWR_EVENT_DRAM_ENERGY:
+                                ret |= metrics_append(b, "\"} %.3f\n",
+                                                      g->dram_power);
+                                break;
+                        default:
+                                ret |= metrics_append(b, "\"} %llu\n",
+                                                      (unsigned long long)
+                                                      (g->value *
+                                                       scale_factor));
+                                break;
+                        }
+                }
+        }
+        ret |= metrics_append(b, "# HELP pqos_sample_timestamp_seconds "
+                              "Time of the sample\n"
+                              "# TYPE pqos_sample_timestamp_seconds gauge\n"
+                              "pqos_sample_timestamp_seconds %ld.%06ld\n"
+                              "# HELP pqos_samples_total Samples published\n"
+                              "# TYPE pqos_samples_total counter\n"
+                              "pqos_samples_total %llu\n",
+                              (long) tv->tv_sec, (long) tv->tv_usec,
+                              (unsigned long long) (m->samples + 1));
+        if (ret!=0)
+                return;
+
+        pthread_mutex_lock(&m->lock);
+        m->cur = idx;
+        m->samples++;
+        pthread_mutex_unlock(&m->lock);
+}
+
+void
+metrics_stop(struct metrics *m)
+{
+        unsigned i;
+
+        if (m==NULL || m->fd<0)
+                return;
+
+        if (write(m->wake[1], "x", 1)!=1)
+                pthread_cancel(m->thread);
+        pthread_join(m->thread, NULL);
+        pthread_mutex_destroy(&m->lock);
+        close(m->wake[0]);
+        close(m->wake[1]);
+        close(m->fd);
+        m->fd = -1;
+        if (m->path[0]!='\0')
+                unlink(m->path);
+        for (i=0;i<METRICS_NUM_BUFS;i++) {
+                free(m->bufs[i].data);
+                m->bufs[i].data = NULL;
+        }
+}
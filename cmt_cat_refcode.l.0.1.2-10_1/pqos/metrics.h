@@ -0,0 +1,95 @@
+/**
+ * @file metrics.h
+ * @brief Prometheus metrics endpoint
+ *
+ * The monitoring loop renders every sample in Prometheus text
+ * exposition format into a snapshot buffer. A server thread accepts
+ * HTTP requests on a unix socket or loopback TCP port and sends the
+ * latest snapshot, so scrapes never read MSRs and never wait for
+ * the sampler. Snapshots are reference counted: a new one is rendered
+ * into a buffer no scrape is sending and then made current, a slow
+ * scrape keeps sending the buffer it started with.
+ */
+
+#ifndef __METRICS_H__
+#define __METRICS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "pqos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define METRICS_NUM_BUFS  3                     /**< snapshot buffers */
+#define METRICS_MAX_PATH  108                   /**< unix socket path size */
+
+/**
+ * Snapshot buffer
+ */
+struct metrics_buf {
+        char *data;
+        size_t len;
+        size_t cap;
+        unsigned refs;                          /**< scrapes sending it */
+};
+
+/**
+ * Metrics endpoint
+ */
+struct metrics {
+        int fd;                                 /**< listening socket */
+        int wake[2];                            /**< stop pipe of the thread */
+        char path[METRICS_MAX_PATH];            /**< unix socket path or "" */
+        pthread_t thread;
+        pthread_mutex_t lock;                   /**< protects buffers */
+        struct metrics_buf bufs[METRICS_NUM_BUFS];
+        int cur;                                /**< current snapshot, -1 none */
+        uint64_t samples;                       /**< snapshots published */
+        uint64_t skipped;                       /**< samples not published,
+                                                   all buffers busy */
+        uint64_t scrapes;                       /**< requests served */
+};
+
+/**
+ * @brief Starts the endpoint
+ *
+ * @param [out] m endpoint
+ * @param [in] spec "unix:<path>", "<port>" or "<host>:<port>"
+ *             where host is "localhost" or "127.0.0.1"
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int metrics_start(struct metrics *m, const char *spec);
+
+/**
+ * @brief Renders sample of monitoring groups as the current snapshot
+ *
+ * @param [in,out] m endpoint
+ * @param [in] groups monitoring groups
+ * @param [in] num number of groups
+ * @param [in] scale_factor LLC occupancy scale factor
+ * @param [in] tv sample time
+ */
+void metrics_publish(struct metrics *m, const struct pqos_mon_data *groups,
+                     const unsigned num, const uint32_t scale_factor,
+                     const struct timeval *tv);
+
+/**
+ * @brief Stops the endpoint and releases its resources
+ *
+ * @param [in,out] m endpoint
+ */
+void metrics_stop(struct metrics *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __METRICS_H__ */
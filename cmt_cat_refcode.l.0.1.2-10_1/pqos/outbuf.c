@@ -0,0 +1,390 @@
+/**
+ * @file outbuf.c
+ * @brief Buffered batch writer of monitoring output
+ *
+ * Chunks are used in a circle. Producer fills chunk head % num_chunks,
+ * chunks from tail to head are queued for the writer thread.
+ * The mutex is only taken when a chunk changes hands.
+ *
+ * Formatters convert numbers by hand, they avoid printf format
+ * parsing and locale handling on the sampling thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "outbuf.h"
+
+#define OUTBUF_MAX_NAME 32                      /**< max event name length */
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+outbuf_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Writer thread
+ *
+ * @param arg batch writer
+ *
+ * @return NULL
+ */
+static void *
+outbuf_thread(void *arg)
+{
+        struct outbuf *ob = (struct outbuf *) arg;
+
+        pthread_mutex_lock(&ob->lock);
+        for (;;) {
+                struct outbuf_chunk *c = NULL;
+                size_t done = 0;
+
+                while (ob->tail==ob->head && !ob->stop)
+                        pthread_cond_wait(&ob->cond, &ob->lock);
+                if (ob->tail==ob->head)
+                        break;
+
+                c = &ob->chunks[ob->tail % ob->num_chunks];
+                pthread_mutex_unlock(&ob->lock);
+
+                while (done<c->len) {
+                        const ssize_t n = write(ob->fd, c->data + done,
+                                                c->len - done);
+
+                        if (n<0 && errno==EINTR)
+                                continue;
+                        if (n<=0) {
+                                ob->error = (n<0) ? errno : EIO;
+                                break;
+                        }
+                        done += (size_t) n;
+                        ob->writes++;
+                }
+
+                pthread_mutex_lock(&ob->lock);
+                ob->bytes += done;
+                c->len = 0;
+                ob->tail++;
+                pthread_cond_broadcast(&ob->cond);
+        }
+        pthread_mutex_unlock(&ob->lock);
+        return NULL;
+}
+
+/**
+ * @brief Queues current chunk to the writer thread
+ *
+ * Waits for a free chunk if all of them are queued.
+ *
+ * @param [in,out] ob writer
+ */
+static void
+outbuf_submit(struct outbuf *ob)
+{
+        if (ob->chunks[ob->head % ob->num_chunks].len==0)
+                return;
+
+        pthread_mutex_lock(&ob->lock);
+        ob->head++;
+        pthread_cond_broadcast(&ob->cond);
+        if (ob->head - ob->tail >= ob->num_chunks) {
+                ob->stalls++;
+                while (ob->head - ob->tail >= ob->num_chunks)
+                        pthread_cond_wait(&ob->cond, &ob->lock);
+        }
+        pthread_mutex_unlock(&ob->lock);
+}
+
+int
+outbuf_init(struct outbuf *ob, const int fd, const size_t chunk_size,
+            const unsigned num_chunks)
+{
+        unsigned i;
+
+        if (ob==NULL || fd<0)
+                return -1;
+
+        memset(ob, 0, sizeof(*ob));
+        ob->fd = fd;
+        ob->chunk_size = chunk_size ? chunk_size : OUTBUF_CHUNK_SIZE;
+        ob->num_chunks = num_chunks ? num_chunks : OUTBUF_NUM_CHUNKS;
+        ob->flush_ns = OUTBUF_FLUSH_MS * 1000000ULL;
+        if (ob->num_chunks<2 || ob->chunk_size<OUTBUF_MAX_RECORD)
+                return -1;
+
+        ob->chunks = calloc(ob->num_chunks, sizeof(ob->chunks[0]));
+        if (ob->chunks==NULL)
+                return -1;
+        for (i=0;i<ob->num_chunks;i++) {
+                ob->chunks[i].data = malloc(ob->chunk_size);
+                if (ob->chunks[i].data==NULL)
+                        goto error;
+        }
+
+        pthread_mutex_init(&ob->lock, NULL);
+        pthread_cond_init(&ob->cond, NULL);
+        if (pthread_create(&ob->thread, NULL, outbuf_thread, ob)!=0) {
+                pthread_cond_destroy(&ob->cond);
+                pthread_mutex_destroy(&ob->lock);
+                goto error;
+        }
+        return 0;
+
+ error:
+        for (i=0;i<ob->num_chunks;i++)
+                free(ob->chunks[i].data);
+        free(ob->chunks);
+        ob->chunks = NULL;
+        return -1;
+}
+
+char *
+outbuf_reserve(struct outbuf *ob, const size_t len)
+{
+        struct outbuf_chunk *c = &ob->chunks[ob->head % ob->num_chunks];
+
+        if (c->len + len > ob->chunk_size) {
+                outbuf_submit(ob);
+                c = &ob->chunks[ob->head % ob->num_chunks];
+        }
+        if (c->len==0)
+                ob->first_ns = outbuf_now();
+        return c->data + c->len;
+}
+
+void
+outbuf_commit(struct outbuf *ob, const size_t len)
+{
+        ob->chunks[ob->head % ob->num_chunks].len += len;
+}
+
+void
+outbuf_end_sample(struct outbuf *ob)
+{
+        const struct outbuf_chunk *c = &ob->chunks[ob->head % ob->num_chunks];
+
+        if (c->len==0)
+                return;
+        if (c->len >= ob->chunk_size / 2 ||
+            outbuf_now() - ob->first_ns >= ob->flush_ns)
+                outbuf_submit(ob);
+}
+
+int
+outbuf_fini(struct outbuf *ob)
+{
+        unsigned i;
+
+        if (ob==NULL || ob->chunks==NULL)
+                return -1;
+
+        outbuf_submit(ob);
+        pthread_mutex_lock(&ob->lock);
+        ob->stop = 1;
+        pthread_cond_broadcast(&ob->cond);
+        pthread_mutex_unlock(&ob->lock);
+        pthread_join(ob->thread, NULL);
+
+        pthread_cond_destroy(&ob->cond);
+        pthread_mutex_destroy(&ob->lock);
+        for (i=0;i<ob->num_chunks;i++)
+                free(ob->chunks[i].data);
+        free(ob->chunks);
+        ob->chunks = NULL;
+        return (ob->error!=0) ? -1 : 0;
+}
+
+/**
+ * @brief Writes decimal representation of \a v
+ *
+ * @return Number of characters written
+ */
+static size_t
+fmt_u64(char *p, uint64_t v)
+{
+        char tmp[20];
+        size_t n = 0, i;
+
+        do {
+                tmp[n++] = (char) ('0' + (v % 10));
+                v /= 10;
+        } while (v!=0);
+        for (i=0;i<n;i++)
+                p[i] = tmp[n - 1 - i];
+        return n;
+}
+
+/**
+ * @brief Writes \a v with exactly \a digits digits, zero padded
+ */
+static size_t
+fmt_u64_pad(char *p, uint64_t v, const size_t digits)
+{
+        size_t i;
+
+        for (i=digits;i>0;i--) {
+                p[i-1] = (char) ('0' + (v % 10));
+                v /= 10;
+        }
+        return digits;
+}
+
+/**
+ * @brief Writes string, at most OUTBUF_MAX_NAME characters
+ */
+static size_t
+fmt_str(char *p, const char *s)
+{
+        size_t n = 0;
+
+        while (s[n]!='\0' && n<OUTBUF_MAX_NAME) {
+                p[n] = s[n];
+                n++;
+        }
+        return n;
+}
+
+/**
+ * @brief Writes time in seconds with microsecond fraction
+ */
+static size_t
+fmt_time(char *p, const uint64_t time_us)
+{
+        size_t n = fmt_u64(p, time_us / 1000000ULL);
+
+        p[n++] = '.';
+        return n + fmt_u64_pad(&p[n], time_us % 1000000ULL, 6);
+}
+
+/**
+ * @brief Writes \a bytes in kilobytes rounded to one decimal place
+ */
+static size_t
+fmt_kb(char *p, const uint64_t bytes)
+{
+        const uint64_t tenths = (bytes * 10 + 512) / 1024;
+        size_t n = fmt_u64(p, tenths / 10);
+
+        p[n++] = '.';
+        p[n++] = (char) ('0' + (tenths % 10));
+        return n;
+}
+
+/**
+ * @brief Writes \a v rounded to two decimal places
+ */
+static size_t
+fmt_fixed2(char *p, const double v)
+{
+        const uint64_t hundredths = (v>0.0) ? (uint64_t) (v * 100.0 + 0.5) : 0;
+        size_t n = fmt_u64(p, hundredths / 100);
+
+        p[n++] = '.';
+        return n + fmt_u64_pad(&p[n], hundredths % 100, 2);
+}
+
+#define PUT_LIT(p, n, lit) do {                         \
+                memcpy(&(p)[n], lit, sizeof(lit) - 1);  \
+                (n) += sizeof(lit) - 1;                 \
+        } while (0)
+
+size_t
+outbuf_fmt_csv(char *p, const uint64_t time_us,
+               const unsigned socket, const unsigned core,
+               const unsigned rmid, const char *event,
+               const uint64_t bytes,
+               const struct outbuf_perf *perf)
+{
+        size_t n = fmt_time(p, time_us);
+
+        p[n++] = ',';
+        n += fmt_u64(&p[n], socket);
+        p[n++] = ',';
+        n += fmt_u64(&p[n], core);
+        p[n++] = ',';
+        n += fmt_u64(&p[n], rmid);
+        p[n++] = ',';
+        n += fmt_str(&p[n], event);
+        p[n++] = ',';
+        n += fmt_kb(&p[n], bytes);
+        if (perf!=NULL) {
+                p[n++] = ',';
+                if (perf->has_ipc)
+                        n += fmt_fixed2(&p[n], perf->ipc);
+                p[n++] = ',';
+                if (perf->has_mpki)
+                        n += fmt_u64(&p[n], perf->llc_misses);
+                p[n++] = ',';
+                if (perf->has_mpki)
+                        n += fmt_fixed2(&p[n], perf->mpki);
+                p[n++] = ',';
+                if (perf->has_freq)
+                        n += fmt_u64(&p[n], (uint64_t) (perf->freq + 0.5));
+                p[n++] = ',';
+                if (perf->has_pkg)
+                        n += fmt_fixed2(&p[n], perf->pkg_power);
+                p[n++] = ',';
+                if (perf->has_dram)
+                        n += fmt_fixed2(&p[n], perf->dram_power);
+        }
+        p[n++] = '\n';
+        return n;
+}
+
+size_t
+outbuf_fmt_json(char *p, const uint64_t time_us,
+                const unsigned socket, const unsigned core,
+                const unsigned rmid, const char *event,
+                const uint64_t bytes,
+                const struct outbuf_perf *perf)
+{
+        size_t n = 0;
+
+        PUT_LIT(p, n, "{\"time\":");
+        n += fmt_time(&p[n], time_us);
+        PUT_LIT(p, n, ",\"socket\":");
+        n += fmt_u64(&p[n], socket);
+        PUT_LIT(p, n, ",\"core\":");
+        n += fmt_u64(&p[n], core);
+        PUT_LIT(p, n, ",\"rmid\":");
+        n += fmt_u64(&p[n], rmid);
+        PUT_LIT(p, n, ",\"event\":\"");
+        n += fmt_str(&p[n], event);
+        PUT_LIT(p, n, "\",\"value_kb\":");
+        n += fmt_kb(&p[n], bytes);
+        if (perf!=NULL && perf->has_ipc) {
+                PUT_LIT(p, n, ",\"ipc\":");
+                n += fmt_fixed2(&p[n], perf->ipc);
+        }
+        if (perf!=NULL && perf->has_mpki) {
+                PUT_LIT(p, n, ",\"llc_misses\":");
+                n += fmt_u64(&p[n], perf->llc_misses);
+                PUT_LIT(p, n, ",\"mpki\":");
+                n += fmt_fixed2(&p[n], perf->mpki);
+        }
+        if (perf!=NULL && perf->has_freq) {
+                PUT_LIT(p, n, ",\"freq_mhz\":");
+                n += fmt_u64(&p[n], (uint64_t) (perf->freq + 0.5));
+        }
+        if (perf!=NULL && perf->has_pkg) {
+                PUT_LIT(p, n, ",\"pkg_watts\":");
+                n += fmt_fixed2(&p[n], perf->pkg_power);
+        }
+        if (perf!=NULL && perf->has_dram) {
+                PUT_LIT(p, n, ",\"dram_watts\":");
+                n += fmt_fixed2(&p[n], perf->dram_power);
+        }
+        PUT_LIT(p, n, "}\n");
+        return n;
+}
@@ -0,0 +1,169 @@
+/**
+ * @file outbuf.h
+ * @brief Buffered batch writer of monitoring output
+ *
+ * Records are formatted straight into preallocated chunks. Filled
+ * chunks are queued to a writer thread that flushes them with large
+ * write() calls, so the sampling thread does not wait for the disk.
+ * The sampling thread only waits when all chunks are queued, such
+ * waits are counted as stalls.
+ */
+
+#ifndef __OUTBUF_H__
+#define __OUTBUF_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OUTBUF_CHUNK_SIZE  (1024 * 1024)        /**< default chunk size */
+#define OUTBUF_NUM_CHUNKS  8                    /**< default number of chunks */
+#define OUTBUF_FLUSH_MS    1000                 /**< max age of buffered data */
+#define OUTBUF_MAX_RECORD  384                  /**< max size of a formatted record */
+
+/**
+ * Core performance counter, frequency and power columns of a record
+ */
+struct outbuf_perf {
+        int has_ipc;                            /**< ipc is valid */
+        int has_mpki;                           /**< llc_misses and mpki are valid */
+        int has_freq;                           /**< freq is valid */
+        int has_pkg;                            /**< pkg_power is valid */
+        int has_dram;                           /**< dram_power is valid */
+        double ipc;                             /**< instructions per cycle */
+        uint64_t llc_misses;                    /**< LLC misses in the interval */
+        double mpki;                            /**< LLC misses per 1000 instructions */
+        double freq;                            /**< effective frequency in MHz */
+        double pkg_power;                       /**< package power in Joules/s */
+        double dram_power;                      /**< DRAM power in Joules/s */
+};
+
+/**
+ * Output chunk
+ */
+struct outbuf_chunk {
+        char *data;
+        size_t len;
+};
+
+/**
+ * Batch writer
+ */
+struct outbuf {
+        int fd;                                 /**< output file descriptor */
+        size_t chunk_size;
+        unsigned num_chunks;
+        struct outbuf_chunk *chunks;
+        uint64_t head;                          /**< chunks submitted, current one
+                                                   is head % num_chunks */
+        uint64_t tail;                          /**< chunks written */
+        uint64_t first_ns;                      /**< time of first record in
+                                                   current chunk */
+        uint64_t flush_ns;                      /**< max age of buffered data */
+        pthread_t thread;
+        pthread_mutex_t lock;
+        pthread_cond_t cond;
+        int stop;
+        int error;                              /**< errno of failed write */
+        uint64_t bytes;                         /**< bytes written */
+        uint64_t writes;                        /**< write() calls */
+        uint64_t stalls;                        /**< waits for a free chunk */
+};
+
+/**
+ * @brief Starts batch writer
+ *
+ * @param [out] ob writer
+ * @param [in] fd output file descriptor
+ * @param [in] chunk_size chunk size, 0 for default
+ * @param [in] num_chunks number of chunks (at least 2), 0 for default
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int outbuf_init(struct outbuf *ob, const int fd, const size_t chunk_size,
+                const unsigned num_chunks);
+
+/**
+ * @brief Returns space for a record of up to \a len bytes
+ *
+ * @param [in,out] ob writer
+ * @param [in] len max record size, not more than chunk size
+ *
+ * @return Pointer to write the record at
+ */
+char *outbuf_reserve(struct outbuf *ob, const size_t len);
+
+/**
+ * @brief Appends \a len bytes written at outbuf_reserve() pointer
+ *
+ * @param [in,out] ob writer
+ * @param [in] len number of bytes written
+ */
+void outbuf_commit(struct outbuf *ob, const size_t len);
+
+/**
+ * @brief Marks end of a sample, submits current chunk to the writer
+ *        thread if it is half full or older than flush time
+ *
+ * @param [in,out] ob writer
+ */
+void outbuf_end_sample(struct outbuf *ob);
+
+/**
+ * @brief Flushes all data and stops the writer thread
+ *
+ * @param [in,out] ob writer
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 write error occurred
+ */
+int outbuf_fini(struct outbuf *ob);
+
+/**
+ * @brief Formats CSV record
+ *
+ * Columns: time,socket,core,rmid,event,value_kb
+ * and ipc,llc_misses,mpki,freq_mhz,pkg_watts,dram_watts
+ * when \a perf is given, columns not valid in \a perf are left empty
+ *
+ * @param [out] p output, at least OUTBUF_MAX_RECORD bytes
+ * @param [in] time_us CLOCK_REALTIME in microseconds
+ * @param [in] socket socket id
+ * @param [in] core first core of the group
+ * @param [in] rmid RMID
+ * @param [in] event event name
+ * @param [in] bytes event value in bytes
+ * @param [in] perf performance counter columns, can be NULL
+ *
+ * @return Record length
+ */
+size_t outbuf_fmt_csv(char *p, const uint64_t time_us,
+                      const unsigned socket, const unsigned core,
+                      const unsigned rmid, const char *event,
+                      const uint64_t bytes,
+                      const struct outbuf_perf *perf);
+
+/**
+ * @brief Formats JSON lines record with the same fields as CSV,
+ *        fields not valid in \a perf are left out
+ *
+ * @return Record length
+ */
+size_t outbuf_fmt_json(char *p, const uint64_t time_us,
+                       const unsigned socket, const unsigned core,
+                       const unsigned rmid, const char *event,
+                       const uint64_t bytes,
+                       const struct outbuf_perf *perf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __OUTBUF_H__ */
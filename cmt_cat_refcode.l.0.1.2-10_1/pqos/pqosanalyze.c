@@ -0,0 +1,1082 @@
+/**
+ * @file pqosanalyze.c
+ * @brief Post-processor of recorded pqos monitoring output
+ *
+ * Usage: pqos-analyze [-m summary|series|extract] [-g core|socket]
+ *                     [-c <cores>] [-s <sockets>] [-f <from>] [-t <to>]
+ *                     [-F text|json] [-j <threads>] [-v] <file>
+ *
+ * The file (text, xml, csv or bin output of pqos) is mapped into
+ * memory and parsed in windows. Every window is split at record
+ * boundaries into one range per thread, threads convert their ranges
+ * into compact records and the records are then consumed in file
+ * order, so results do not depend on the number of threads.
+ *
+ * The scanners look for line feeds and tags with memchr()/memmem(),
+ * which are vectorized in libc, and convert numbers by hand.
+ *
+ * Modes:
+ * - summary: count, min, mean, max, stddev and quantiles per core
+ *   and socket, same table as pqos --stats
+ * - series: one CSV row per sample with a column per core, or per
+ *   socket with LLC occupancy of its cores summed up
+ * - extract: selected records in pqos CSV format
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "binfmt.h"
+#include "stats.h"
+#include "outbuf.h"
+
+#define AN_MAX_CORES    4096                    /**< max core id + 1 */
+#define AN_MAX_SOCKETS  64                      /**< max socket id + 1 */
+#define AN_MAX_THREADS  64
+#define AN_WINDOW       (256UL * 1024 * 1024)   /**< bytes parsed per round */
+#define AN_TIME_LEN     19                      /**< "YYYY-MM-DD HH:MM:SS" */
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+enum an_format {
+        AN_TEXT = 0,
+        AN_XML,
+        AN_CSV,
+        AN_BIN
+};
+
+enum an_mode {
+        AN_SUMMARY = 0,
+        AN_SERIES,
+        AN_EXTRACT
+};
+
+/**
+ * Single monitoring record
+ */
+struct an_rec {
+        double time;                            /**< seconds since epoch */
+        double kb;                              /**< LLC occupancy */
+        uint32_t socket;
+        uint32_t core;
+        uint32_t rmid;
+};
+
+/**
+ * Cache of the last converted text time stamp
+ */
+struct an_timecache {
+        char str[AN_TIME_LEN];
+        double value;
+        int valid;
+};
+
+/**
+ * Part of a window parsed by one thread
+ */
+struct an_chunk {
+        const char *file;                       /**< start of the mapping */
+        const char *begin;                      /**< first record */
+        const char *end;                        /**< end of last record */
+        enum an_format fmt;
+        struct an_timecache tc;
+        struct an_rec *recs;
+        size_t num;
+        size_t cap;
+        int error;                              /**< out of memory */
+};
+
+/**
+ * Selection and results consumed in file order
+ */
+struct an_state {
+        enum an_mode mode;
+        int by_socket;                          /**< series per socket */
+        int json;                               /**< summary as JSON */
+        unsigned char core_sel[AN_MAX_CORES];   /**< empty selects all */
+        unsigned char socket_sel[AN_MAX_SOCKETS];
+        int core_filter;
+        int socket_filter;
+        double from;                            /**< relative to first record */
+        double to;                              /**< negative means no limit */
+
+        double first_time;
+        double last_time;
+        uint64_t records;                       /**< all records read */
+        uint64_t selected;                      /**< records passing filters */
+
+        /* summary */
+        int group_idx[AN_MAX_CORES];            /**< core -> group + 1 */
+        struct stats_group *groups;
+        unsigned num_groups;
+
+        /* series */
+        double sample_time;
+        unsigned char seen[AN_MAX_CORES];       /**< cores in current sample */
+        int in_sample;
+        int columns_set;
+        int column_idx[AN_MAX_CORES];           /**< key -> column + 1 */
+        unsigned num_columns;
+        double *row;
+        unsigned char *row_set;
+        struct an_rec *pending;                 /**< first sample, columns
+                                                   are set when it ends */
+        size_t num_pending;
+};
+
+/**
+ * @brief Parses unsigned decimal number, leading blanks are skipped
+ *
+ * @param [in,out] p parse position
+ * @param [in] end end of data
+ * @param [out] v number
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 no digits found
+ */
+static int
+an_uint(const char **p, const char *end, uint32_t *v)
+{
+        const char *s = *p;
+        uint32_t r = 0;
+
+        while (s<end && (*s==' ' || *s=='\t'))
+                s++;
+        if (s>=end || *s<'0' || *s>'9')
+                return -1;
+        while (s<end && *s>='0' && *s<='9')
+                r = (r * 10) + (uint32_t) (*s++ - '0');
+        *p = s;
+        *v = r;
+        return 0;
+}
+
+/**
+ * @brief Parses non-negative decimal number with optional fraction
+ *
+ * @param [in,out] p parse position
+ * @param [in] end end of data
+ * @param [out] v number
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 no digits found
+ */
+static int
+an_decimal(const char **p, const char *end, double *v)
+{
+        static const double scale[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+        };
+        const char *s = *p;
+        uint64_t ip = 0, fp = 0;
+        unsigned fd = 0;
+
+        while (s<end && (*s==' ' || *s=='\t'))
+                s++;
+        if (s>=end || *s<'0' || *s>'9')
+                return -1;
+        while (s<end && *s>='0' && *s<='9')
+                ip = (ip * 10) + (uint64_t) (*s++ - '0');
+        if (s<end && *s=='.') {
+                s++;
+                while (s<end && *s>='0' && *s<='9') {
+                        if (fd<9) {
+                                fp = (fp * 10) + (uint64_t) (*s - '0');
+                                fd++;
+                        }
+                        s++;
+                }
+        }
+        *p = s;
+        *v = (double) ip + ((double) fp / scale[fd]);
+        return 0;
+}
+
+/**
+ * @brief Converts local "YYYY-MM-DD HH:MM:SS" time to seconds
+ *        since epoch
+ *
+ * Samples share time stamps, so the last conversion is cached.
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 invalid time stamp
+ */
+static int
+an_time(struct an_timecache *tc, const char *s, const char *end, double *v)
+{
+        struct tm tm;
+        const char *p = s;
+        uint32_t f[6];
+        unsigned i;
+
+        if (end - s < AN_TIME_LEN)
+                return -1;
+        if (tc->valid && memcmp(tc->str, s, AN_TIME_LEN)==0) {
+                *v = tc->value;
+                return 0;
+        }
+
+        for (i=0;i<DIM(f);i++) {
+                if (an_uint(&p, s + AN_TIME_LEN, &f[i])!=0)
+                        return -1;
+                if (i<DIM(f)-1) {
+                        if (p>=s + AN_TIME_LEN)
+                                return -1;
+                        p++;                    /**< separator */
+                }
+        }
+
+        memset(&tm, 0, sizeof(tm));
+        tm.tm_year = (int) f[0] - 1900;
+        tm.tm_mon = (int) f[1] - 1;
+        tm.tm_mday = (int) f[2];
+        tm.tm_hour = (int) f[3];
+        tm.tm_min = (int) f[4];
+        tm.tm_sec = (int) f[5];
+        tm.tm_isdst = -1;
+
+        memcpy(tc->str, s, AN_TIME_LEN);
+        tc->value = (double) mktime(&tm);
+        tc->valid = 1;
+        *v = tc->value;
+        return 0;
+}
+
+/**
+ * @brief Appends record to chunk
+ */
+static void
+an_push(struct an_chunk *c, const struct an_rec *r)
+{
+        if (c->num==c->cap) {
+                const size_t cap = c->cap ? c->cap * 2 : 65536;
+                struct an_rec *recs = realloc(c->recs, cap * sizeof(*recs));
+
+                if (recs==NULL) {
+                        c->error = 1;
+                        return;
+                }
+                c->recs = recs;
+                c->cap = cap;
+        }
+        c->recs[c->num++] = *r;
+}
+
+/**
+ * @brief Returns start of the first record at or after \a p
+ */
+static const char *
+an_record_start(const char *file, const char *p, const char *end,
+                const enum an_format fmt)
+{
+        if (fmt==AN_XML) {
+                p = memmem(p, (size_t) (end - p), "<record>", 8);
+                return (p==NULL) ? end : p;
+        }
+        if (p==file || p[-1]=='\n')
+                return p;
+        p = memchr(p, '\n', (size_t) (end - p));
+        return (p==NULL) ? end : p + 1;
+}
+
+/**
+ * @brief Finds text output time stamp in effect at \a p
+ *
+ * Time stamps start samples, rows before the first one are
+ * dropped by the text scanner.
+ *
+ * @return Pointer to the time stamp or NULL
+ */
+static const char *
+an_text_last_time(const char *file, const char *p)
+{
+        while (p - file >= 5) {
+                p--;
+                if (*p=='T' && memcmp(p, "TIME ", 5)==0)
+                        return p + 5;
+        }
+        return NULL;
+}
+
+/**
+ * @brief Parses text output
+ *
+ * Data rows hold exactly socket, core, RMID and LLC[KB]. The row
+ * finishing a sample is followed by the next "TIME" on the same line.
+ */
+static void
+an_parse_text(struct an_chunk *c)
+{
+        const char *p = c->begin, *end = c->end;
+        const char *t = an_text_last_time(c->file, p);
+        double time = 0.0;
+        int have_time = 0;
+
+        if (t!=NULL)
+                have_time = an_time(&c->tc, t, c->end, &time)==0;
+
+        while (p<end && !c->error) {
+                const char *eol = memchr(p, '\n', (size_t) (end - p));
+                const char *q = p;
+                struct an_rec r;
+
+                if (eol==NULL)
+                        eol = end;
+
+                if (an_uint(&q, eol, &r.socket)==0 &&
+                    an_uint(&q, eol, &r.core)==0 &&
+                    an_uint(&q, eol, &r.rmid)==0 &&
+                    an_decimal(&q, eol, &r.kb)==0) {
+                        while (q<eol && (*q==' ' || *q=='\r'))
+                                q++;
+                        if (have_time && (q==eol || *q=='T')) {
+                                r.time = time;
+                                an_push(c, &r);
+                        }
+                } else {
+                        q = p;
+                }
+
+                if (eol - q > 5 && memcmp(q, "TIME ", 5)==0)
+                        have_time = an_time(&c->tc, q + 5, eol, &time)==0;
+                p = eol + 1;
+        }
+}
+
+/**
+ * @brief Parses xml output records
+ */
+static void
+an_parse_xml(struct an_chunk *c)
+{
+        const char *p = c->begin, *end = c->end;
+
+        while (p<end && !c->error) {
+                struct an_rec r;
+                int fields = 0;
+
+                p = memmem(p, (size_t) (end - p), "<record>", 8);
+                if (p==NULL)
+                        break;
+                p += 8;
+                memset(&r, 0, sizeof(r));
+
+                for (;;) {
+                        const char *tag = memchr(p, '<', (size_t) (end - p));
+                        const char *val = NULL;
+
+                        if (tag==NULL || end - tag < 2) {
+                                p = end;
+                                break;
+                        }
+                        if (tag[1]=='/') {
+                                /* closing tag of a field or the record */
+                                if (end - tag >= 9 &&
+                                    memcmp(tag, "</record>", 9)==0) {
+                                        p = tag + 9;
+                                        break;
+                                }
+                                p = tag + 2;
+                                continue;
+                        }
+                        val = memchr(tag, '>', (size_t) (end - tag));
+                        if (val==NULL) {
+                                p = end;
+                                break;
+                        }
+                        val++;
+                        p = val;
+
+                        switch (tag[1]) {
+                        case 't':
+                                if (val - tag==6 &&
+                                    memcmp(tag, "<time>", 6)==0 &&
+                                    an_time(&c->tc, val, end, &r.time)==0)
+                                        fields |= 1;
+                                break;
+                        case 's':
+                                if (val - tag==8 &&
+                                    memcmp(tag, "<socket>", 8)==0 &&
+                                    an_uint(&p, end, &r.socket)==0)
+                                        fields |= 2;
+                                break;
+                        case 'c':
+                                if (val - tag==6 &&
+                                    memcmp(tag, "<core>", 6)==0 &&
+                                    an_uint(&p, end, &r.core)==0)
+                                        fields |= 4;
+                                break;
+                        case 'r':
+                                if (val - tag==6 &&
+                                    memcmp(tag, "<rmid>", 6)==0 &&
+                                    an_uint(&p, end, &r.rmid)==0)
+                                        fields |= 8;
+                                break;
+                        case 'l':
+                                if (val - tag==17 &&
+                                    memcmp(tag, "<l3_occupancy_kB>", 17)==0 &&
+                                    an_decimal(&p, end, &r.kb)==0)
+                                        fields |= 16;
+                                break;
+                        default:
+                                break;
+                        }
+                }
+
+                if (fields==31)
+                        an_push(c, &r);
+        }
+}
+
+/**
+ * @brief Parses csv output, time,socket,core,rmid,event,value_kb
+ */
+static void
+an_parse_csv(struct an_chunk *c)
+{
+        const char *p = c->begin, *end = c->end;
+
+        while (p<end && !c->error) {
+                const char *eol = memchr(p, '\n', (size_t) (end - p));
+                const char *q = p;
+                struct an_rec r;
+
+                if (eol==NULL)
+                        eol = end;
+
+                if (an_decimal(&q, eol, &r.time)==0 && q<eol && *q++==',' &&
+                    an_uint(&q, eol, &r.socket)==0 && q<eol && *q++==',' &&
+                    an_uint(&q, eol, &r.core)==0 && q<eol && *q++==',' &&
+                    an_uint(&q, eol, &r.rmid)==0 && q<eol && *q++==',') {
+                        /* skip event name */
+                        q = memchr(q, ',', (size_t) (eol - q));
+                        if (q!=NULL)
+                                q++;
+                        if (q!=NULL && an_decimal(&q, eol, &r.kb)==0)
+                                an_push(c, &r);
+                }
+                p = eol + 1;
+        }
+}
+
+/**
+ * @brief Thread body parsing one chunk
+ */
+static void *
+an_parse_thread(void *arg)
+{
+        struct an_chunk *c = (struct an_chunk *) arg;
+
+        c->num = 0;
+        switch (c->fmt) {
+        case AN_XML:
+                an_parse_xml(c);
+                break;
+        case AN_CSV:
+                an_parse_csv(c);
+                break;
+        default:
+                an_parse_text(c);
+                break;
+        }
+        return NULL;
+}
+
+/**
+ * @brief Parses comma separated list of numbers and ranges into
+ *        selection table
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 invalid list
+ */
+static int
+an_parse_list(const char *str, unsigned char *sel, const unsigned max)
+{
+        const char *p = str, *end = str + strlen(str);
+
+        while (p<end) {
+                uint32_t a, b;
+
+                if (an_uint(&p, end, &a)!=0)
+                        return -1;
+                b = a;
+                if (p<end && *p=='-') {
+                        p++;
+                        if (an_uint(&p, end, &b)!=0 || b<a)
+                                return -1;
+                }
+                if (b>=max)
+                        return -1;
+                for (;a<=b;a++)
+                        sel[a] = 1;
+                if (p<end && *p++!=',')
+                        return -1;
+        }
+        return 0;
+}
+
+/**
+ * @brief Prints series row of the current sample
+ */
+static void
+an_series_flush(struct an_state *st)
+{
+        unsigned i;
+
+        if (!st->in_sample)
+                return;
+
+        printf("%.6f", st->sample_time - st->first_time);
+        for (i=0;i<st->num_columns;i++)
+                if (st->row_set[i])
+                        printf(",%.1f", st->row[i]);
+                else
+                        fputc(',', stdout);
+        fputc('\n', stdout);
+
+        memset(st->row, 0, st->num_columns * sizeof(st->row[0]));
+        memset(st->row_set, 0, st->num_columns);
+        memset(st->seen, 0, sizeof(st->seen));
+        st->in_sample = 0;
+}
+
+/**
+ * @brief Tells if record \a r passes selection
+ */
+static int
+an_selected(struct an_state *st, const struct an_rec *r)
+{
+        double t;
+
+        if (r->core>=AN_MAX_CORES || r->socket>=AN_MAX_SOCKETS)
+                return 0;
+        if (st->records++==0)
+                st->first_time = r->time;
+        t = r->time - st->first_time;
+        if (t<st->from || (st->to>=0.0 && t>st->to))
+                return 0;
+        if (st->core_filter && !st->core_sel[r->core])
+                return 0;
+        if (st->socket_filter && !st->socket_sel[r->socket])
+                return 0;
+        st->selected++;
+        st->last_time = r->time;
+        return 1;
+}
+
+/**
+ * @brief Adds record to the current series sample
+ *
+ * A new sample starts when time changes or a core repeats.
+ */
+static void
+an_series_add(struct an_state *st, const struct an_rec *r)
+{
+        int col;
+
+        if (st->in_sample &&
+            (r->time!=st->sample_time || st->seen[r->core]))
+                an_series_flush(st);
+        if (!st->in_sample) {
+                st->sample_time = r->time;
+                st->in_sample = 1;
+        }
+        st->seen[r->core] = 1;
+
+        col = st->column_idx[st->by_socket ? r->socket : r->core];
+        if (col>0) {
+                st->row[col - 1] += r->kb;
+                st->row_set[col - 1] = 1;
+        }
+}
+
+/**
+ * @brief Sets series columns from the pending first sample and
+ *        prints the header
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_series_columns(struct an_state *st)
+{
+        const unsigned max = st->by_socket ? AN_MAX_SOCKETS : AN_MAX_CORES;
+        unsigned char *key = calloc(max, 1);
+        unsigned i;
+        size_t j;
+
+        if (key==NULL)
+                return -1;
+        for (j=0;j<st->num_pending;j++)
+                key[st->by_socket ? st->pending[j].socket :
+                    st->pending[j].core] = 1;
+
+        printf("time_s");
+        for (i=0;i<max;i++)
+                if (key[i]) {
+                        st->column_idx[i] = (int) ++st->num_columns;
+                        printf(",%s%u", st->by_socket ? "socket" : "core", i);
+                }
+        fputc('\n', stdout);
+        free(key);
+
+        st->row = calloc(st->num_columns + 1, sizeof(st->row[0]));
+        st->row_set = calloc(st->num_columns + 1, 1);
+        if (st->row==NULL || st->row_set==NULL)
+                return -1;
+        st->columns_set = 1;
+
+        memset(st->seen, 0, sizeof(st->seen));
+        for (j=0;j<st->num_pending;j++)
+                an_series_add(st, &st->pending[j]);
+        free(st->pending);
+        st->pending = NULL;
+        st->num_pending = 0;
+        return 0;
+}
+
+/**
+ * @brief Collects records of the first sample
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_series_pending(struct an_state *st, const struct an_rec *r)
+{
+        struct an_rec *p = NULL;
+
+        if (st->num_pending>0 &&
+            (r->time!=st->pending[0].time || st->seen[r->core]))
+                return an_series_columns(st);
+
+        p = realloc(st->pending, (st->num_pending + 1) * sizeof(*p));
+        if (p==NULL)
+                return -1;
+        st->pending = p;
+        st->pending[st->num_pending++] = *r;
+        st->seen[r->core] = 1;
+        return 0;
+}
+
+/**
+ * @brief Adds record to summary of its core
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_summary_add(struct an_state *st, const struct an_rec *r)
+{
+        if (st->group_idx[r->core]==0) {
+                struct stats_group *g = realloc(st->groups,
+                                                (st->num_groups + 1) *
+                                                sizeof(*g));
+
+                if (g==NULL)
+                        return -1;
+                st->groups = g;
+                g = &st->groups[st->num_groups++];
+                g->socket = r->socket;
+                g->core = r->core;
+                g->rmid = r->rmid;
+                g->event = "llc";
+                g->unit = "KB";
+                g->scale = 1.0;
+                stats_init(&g->acc);
+                st->group_idx[r->core] = (int) st->num_groups;
+        }
+        stats_add(&st->groups[st->group_idx[r->core] - 1].acc, r->kb);
+        return 0;
+}
+
+/**
+ * @brief Consumes records in file order
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_consume(struct an_state *st, const struct an_rec *recs, const size_t num)
+{
+        char line[OUTBUF_MAX_RECORD];
+        size_t j;
+
+        for (j=0;j<num;j++) {
+                const struct an_rec *r = &recs[j];
+
+                if (!an_selected(st, r))
+                        continue;
+
+                switch (st->mode) {
+                case AN_EXTRACT:
+                        fwrite(line, 1,
+                               outbuf_fmt_csv(line,
+                                              (uint64_t) (r->time * 1e6 + 0.5),
+                                              r->socket, r->core, r->rmid,
+                                              "llc",
+                                              (uint64_t) (r->kb * 1024.0),
+                                              NULL),
+                               stdout);
+                        break;
+                case AN_SERIES:
+                        if (!st->columns_set &&
+                            an_series_pending(st, r)!=0)
+                                return -1;
+                        if (st->columns_set)
+                                an_series_add(st, r);
+                        break;
+                default:
+                        if (an_summary_add(st, r)!=0)
+                                return -1;
+                        break;
+                }
+        }
+        return 0;
+}
+
+/**
+ * @brief Converts binary output and consumes it
+ *
+ * Binary output is dense and delta coded, it is decoded sequentially.
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_run_bin(struct an_state *st, const char *map, const size_t size)
+{
+        struct binfmt_reader rd;
+        struct an_rec *recs = NULL;
+        FILE *fp = fmemopen((void *) (uintptr_t) map, size, "rb");
+        int rec, ret = 0;
+
+        if (fp==NULL)
+                return -1;
+
+        binfmt_reader_init(fp, &rd);
+        while ((rec = binfmt_read(&rd))>0) {
+                uint32_t i, n;
+
+                if (rec==BINFMT_REC_HEADER) {
+                        free(recs);
+                        recs = calloc(rd.hdr.num_groups + 1, sizeof(*recs));
+                        if (recs==NULL)
+                                break;
+                        continue;
+                }
+                for (i=0, n=0;i<rd.hdr.num_groups;i++) {
+                        const struct binfmt_group *g = &rd.hdr.groups[i];
+
+                        /* performance counter metrics are not analyzed */
+                        if (g->event!=BINFMT_EVENT_LLC)
+                                continue;
+                        recs[n].time = (double) rd.time / 1e9;
+                        recs[n].socket = g->socket;
+                        recs[n].core = (g->num_cores>0) ? g->cores[0] : 0;
+                        recs[n].rmid = g->rmid;
+                        recs[n].kb = (double) (rd.values[i] *
+                                               rd.hdr.scale_factor) / 1024.0;
+                        n++;
+                }
+                if (an_consume(st, recs, n)!=0)
+                        break;
+        }
+        if (rec!=0) {
+                fprintf(stderr, "Corrupted input stream!\n");
+                ret = -1;
+        }
+
+        free(recs);
+        binfmt_reader_fini(&rd);
+        fclose(fp);
+        return ret;
+}
+
+/**
+ * @brief Parses text, xml or csv output in windows, each split
+ *        among threads, and consumes records in file order
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+an_run_parallel(struct an_state *st, const char *map, const size_t size,
+                const enum an_format fmt, const unsigned threads)
+{
+        struct an_chunk chunks[AN_MAX_THREADS];
+        pthread_t tids[AN_MAX_THREADS];
+        int started[AN_MAX_THREADS];
+        const char *end = map + size, *pos = map;
+        unsigned i;
+        int ret = 0;
+
+        memset(chunks, 0, sizeof(chunks));
+        for (i=0;i<threads;i++) {
+                chunks[i].file = map;
+                chunks[i].fmt = fmt;
+        }
+
+        while (pos<end && ret==0) {
+                const char *wend = end;
+                size_t span;
+
+                if ((size_t) (end - pos) > AN_WINDOW)
+                        wend = an_record_start(map, pos + AN_WINDOW, end,
+                                               fmt);
+                span = (size_t) (wend - pos) / threads;
+
+                for (i=0;i<threads;i++) {
+                        chunks[i].begin = (i==0) ? pos : chunks[i-1].end;
+                        chunks[i].end = (i==threads-1) ? wend :
+                                an_record_start(map, pos + span * (i + 1),
+                                                wend, fmt);
+                        if (chunks[i].end<chunks[i].begin)
+                                chunks[i].end = chunks[i].begin;
+                }
+
+                for (i=1;i<threads;i++)
+                        started[i] = pthread_create(&tids[i], NULL,
+                                                    an_parse_thread,
+                                                    &chunks[i])==0;
+                an_parse_thread(&chunks[0]);
+                for (i=1;i<threads;i++)
+                        if (started[i])
+                                pthread_join(tids[i], NULL);
+                        else
+                                an_parse_thread(&chunks[i]);
+
+                for (i=0;i<threads && ret==0;i++) {
+                        if (chunks[i].error) {
+                                fprintf(stderr, "Memory allocation error!\n");
+                                ret = -1;
+                                break;
+                        }
+                        ret = an_consume(st, chunks[i].recs, chunks[i].num);
+                }
+                pos = wend;
+        }
+
+        for (i=0;i<threads;i++)
+                free(chunks[i].recs);
+        return ret;
+}
+
+/**
+ * @brief Returns current CLOCK_MONOTONIC time in seconds
+ */
+static double
+an_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+static void
+an_usage(const char *name)
+{
+        printf("Usage: %s [-m summary|series|extract] [-g core|socket]\n"
+               "          [-c <cores>] [-s <sockets>] [-f <from>] "
+               "[-t <to>]\n"
+               "          [-F text|json] [-j <threads>] [-v] <file>\n"
+               "Notes:\n"
+               "\t-m\tsummary (default) table of each core and socket, "
+               "series of samples\n\t\tas CSV or extract of selected "
+               "records as CSV\n"
+               "\t-g\tseries columns, per core (default) or sum per "
+               "socket\n"
+               "\t-c\tselect cores, example: \"0,2,4-7\"\n"
+               "\t-s\tselect sockets, example: \"0\"\n"
+               "\t-f\tskip records earlier than <from> seconds since "
+               "the first one\n"
+               "\t-t\tskip records later than <to> seconds since the "
+               "first one\n"
+               "\t-F\tsummary format, \"text\" (default) or \"json\"\n"
+               "\t-j\tnumber of parsing threads, all online cpus by "
+               "default\n"
+               "\t-v\treport parsing throughput on stderr\n", name);
+}
+
+int main(int argc, char **argv)
+{
+        struct an_state *st = NULL;
+        enum an_format fmt = AN_TEXT;
+        unsigned threads = 0;
+        int opt, fd, verbose = 0, ret = EXIT_SUCCESS;
+        const char *map = NULL;
+        struct stat sb;
+        double t0;
+
+        st = calloc(1, sizeof(*st));
+        if (st==NULL) {
+                printf("Memory allocation error!\n");
+                return EXIT_FAILURE;
+        }
+        st->to = -1.0;
+
+        while ((opt = getopt(argc, argv, "m:g:c:s:f:t:F:j:vh"))!=-1) {
+                switch (opt) {
+                case 'm':
+                        if (strcasecmp(optarg,"summary")==0)
+                                st->mode = AN_SUMMARY;
+                        else if (strcasecmp(optarg,"series")==0)
+                                st->mode = AN_SERIES;
+                        else if (strcasecmp(optarg,"extract")==0)
+                                st->mode = AN_EXTRACT;
+                        else
+                                goto usage;
+                        break;
+                case 'g':
+                        if (strcasecmp(optarg,"socket")==0)
+                                st->by_socket = 1;
+                        else if (strcasecmp(optarg,"core")!=0)
+                                goto usage;
+                        break;
+                case 'c':
+                        if (an_parse_list(optarg, st->core_sel,
+                                          AN_MAX_CORES)!=0)
+                                goto usage;
+                        st->core_filter = 1;
+                        break;
+                case 's':
+                        if (an_parse_list(optarg, st->socket_sel,
+                                          AN_MAX_SOCKETS)!=0)
+                                goto usage;
+                        st->socket_filter = 1;
+                        break;
+                case 'f':
+                        st->from = strtod(optarg, NULL);
+                        break;
+                case 't':
+                        st->to = strtod(optarg, NULL);
+                        break;
+                case 'F':
+                        if (strcasecmp(optarg,"json")==0)
+                                st->json = 1;
+                        else if (strcasecmp(optarg,"text")!=0)
+                                goto usage;
+                        break;
+                case 'j':
+                        threads = (unsigned) strtoul(optarg, NULL, 0);
+                        break;
+                case 'v':
+                        verbose = 1;
+                        break;
+                default:
+                        goto usage;
+                }
+        }
+        if (optind!=argc-1)
+                goto usage;
+
+        if (threads==0) {
+                const long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+                threads = (n>0) ? (unsigned) n : 1;
+        }
+        if (threads>AN_MAX_THREADS)
+                threads = AN_MAX_THREADS;
+
+        fd = open(argv[optind], O_RDONLY);
+        if (fd<0 || fstat(fd, &sb)!=0) {
+                perror("Input file open error");
+                free(st);
+                return EXIT_FAILURE;
+        }
+        if (sb.st_size>0) {
+                map = mmap(NULL, (size_t) sb.st_size, PROT_READ, MAP_PRIVATE,
+                           fd, 0);
+                if (map==MAP_FAILED) {
+                        perror("Input file mmap error");
+                        close(fd);
+                        free(st);
+                        return EXIT_FAILURE;
+                }
+                madvise((void *) (uintptr_t) map, (size_t) sb.st_size,
+                        MADV_SEQUENTIAL);
+        }
+        close(fd);
+
+        if (sb.st_size>=BINFMT_MAGIC_SIZE &&
+            memcmp(map, BINFMT_MAGIC, BINFMT_MAGIC_SIZE)==0)
+                fmt = AN_BIN;
+        else if (sb.st_size>0 && map[0]=='<')
+                fmt = AN_XML;
+        else if (sb.st_size>=5 && memcmp(map, "time,", 5)==0)
+                fmt = AN_CSV;
+
+        t0 = an_now();
+        if (sb.st_size>0) {
+                if (fmt==AN_BIN)
+                        ret = an_run_bin(st, map, (size_t) sb.st_size);
+                else
+                        ret = an_run_parallel(st, map, (size_t) sb.st_size,
+                                              fmt, threads);
+                ret = (ret==0) ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+
+        if (st->mode==AN_SERIES) {
+                if (!st->columns_set && st->num_pending>0 &&
+                    an_series_columns(st)!=0)
+                        ret = EXIT_FAILURE;
+                an_series_flush(st);
+        }
+        else if (st->mode==AN_SUMMARY && st->json)
+                stats_report_json(stdout, st->groups, st->num_groups,
+                                  st->last_time - st->first_time);
+        else if (st->mode==AN_SUMMARY)
+                stats_report_text(stdout, st->groups, st->num_groups,
+                                  st->last_time - st->first_time);
+        fflush(stdout);
+
+        if (verbose) {
+                const double t = an_now() - t0;
+
+                fprintf(stderr, "%s: %llu bytes, %llu record(s), "
+                        "%llu selected, %u thread(s), %.3fs, %.1f MB/s\n",
+                        argv[optind], (unsigned long long) sb.st_size,
+                        (unsigned long long) st->records,
+                        (unsigned long long) st->selected,
+                        (fmt==AN_BIN) ? 1 : threads, t,
+                        (double) sb.st_size / 1e6 / (t>0.0 ? t : 1e-9));
+        }
+
+        if (map!=NULL)
+                munmap((void *) (uintptr_t) map, (size_t) sb.st_size);
+        free(st->groups);
+        free(st->row);
+        free(st->row_set);
+        free(st->pending);
+        free(st);
+        return ret;
+
+ usage:
+        an_usage(argv[0]);
+        free(st);
+        return EXIT_FAILURE;
+}
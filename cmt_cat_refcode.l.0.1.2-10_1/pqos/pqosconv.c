@@ -0,0 +1,332 @@
+/**
+ * @file pqosconv.c
+ * @brief Converts binary monitoring output (-u bin) to text, CSV
+ *        or JSON lines
+ *
+ * Usage: pqosconv [-f text|csv|json] [<file>]
+ *
+ * Input is read from stdin when no file is given, so the tool can
+ * follow pqos output through a pipe.
+ *
+ * IPC, MPKI, frequency and power groups are printed as columns of
+ * the LLC occupancy group with the same socket, RMID and first core,
+ * like pqos does.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "binfmt.h"
+
+enum conv_format {
+        CONV_TEXT = 0,
+        CONV_CSV,
+        CONV_JSON
+};
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+/**
+ * Metric groups printed as columns, text columns of
+ * the same set are shown together
+ */
+static const struct {
+        uint32_t event;
+        const char *name;                       /**< CSV and JSON field */
+        const char *title;                      /**< text column title */
+        const char *fmt;                        /**< value format */
+        unsigned set;                           /**< text column set */
+} conv_metrics[] = {
+        { BINFMT_EVENT_IPC,  "ipc",        "IPC",     "%.2f", 1 },
+        { BINFMT_EVENT_MPKI, "mpki",       "MPKI",    "%.2f", 1 },
+        { BINFMT_EVENT_FREQ, "freq_mhz",   "MHz",     "%.0f", 2 },
+        { BINFMT_EVENT_PKG,  "pkg_watts",  "PKG[W]",  "%.2f", 4 },
+        { BINFMT_EVENT_DRAM, "dram_watts", "DRAM[W]", "%.2f", 4 },
+};
+
+/**
+ * Metric groups of LLC occupancy groups of current run,
+ * -1 if not monitored
+ */
+static int *m_metric[DIM(conv_metrics)];
+static unsigned m_perf = 0;             /**< column sets of current run */
+
+/**
+ * @brief Returns name of monitoring event \a event
+ */
+static const char *
+conv_event_name(const uint32_t event)
+{
+        switch (event) {
+        case BINFMT_EVENT_LLC:
+                return "llc";
+        case BINFMT_EVENT_IPC:
+                return "ipc";
+        case BINFMT_EVENT_MPKI:
+                return "mpki";
+        case BINFMT_EVENT_FREQ:
+                return "freq";
+        case BINFMT_EVENT_PKG:
+                return "pkg";
+        case BINFMT_EVENT_DRAM:
+                return "dram";
+        default:
+                return "unknown";
+        }
+}
+
+/**
+ * @brief Frees metric group tables
+ */
+static void
+conv_free(void)
+{
+        unsigned k;
+
+        for (k=0;k<DIM(m_metric);k++) {
+                free(m_metric[k]);
+                m_metric[k] = NULL;
+        }
+}
+
+/**
+ * @brief Finds metric groups of LLC occupancy groups
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 out of memory
+ */
+static int
+conv_match(const struct binfmt_header *hdr)
+{
+        uint32_t i, j;
+        unsigned k;
+
+        conv_free();
+        m_perf = 0;
+        for (k=0;k<DIM(m_metric);k++) {
+                m_metric[k] = malloc((hdr->num_groups + 1) *
+                                     sizeof(m_metric[k][0]));
+                if (m_metric[k]==NULL)
+                        return -1;
+        }
+
+        for (i=0;i<hdr->num_groups;i++) {
+                const struct binfmt_group *g = &hdr->groups[i];
+
+                for (k=0;k<DIM(m_metric);k++)
+                        m_metric[k][i] = -1;
+                if (g->event!=BINFMT_EVENT_LLC)
+                        continue;
+                for (j=0;j<hdr->num_groups;j++) {
+                        const struct binfmt_group *p = &hdr->groups[j];
+
+                        if (p->socket!=g->socket || p->rmid!=g->rmid ||
+                            p->num_cores==0 || g->num_cores==0 ||
+                            p->cores[0]!=g->cores[0])
+                                continue;
+                        for (k=0;k<DIM(conv_metrics);k++)
+                                if (p->event==conv_metrics[k].event) {
+                                        m_metric[k][i] = (int) j;
+                                        m_perf |= conv_metrics[k].set;
+                                }
+                }
+        }
+        return 0;
+}
+
+/**
+ * @brief Formats performance counter metric \a idx of a sample,
+ *        empty if not monitored
+ */
+static const char *
+conv_metric(char *buf, const size_t len, const struct binfmt_reader *r,
+            const unsigned k, const int idx)
+{
+        if (idx<0)
+                buf[0] = '\0';
+        else
+                snprintf(buf, len, conv_metrics[k].fmt,
+                         (double) r->values[idx] / 1e3);
+        return buf;
+}
+
+/**
+ * @brief Prints a run header
+ */
+static void
+conv_header(const struct binfmt_header *hdr, const enum conv_format fmt,
+            const int first)
+{
+        uint32_t i;
+
+        switch (fmt) {
+        case CONV_CSV:
+                if (first)
+                        printf("time,socket,core,rmid,event,value_kb%s\n",
+                               m_perf ? ",ipc,llc_misses,mpki,freq_mhz,"
+                               "pkg_watts,dram_watts" : "");
+                break;
+        case CONV_JSON:
+                printf("{\"run\":{\"start\":%.6f,\"interval_us\":%llu,"
+                       "\"scale_factor\":%u,\"cores\":%u,\"events\":[",
+                       (double) hdr->start / 1e9,
+                       (unsigned long long) hdr->interval,
+                       hdr->scale_factor, hdr->num_cores);
+                for (i=0;i<hdr->num_events;i++)
+                        printf("%s\"%s\"", i ? "," : "",
+                               conv_event_name(hdr->events[i]));
+                printf("],\"groups\":%u}}\n", hdr->num_groups);
+                break;
+        default:
+                printf("RUN %u core(s), %u group(s), interval %.3fms, "
+                       "scale factor %u\n", hdr->num_cores, hdr->num_groups,
+                       (double) hdr->interval / 1e3, hdr->scale_factor);
+                break;
+        }
+}
+
+/**
+ * @brief Prints a sample
+ */
+static void
+conv_sample(const struct binfmt_reader *r, const enum conv_format fmt)
+{
+        const struct binfmt_header *hdr = &r->hdr;
+        const double t = (double) r->time / 1e9;
+        time_t sec = (time_t) (r->time / 1000000000ULL);
+        struct tm *ptm = NULL;
+        char cb_time[64];
+        uint32_t i;
+        unsigned k;
+
+        if (fmt==CONV_TEXT) {
+                ptm = localtime(&sec);
+                if (ptm==NULL ||
+                    strftime(cb_time, sizeof(cb_time),
+                             "%Y-%m-%d %H:%M:%S", ptm)==0)
+                        strncpy(cb_time, "error", sizeof(cb_time));
+                printf("TIME %s\nSOCKET     CORE     RMID    LLC[KB]",
+                       cb_time);
+                for (k=0;k<DIM(conv_metrics);k++)
+                        if (m_perf & conv_metrics[k].set)
+                                printf(" %8s", conv_metrics[k].title);
+                printf("\n");
+        }
+
+        for (i=0;i<hdr->num_groups;i++) {
+                const struct binfmt_group *g = &hdr->groups[i];
+                const unsigned core = (g->num_cores>0) ? g->cores[0] : 0;
+                const double kb = (double) (r->values[i] * hdr->scale_factor) /
+                        1024.0;
+                char val[DIM(conv_metrics)][32];
+
+                if (g->event!=BINFMT_EVENT_LLC)
+                        continue;
+                for (k=0;k<DIM(conv_metrics);k++)
+                        conv_metric(val[k], sizeof(val[k]), r, k,
+                                    m_metric[k][i]);
+
+                switch (fmt) {
+                case CONV_CSV:
+                        /**
+                         * LLC miss counts are not kept in binary
+                         * output, their column stays empty
+                         */
+                        printf("%.6f,%u,%u,%u,%s,%.1f", t, g->socket, core,
+                               g->rmid, conv_event_name(g->event), kb);
+                        for (k=0;m_perf && k<DIM(conv_metrics);k++)
+                                printf(",%s%s", val[k],
+                                       (conv_metrics[k].event==
+                                        BINFMT_EVENT_IPC) ? "," : "");
+                        printf("\n");
+                        break;
+                case CONV_JSON:
+                        printf("{\"time\":%.6f,\"socket\":%u,\"core\":%u,"
+                               "\"rmid\":%u,\"event\":\"%s\","
+                               "\"value_kb\":%.1f", t, g->socket, core,
+                               g->rmid, conv_event_name(g->event), kb);
+                        for (k=0;k<DIM(conv_metrics);k++)
+                                if (val[k][0]!='\0')
+                                        printf(",\"%s\":%s",
+                                               conv_metrics[k].name, val[k]);
+                        printf("}\n");
+                        break;
+                default:
+                        printf("%6u %8u %8u %10.1f", g->socket, core,
+                               g->rmid, kb);
+                        for (k=0;k<DIM(conv_metrics);k++)
+                                if (m_perf & conv_metrics[k].set)
+                                        printf(" %8s",
+                                               val[k][0] ? val[k] : "-");
+                        printf("\n");
+                        break;
+                }
+        }
+}
+
+int main(int argc, char **argv)
+{
+        enum conv_format fmt = CONV_TEXT;
+        struct binfmt_reader r;
+        FILE *fp = stdin;
+        int opt, rec, runs = 0, ret = EXIT_SUCCESS;
+
+        while ((opt = getopt(argc, argv, "f:h"))!=-1) {
+                switch (opt) {
+                case 'f':
+                        if (strcasecmp(optarg,"text")==0)
+                                fmt = CONV_TEXT;
+                        else if (strcasecmp(optarg,"csv")==0)
+                                fmt = CONV_CSV;
+                        else if (strcasecmp(optarg,"json")==0)
+                                fmt = CONV_JSON;
+                        else {
+                                printf("Unknown format '%s'!\n", optarg);
+                                return EXIT_FAILURE;
+                        }
+                        break;
+                default:
+                        printf("Usage: %s [-f text|csv|json] [<file>]\n",
+                               argv[0]);
+                        return (opt=='h') ? EXIT_SUCCESS : EXIT_FAILURE;
+                }
+        }
+
+        if (optind<argc) {
+                fp = fopen(argv[optind], "rb");
+                if (fp==NULL) {
+                        perror("Input file open error");
+                        return EXIT_FAILURE;
+                }
+        }
+
+        binfmt_reader_init(fp, &r);
+        while ((rec = binfmt_read(&r))>0) {
+                if (rec==BINFMT_REC_HEADER) {
+                        if (conv_match(&r.hdr)!=0) {
+                                fprintf(stderr, "Out of memory!\n");
+                                ret = EXIT_FAILURE;
+                                break;
+                        }
+                        conv_header(&r.hdr, fmt, runs++==0);
+                } else
+                        conv_sample(&r, fmt);
+        }
+        if (rec<0) {
+                fprintf(stderr, "Corrupted input stream!\n");
+                ret = EXIT_FAILURE;
+        }
+
+        conv_free();
+        binfmt_reader_fini(&r);
+        if (fp!=stdin)
+                fclose(fp);
+        return ret;
+}
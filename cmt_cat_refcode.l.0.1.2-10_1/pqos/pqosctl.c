@@ -0,0 +1,344 @@
+/**
+ * @file pqosctl.c
+ * @brief Command line client of the PQoS daemon
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "pqosd_client.h"
+
+#define PQOSCTL_MAX_CORES 128                   /**< max cores of a group */
+
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Parses unsigned number, decimal or hexadecimal with 0x prefix
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+parse_uint(const char *str, uint64_t *val)
+{
+        char *end = NULL;
+
+        if (str==NULL || *str=='\0' || *str=='-')
+                return -1;
+        *val = strtoull(str, &end, 0);
+        return (*end=='\0') ? 0 : -1;
+}
+
+/**
+ * @brief Parses list of cores e.g. "0,2,4-7"
+ *
+ * @return Number of cores or 0 on error
+ */
+static unsigned
+parse_cores(const char *str, unsigned *cores, const unsigned max)
+{
+        char buf[512], *saveptr = NULL, *tok;
+        unsigned num = 0;
+
+        if (strlen(str)>=sizeof(buf))
+                return 0;
+        strcpy(buf, str);
+
+        for (tok=strtok_r(buf, ",", &saveptr);tok!=NULL;
+             tok=strtok_r(NULL, ",", &saveptr)) {
+                char *dash = strchr(tok, '-');
+                uint64_t first, last, i;
+
+                if (dash!=NULL)
+                        *dash = '\0';
+                if (parse_uint(tok, &first)!=0)
+                        return 0;
+                last = first;
+                if (dash!=NULL && parse_uint(dash + 1, &last)!=0)
+                        return 0;
+                if (last<first || last - first>=max)
+                        return 0;
+                for (i=first;i<=last;i++) {
+                        if (num>=max)
+                                return 0;
+                        cores[num++] = (unsigned) i;
+                }
+        }
+        return num;
+}
+
+/**
+ * @brief Measures request round trip time
+ */
+static int
+cmd_ping(struct pqosd_client *c, const unsigned count)
+{
+        uint64_t min = UINT64_MAX, max = 0, sum = 0;
+        unsigned i;
+
+        for (i=0;i<count;i++) {
+                const uint64_t start = now_ns();
+                const int ret = pqosd_ping(c);
+                uint64_t t;
+
+                if (ret!=PQOS_RETVAL_OK)
+                        return ret;
+                t = now_ns() - start;
+                sum += t;
+                if (t<min)
+                        min = t;
+                if (t>max)
+                        max = t;
+        }
+        printf("%u requests round trip avg %.1fus min %.1fus max %.1fus\n",
+               count, (double) sum / count / 1000.0,
+               (double) min / 1000.0, (double) max / 1000.0);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Prints platform information
+ */
+static int
+cmd_info(struct pqosd_client *c)
+{
+        struct pqosd_info info;
+        int ret;
+
+        ret = pqosd_info_get(c, &info);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        printf("pid %u\n"
+               "cores %u\n"
+               "sockets %u\n"
+               "classes of service %u\n"
+               "ways %u\n"
+               "max RMID %u\n"
+               "groups %u\n",
+               info.pid, info.num_cores, info.num_sockets, info.num_cos,
+               info.num_ways, info.max_rmid, info.num_groups);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Formats query column of event \a evt, "-" if the group
+ *        does not monitor it
+ *
+ * @return \a buf
+ */
+static const char *
+query_col(char *buf, const size_t len, const struct pqosd_sample *p,
+          const unsigned evt, const char *fmt, const double value)
+{
+        if (p->event & evt)
+                snprintf(buf, len, fmt, value);
+        else
+                snprintf(buf, len, "-");
+        return buf;
+}
+
+/**
+ * @brief Prints samples of monitoring groups
+ */
+static int
+cmd_query(struct pqosd_client *c, const unsigned group)
+{
+        struct pqosd_sample samples[PQOSD_MAX_GROUPS];
+        unsigned i, num = 0;
+        int ret;
+
+        ret = pqosd_mon_query(c, group, PQOSD_MAX_GROUPS, &num, samples);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        printf("GROUP SOCKET RMID  CORE CORES   LLC[KB]      IPC     MPKI"
+               "      MHz   PKG[W]  DRAM[W]\n");
+        for (i=0;i<num;i++) {
+                const struct pqosd_sample *p = &samples[i];
+                char ipc[16], mpki[16], freq[16], pkg[16], dram[16];
+
+                printf("%5u %6u %4u %5u %5u %9.1f %8s %8s %8s %8s %8s\n",
+                       p->group, p->socket, p->rmid, p->core, p->num_cores,
+                       (double) p->value / 1024.0,
+                       query_col(ipc, sizeof(ipc), p, PQOS_PERF_EVENT_IPC,
+                                 "%.2f", (double) p->ipc / 1000.0),
+                       query_col(mpki, sizeof(mpki), p,
+                                 PQOS_PERF_EVENT_LLC_MISS, "%.2f",
+                                 (double) p->mpki / 1000.0),
+                       query_col(freq, sizeof(freq), p, PQOS_PERF_EVENT_FREQ,
+                                 "%.0f", (double) p->freq),
+                       query_col(pkg, sizeof(pkg), p,
+                                 PQOS_PWR_EVENT_PKG_ENERGY, "%.2f",
+                                 (double) p->pkg_power / 1000.0),
+                       query_col(dram, sizeof(dram), p,
+                                 PQOS_PWR_EVENT_DRAM_ENERGY, "%.2f",
+                                 (double) p->dram_power / 1000.0));
+        }
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Prints classes of service of a socket
+ */
+static int
+cmd_l3ca_get(struct pqosd_client *c, const unsigned socket)
+{
+        struct pqos_l3ca ca[PQOSD_MAX_COS];
+        unsigned i, num = 0;
+        int ret;
+
+        ret = pqosd_l3ca_get(c, socket, PQOSD_MAX_COS, &num, ca);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        for (i=0;i<num;i++)
+                printf("COS%u => MASK 0x%llx\n", ca[i].class_id,
+                       (unsigned long long) ca[i].ways_mask);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Displays help information
+ */
+static void
+print_help(void)
+{
+        printf("Usage: pqosctl [-s <socket>] <command> [<args>]\n\n"
+               "Commands:\n"
+               "  ping [<count>]                   round trip time\n"
+               "  info                             platform information\n"
+               "  mon-start <cores> [<events>]     start monitoring group,\n"
+               "                                   events is a mask of\n"
+               "                                   enum pqos_mon_event\n"
+               "  mon-stop <group>                 stop monitoring group\n"
+               "  query [<group>]                  poll monitoring groups\n"
+               "  l3ca-set <socket> <cos> <mask>   set ways mask of COS\n"
+               "  l3ca-get <socket>                list classes of service\n"
+               "  assoc-set <core> <cos>           associate core with COS\n"
+               "  assoc-get <core>                 show COS of a core\n\n"
+               "Control socket defaults to %s.\n",
+               PQOSD_DEF_SOCKET);
+}
+
+int main(int argc, char **argv)
+{
+        static const struct option long_opts[] = {
+                { "socket", required_argument, NULL, 's' },
+                { "help",   no_argument,       NULL, 'h' },
+                { NULL, 0, NULL, 0 }
+        };
+        const char *path = NULL;
+        struct pqosd_client c;
+        const char *cmd;
+        uint64_t a[3] = {0, 0, 0};
+        unsigned nargs, i;
+        int opt, ret;
+
+        while ((opt = getopt_long(argc, argv, "+s:h", long_opts, NULL))!=-1) {
+                switch (opt) {
+                case 's':
+                        path = optarg;
+                        break;
+                case 'h':
+                        print_help();
+                        return EXIT_SUCCESS;
+                default:
+                        print_help();
+                        return EXIT_FAILURE;
+                }
+        }
+        if (optind>=argc) {
+                print_help();
+                return EXIT_FAILURE;
+        }
+        cmd = argv[optind++];
+        nargs = (unsigned) (argc - optind);
+
+        /**
+         * All arguments but the mon-start core list are numeric
+         */
+        if (nargs>DIM(a))
+                goto invalid;
+        for (i=(strcmp(cmd, "mon-start")==0) ? 1 : 0;i<nargs;i++)
+                if (parse_uint(argv[optind + i], &a[i])!=0)
+                        goto invalid;
+
+        ret = pqosd_connect(&c, path);
+        if (ret!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "Error connecting to '%s'!\n",
+                        path!=NULL ? path : PQOSD_DEF_SOCKET);
+                return EXIT_FAILURE;
+        }
+
+        if (strcmp(cmd, "ping")==0 && nargs<=1) {
+                ret = cmd_ping(&c, nargs ? (unsigned) a[0] : 1);
+        } else if (strcmp(cmd, "info")==0 && nargs==0) {
+                ret = cmd_info(&c);
+        } else if (strcmp(cmd, "mon-start")==0 && nargs>=1 && nargs<=2) {
+                unsigned cores[PQOSCTL_MAX_CORES], num, group = 0;
+
+                num = parse_cores(argv[optind], cores, DIM(cores));
+                if (num==0) {
+                        pqosd_disconnect(&c);
+                        goto invalid;
+                }
+                ret = pqosd_mon_start(&c, nargs>1 ?
+                                      (enum pqos_mon_event) a[1] :
+                                      PQOS_MON_EVENT_L3_OCCUP,
+                                      num, cores, &group);
+                if (ret==PQOS_RETVAL_OK)
+                        printf("group %u\n", group);
+        } else if (strcmp(cmd, "mon-stop")==0 && nargs==1) {
+                ret = pqosd_mon_stop(&c, (unsigned) a[0]);
+        } else if (strcmp(cmd, "query")==0 && nargs<=1) {
+                ret = cmd_query(&c, nargs ? (unsigned) a[0] :
+                                PQOSD_ALL_GROUPS);
+        } else if (strcmp(cmd, "l3ca-set")==0 && nargs==3) {
+                ret = pqosd_l3ca_set(&c, (unsigned) a[0], (unsigned) a[1],
+                                     a[2]);
+        } else if (strcmp(cmd, "l3ca-get")==0 && nargs==1) {
+                ret = cmd_l3ca_get(&c, (unsigned) a[0]);
+        } else if (strcmp(cmd, "assoc-set")==0 && nargs==2) {
+                ret = pqosd_assoc_set(&c, (unsigned) a[0], (unsigned) a[1]);
+        } else if (strcmp(cmd, "assoc-get")==0 && nargs==1) {
+                unsigned class_id = 0;
+
+                ret = pqosd_assoc_get(&c, (unsigned) a[0], &class_id);
+                if (ret==PQOS_RETVAL_OK)
+                        printf("Core %u => COS%u\n", (unsigned) a[0],
+                               class_id);
+        } else {
+                pqosd_disconnect(&c);
+                goto invalid;
+        }
+        pqosd_disconnect(&c);
+
+        if (ret!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "Command '%s' failed with status %d!\n",
+                        cmd, ret);
+                return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+
+ invalid:
+        fprintf(stderr, "Invalid command '%s'!\n", cmd);
+        print_help();
+        return EXIT_FAILURE;
+}
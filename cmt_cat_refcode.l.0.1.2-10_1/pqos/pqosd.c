@@ -0,0 +1,684 @@
+/**
+ * @file pqosd.c
+ * @brief PQoS daemon
+ *
+ * Holds PQoS library state for the lifetime of the process and
+ * serves monitoring and allocation requests from the control socket
+ * (see pqosd_proto.h), so clients can change the configuration
+ * without re-initializing the library. Monitoring groups persist
+ * until stopped by a client or the daemon exits.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "pqos.h"
+#include "sim.h"
+#include "pqosd_proto.h"
+
+#define PQOSD_MAX_CLIENTS 32                    /**< max connected clients */
+#define PQOSD_MAX_SOCKETS 8                     /**< max CPU sockets reported */
+
+/**
+ * Monitoring groups, slot index is the group id
+ */
+static struct pqos_mon_data m_groups[PQOSD_MAX_GROUPS];
+static int m_used[PQOSD_MAX_GROUPS];
+static unsigned m_num_groups = 0;
+
+/**
+ * Platform information
+ */
+static const struct pqos_cap *m_cap = NULL;
+static const struct pqos_cpuinfo *m_cpu = NULL;
+static uint32_t m_llc_scale = 1;
+
+/**
+ * Set by termination signals
+ */
+static volatile sig_atomic_t m_stop = 0;
+
+/**
+ * @brief Termination signal handler
+ */
+static void
+signal_handler(int signo)
+{
+        (void) signo;
+        m_stop = 1;
+}
+
+/**
+ * @brief Returns CLOCK_REALTIME time in nanoseconds
+ */
+static uint64_t
+now_ns(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_REALTIME, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Fills in platform information
+ */
+static int
+op_info(void *rsp, uint32_t *rsp_len)
+{
+        struct pqosd_info *info = (struct pqosd_info *) rsp;
+        const struct pqos_capability *item = NULL;
+        unsigned sockets[PQOSD_MAX_SOCKETS], num = 0;
+
+        memset(info, 0, sizeof(*info));
+        info->num_cores = m_cpu->num_cores;
+        if (pqos_cpu_get_sockets(m_cpu, PQOSD_MAX_SOCKETS,
+                                 &num, sockets)==PQOS_RETVAL_OK)
+                info->num_sockets = num;
+        if (pqos_cap_get_type(m_cap, PQOS_CAP_TYPE_L3CA,
+                              &item)==PQOS_RETVAL_OK) {
+                info->num_cos = item->u.l3ca->num_classes;
+                info->num_ways = item->u.l3ca->num_ways;
+        }
+        if (pqos_cap_get_type(m_cap, PQOS_CAP_TYPE_MON,
+                              &item)==PQOS_RETVAL_OK)
+                info->max_rmid = item->u.mon->max_rmid;
+        info->num_groups = m_num_groups;
+        info->llc_scale = m_llc_scale;
+        info->pid = (uint32_t) getpid();
+        *rsp_len = sizeof(*info);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Starts monitoring group
+ */
+static int
+op_mon_start(const void *req, const uint32_t req_len,
+             void *rsp, uint32_t *rsp_len)
+{
+        const struct pqosd_mon_start_req *r =
+                (const struct pqosd_mon_start_req *) req;
+        struct pqosd_mon_start_rsp *s = (struct pqosd_mon_start_rsp *) rsp;
+        unsigned cores[PQOSD_MAX_CORES];
+        unsigned i, id;
+        int ret;
+
+        if (req_len<sizeof(*r) || r->num_cores==0 ||
+            r->num_cores>PQOSD_MAX_CORES ||
+            req_len!=sizeof(*r) + r->num_cores * sizeof(r->cores[0]))
+                return PQOS_RETVAL_PARAM;
+
+        for (id=0;id<PQOSD_MAX_GROUPS;id++)
+                if (!m_used[id])
+                        break;
+        if (id>=PQOSD_MAX_GROUPS)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (i=0;i<r->num_cores;i++)
+                cores[i] = r->cores[i];
+        ret = pqos_mon_start(r->num_cores, cores,
+                             (enum pqos_mon_event) r->event,
+                             NULL, &m_groups[id]);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        m_used[id] = 1;
+        m_num_groups++;
+        s->group = id;
+        s->socket = m_groups[id].socket;
+        s->rmid = m_groups[id].rmid;
+        *rsp_len = sizeof(*s);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Stops monitoring group
+ */
+static int
+op_mon_stop(const void *req, const uint32_t req_len)
+{
+        const struct pqosd_group_req *r = (const struct pqosd_group_req *) req;
+        int ret;
+
+        if (req_len!=sizeof(*r) || r->group>=PQOSD_MAX_GROUPS ||
+            !m_used[r->group])
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqos_mon_stop(&m_groups[r->group]);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        memset(&m_groups[r->group], 0, sizeof(m_groups[0]));
+        m_used[r->group] = 0;
+        m_num_groups--;
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Polls selected monitoring groups
+ */
+static int
+op_mon_query(const void *req, const uint32_t req_len,
+             void *rsp, uint32_t *rsp_len)
+{
+        const struct pqosd_group_req *r = (const struct pqosd_group_req *) req;
+        struct pqosd_query_rsp *s = (struct pqosd_query_rsp *) rsp;
+        struct pqos_mon_data *grps[PQOSD_MAX_GROUPS];
+        unsigned ids[PQOSD_MAX_GROUPS];
+        unsigned i, num = 0;
+        uint64_t ts;
+        int ret;
+
+        if (req_len!=sizeof(*r))
+                return PQOS_RETVAL_PARAM;
+
+        if (r->group==PQOSD_ALL_GROUPS) {
+                for (i=0;i<PQOSD_MAX_GROUPS;i++)
+                        if (m_used[i]) {
+                                ids[num] = i;
+                                grps[num++] = &m_groups[i];
+                        }
+        } else {
+                if (r->group>=PQOSD_MAX_GROUPS || !m_used[r->group])
+                        return PQOS_RETVAL_PARAM;
+                ids[num] = r->group;
+                grps[num++] = &m_groups[r->group];
+        }
+
+        /**
+         * pqos_mon_poll() takes an array of groups,
+         * poll slots one by one as they are not contiguous
+         */
+        for (i=0;i<num;i++) {
+                ret = pqos_mon_poll(grps[i], 1);
+                if (ret!=PQOS_RETVAL_OK)
+                        return ret;
+        }
+        ts = now_ns();
+
+        memset(s, 0, sizeof(*s));
+        s->num = num;
+        for (i=0;i<num;i++) {
+                struct pqosd_sample *p = &s->samples[i];
+                const struct pqos_mon_data *g = grps[i];
+
+                memset(p, 0, sizeof(*p));
+                p->group = ids[i];
+                p->socket = g->socket;
+                p->rmid = g->rmid;
+                p->event = g->event;
+                p->core = g->cores[0];
+                p->num_cores = g->num_cores;
+                p->value = g->value;
+                if (g->event & PQOS_MON_EVENT_L3_OCCUP)
+                        p->value *= m_llc_scale;
+                p->timestamp = ts;
+                if (g->event & PQOS_PERF_EVENT_IPC)
+                        p->ipc = (uint32_t) (g->ipc * 1000.0 + 0.5);
+                if (g->event & PQOS_PERF_EVENT_LLC_MISS) {
+                        p->llc_misses = g->llc_misses;
+                        if (g->instructions>0)
+                                p->mpki = (uint32_t)
+                                        (((double) g->llc_misses * 1e6) /
+                                         (double) g->instructions + 0.5);
+                }
+                if (g->event & PQOS_PERF_EVENT_FREQ)
+                        p->freq = (uint32_t) (g->freq + 0.5);
+                if (g->event & PQOS_PWR_EVENT_PKG_ENERGY)
+                        p->pkg_power = (uint32_t) (g->pkg_power * 1000.0 +
+                                                   0.5);
+                if (g->event & PQOS_PWR_EVENT_DRAM_ENERGY)
+                        p->dram_power = (uint32_t) (g->dram_power * 1000.0 +
+                                                    0.5);
+        }
+        *rsp_len = sizeof(*s) + num * sizeof(s->samples[0]);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Sets ways mask of a class of service
+ */
+static int
+op_l3ca_set(const void *req, const uint32_t req_len)
+{
+        const struct pqosd_l3ca_req *r = (const struct pqosd_l3ca_req *) req;
+        struct pqos_l3ca ca;
+
+        if (req_len!=sizeof(*r))
+                return PQOS_RETVAL_PARAM;
+
+        ca.class_id = r->class_id;
+        ca.ways_mask = r->ways_mask;
+        return pqos_l3ca_set(r->socket, 1, &ca);
+}
+
+/**
+ * @brief Reads classes of service of a socket
+ */
+static int
+op_l3ca_get(const void *req, const uint32_t req_len,
+            void *rsp, uint32_t *rsp_len)
+{
+        const struct pqosd_l3ca_req *r = (const struct pqosd_l3ca_req *) req;
+        struct pqosd_l3ca_rsp *s = (struct pqosd_l3ca_rsp *) rsp;
+        struct pqos_l3ca ca[PQOSD_MAX_COS];
+        unsigned i, num = 0;
+        int ret;
+
+        if (req_len!=sizeof(*r))
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqos_l3ca_get(r->socket, PQOSD_MAX_COS, &num, ca);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        memset(s, 0, sizeof(*s));
+        s->num = num;
+        for (i=0;i<num;i++) {
+                s->cos[i].class_id = ca[i].class_id;
+                s->cos[i].reserved = 0;
+                s->cos[i].ways_mask = ca[i].ways_mask;
+        }
+        *rsp_len = sizeof(*s) + num * sizeof(s->cos[0]);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Associates core with a class of service
+ */
+static int
+op_assoc_set(const void *req, const uint32_t req_len)
+{
+        const struct pqosd_assoc_req *r = (const struct pqosd_assoc_req *) req;
+
+        if (req_len!=sizeof(*r))
+                return PQOS_RETVAL_PARAM;
+
+        return pqos_l3ca_assoc_set(r->lcore, r->class_id);
+}
+
+/**
+ * @brief Reads class of service of a core
+ */
+static int
+op_assoc_get(const void *req, const uint32_t req_len,
+             void *rsp, uint32_t *rsp_len)
+{
+        const struct pqosd_assoc_req *r = (const struct pqosd_assoc_req *) req;
+        struct pqosd_assoc_req *s = (struct pqosd_assoc_req *) rsp;
+        unsigned class_id = 0;
+        int ret;
+
+        if (req_len!=sizeof(*r))
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqos_l3ca_assoc_get(r->lcore, &class_id);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        s->lcore = r->lcore;
+        s->class_id = class_id;
+        *rsp_len = sizeof(*s);
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Serves one request of a client
+ *
+ * @param [in] fd client socket
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 client disconnected or sent malformed message
+ */
+static int
+serve(const int fd)
+{
+        uint64_t req_buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        uint64_t rsp_buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        struct pqosd_hdr *req = (struct pqosd_hdr *) req_buf;
+        struct pqosd_hdr *rsp = (struct pqosd_hdr *) rsp_buf;
+        const void *req_data = req + 1;
+        void *rsp_data = rsp + 1;
+        uint32_t req_len, rsp_len = 0;
+        ssize_t n;
+        int ret;
+
+        n = recv(fd, req_buf, sizeof(req_buf), 0);
+        if (n<=0)
+                return -1;
+        if ((size_t) n<sizeof(*req) || req->magic!=PQOSD_MAGIC ||
+            req->version!=PQOSD_VERSION ||
+            req->len!=(size_t) n - sizeof(*req))
+                return -1;
+        req_len = req->len;
+
+        switch (req->op) {
+        case PQOSD_OP_PING:
+                ret = PQOS_RETVAL_OK;
+                break;
+        case PQOSD_OP_INFO:
+                ret = op_info(rsp_data, &rsp_len);
+                break;
+        case PQOSD_OP_MON_START:
+                ret = op_mon_start(req_data, req_len, rsp_data, &rsp_len);
+                break;
+        case PQOSD_OP_MON_STOP:
+                ret = op_mon_stop(req_data, req_len);
+                break;
+        case PQOSD_OP_MON_QUERY:
+                ret = op_mon_query(req_data, req_len, rsp_data, &rsp_len);
+                break;
+        case PQOSD_OP_L3CA_SET:
+                ret = op_l3ca_set(req_data, req_len);
+                break;
+        case PQOSD_OP_L3CA_GET:
+                ret = op_l3ca_get(req_data, req_len, rsp_data, &rsp_len);
+                break;
+        case PQOSD_OP_ASSOC_SET:
+                ret = op_assoc_set(req_data, req_len);
+                break;
+        case PQOSD_OP_ASSOC_GET:
+                ret = op_assoc_get(req_data, req_len, rsp_data, &rsp_len);
+                break;
+        default:
+                ret = PQOS_RETVAL_PARAM;
+                break;
+        }
+
+        if (ret!=PQOS_RETVAL_OK)
+                rsp_len = 0;
+        rsp->magic = PQOSD_MAGIC;
+        rsp->version = PQOSD_VERSION;
+        rsp->op = req->op;
+        rsp->seq = req->seq;
+        rsp->status = ret;
+        rsp->len = rsp_len;
+        if (send(fd, rsp_buf, sizeof(*rsp) + rsp_len, MSG_NOSIGNAL)<0)
+                return -1;
+        return 0;
+}
+
+/**
+ * @brief Creates listening control socket
+ *
+ * @param [in] path socket path
+ *
+ * @return Socket descriptor or -1 on error
+ */
+static int
+listen_socket(const char *path)
+{
+        struct sockaddr_un addr;
+        struct stat st;
+        mode_t mask;
+        int fd, probe, ret;
+
+        if (strlen(path)>=sizeof(addr.sun_path)) {
+                fprintf(stderr, "Socket path '%s' too long!\n", path);
+                return -1;
+        }
+
+        fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (fd<0) {
+                perror("socket");
+                return -1;
+        }
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path, strlen(path));
+
+        /**
+         * Socket of a previous instance is removed only when no
+         * daemon answers on it, the socket is accessible to the
+         * owner only
+         */
+        probe = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (probe<0) {
+                perror("socket");
+                close(fd);
+                return -1;
+        }
+        ret = connect(probe, (struct sockaddr *) &addr, sizeof(addr));
+        if (ret!=0 && errno==ECONNREFUSED &&
+            lstat(path, &st)==0 && S_ISSOCK(st.st_mode))
+                unlink(path);
+        close(probe);
+        if (ret==0) {
+                fprintf(stderr, "pqosd already running on '%s'!\n", path);
+                close(fd);
+                return -1;
+        }
+        mask = umask(077);
+        ret = bind(fd, (struct sockaddr *) &addr, sizeof(addr));
+        umask(mask);
+        if (ret!=0 || listen(fd, PQOSD_MAX_CLIENTS)!=0) {
+                fprintf(stderr, "Error binding '%s': %s\n",
+                        path, strerror(errno));
+                close(fd);
+                return -1;
+        }
+        return fd;
+}
+
+/**
+ * @brief Serves clients until termination signal
+ *
+ * @param [in] lfd listening socket
+ */
+static void
+serve_loop(const int lfd)
+{
+        struct pollfd fds[PQOSD_MAX_CLIENTS + 1];
+        nfds_t nfds = 1, i;
+
+        fds[0].fd = lfd;
+        fds[0].events = POLLIN;
+
+        while (!m_stop) {
+                if (poll(fds, nfds, -1)<0) {
+                        if (errno==EINTR)
+                                continue;
+                        perror("poll");
+                        break;
+                }
+
+                /**
+                 * Serve clients, dropped ones are replaced with
+                 * the last entry
+                 */
+                for (i=1;i<nfds;) {
+                        if (fds[i].revents==0 ||
+                            ((fds[i].revents & POLLIN) &&
+                             serve(fds[i].fd)==0)) {
+                                i++;
+                                continue;
+                        }
+                        close(fds[i].fd);
+                        fds[i] = fds[--nfds];
+                }
+
+                if (fds[0].revents & POLLIN) {
+                        int fd = accept(lfd, NULL, NULL);
+
+                        if (fd<0)
+                                continue;
+                        if (nfds>PQOSD_MAX_CLIENTS) {
+                                close(fd);
+                                continue;
+                        }
+                        fds[nfds].fd = fd;
+                        fds[nfds].events = POLLIN;
+                        fds[nfds].revents = 0;
+                        nfds++;
+                }
+        }
+
+        for (i=1;i<nfds;i++)
+                close(fds[i].fd);
+}
+
+/**
+ * @brief Displays help information
+ */
+static void
+print_help(void)
+{
+        printf("Usage: pqosd [-s <socket>] [-r] [-l <log file>] [-v] "
+               "[--sim[=<spec>]]\n"
+               "       pqosd -h\n\n"
+               "Options:\n"
+               "  -s <socket>, --socket <socket>\n"
+               "          control socket path (default %s)\n"
+               "  -r, --reset-rmids\n"
+               "          reuse RMIDs marked in use by other tools\n"
+               "  -l <file>, --log-file <file>\n"
+               "          write library log to <file>\n"
+               "  -v, --verbose\n"
+               "          verbose library log\n"
+               "  --sim[=<spec>]\n"
+               "          run on simulated platform, see 'pqos -h'\n"
+               "  -h, --help\n"
+               "          this help\n",
+               PQOSD_DEF_SOCKET);
+}
+
+int main(int argc, char **argv)
+{
+        static const struct option long_opts[] = {
+                { "socket",      required_argument, NULL, 's' },
+                { "reset-rmids", no_argument,       NULL, 'r' },
+                { "log-file",    required_argument, NULL, 'l' },
+                { "verbose",     no_argument,       NULL, 'v' },
+                { "sim",         optional_argument, NULL, 'S' },
+                { "help",        no_argument,       NULL, 'h' },
+                { NULL, 0, NULL, 0 }
+        };
+        const char *path = PQOSD_DEF_SOCKET;
+        const char *log_file = NULL;
+        const char *sim_spec = NULL;
+        const struct pqos_monitor *l3mon = NULL;
+        struct pqos_config cfg;
+        struct sigaction sa;
+        int sim = 0, lfd = -1, ret, opt;
+        int exit_val = EXIT_SUCCESS;
+        unsigned i;
+
+        memset(&cfg, 0, sizeof(cfg));
+
+        while ((opt = getopt_long(argc, argv, "s:rl:vh",
+                                  long_opts, NULL))!=-1) {
+                switch (opt) {
+                case 's':
+                        path = optarg;
+                        break;
+                case 'r':
+                        cfg.free_in_use_rmid = 1;
+                        break;
+                case 'l':
+                        log_file = optarg;
+                        break;
+                case 'v':
+                        cfg.verbose = 1;
+                        break;
+                case 'S':
+                        sim = 1;
+                        sim_spec = optarg;
+                        break;
+                case 'h':
+                        print_help();
+                        return EXIT_SUCCESS;
+                default:
+                        print_help();
+                        return EXIT_FAILURE;
+                }
+        }
+
+        if (sim && sim_init(sim_spec, &cfg)!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "Invalid simulated platform specification "
+                        "'%s'!\n", sim_spec);
+                return EXIT_FAILURE;
+        }
+
+        /**
+         * Socket goes first so that a second instance does not
+         * initialize the library under a running daemon
+         */
+        lfd = listen_socket(path);
+        if (lfd<0) {
+                exit_val = EXIT_FAILURE;
+                goto error_exit_1;
+        }
+
+        /**
+         * The library closes its log on pqos_fini(),
+         * a duplicate keeps stderr open
+         */
+        if (log_file==NULL) {
+                cfg.fd_log = dup(STDERR_FILENO);
+        } else {
+                cfg.fd_log = open(log_file, O_WRONLY|O_CREAT|O_APPEND,
+                                  S_IRUSR|S_IWUSR);
+        }
+        if (cfg.fd_log==-1) {
+                fprintf(stderr, "Error opening log: %s\n", strerror(errno));
+                exit_val = EXIT_FAILURE;
+                goto error_exit_2;
+        }
+
+        ret = pqos_init(&cfg);
+        if (ret!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "Error initializing PQoS library!\n");
+                exit_val = EXIT_FAILURE;
+                goto error_exit_2;
+        }
+
+        ret = pqos_cap_get(&m_cap, &m_cpu);
+        if (ret!=PQOS_RETVAL_OK) {
+                fprintf(stderr, "Error retrieving PQoS capabilities!\n");
+                exit_val = EXIT_FAILURE;
+                goto error_exit_3;
+        }
+        if (pqos_cap_get_event(m_cap, PQOS_MON_EVENT_L3_OCCUP,
+                               &l3mon)==PQOS_RETVAL_OK)
+                m_llc_scale = l3mon->scale_factor;
+
+        /**
+         * No SA_RESTART so that the signal interrupts poll()
+         */
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = signal_handler;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        serve_loop(lfd);
+
+        for (i=0;i<PQOSD_MAX_GROUPS;i++)
+                if (m_used[i] && pqos_mon_stop(&m_groups[i])!=PQOS_RETVAL_OK)
+                        fprintf(stderr, "Error stopping group %u!\n", i);
+
+ error_exit_3:
+        ret = pqos_fini();
+        if (ret!=PQOS_RETVAL_OK)
+                fprintf(stderr, "Error shutting down PQoS library!\n");
+ error_exit_2:
+        close(lfd);
+        unlink(path);
+ error_exit_1:
+        if (sim)
+                sim_fini();
+        return exit_val;
+}
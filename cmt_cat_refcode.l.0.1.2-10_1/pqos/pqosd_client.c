@@ -0,0 +1,288 @@
+/**
+ * @file pqosd_client.c
+ * @brief Client library of the pqosd control socket
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "pqosd_client.h"
+
+/**
+ * @brief Sends request and receives its response
+ *
+ * @param [in,out] c connection
+ * @param [in] op operation
+ * @param [in] req request payload, can be NULL if \a req_len is 0
+ * @param [in] req_len request payload size
+ * @param [out] rsp response payload buffer, can be NULL
+ * @param [in] rsp_max size of \a rsp
+ * @param [out] rsp_len response payload size, can be NULL
+ *
+ * @return Operation status
+ */
+static int
+pqosd_call(struct pqosd_client *c, const enum pqosd_op op,
+           const void *req, const size_t req_len,
+           void *rsp, const size_t rsp_max, size_t *rsp_len)
+{
+        uint64_t buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        struct pqosd_hdr *hdr = (struct pqosd_hdr *) buf;
+        const uint32_t seq = ++c->seq;
+        ssize_t n;
+
+        if (c->fd<0 || req_len>sizeof(buf) - sizeof(*hdr))
+                return PQOS_RETVAL_PARAM;
+
+        hdr->magic = PQOSD_MAGIC;
+        hdr->version = PQOSD_VERSION;
+        hdr->op = (uint8_t) op;
+        hdr->seq = seq;
+        hdr->status = 0;
+        hdr->len = (uint32_t) req_len;
+        if (req_len>0)
+                memcpy(hdr + 1, req, req_len);
+
+        do {
+                n = send(c->fd, buf, sizeof(*hdr) + req_len, MSG_NOSIGNAL);
+        } while (n<0 && errno==EINTR);
+        if (n<0)
+                return PQOS_RETVAL_TRANSPORT;
+
+        do {
+                n = recv(c->fd, buf, sizeof(buf), 0);
+        } while (n<0 && errno==EINTR);
+        if (n<(ssize_t) sizeof(*hdr) || hdr->magic!=PQOSD_MAGIC ||
+            hdr->op!=op || hdr->seq!=seq ||
+            hdr->len!=(size_t) n - sizeof(*hdr))
+                return PQOS_RETVAL_TRANSPORT;
+        if (hdr->status!=PQOS_RETVAL_OK)
+                return hdr->status;
+        if (hdr->len>rsp_max)
+                return PQOS_RETVAL_TRANSPORT;
+
+        if (rsp!=NULL && hdr->len>0)
+                memcpy(rsp, hdr + 1, hdr->len);
+        if (rsp_len!=NULL)
+                *rsp_len = hdr->len;
+        return PQOS_RETVAL_OK;
+}
+
+int
+pqosd_connect(struct pqosd_client *c, const char *path)
+{
+        struct sockaddr_un addr;
+
+        if (c==NULL)
+                return PQOS_RETVAL_PARAM;
+        if (path==NULL)
+                path = PQOSD_DEF_SOCKET;
+        if (strlen(path)>=sizeof(addr.sun_path))
+                return PQOS_RETVAL_PARAM;
+
+        c->seq = 0;
+        c->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (c->fd<0)
+                return PQOS_RETVAL_TRANSPORT;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        memcpy(addr.sun_path, path, strlen(path));
+        if (connect(c->fd, (struct sockaddr *) &addr, sizeof(addr))!=0) {
+                close(c->fd);
+                c->fd = -1;
+                return PQOS_RETVAL_TRANSPORT;
+        }
+        return PQOS_RETVAL_OK;
+}
+
+void
+pqosd_disconnect(struct pqosd_client *c)
+{
+        if (c==NULL || c->fd<0)
+                return;
+        close(c->fd);
+        c->fd = -1;
+}
+
+int
+pqosd_ping(struct pqosd_client *c)
+{
+        return pqosd_call(c, PQOSD_OP_PING, NULL, 0, NULL, 0, NULL);
+}
+
+int
+pqosd_info_get(struct pqosd_client *c, struct pqosd_info *info)
+{
+        size_t len = 0;
+        int ret;
+
+        if (info==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqosd_call(c, PQOSD_OP_INFO, NULL, 0,
+                         info, sizeof(*info), &len);
+        if (ret==PQOS_RETVAL_OK && len!=sizeof(*info))
+                ret = PQOS_RETVAL_TRANSPORT;
+        return ret;
+}
+
+int
+pqosd_mon_start(struct pqosd_client *c, const enum pqos_mon_event event,
+                const unsigned num_cores, const unsigned *cores,
+                unsigned *group)
+{
+        uint64_t buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        struct pqosd_mon_start_req *req = (struct pqosd_mon_start_req *) buf;
+        struct pqosd_mon_start_rsp rsp;
+        size_t len = 0;
+        unsigned i;
+        int ret;
+
+        if (num_cores==0 || num_cores>PQOSD_MAX_CORES ||
+            cores==NULL || group==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        req->event = (uint32_t) event;
+        req->num_cores = num_cores;
+        for (i=0;i<num_cores;i++)
+                req->cores[i] = cores[i];
+
+        ret = pqosd_call(c, PQOSD_OP_MON_START, req,
+                         sizeof(*req) + num_cores * sizeof(req->cores[0]),
+                         &rsp, sizeof(rsp), &len);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        if (len!=sizeof(rsp))
+                return PQOS_RETVAL_TRANSPORT;
+        *group = rsp.group;
+        return PQOS_RETVAL_OK;
+}
+
+int
+pqosd_mon_stop(struct pqosd_client *c, const unsigned group)
+{
+        struct pqosd_group_req req;
+
+        req.group = group;
+        return pqosd_call(c, PQOSD_OP_MON_STOP, &req, sizeof(req),
+                          NULL, 0, NULL);
+}
+
+int
+pqosd_mon_query(struct pqosd_client *c, const unsigned group,
+                const unsigned max_num, unsigned *num,
+                struct pqosd_sample *samples)
+{
+        uint64_t buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        struct pqosd_query_rsp *rsp = (struct pqosd_query_rsp *) buf;
+        struct pqosd_group_req req;
+        size_t len = 0;
+        int ret;
+
+        if (num==NULL || (samples==NULL && max_num>0))
+                return PQOS_RETVAL_PARAM;
+
+        req.group = group;
+        ret = pqosd_call(c, PQOSD_OP_MON_QUERY, &req, sizeof(req),
+                         rsp, sizeof(buf) - sizeof(struct pqosd_hdr), &len);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        if (len<sizeof(*rsp) ||
+            len!=sizeof(*rsp) + rsp->num * sizeof(rsp->samples[0]))
+                return PQOS_RETVAL_TRANSPORT;
+        if (rsp->num>max_num)
+                return PQOS_RETVAL_RESOURCE;
+
+        memcpy(samples, rsp->samples, rsp->num * sizeof(rsp->samples[0]));
+        *num = rsp->num;
+        return PQOS_RETVAL_OK;
+}
+
+int
+pqosd_l3ca_set(struct pqosd_client *c, const unsigned socket,
+               const unsigned class_id, const uint64_t ways_mask)
+{
+        struct pqosd_l3ca_req req;
+
+        req.socket = socket;
+        req.class_id = class_id;
+        req.ways_mask = ways_mask;
+        return pqosd_call(c, PQOSD_OP_L3CA_SET, &req, sizeof(req),
+                          NULL, 0, NULL);
+}
+
+int
+pqosd_l3ca_get(struct pqosd_client *c, const unsigned socket,
+               const unsigned max_num_ca, unsigned *num_ca,
+               struct pqos_l3ca *ca)
+{
+        uint64_t buf[PQOSD_MAX_MSG / sizeof(uint64_t)];
+        struct pqosd_l3ca_rsp *rsp = (struct pqosd_l3ca_rsp *) buf;
+        struct pqosd_l3ca_req req;
+        size_t len = 0;
+        unsigned i;
+        int ret;
+
+        if (num_ca==NULL || (ca==NULL && max_num_ca>0))
+                return PQOS_RETVAL_PARAM;
+
+        memset(&req, 0, sizeof(req));
+        req.socket = socket;
+        ret = pqosd_call(c, PQOSD_OP_L3CA_GET, &req, sizeof(req),
+                         rsp, sizeof(buf) - sizeof(struct pqosd_hdr), &len);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        if (len<sizeof(*rsp) ||
+            len!=sizeof(*rsp) + rsp->num * sizeof(rsp->cos[0]))
+                return PQOS_RETVAL_TRANSPORT;
+        if (rsp->num>max_num_ca)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (i=0;i<rsp->num;i++) {
+                ca[i].class_id = rsp->cos[i].class_id;
+                ca[i].ways_mask = rsp->cos[i].ways_mask;
+        }
+        *num_ca = rsp->num;
+        return PQOS_RETVAL_OK;
+}
+
+int
+pqosd_assoc_set(struct pqosd_client *c, const unsigned lcore,
+                const unsigned class_id)
+{
+        struct pqosd_assoc_req req;
+
+        req.lcore = lcore;
+        req.class_id = class_id;
+        return pqosd_call(c, PQOSD_OP_ASSOC_SET, &req, sizeof(req),
+                          NULL, 0, NULL);
+}
+
+int
+pqosd_assoc_get(struct pqosd_client *c, const unsigned lcore,
+                unsigned *class_id)
+{
+        struct pqosd_assoc_req req, rsp;
+        size_t len = 0;
+        int ret;
+
+        if (class_id==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        req.lcore = lcore;
+        req.class_id = 0;
+        ret = pqosd_call(c, PQOSD_OP_ASSOC_GET, &req, sizeof(req),
+                         &rsp, sizeof(rsp), &len);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        if (len!=sizeof(rsp))
+                return PQOS_RETVAL_TRANSPORT;
+        *class_id = rsp.class_id;
+        return PQOS_RETVAL_OK;
+}
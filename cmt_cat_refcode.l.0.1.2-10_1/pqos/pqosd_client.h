@@ -0,0 +1,165 @@
+/**
+ * @file pqosd_client.h
+ * @brief Client library of the pqosd control socket
+ *
+ * Calls are synchronous, each sends one request and waits for its
+ * response. Functions return the PQOS_RETVAL_* status reported by
+ * the daemon or PQOS_RETVAL_TRANSPORT if the daemon could not be
+ * reached or replied with a malformed message.
+ */
+
+#ifndef __PQOSD_CLIENT_H__
+#define __PQOSD_CLIENT_H__
+
+#include <stdint.h>
+
+#include "pqos.h"
+#include "pqosd_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Connection to the daemon
+ */
+struct pqosd_client {
+        int fd;
+        uint32_t seq;                           /**< last request number */
+};
+
+/**
+ * @brief Connects to the daemon
+ *
+ * @param [out] c connection
+ * @param [in] path control socket, NULL selects PQOSD_DEF_SOCKET
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_TRANSPORT daemon not reachable
+ */
+int pqosd_connect(struct pqosd_client *c, const char *path);
+
+/**
+ * @brief Closes connection
+ *
+ * @param [in,out] c connection
+ */
+void pqosd_disconnect(struct pqosd_client *c);
+
+/**
+ * @brief Checks the daemon responds
+ *
+ * @param [in,out] c connection
+ *
+ * @return Operation status
+ */
+int pqosd_ping(struct pqosd_client *c);
+
+/**
+ * @brief Reads platform information
+ *
+ * @param [in,out] c connection
+ * @param [out] info platform information
+ *
+ * @return Operation status
+ */
+int pqosd_info_get(struct pqosd_client *c, struct pqosd_info *info);
+
+/**
+ * @brief Starts monitoring group
+ *
+ * @param [in,out] c connection
+ * @param [in] event monitoring event
+ * @param [in] num_cores number of cores in \a cores
+ * @param [in] cores cores of the group, all on the same socket
+ * @param [out] group group id
+ *
+ * @return Operation status
+ */
+int pqosd_mon_start(struct pqosd_client *c, const enum pqos_mon_event event,
+                    const unsigned num_cores, const unsigned *cores,
+                    unsigned *group);
+
+/**
+ * @brief Stops monitoring group
+ *
+ * @param [in,out] c connection
+ * @param [in] group group id
+ *
+ * @return Operation status
+ */
+int pqosd_mon_stop(struct pqosd_client *c, const unsigned group);
+
+/**
+ * @brief Polls monitoring groups
+ *
+ * @param [in,out] c connection
+ * @param [in] group group id or PQOSD_ALL_GROUPS
+ * @param [in] max_num size of \a samples
+ * @param [out] num number of samples stored
+ * @param [out] samples samples of selected groups
+ *
+ * @return Operation status
+ */
+int pqosd_mon_query(struct pqosd_client *c, const unsigned group,
+                    const unsigned max_num, unsigned *num,
+                    struct pqosd_sample *samples);
+
+/**
+ * @brief Sets ways mask of a class of service
+ *
+ * @param [in,out] c connection
+ * @param [in] socket CPU socket id
+ * @param [in] class_id class of service
+ * @param [in] ways_mask ways mask
+ *
+ * @return Operation status
+ */
+int pqosd_l3ca_set(struct pqosd_client *c, const unsigned socket,
+                   const unsigned class_id, const uint64_t ways_mask);
+
+/**
+ * @brief Reads classes of service of a socket
+ *
+ * @param [in,out] c connection
+ * @param [in] socket CPU socket id
+ * @param [in] max_num_ca size of \a ca
+ * @param [out] num_ca number of classes read
+ * @param [out] ca classes of service
+ *
+ * @return Operation status
+ */
+int pqosd_l3ca_get(struct pqosd_client *c, const unsigned socket,
+                   const unsigned max_num_ca, unsigned *num_ca,
+                   struct pqos_l3ca *ca);
+
+/**
+ * @brief Associates core with a class of service
+ *
+ * @param [in,out] c connection
+ * @param [in] lcore CPU logical core id
+ * @param [in] class_id class of service
+ *
+ * @return Operation status
+ */
+int pqosd_assoc_set(struct pqosd_client *c, const unsigned lcore,
+                    const unsigned class_id);
+
+/**
+ * @brief Reads class of service of a core
+ *
+ * @param [in,out] c connection
+ * @param [in] lcore CPU logical core id
+ * @param [out] class_id class of service
+ *
+ * @return Operation status
+ */
+int pqosd_assoc_get(struct pqosd_client *c, const unsigned lcore,
+                    unsigned *class_id);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PQOSD_CLIENT_H__ */
@@ -0,0 +1,175 @@
+/**
+ * @file pqosd_proto.h
+ * @brief Request/response protocol of the pqosd control socket
+ *
+ * Messages travel over a SOCK_SEQPACKET unix socket, so every
+ * request and response is a single datagram: a fixed header followed
+ * by an operation specific payload of 32 and 64-bit fields in host
+ * byte order. Responses echo operation and sequence number of the
+ * request and carry a PQOS_RETVAL_* status.
+ */
+
+#ifndef __PQOSD_PROTO_H__
+#define __PQOSD_PROTO_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PQOSD_DEF_SOCKET  "/var/run/pqosd.sock"  /**< default control socket */
+#define PQOSD_MAGIC       0x5051                  /**< "PQ" */
+#define PQOSD_VERSION     2
+#define PQOSD_MAX_MSG     16384                   /**< max message size */
+#define PQOSD_MAX_GROUPS  128                     /**< max monitoring groups */
+#define PQOSD_MAX_CORES   ((PQOSD_MAX_MSG - sizeof(struct pqosd_hdr) - \
+                            sizeof(struct pqosd_mon_start_req)) / \
+                           sizeof(uint32_t))     /**< max cores in a group */
+#define PQOSD_MAX_COS     64                      /**< max classes in a reply */
+#define PQOSD_ALL_GROUPS  0xffffffffU             /**< query selector */
+
+/**
+ * Operations
+ */
+enum pqosd_op {
+        PQOSD_OP_PING = 1,                      /**< no payload */
+        PQOSD_OP_INFO,                          /**< -> pqosd_info */
+        PQOSD_OP_MON_START,                     /**< pqosd_mon_start_req ->
+                                                   pqosd_mon_start_rsp */
+        PQOSD_OP_MON_STOP,                      /**< pqosd_group_req */
+        PQOSD_OP_MON_QUERY,                     /**< pqosd_group_req ->
+                                                   pqosd_query_rsp */
+        PQOSD_OP_L3CA_SET,                      /**< pqosd_l3ca_req */
+        PQOSD_OP_L3CA_GET,                      /**< pqosd_l3ca_req ->
+                                                   pqosd_l3ca_rsp */
+        PQOSD_OP_ASSOC_SET,                     /**< pqosd_assoc_req */
+        PQOSD_OP_ASSOC_GET,                     /**< pqosd_assoc_req ->
+                                                   pqosd_assoc_req */
+};
+
+/**
+ * Message header
+ */
+struct pqosd_hdr {
+        uint16_t magic;
+        uint8_t version;
+        uint8_t op;                             /**< enum pqosd_op */
+        uint32_t seq;                           /**< echoed in the response */
+        int32_t status;                         /**< response PQOS_RETVAL_* */
+        uint32_t len;                           /**< payload size */
+};
+
+/**
+ * Platform information
+ */
+struct pqosd_info {
+        uint32_t num_cores;
+        uint32_t num_sockets;
+        uint32_t num_cos;                       /**< 0 if CAT not supported */
+        uint32_t num_ways;
+        uint32_t max_rmid;                      /**< 0 if CMT not supported */
+        uint32_t num_groups;                    /**< groups started */
+        uint32_t llc_scale;                     /**< LLC occupancy scale factor */
+        uint32_t pid;                           /**< daemon process id */
+};
+
+/**
+ * Monitoring group start request
+ */
+struct pqosd_mon_start_req {
+        uint32_t event;                         /**< enum pqos_mon_event */
+        uint32_t num_cores;
+        uint32_t cores[0];
+};
+
+/**
+ * Monitoring group start response
+ */
+struct pqosd_mon_start_rsp {
+        uint32_t group;                         /**< group id */
+        uint32_t socket;
+        uint32_t rmid;
+};
+
+/**
+ * Request selecting a monitoring group
+ */
+struct pqosd_group_req {
+        uint32_t group;                         /**< id or PQOSD_ALL_GROUPS */
+};
+
+/**
+ * Sample of a monitoring group
+ *
+ * Core performance counter, frequency and power fields cover the time
+ * since the previous query of the group and are 0 for events the
+ * group does not monitor.
+ */
+struct pqosd_sample {
+        uint32_t group;
+        uint32_t socket;
+        uint32_t rmid;
+        uint32_t event;
+        uint32_t core;                          /**< first core of the group */
+        uint32_t num_cores;
+        uint64_t value;                         /**< bytes for LLC occupancy */
+        uint64_t timestamp;                     /**< CLOCK_REALTIME ns */
+        uint64_t llc_misses;
+        uint32_t ipc;                           /**< IPC in thousandths */
+        uint32_t mpki;                          /**< MPKI in thousandths */
+        uint32_t freq;                          /**< MHz */
+        uint32_t pkg_power;                     /**< package mW */
+        uint32_t dram_power;                    /**< DRAM mW */
+        uint32_t reserved;
+};
+
+/**
+ * Monitoring query response
+ */
+struct pqosd_query_rsp {
+        uint32_t num;
+        uint32_t reserved;
+        struct pqosd_sample samples[0];
+};
+
+/**
+ * Class of service request
+ */
+struct pqosd_l3ca_req {
+        uint32_t socket;
+        uint32_t class_id;                      /**< not used by L3CA_GET */
+        uint64_t ways_mask;                     /**< not used by L3CA_GET */
+};
+
+/**
+ * Class of service definition
+ */
+struct pqosd_cos {
+        uint32_t class_id;
+        uint32_t reserved;
+        uint64_t ways_mask;
+};
+
+/**
+ * Classes of service of a socket
+ */
+struct pqosd_l3ca_rsp {
+        uint32_t num;
+        uint32_t reserved;
+        struct pqosd_cos cos[0];
+};
+
+/**
+ * Core association request and ASSOC_GET response
+ */
+struct pqosd_assoc_req {
+        uint32_t lcore;
+        uint32_t class_id;
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __PQOSD_PROTO_H__ */
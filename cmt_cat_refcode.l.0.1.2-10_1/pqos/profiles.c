@@ -35,9 +35,15 @@
 
 /**
  * @brief  Set of utility functions to list and retrieve L3CA setting profiles
+ *
+ * Profiles are generated from a policy for given number of cache ways
+ * and classes of service. Masks of common geometries are computed at
+ * compile time, other geometries are generated on request.
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #ifdef DEBUG
 #include <assert.h>
 #endif
@@ -55,194 +61,117 @@
 #endif
 
 /**
- * 12-cache ways
+ * Profile policies
  */
-static const char *classes_way12_overlapN_equalY[] = {
-        "0=0x007",
-        "1=0x038",
-        "2=0x1C0",
-        "3=0xE00"
-};
-
-static const char *classes_way12_overlapN_equalN[] = {
-        "0=0x03F",
-        "1=0x0C0",
-        "2=0x300",
-        "3=0xC00"
-};
-
-static const char *classes_way12_overlapP0_equalN[] = {
-        "0=0xFFF",
-        "1=0x0C0",
-        "2=0x300",
-        "3=0xC00"
-};
-
-static const char *classes_way12_overlapY_equalN[] = {
-        "0=0xFFF",
-        "1=0xFF0",
-        "2=0xF00",
-        "3=0xC00"
+enum profile_policy {
+        PROFILE_EQUAL = 0,              /**< CFG0 */
+        PROFILE_UNEQUAL,                /**< CFG1 */
+        PROFILE_OVERLAP_P0,             /**< CFG2 */
+        PROFILE_OVERLAP,                /**< CFG3 */
 };
 
 /**
- * 16-cache ways
+ * Mask of \a len ways starting from way \a start
  */
-static const char *classes_way16_overlapN_equalY[] = {
-        "0=0x000F",
-        "1=0x00F0",
-        "2=0x0F00",
-        "3=0xF000"
-};
+#define WAYS(start, len) \
+        (((start) >= 64) ? 0ULL : \
+         ((((len) >= 64) ? ~0ULL : ((1ULL << (len)) - 1ULL)) << (start)))
 
-static const char *classes_way16_overlapN_equalN[] = {
-        "0=0x03FF",
-        "1=0x0C00",
-        "2=0x3000",
-        "3=0xC000"
-};
+/**
+ * CFG0: non-overlapping, ways equally divided,
+ * remainder goes to the lowest classes
+ */
+#define EQ_LEN(w, n, i)   ((w)/(n) + (((i) < (w)%(n)) ? 1 : 0))
+#define EQ_START(w, n, i) \
+        ((i)*((w)/(n)) + (((i) < (w)%(n)) ? (i) : (w)%(n)))
 
-static const char *classes_way16_overlapP0_equalN[] = {
-        "0=0xFFFF",
-        "1=0x0C00",
-        "2=0x3000",
-        "3=0xC000"
-};
+/**
+ * CFG1: non-overlapping, classes 1 and up get an even number of ways
+ * at the top of the cache, class 0 gets the rest
+ */
+#define UNEQ_K(w, n)      ((((w)/((n)+1)) & ~1U) ? (((w)/((n)+1)) & ~1U) : 1U)
+#define UNEQ_LEN(w, n, i) \
+        (((i) == 0) ? (w) - ((n)-1)*UNEQ_K(w, n) : UNEQ_K(w, n))
+#define UNEQ_START(w, n, i) \
+        (((i) == 0) ? 0 : (w) - ((n)-(i))*UNEQ_K(w, n))
 
-static const char *classes_way16_overlapY_equalN[] = {
-        "0=0xFFFF",
-        "1=0xFF00",
-        "2=0xF000",
-        "3=0xC000"
-};
+/**
+ * CFG2: class 0 can access all ways,
+ * classes 1 and up get 2 ways each at the top of the cache
+ */
+#define P0_K(w, n)        ((2*((n)-1) < (w)) ? 2U : 1U)
+#define P0_LEN(w, n, i)   (((i) == 0) ? (w) : P0_K(w, n))
+#define P0_START(w, n, i) (((i) == 0) ? 0 : (w) - ((n)-(i))*P0_K(w, n))
 
 /**
- * 20-cache ways
+ * CFG3: class 0 can access all ways, class i gets 2^(n-i) top ways
  */
-static const char *classes_way20_overlapN_equalY[] = {
-        "0=0x0001F",
-        "1=0x003E0",
-        "2=0x07C00",
-        "3=0xF8000"
-};
+#define OV_LEN(w, n, i) \
+        (((i) == 0 || (n)-(i) >= 32 || (1U << ((n)-(i))) >= (w)) ? \
+         (w) : (1U << ((n)-(i))))
+#define OV_START(w, n, i) ((w) - OV_LEN(w, n, i))
 
-static const char *classes_way20_overlapN_equalN[] = {
-        "0=0x000FF",
-        "1=0x00F00",
-        "2=0x0F000",
-        "3=0xF000"
-};
+/**
+ * Ways mask of class \a i for policy \a p,
+ * \a w ways and \a n classes of service
+ */
+#define PROFILE_MASK(p, w, n, i) \
+        ((p) == PROFILE_EQUAL ? WAYS(EQ_START(w, n, i), EQ_LEN(w, n, i)) : \
+         (p) == PROFILE_UNEQUAL ? WAYS(UNEQ_START(w, n, i), UNEQ_LEN(w, n, i)) : \
+         (p) == PROFILE_OVERLAP_P0 ? WAYS(P0_START(w, n, i), P0_LEN(w, n, i)) : \
+         WAYS(OV_START(w, n, i), OV_LEN(w, n, i)))
 
-static const char *classes_way20_overlapP0_equalN[] = {
-        "0=0xFFFFF",
-        "1=0x0C000",
-        "2=0x30000",
-        "3=0xC0000"
-};
+#define PROFILE_TAB4(p, w) {                                            \
+                PROFILE_MASK(p, w, 4, 0), PROFILE_MASK(p, w, 4, 1),     \
+                PROFILE_MASK(p, w, 4, 2), PROFILE_MASK(p, w, 4, 3) }
 
-static const char *classes_way20_overlapY_equalN[] = {
-        "0=0xFFFFF",
-        "1=0xFF000",
-        "2=0xF0000",
-        "3=0xC0000"
-};
+#define PROFILE_GEOMETRY4(w) {                                          \
+                .num_ways = w,                                          \
+                .num_classes = 4,                                       \
+                .masks = {                                              \
+                        PROFILE_TAB4(PROFILE_EQUAL, w),                 \
+                        PROFILE_TAB4(PROFILE_UNEQUAL, w),               \
+                        PROFILE_TAB4(PROFILE_OVERLAP_P0, w),            \
+                        PROFILE_TAB4(PROFILE_OVERLAP, w) } }
 
 /**
- * meat and potatos now :)
+ * Precomputed profiles of common cache geometries
  */
-struct llc_allocation_config {
+static const struct {
         unsigned num_ways;
         unsigned num_classes;
-        const char **tab;
-};
-
-static const struct llc_allocation_config config_cfg0[] = {
-        { .num_ways=12,
-          .num_classes=4,
-          .tab = classes_way12_overlapN_equalY,
-        },
-        { .num_ways=16,
-          .num_classes=4,
-          .tab = classes_way16_overlapN_equalY,
-        },
-        { .num_ways=20,
-          .num_classes=4,
-          .tab = classes_way20_overlapN_equalY,
-        }
-};
-
-static const struct llc_allocation_config config_cfg1[] = {
-        { .num_ways=12,
-          .num_classes=4,
-          .tab = classes_way12_overlapN_equalN,
-        },
-        { .num_ways=16,
-          .num_classes=4,
-          .tab = classes_way16_overlapN_equalN,
-        },
-        { .num_ways=20,
-          .num_classes=4,
-          .tab = classes_way20_overlapN_equalN,
-        }
-};
-
-static const struct llc_allocation_config config_cfg2[] = {
-        { .num_ways=12,
-          .num_classes=4,
-          .tab = classes_way12_overlapP0_equalN,
-        },
-        { .num_ways=16,
-          .num_classes=4,
-          .tab = classes_way16_overlapP0_equalN,
-        },
-        { .num_ways=20,
-          .num_classes=4,
-          .tab = classes_way20_overlapP0_equalN,
-        },
-};
-
-static const struct llc_allocation_config config_cfg3[] = {
-        { .num_ways=12,
-          .num_classes=4,
-          .tab = classes_way12_overlapY_equalN,
-        },
-        { .num_ways=16,
-          .num_classes=4,
-          .tab = classes_way16_overlapY_equalN,
-        },
-        { .num_ways=20,
-          .num_classes=4,
-          .tab = classes_way20_overlapY_equalN,
-        },
+        uint64_t masks[4][4];                   /**< [policy][class] */
+} profile_tab[] = {
+        PROFILE_GEOMETRY4(11),
+        PROFILE_GEOMETRY4(12),
+        PROFILE_GEOMETRY4(15),
+        PROFILE_GEOMETRY4(16),
+        PROFILE_GEOMETRY4(19),
+        PROFILE_GEOMETRY4(20),
 };
 
 struct llc_allocation {
         const char *id;
         const char *descr;
-        unsigned num_config;
-        const struct llc_allocation_config *config;
+        enum profile_policy policy;
 };
 
 static const struct llc_allocation allocation_tab[] = {
         { .id = "CFG0",
           .descr = "non-overlapping, ways equally divided",
-          .num_config = DIM(config_cfg0),
-          .config = config_cfg0,
+          .policy = PROFILE_EQUAL,
         },
         { .id = "CFG1",
           .descr = "non-overlapping, ways unequally divided",
-          .num_config = DIM(config_cfg1),
-          .config = config_cfg1,
+          .policy = PROFILE_UNEQUAL,
         },
         { .id = "CFG2",
           .descr = "overlapping, ways unequally divided, class 0 can access all ways",
-          .num_config = DIM(config_cfg2),
-          .config = config_cfg2,
+          .policy = PROFILE_OVERLAP_P0,
         },
         { .id = "CFG3",
           .descr = "ways unequally divided, overlapping access for higher classes",
-          .num_config = DIM(config_cfg3),
-          .config = config_cfg3,
+          .policy = PROFILE_OVERLAP,
         },
 };
 
@@ -263,40 +192,197 @@ void profile_l3ca_list(FILE *fp)
                         i+1,
                         allocation_tab[i].id,
                         allocation_tab[i].descr);
-                for (j=0;j<allocation_tab[i].num_config;j++) {
+                for (j=0;j<DIM(profile_tab);j++) {
                         fprintf(fp,
                                 "\tnumber of classes = %u, number of cache ways = %u\n",
-                                (unsigned) allocation_tab[i].config[j].num_classes,
-                                (unsigned) allocation_tab[i].config[j].num_ways);
+                                profile_tab[j].num_classes,
+                                profile_tab[j].num_ways);
                 }
+                fprintf(fp, "\tother geometries generated on request\n");
         }
 }
 
+/**
+ * @brief Moves \a mask into \a allowed ways
+ *
+ * The same number of ways is placed closest to the original position.
+ * If no range of allowed ways is long enough the longest one is used.
+ *
+ * @param mask ways mask to move
+ * @param allowed mask of allowed ways
+ * @param num_ways number of cache ways
+ *
+ * @return Moved mask, 0 if no way is allowed
+ */
+static uint64_t
+profile_steer(const uint64_t mask,
+              const uint64_t allowed,
+              const unsigned num_ways)
+{
+        unsigned i, len = 0, start = 0, dist = 0, best_dist = ~0U;
+        unsigned run = 0, best_run = 0, run_start = 0, best_start = 0;
+        uint64_t best = 0;
+
+        if ((mask & ~allowed)==0)
+                return mask;
+
+        for (i=0;i<num_ways;i++)
+                if (mask & (1ULL << i)) {
+                        if (len==0)
+                                start = i;
+                        len++;
+                }
+
+        for (i=0;i+len<=num_ways && len>0;i++) {
+                const uint64_t m = WAYS(i, len);
+
+                if ((m & allowed)!=m)
+                        continue;
+                dist = (i>start) ? i-start : start-i;
+                if (dist<best_dist) {
+                        best_dist = dist;
+                        best = m;
+                }
+        }
+        if (best!=0)
+                return best;
+
+        for (i=0;i<num_ways;i++) {
+                if (!(allowed & (1ULL << i))) {
+                        run = 0;
+                        continue;
+                }
+                if (run==0)
+                        run_start = i;
+                run++;
+                if (run>best_run) {
+                        best_run = run;
+                        best_start = run_start;
+                }
+        }
+
+        return (best_run==0) ? 0 : WAYS(best_start, best_run);
+}
+
+/**
+ * @brief Parses list of classes separated with '+'
+ *
+ * @param str list of classes
+ *
+ * @return Bit mask of listed classes
+ */
+static unsigned
+profile_class_list(const char *str)
+{
+        unsigned set = 0;
+
+        while (*str!='\0') {
+                char *end = NULL;
+                unsigned long c = strtoul(str, &end, 0);
+
+                if (end==str)
+                        break;
+                if (c<32)
+                        set |= 1U << c;
+                str = (*end=='+') ? end+1 : end;
+        }
+        return set;
+}
+
 int profile_l3ca_get(const char *id, const struct pqos_cap_l3ca *l3ca,
-                           unsigned *p_num, const char ***p_tab)
+                     const unsigned max_num, unsigned *p_num,
+                     struct pqos_l3ca *tab)
 {
-        unsigned i=0, j=0;
+        const uint64_t all_ways = WAYS(0, l3ca->num_ways);
+        char *cp = NULL, *tok = NULL, *saveptr = NULL;
+        unsigned i=0, j=0, num_classes = 0, n = 0;
+        unsigned noio = 0, io = 0;
+        int ret = PQOS_RETVAL_OK;
 
         ASSERT(id!=NULL);
         ASSERT(l3ca!=NULL);
-        ASSERT(p_tab!=NULL);
+        ASSERT(tab!=NULL);
         ASSERT(p_num!=NULL);
 
-        if (id==NULL || l3ca==NULL || p_tab==NULL || p_num==NULL)
+        if (id==NULL || l3ca==NULL || tab==NULL || p_num==NULL ||
+            max_num==0)
                 return PQOS_RETVAL_PARAM;
 
-        for (i=0;i<DIM(allocation_tab);i++) {
-                if (strcasecmp(id,allocation_tab[i].id)!=0)
-                        continue;
-                for (j=0;j<allocation_tab[i].num_config;j++) {
-                        if (allocation_tab[i].config[j].num_classes!=l3ca->num_classes ||
-                            allocation_tab[i].config[j].num_ways!=l3ca->num_ways)
-                                continue;
-                        *p_num = allocation_tab[i].config[j].num_classes;
-                        *p_tab = allocation_tab[i].config[j].tab;
-                        return PQOS_RETVAL_OK;
-                }
+        /**
+         * Accept "[llc:]<id>[:<number of classes>][:noio=<classes>]
+         * [:io=<classes>]"
+         */
+        if (strncasecmp(id,"llc:",4)==0)
+                id += 4;
+        cp = strdup(id);
+        if (cp==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        tok = strtok_r(cp, ":", &saveptr);
+        for (i=0;i<DIM(allocation_tab) && tok!=NULL;i++)
+                if (strcasecmp(tok,allocation_tab[i].id)==0)
+                        break;
+        if (tok==NULL || i>=DIM(allocation_tab)) {
+                free(cp);
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        num_classes = (l3ca->num_classes>max_num) ?
+                max_num : l3ca->num_classes;
+        while ((tok = strtok_r(NULL, ":", &saveptr))!=NULL) {
+                if (strncasecmp(tok,"noio=",5)==0)
+                        noio |= profile_class_list(tok+5);
+                else if (strncasecmp(tok,"io=",3)==0)
+                        io |= profile_class_list(tok+3);
+                else
+                        num_classes = (unsigned) strtoul(tok,NULL,0);
+        }
+        free(cp);
+
+        if (num_classes==0 || num_classes>l3ca->num_classes ||
+            num_classes>max_num || (noio & io)!=0)
+                return PQOS_RETVAL_PARAM;
+
+        if ((noio!=0 || io!=0) && l3ca->io_mask==0)
+                return PQOS_RETVAL_RESOURCE;            /**< I/O ways unknown */
+
+        for (j=0;j<DIM(profile_tab);j++)
+                if (profile_tab[j].num_classes==num_classes &&
+                    profile_tab[j].num_ways==l3ca->num_ways)
+                        break;
+
+        for (n=0; n<num_classes; n++) {
+                const enum profile_policy pol = allocation_tab[i].policy;
+
+                tab[n].class_id = n;
+                if (j<DIM(profile_tab))
+                        tab[n].ways_mask = profile_tab[j].masks[pol][n];
+                else
+                        tab[n].ways_mask =
+                                PROFILE_MASK(pol, l3ca->num_ways,
+                                             num_classes, n);
+
+                /**
+                 * Steer selected classes away from or onto I/O ways
+                 */
+                if (noio & (1U << n))
+                        tab[n].ways_mask = profile_steer(tab[n].ways_mask,
+                                                         all_ways & ~l3ca->io_mask,
+                                                         l3ca->num_ways);
+                if (io & (1U << n))
+                        tab[n].ways_mask = profile_steer(tab[n].ways_mask,
+                                                         l3ca->io_mask,
+                                                         l3ca->num_ways);
+
+                /**
+                 * Too many classes for the cache - profile not available
+                 */
+                if (pqos_l3ca_mask_check(l3ca,tab[n].ways_mask)!=
+                    PQOS_RETVAL_OK)
+                        ret = PQOS_RETVAL_RESOURCE;
         }
 
-        return PQOS_RETVAL_RESOURCE;
+        if (ret==PQOS_RETVAL_OK)
+                *p_num = num_classes;
+        return ret;
 }
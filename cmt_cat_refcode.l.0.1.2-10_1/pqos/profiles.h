@@ -57,17 +57,25 @@ void profile_l3ca_list(FILE *fp);
 
 /** 
  * @brief Retrieves selected L3CA profile by its \a id
+ *
+ * Profile \a id can be followed by ":<number of classes>",
+ * by default all classes of service are used.
+ * ":noio=<classes>" moves listed classes off the I/O ways and
+ * ":io=<classes>" onto them, classes are separated with '+'.
  * 
  * @param [in] id profile identity (string)
  * @param [in] l3ca L3CA capability structure
+ * @param [in] max_num maximum number of classes \a tab can accommodate
  * @param [out] p_num number of L3CA classes of service retrieved for the profile
- * @param [out] p_tab pointer to definition of L3CA classes of service
+ * @param [out] tab table to store L3CA classes of service definitions in
  * 
  * @return Operations status
  * @retval PQOS_RETVAL_OK on success
+ * @retval PQOS_RETVAL_RESOURCE profile not available for the cache
  */
 int profile_l3ca_get(const char *id, const struct pqos_cap_l3ca *l3ca,
-                     unsigned *p_num, const char ***p_tab);
+                     const unsigned max_num, unsigned *p_num,
+                     struct pqos_l3ca *tab);
 
 
 #ifdef __cplusplus
@@ -0,0 +1,203 @@
+/**
+ * @file screen.c
+ * @brief Incremental terminal renderer of the monitoring output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include "screen.h"
+
+/**
+ * Unchanged cells between two changes that are rewritten rather than
+ * skipped with a cursor move, which takes about as many bytes
+ */
+#define SCREEN_MAX_GAP 8
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+screen_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Resizes frames to the terminal
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+static int
+screen_resize(struct screen *s)
+{
+        struct winsize w;
+        unsigned rows = 24, cols = 80;
+        size_t size;
+
+        if (ioctl(fileno(s->fp), TIOCGWINSZ, &w)!=-1 &&
+            w.ws_row>0 && w.ws_col>1) {
+                rows = w.ws_row;
+                cols = w.ws_col;
+        }
+        cols--;
+        if (rows==s->rows && cols==s->cols && s->cur!=NULL)
+                return 0;
+
+        size = (size_t) rows * cols;
+        free(s->cur);
+        free(s->prev);
+        s->cur = malloc(size);
+        s->prev = malloc(size);
+        if (s->cur==NULL || s->prev==NULL)
+                return -1;
+        s->rows = rows;
+        s->cols = cols;
+        s->full = 1;
+        return 0;
+}
+
+int
+screen_init(struct screen *s, FILE *fp)
+{
+        if (s==NULL || fp==NULL)
+                return -1;
+
+        memset(s, 0, sizeof(*s));
+        s->fp = fp;
+        if (screen_resize(s)!=0) {
+                screen_fini(s);
+                return -1;
+        }
+        fputs("\033[?25l", fp);                 /**< hide cursor */
+        return 0;
+}
+
+int
+screen_begin(struct screen *s)
+{
+        const uint64_t now = screen_now();
+
+        if (s->frames>0 &&
+            now - s->last_ns < SCREEN_MIN_FRAME_MS * 1000000ULL) {
+                s->skipped++;
+                return 1;
+        }
+        s->last_ns = now;
+
+        if (screen_resize(s)!=0)
+                return -1;
+        memset(s->cur, ' ', (size_t) s->rows * s->cols);
+        return 0;
+}
+
+void
+screen_printf(struct screen *s, const unsigned row, const char *fmt, ...)
+{
+        char line[512];
+        va_list ap;
+        int n;
+
+        if (row>=s->rows)
+                return;
+
+        va_start(ap, fmt);
+        n = vsnprintf(line, sizeof(line), fmt, ap);
+        va_end(ap);
+        if (n<0)
+                return;
+        if ((size_t) n>=sizeof(line))
+                n = sizeof(line) - 1;
+        if ((unsigned) n>s->cols)
+                n = (int) s->cols;
+        memcpy(&s->cur[(size_t) row * s->cols], line, (size_t) n);
+}
+
+/**
+ * @brief Moves cursor and writes \a len cells of the frame
+ */
+static void
+screen_put(struct screen *s, const unsigned row, const unsigned col,
+           const unsigned len)
+{
+        const int n = fprintf(s->fp, "\033[%u;%uH", row + 1, col + 1);
+
+        fwrite(&s->cur[(size_t) row * s->cols + col], 1, len, s->fp);
+        s->bytes += len + (n>0 ? (unsigned) n : 0);
+}
+
+void
+screen_flush(struct screen *s)
+{
+        unsigned row;
+        char *tmp;
+
+        if (s->full) {
+                fputs("\033[2J", s->fp);        /**< clear screen */
+                s->bytes += 4;
+        }
+
+        for (row=0;row<s->rows;row++) {
+                const char *c = &s->cur[(size_t) row * s->cols];
+                const char *p = &s->prev[(size_t) row * s->cols];
+                unsigned col = 0;
+
+                if (!s->full && memcmp(c, p, s->cols)==0)
+                        continue;
+
+                /**
+                 * Emit runs of changed cells, short unchanged
+                 * gaps are rewritten instead of skipped
+                 */
+                while (col<s->cols) {
+                        unsigned first, last, gap = 0;
+
+                        while (col<s->cols && !s->full && c[col]==p[col])
+                                col++;
+                        if (col>=s->cols)
+                                break;
+                        first = last = col;
+                        for (;col<s->cols && gap<=SCREEN_MAX_GAP;col++) {
+                                if (s->full || c[col]!=p[col]) {
+                                        last = col;
+                                        gap = 0;
+                                } else {
+                                        gap++;
+                                }
+                        }
+                        screen_put(s, row, first, last - first + 1);
+                }
+        }
+
+        fflush(s->fp);
+        s->full = 0;
+        s->frames++;
+        tmp = s->prev;
+        s->prev = s->cur;
+        s->cur = tmp;
+}
+
+void
+screen_fini(struct screen *s)
+{
+        if (s==NULL)
+                return;
+        if (s->fp!=NULL && s->cur!=NULL) {
+                fprintf(s->fp, "\033[%u;1H\033[?25h\n", s->rows);
+                fflush(s->fp);
+        }
+        free(s->cur);
+        free(s->prev);
+        s->cur = NULL;
+        s->prev = NULL;
+}
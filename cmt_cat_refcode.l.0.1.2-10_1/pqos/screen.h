@@ -0,0 +1,99 @@
+/**
+ * @file screen.h
+ * @brief Incremental terminal renderer of the monitoring output
+ *
+ * Frames are composed into a character grid of terminal size and
+ * compared with the previous frame. Only runs of changed cells are
+ * sent to the terminal, prefixed with a cursor move, so unchanged
+ * rows do not flicker and output size follows the amount of change.
+ * Frames are limited to one per SCREEN_MIN_FRAME_MS, which bounds
+ * rendering cost for short sampling intervals.
+ */
+
+#ifndef __SCREEN_H__
+#define __SCREEN_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SCREEN_MIN_FRAME_MS 100                 /**< min time between frames */
+
+/**
+ * Terminal renderer
+ */
+struct screen {
+        FILE *fp;                               /**< terminal stream */
+        unsigned rows;
+        unsigned cols;                          /**< columns drawn, the last
+                                                   terminal column is kept
+                                                   free to avoid wrapping */
+        char *cur;                              /**< frame being composed */
+        char *prev;                             /**< frame on the terminal */
+        int full;                               /**< repaint all cells */
+        uint64_t last_ns;                       /**< time of last frame */
+        uint64_t frames;                        /**< frames drawn */
+        uint64_t skipped;                       /**< frames dropped by rate
+                                                   limit */
+        uint64_t bytes;                         /**< bytes sent to terminal */
+};
+
+/**
+ * @brief Initializes renderer of terminal \a fp
+ *
+ * @param [out] s renderer
+ * @param [in] fp terminal stream
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int screen_init(struct screen *s, FILE *fp);
+
+/**
+ * @brief Starts a new frame
+ *
+ * Follows terminal size changes and clears the frame.
+ *
+ * @param [in,out] s renderer
+ *
+ * @return Operation status
+ * @retval 0 frame should be drawn
+ * @retval 1 frame skipped, previous one is too recent
+ * @retval -1 on error
+ */
+int screen_begin(struct screen *s);
+
+/**
+ * @brief Prints line into the frame, text beyond terminal width
+ *        is cut off
+ *
+ * @param [in,out] s renderer
+ * @param [in] row frame row, rows out of the terminal are ignored
+ * @param [in] fmt printf format
+ */
+void screen_printf(struct screen *s, const unsigned row, const char *fmt, ...)
+        __attribute__((format(printf, 3, 4)));
+
+/**
+ * @brief Sends changes of the frame to the terminal
+ *
+ * @param [in,out] s renderer
+ */
+void screen_flush(struct screen *s);
+
+/**
+ * @brief Restores cursor below the output and releases renderer
+ *
+ * @param [in,out] s renderer
+ */
+void screen_fini(struct screen *s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SCREEN_H__ */
@@ -0,0 +1,177 @@
+/**
+ * @file shmbench.c
+ * @brief Shared memory sample ring throughput benchmark
+ *
+ * Publishes records as fast as possible while reader threads follow
+ * the ring through their own read-only mappings, the same way reader
+ * processes do. Reports writer and reader rates and records lost by
+ * readers that fell behind.
+ *
+ * Usage: shmbench [<records> [<readers> [<capacity>]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "shmring.h"
+
+/**
+ * Reader thread data
+ */
+struct bench_reader {
+        pthread_t thread;
+        const char *name;
+        uint64_t total;                         /**< records to account for */
+        uint64_t read;
+        uint64_t lost;
+        uint64_t bad;                           /**< records with wrong content */
+        double seconds;
+        int ready;
+};
+
+static volatile int m_start = 0;
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+bench_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Reader thread, consumes records until all are read or lost
+ *
+ * @param arg reader data
+ *
+ * @return NULL
+ */
+static void *
+bench_reader_thread(void *arg)
+{
+        struct bench_reader *r = (struct bench_reader *) arg;
+        struct shmring_reader rd;
+        struct shmring_record rec;
+        double t0;
+
+        if (shmring_open(r->name, &rd)!=0) {
+                __atomic_store_n(&r->ready, -1, __ATOMIC_RELEASE);
+                return NULL;
+        }
+        __atomic_store_n(&r->ready, 1, __ATOMIC_RELEASE);
+        while (!m_start)
+                ;
+
+        t0 = bench_now();
+        while (r->read + rd.lost < r->total) {
+                if (shmring_read(&rd, &rec)==0)
+                        continue;
+                r->read++;
+                /**
+                 * Writer stores the record number in value and RMID
+                 */
+                if (rec.value!=rd.cursor - 1 ||
+                    rec.rmid!=(uint32_t) (rec.value & 0xffff))
+                        r->bad++;
+        }
+        r->seconds = bench_now() - t0;
+        r->lost = rd.lost;
+        shmring_close(&rd);
+        return NULL;
+}
+
+int main(int argc, char **argv)
+{
+        uint64_t total = 10000000, capacity = SHMRING_DEF_SIZE, n;
+        unsigned num_readers = 2, i;
+        struct bench_reader *readers = NULL;
+        struct shmring ring;
+        struct shmring_record rec;
+        char name[64];
+        double t0, t;
+        int ret = EXIT_SUCCESS;
+
+        if (argc>1)
+                total = strtoull(argv[1], NULL, 0);
+        if (argc>2)
+                num_readers = (unsigned) strtoul(argv[2], NULL, 0);
+        if (argc>3)
+                capacity = strtoull(argv[3], NULL, 0);
+        if (total==0 || capacity==0) {
+                printf("Usage: %s [<records> [<readers> [<capacity>]]]\n",
+                       argv[0]);
+                return EXIT_FAILURE;
+        }
+
+        snprintf(name, sizeof(name), "/pqos-bench-%d", (int) getpid());
+        if (shmring_create(name, capacity, &ring)!=0) {
+                printf("Failed to create shared memory ring %s!\n", name);
+                return EXIT_FAILURE;
+        }
+
+        readers = calloc(num_readers ? num_readers : 1, sizeof(readers[0]));
+        if (readers==NULL) {
+                shmring_destroy(&ring);
+                return EXIT_FAILURE;
+        }
+        for (i=0;i<num_readers;i++) {
+                readers[i].name = name;
+                readers[i].total = total;
+                pthread_create(&readers[i].thread, NULL,
+                               bench_reader_thread, &readers[i]);
+                while (__atomic_load_n(&readers[i].ready,
+                                       __ATOMIC_ACQUIRE)==0)
+                        ;
+        }
+
+        memset(&rec, 0, sizeof(rec));
+        rec.num_cores = 1;
+        m_start = 1;
+        t0 = bench_now();
+        for (n=0;n<total;n++) {
+                rec.timestamp = n;
+                rec.value = n;
+                rec.rmid = (uint32_t) (n & 0xffff);
+                rec.cores[0] = (uint32_t) (n & 0xff);
+                shmring_write(&ring, &rec);
+        }
+        t = bench_now() - t0;
+
+        printf("Ring: %llu records x %u bytes, %u reader(s)\n",
+               (unsigned long long) capacity,
+               (unsigned) sizeof(struct shmring_slot), num_readers);
+        printf("Writer: %llu records in %.3fs, %.2f Mrecords/s, %.1f ns/record\n",
+               (unsigned long long) total, t, (double) total / t / 1e6,
+               t * 1e9 / (double) total);
+
+        for (i=0;i<num_readers;i++) {
+                pthread_join(readers[i].thread, NULL);
+                if (readers[i].ready<0) {
+                        printf("Reader %u: failed to open the ring!\n", i);
+                        ret = EXIT_FAILURE;
+                        continue;
+                }
+                printf("Reader %u: %llu read, %llu lost, %llu corrupted, "
+                       "%.2f Mrecords/s\n", i,
+                       (unsigned long long) readers[i].read,
+                       (unsigned long long) readers[i].lost,
+                       (unsigned long long) readers[i].bad,
+                       readers[i].seconds>0.0 ?
+                       (double) readers[i].read / readers[i].seconds / 1e6 :
+                       0.0);
+                if (readers[i].bad!=0)
+                        ret = EXIT_FAILURE;
+        }
+
+        free(readers);
+        shmring_destroy(&ring);
+        return ret;
+}
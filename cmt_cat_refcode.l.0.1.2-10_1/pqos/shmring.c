@@ -0,0 +1,215 @@
+/**
+ * @file shmring.c
+ * @brief Shared memory ring of monitoring samples
+ *
+ * Single writer, any number of readers. Readers never write to the
+ * shared memory, the object is mapped read-only on their side.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shmring.h"
+
+/**
+ * @brief Returns size of the object holding \a capacity slots
+ */
+static uint64_t
+shmring_size(const uint64_t capacity)
+{
+        return sizeof(struct shmring_header) +
+                capacity * sizeof(struct shmring_slot);
+}
+
+int
+shmring_create(const char *name, const uint64_t capacity,
+               struct shmring *ring)
+{
+        void *p = NULL;
+        uint64_t size;
+        int fd;
+
+        if (name==NULL || ring==NULL || capacity==0)
+                return -1;
+
+        memset(ring, 0, sizeof(*ring));
+        size = shmring_size(capacity);
+
+        /**
+         * Readers of a previous ring keep their mapping of the
+         * unlinked object, a new object is never shared with them
+         */
+        (void) shm_unlink(name);
+        fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+        if (fd==-1)
+                return -1;
+        if (ftruncate(fd, (off_t) size)==-1) {
+                close(fd);
+                shm_unlink(name);
+                return -1;
+        }
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p==MAP_FAILED) {
+                shm_unlink(name);
+                return -1;
+        }
+
+        ring->name = strdup(name);
+        ring->hdr = (struct shmring_header *) p;
+        ring->slots = (struct shmring_slot *) (ring->hdr + 1);
+        ring->map_size = size;
+
+        ring->hdr->version = SHMRING_VERSION;
+        ring->hdr->slot_size = (uint32_t) sizeof(struct shmring_slot);
+        ring->hdr->capacity = capacity;
+        ring->hdr->writer_pid = (uint64_t) getpid();
+        /**
+         * Magic goes last, readers check it to see the ring is ready
+         */
+        __atomic_store_n(&ring->hdr->magic, SHMRING_MAGIC, __ATOMIC_RELEASE);
+        return 0;
+}
+
+void
+shmring_write(struct shmring *ring, const struct shmring_record *rec)
+{
+        struct shmring_slot *slot = NULL;
+        uint64_t n;
+
+        if (ring==NULL || ring->hdr==NULL || rec==NULL)
+                return;
+
+        n = ring->hdr->head;
+        slot = &ring->slots[n % ring->hdr->capacity];
+
+        __atomic_store_n(&slot->seq, 2*n + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->rec = *rec;
+        __atomic_store_n(&slot->seq, 2*n + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&ring->hdr->head, n + 1, __ATOMIC_RELEASE);
+}
+
+void
+shmring_destroy(struct shmring *ring)
+{
+        if (ring==NULL || ring->hdr==NULL)
+                return;
+        munmap(ring->hdr, ring->map_size);
+        if (ring->name!=NULL) {
+                shm_unlink(ring->name);
+                free(ring->name);
+        }
+        memset(ring, 0, sizeof(*ring));
+}
+
+int
+shmring_open(const char *name, struct shmring_reader *rd)
+{
+        struct shmring_header hdr;
+        struct stat st;
+        void *p = NULL;
+        uint64_t head;
+        int fd;
+
+        if (name==NULL || rd==NULL)
+                return -1;
+
+        memset(rd, 0, sizeof(*rd));
+        fd = shm_open(name, O_RDONLY, 0);
+        if (fd==-1)
+                return -1;
+        if (fstat(fd, &st)==-1 ||
+            (uint64_t) st.st_size < sizeof(struct shmring_header)) {
+                close(fd);
+                return -1;
+        }
+        if (pread(fd, &hdr, sizeof(hdr), 0)!=(ssize_t) sizeof(hdr) ||
+            hdr.magic!=SHMRING_MAGIC || hdr.version!=SHMRING_VERSION ||
+            hdr.slot_size!=sizeof(struct shmring_slot) ||
+            hdr.capacity==0 ||
+            (uint64_t) st.st_size < shmring_size(hdr.capacity)) {
+                close(fd);
+                return -1;
+        }
+
+        p = mmap(NULL, shmring_size(hdr.capacity), PROT_READ, MAP_SHARED,
+                 fd, 0);
+        close(fd);
+        if (p==MAP_FAILED)
+                return -1;
+
+        rd->map = p;
+        rd->hdr = (const struct shmring_header *) p;
+        rd->slots = (const struct shmring_slot *) (rd->hdr + 1);
+        rd->map_size = shmring_size(hdr.capacity);
+
+        head = __atomic_load_n(&rd->hdr->head, __ATOMIC_ACQUIRE);
+        rd->cursor = (head > hdr.capacity) ? head - hdr.capacity : 0;
+        rd->head = head;
+        return 0;
+}
+
+int
+shmring_read(struct shmring_reader *rd, struct shmring_record *rec)
+{
+        const uint64_t capacity = rd->hdr->capacity;
+
+        for (;;) {
+                const struct shmring_slot *slot = NULL;
+                uint64_t s1, s2, want;
+
+                /**
+                 * Shared head is read only after all records seen
+                 * so far are consumed, it is the contended cache line
+                 */
+                if (rd->cursor >= rd->head) {
+                        rd->head = __atomic_load_n(&rd->hdr->head,
+                                                   __ATOMIC_ACQUIRE);
+                        if (rd->cursor >= rd->head)
+                                return 0;
+                }
+
+                if (rd->head - rd->cursor > capacity) {
+                        rd->lost += rd->head - rd->cursor - capacity;
+                        rd->cursor = rd->head - capacity;
+                }
+
+                slot = &rd->slots[rd->cursor % capacity];
+                want = 2*rd->cursor + 2;
+
+                s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+                if (s1==want) {
+                        memcpy(rec, &slot->rec, sizeof(*rec));
+                        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+                        s2 = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED);
+                        if (s2==s1) {
+                                rd->cursor++;
+                                return 1;
+                        }
+                }
+                /**
+                 * Slot already reused by a newer record,
+                 * writer is at least a full ring ahead
+                 */
+                rd->head = __atomic_load_n(&rd->hdr->head, __ATOMIC_ACQUIRE);
+                if (rd->head - rd->cursor <= capacity) {
+                        rd->lost++;
+                        rd->cursor++;
+                }
+        }
+}
+
+void
+shmring_close(struct shmring_reader *rd)
+{
+        if (rd==NULL || rd->map==NULL)
+                return;
+        munmap(rd->map, rd->map_size);
+        memset(rd, 0, sizeof(*rd));
+}
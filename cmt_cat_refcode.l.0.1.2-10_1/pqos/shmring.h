@@ -0,0 +1,176 @@
+/**
+ * @file shmring.h
+ * @brief Shared memory ring of monitoring samples
+ *
+ * pqos publishes every sample into a POSIX shared memory object
+ * (/dev/shm/<name>) as fixed size binary records. Any number of reader
+ * processes map the object read-only and follow the ring without
+ * system calls or parsing.
+ *
+ * Layout: struct shmring_header followed by \a capacity slots.
+ * Each slot holds a sequence number and a record. Record n goes to
+ * slot n % capacity, its sequence number is 2n+1 while the record is
+ * being written and 2n+2 once it is complete (per slot seqlock).
+ * Header \a head is the number of records published so far.
+ *
+ * A reader copies a slot and accepts the copy only if the sequence
+ * number was 2n+2 before and after the copy. A reader that falls
+ * more than \a capacity records behind skips to the oldest record
+ * still in the ring and counts the skipped ones as lost.
+ *
+ * Groups with core performance counter, frequency or power events
+ * publish extra records after the LLC occupancy one: event
+ * PQOS_PERF_EVENT_IPC holds instructions per cycle,
+ * PQOS_PERF_EVENT_LLC_MISS LLC misses per 1000 instructions,
+ * PQOS_PERF_EVENT_FREQ effective frequency in MHz and
+ * PQOS_PWR_EVENT_PKG_ENERGY/DRAM_ENERGY socket power in Joules/s,
+ * all in thousandths.
+ *
+ * The header is usable from C and C++ readers.
+ */
+
+#ifndef __SHMRING_H__
+#define __SHMRING_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SHMRING_MAGIC      0x31474e52534f5150ULL    /**< "PQOSRNG1" */
+#define SHMRING_VERSION    1
+#define SHMRING_MAX_CORES  8                        /**< cores listed per record */
+#define SHMRING_DEF_NAME   "/pqos"
+#define SHMRING_DEF_SIZE   65536                    /**< default capacity in records */
+
+/**
+ * Monitoring sample record, 64 bytes
+ */
+struct shmring_record {
+        uint64_t timestamp;             /**< CLOCK_REALTIME in nanoseconds */
+        uint32_t socket;                /**< socket id */
+        uint32_t rmid;                  /**< RMID of the group */
+        uint32_t event;                 /**< monitoring event id */
+        uint32_t num_cores;             /**< number of cores in the group */
+        uint32_t cores[SHMRING_MAX_CORES];      /**< first cores of the group */
+        uint64_t value;                 /**< event value, bytes for LLC occupancy,
+                                           thousandths for other metrics */
+};
+
+/**
+ * Ring slot
+ */
+struct shmring_slot {
+        uint64_t seq;                   /**< 2n+1 being written, 2n+2 complete */
+        uint64_t reserved;
+        struct shmring_record rec;
+};
+
+/**
+ * Shared memory object header
+ */
+struct shmring_header {
+        uint64_t magic;                 /**< SHMRING_MAGIC */
+        uint32_t version;               /**< SHMRING_VERSION */
+        uint32_t slot_size;             /**< sizeof(struct shmring_slot) */
+        uint64_t capacity;              /**< number of slots */
+        uint64_t writer_pid;            /**< process publishing samples */
+        uint8_t pad0[32];
+        uint64_t head;                  /**< records published, own cache line */
+        uint8_t pad1[56];
+};
+
+/**
+ * Writer handle
+ */
+struct shmring {
+        char *name;
+        struct shmring_header *hdr;
+        struct shmring_slot *slots;
+        uint64_t map_size;
+};
+
+/**
+ * Reader handle
+ */
+struct shmring_reader {
+        void *map;
+        const struct shmring_header *hdr;
+        const struct shmring_slot *slots;
+        uint64_t map_size;
+        uint64_t cursor;                /**< next record to read */
+        uint64_t head;                  /**< last seen number of records published */
+        uint64_t lost;                  /**< records overwritten before read */
+};
+
+/**
+ * @brief Creates shared memory ring
+ *
+ * Existing object of the same name is unlinked and a new one is
+ * created, readers still mapping the old object are not affected.
+ *
+ * @param [in] name object name, e.g. "/pqos"
+ * @param [in] capacity number of records in the ring
+ * @param [out] ring writer handle
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int shmring_create(const char *name, const uint64_t capacity,
+                   struct shmring *ring);
+
+/**
+ * @brief Publishes a record
+ *
+ * @param [in] ring writer handle
+ * @param [in] rec record to publish
+ */
+void shmring_write(struct shmring *ring, const struct shmring_record *rec);
+
+/**
+ * @brief Unmaps and removes shared memory ring
+ *
+ * @param [in] ring writer handle
+ */
+void shmring_destroy(struct shmring *ring);
+
+/**
+ * @brief Maps existing shared memory ring for reading
+ *
+ * Reading starts from the oldest record still in the ring.
+ *
+ * @param [in] name object name
+ * @param [out] rd reader handle
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int shmring_open(const char *name, struct shmring_reader *rd);
+
+/**
+ * @brief Reads next record
+ *
+ * @param [in,out] rd reader handle
+ * @param [out] rec record
+ *
+ * @return Number of records read
+ * @retval 1 record read
+ * @retval 0 no new record
+ */
+int shmring_read(struct shmring_reader *rd, struct shmring_record *rec);
+
+/**
+ * @brief Unmaps shared memory ring
+ *
+ * @param [in] rd reader handle
+ */
+void shmring_close(struct shmring_reader *rd);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SHMRING_H__ */
@@ -0,0 +1,968 @@
+/**
+ * @file sim.c
+ * @brief Simulated platform with CMT and CAT
+ *
+ * Implements PQoS machine operations (CPUID, RDMSR and WRMSR)
+ * on top of an in-memory register file:
+ * - PQR_ASSOC, QM_EVTSEL and QM_CTR per logical core
+ * - L3 CAT masks per socket
+ * - fixed counters (instructions, cycles) and LLC misses counter
+ *   of architectural performance monitoring per logical core
+ * - APERF/MPERF per logical core, RAPL package and DRAM energy
+ *   status per socket
+ *
+ * LLC occupancy model:
+ * - each core has a working set size (possibly changing over time)
+ * - capacity of every cache way is shared equally between cores
+ *   whose class of service mask includes the way, any capacity not
+ *   used by a core is redistributed between remaining cores
+ * - reported occupancy approaches the result exponentially
+ *   with SIM_OCCUP_TAU time constant
+ *
+ * Core performance model:
+ * - a core with non-zero working set runs at SIM_CORE_HZ,
+ *   an idle core is halted and its counters do not move
+ * - part of the working set not held in LLC misses, up to
+ *   SIM_MAX_MPKI misses per 1000 instructions when nothing is held
+ * - each miss stalls the core for SIM_MISS_CYCLES on top of
+ *   SIM_BASE_CPI cycles per instruction
+ *
+ * Frequency and power model:
+ * - busy cores of a socket run at SIM_TURBO_HZ less SIM_TURBO_STEP
+ *   for every other busy core, but not below SIM_CORE_HZ; MPERF
+ *   counts at SIM_CORE_HZ and APERF at the actual frequency
+ * - package draws SIM_PKG_IDLE_W plus SIM_CORE_W per busy core,
+ *   scaled with the cube of frequency relative to SIM_CORE_HZ
+ * - DRAM draws SIM_DRAM_IDLE_W plus SIM_DRAM_MISS_J per LLC miss
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+#include "sim.h"
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+#ifdef DEBUG
+#define ASSERT assert
+#else
+#define ASSERT(x)
+#endif
+
+/**
+ * Registers handled by the simulator
+ */
+#define SIM_MSR_ASSOC          0xC8F
+#define SIM_MSR_MON_EVTSEL     0xC8D
+#define SIM_MSR_MON_QMC        0xC8E
+#define SIM_MSR_L3CA_MASK_START 0xC90
+#define SIM_MSR_IIO_LLC_WAYS   0xC8B
+
+#define SIM_MSR_FIXED_CTR0     0x309
+#define SIM_MSR_FIXED_CTR1     0x30A
+#define SIM_MSR_FIXED_CTR_CTRL 0x38D
+#define SIM_MSR_GLOBAL_CTRL    0x38F
+#define SIM_MSR_PERFEVTSEL0    0x186
+#define SIM_MSR_PMC0           0xC1
+
+#define SIM_MSR_MPERF          0xE7
+#define SIM_MSR_APERF          0xE8
+#define SIM_MSR_PLATFORM_INFO  0xCE
+#define SIM_MSR_RAPL_POWER_UNIT 0x606
+#define SIM_MSR_PKG_ENERGY     0x611
+#define SIM_MSR_DRAM_ENERGY    0x619
+
+#define SIM_QMC_ERROR          (1ULL<<63)
+#define SIM_RMID_MASK          ((1ULL<<10)-1ULL)
+#define SIM_EVENT_L3_OCCUP     1
+
+#define SIM_MAX_COS            16
+#define SIM_LINE_SIZE          64
+#define SIM_SCALE_FACTOR       32768
+#define SIM_OCCUP_TAU          0.25             /**< seconds */
+
+#define SIM_PMU_WIDTH          48               /**< counter width in bits */
+#define SIM_PMU_MASK           ((1ULL<<SIM_PMU_WIDTH)-1ULL)
+#define SIM_EVTSEL_LLC_MISS    0x412EULL        /**< umask and event */
+#define SIM_EVTSEL_EN          (1ULL<<22)
+#define SIM_CORE_HZ            2.0e9
+#define SIM_BASE_CPI           0.5
+#define SIM_MISS_CYCLES        200.0
+#define SIM_MAX_MPKI           20.0
+
+#define SIM_TURBO_HZ           3.0e9
+#define SIM_TURBO_STEP         0.125e9
+#define SIM_PKG_IDLE_W         20.0
+#define SIM_CORE_W             5.0
+#define SIM_DRAM_IDLE_W        4.0
+#define SIM_DRAM_MISS_J        50e-9
+#define SIM_RAPL_ESU           14               /**< package energy unit 1/2^14 J */
+#define SIM_RAPL_DRAM_ESU      16               /**< fixed DRAM unit of server parts */
+#define SIM_RAPL_POWER_UNIT    ((10<<16) | (SIM_RAPL_ESU<<8) | 3)
+#define SIM_ENERGY_WRAP        4294967296.0     /**< 32 bit energy counters */
+
+/**
+ * Working set phase of a core
+ */
+struct sim_phase {
+        double start;                           /**< seconds from simulation start */
+        uint64_t bytes;                         /**< working set size */
+};
+
+/**
+ * Simulated logical core
+ */
+struct sim_core {
+        unsigned socket;
+        uint64_t assoc;                         /**< PQR_ASSOC register */
+        uint64_t evtsel;                        /**< QM_EVTSEL register */
+        uint64_t wss;                           /**< current working set size */
+        double occupancy;                       /**< current LLC occupancy in bytes */
+        uint64_t fixed_ctrl;                    /**< fixed counter control */
+        uint64_t global_ctrl;                   /**< global counter control */
+        uint64_t evtsel0;                       /**< event select 0 */
+        double instructions;                    /**< fixed counter 0 */
+        double cycles;                          /**< fixed counter 1 */
+        double llc_misses;                      /**< general purpose counter 0 */
+        double aperf;                           /**< actual frequency clock count */
+        double mperf;                           /**< base frequency clock count */
+        double pmu_update;                      /**< time of last counter update */
+        unsigned num_phases;
+        struct sim_phase phases[SIM_MAX_PHASES];
+};
+
+/**
+ * Simulated CPU socket
+ */
+struct sim_socket {
+        uint64_t l3ca_mask[SIM_MAX_COS];
+        double last_update;                     /**< time of last model update */
+        double pkg_energy;                      /**< package energy in Joules */
+        double dram_energy;                     /**< DRAM energy in Joules */
+        double rapl_update;                     /**< time of last idle energy update */
+};
+
+static struct {
+        unsigned num_sockets;
+        unsigned cores_per_socket;
+        unsigned num_ways;
+        unsigned num_cos;
+        unsigned num_rmids;
+        unsigned llc_kb;
+        unsigned shareable;                     /**< CPUID.0x10.1 EBX */
+        unsigned io_ways;                       /**< IIO LLC ways register */
+        unsigned pmu;                           /**< performance monitoring enabled */
+        unsigned aperf;                         /**< APERF/MPERF enabled */
+        unsigned rapl;                          /**< RAPL domains, 1 package, 2 DRAM too */
+        unsigned energy;                        /**< initial energy counts in Joules */
+        double start;
+        struct sim_core *cores;
+        struct sim_socket *sockets;
+        struct pqos_cpuinfo *topology;
+        struct pqos_machine_ops ops;
+} m_sim;
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+sim_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Returns number of simulated logical cores
+ */
+static unsigned
+sim_num_cores(void)
+{
+        return m_sim.num_sockets * m_sim.cores_per_socket;
+}
+
+/**
+ * @brief Returns byte size of a single cache way
+ */
+static uint64_t
+sim_way_size(void)
+{
+        return ((uint64_t) m_sim.llc_kb * 1024ULL) / m_sim.num_ways;
+}
+
+/**
+ * @brief Checks if \a mask is a valid CBM for the simulated cache
+ *
+ * Hardware requires non-zero, contiguous masks within CBM length.
+ */
+static int
+sim_mask_valid(const uint64_t mask)
+{
+        uint64_t m = mask;
+
+        if (m==0)
+                return 0;
+        if (m_sim.num_ways<64 && (m >> m_sim.num_ways)!=0)
+                return 0;
+        while (!(m&1))
+                m >>= 1;
+        return ((m & (m+1))==0);
+}
+
+/**
+ * @brief Updates working set sizes of cores according to their phases
+ *
+ * @param t time from simulation start in seconds
+ */
+static void
+sim_update_phases(const double t)
+{
+        unsigned i, j;
+
+        for (i=0;i<sim_num_cores();i++) {
+                struct sim_core *c = &m_sim.cores[i];
+
+                for (j=0;j<c->num_phases;j++)
+                        if (c->phases[j].start<=t)
+                                c->wss = c->phases[j].bytes;
+        }
+}
+
+/**
+ * @brief Moves occupancy of cores from \a socket towards
+ *        the value resulting from way sharing
+ *
+ * @param socket socket id
+ */
+static void
+sim_update_socket(const unsigned socket)
+{
+        struct sim_socket *s = &m_sim.sockets[socket];
+        const unsigned first = socket * m_sim.cores_per_socket;
+        const unsigned n = m_sim.cores_per_socket;
+        double target[n], remain[n], cap[m_sim.num_ways];
+        uint64_t mask[n];
+        double now = sim_now(), alpha = 0.0;
+        unsigned i, w, pass;
+
+        sim_update_phases(now - m_sim.start);
+
+        for (w=0;w<m_sim.num_ways;w++)
+                cap[w] = (double) sim_way_size();
+
+        for (i=0;i<n;i++) {
+                const struct sim_core *c = &m_sim.cores[first+i];
+                unsigned cos = (unsigned) (c->assoc >> 32);
+
+                target[i] = 0.0;
+                remain[i] = (double) c->wss;
+                mask[i] = (cos<m_sim.num_cos) ? s->l3ca_mask[cos] : 0;
+        }
+
+        /**
+         * Water-fill cache ways: every pass shares remaining
+         * capacity of a way equally between its users
+         * that still have unmet demand.
+         */
+        for (pass=0;pass<=m_sim.num_ways;pass++) {
+                double progress = 0.0;
+
+                for (w=0;w<m_sim.num_ways;w++) {
+                        unsigned users = 0;
+                        double share;
+
+                        if (cap[w]<1.0)
+                                continue;
+                        for (i=0;i<n;i++)
+                                if ((mask[i]&(1ULL<<w)) && remain[i]>=1.0)
+                                        users++;
+                        if (users==0)
+                                continue;
+                        share = cap[w] / (double) users;
+                        for (i=0;i<n;i++) {
+                                double g;
+
+                                if (!(mask[i]&(1ULL<<w)) || remain[i]<1.0)
+                                        continue;
+                                g = (remain[i]<share) ? remain[i] : share;
+                                target[i] += g;
+                                remain[i] -= g;
+                                cap[w] -= g;
+                                progress += g;
+                        }
+                }
+                if (progress<1.0)
+                        break;
+        }
+
+        if (s->last_update>0.0)
+                alpha = 1.0 - exp(-(now - s->last_update) / SIM_OCCUP_TAU);
+        s->last_update = now;
+
+        for (i=0;i<n;i++) {
+                struct sim_core *c = &m_sim.cores[first+i];
+
+                c->occupancy += (target[i] - c->occupancy) * alpha;
+        }
+}
+
+/**
+ * @brief Reads LLC occupancy of \a rmid on \a socket in bytes
+ */
+static uint64_t
+sim_rmid_occupancy(const unsigned socket, const unsigned rmid)
+{
+        const unsigned first = socket * m_sim.cores_per_socket;
+        double sum = 0.0;
+        unsigned i;
+
+        sim_update_socket(socket);
+
+        for (i=first;i<first+m_sim.cores_per_socket;i++)
+                if ((m_sim.cores[i].assoc & SIM_RMID_MASK)==rmid)
+                        sum += m_sim.cores[i].occupancy;
+
+        return (uint64_t) sum;
+}
+
+/**
+ * @brief Returns frequency busy cores of \a socket run at
+ */
+static double
+sim_socket_hz(const unsigned socket)
+{
+        const unsigned first = socket * m_sim.cores_per_socket;
+        unsigned i, busy = 0;
+        double hz;
+
+        for (i=first;i<first+m_sim.cores_per_socket;i++)
+                if (m_sim.cores[i].wss!=0)
+                        busy++;
+        if (busy==0)
+                return SIM_TURBO_HZ;
+
+        hz = SIM_TURBO_HZ - SIM_TURBO_STEP * (double) (busy - 1);
+        return (hz<SIM_CORE_HZ) ? SIM_CORE_HZ : hz;
+}
+
+/**
+ * @brief Advances performance counters of \a lcore to current time
+ *
+ * Occupancy of the core is brought up to date first,
+ * the miss rate follows from the part of the working set
+ * that does not fit in the occupied LLC capacity.
+ * Energy used by the core and by its misses is added
+ * to the socket.
+ */
+static void
+sim_pmu_update(const unsigned lcore)
+{
+        struct sim_core *c = &m_sim.cores[lcore];
+        struct sim_socket *s = &m_sim.sockets[c->socket];
+        const double now = sim_now();
+        const double dt = now - c->pmu_update;
+        double cycles, instructions, misses, hz, mpki = 0.0;
+
+        c->pmu_update = now;
+        if (dt<=0.0 || c->wss==0)
+                return;
+
+        sim_update_socket(c->socket);
+        if (c->occupancy<(double) c->wss)
+                mpki = SIM_MAX_MPKI * ((double) c->wss - c->occupancy) /
+                        (double) c->wss;
+
+        hz = sim_socket_hz(c->socket);
+        cycles = dt * hz;
+        instructions = cycles /
+                (SIM_BASE_CPI + ((mpki * SIM_MISS_CYCLES) / 1000.0));
+        misses = (instructions * mpki) / 1000.0;
+
+        c->aperf += cycles;
+        c->mperf += dt * SIM_CORE_HZ;
+        s->pkg_energy += dt * SIM_CORE_W * pow(hz / SIM_CORE_HZ, 3.0);
+        s->dram_energy += misses * SIM_DRAM_MISS_J;
+
+        if ((c->global_ctrl & (1ULL<<32)) && (c->fixed_ctrl & 0x3))
+                c->instructions += instructions;
+        if ((c->global_ctrl & (1ULL<<33)) && (c->fixed_ctrl & 0x30))
+                c->cycles += cycles;
+        if ((c->global_ctrl & 1ULL) && (c->evtsel0 & SIM_EVTSEL_EN) &&
+            (c->evtsel0 & 0xffffULL)==SIM_EVTSEL_LLC_MISS)
+                c->llc_misses += misses;
+}
+
+/**
+ * @brief Advances energy of \a socket to current time
+ *
+ * Busy cores add their energy through sim_pmu_update(),
+ * idle power is added here.
+ */
+static void
+sim_rapl_update(const unsigned socket)
+{
+        struct sim_socket *s = &m_sim.sockets[socket];
+        const unsigned first = socket * m_sim.cores_per_socket;
+        const double now = sim_now();
+        unsigned i;
+
+        for (i=first;i<first+m_sim.cores_per_socket;i++)
+                sim_pmu_update(i);
+
+        if (now>s->rapl_update) {
+                s->pkg_energy += (now - s->rapl_update) * SIM_PKG_IDLE_W;
+                s->dram_energy += (now - s->rapl_update) * SIM_DRAM_IDLE_W;
+                s->rapl_update = now;
+        }
+}
+
+/**
+ * @brief Returns value of a 32 bit energy status register
+ *
+ * @param joules energy counted so far
+ * @param esu energy status unit, the register counts 1/2^esu Joules
+ */
+static uint64_t
+sim_energy_counter(const double joules, const unsigned esu)
+{
+        return (uint64_t) fmod(joules * (double) (1ULL << esu),
+                               SIM_ENERGY_WRAP);
+}
+
+/**
+ * @brief Returns value of a simulated performance counter
+ */
+static uint64_t
+sim_pmu_counter(const double count)
+{
+        return (uint64_t) fmod(count, (double) (SIM_PMU_MASK + 1ULL));
+}
+
+/**
+ * =======================================
+ * Machine operations
+ * =======================================
+ */
+
+static int
+sim_cpuid(void *context,
+          const unsigned leaf,
+          const unsigned subleaf,
+          struct pqos_cpuid_out *out)
+{
+        (void) context;
+
+        memset(out, 0, sizeof(*out));
+
+        switch (leaf) {
+        case 0x0:
+                out->eax = 0x14;
+                out->ebx = 0x756e6547;                  /**< "Genu" */
+                out->edx = 0x49656e69;                  /**< "ineI" */
+                out->ecx = 0x6c65746e;                  /**< "ntel" */
+                break;
+        case 0x1:
+                out->eax = 0x50654;                     /**< family 6, model 0x55 */
+                break;
+        case 0x4:
+                if (subleaf==3) {
+                        uint64_t sets = sim_way_size() / SIM_LINE_SIZE;
+
+                        out->eax = (3<<5) | 3;          /**< level 3, unified */
+                        out->ebx = ((m_sim.num_ways-1)<<22) | (SIM_LINE_SIZE-1);
+                        out->ecx = (uint32_t) (sets - 1);
+                }
+                break;
+        case 0x6:
+                if (m_sim.aperf)
+                        out->ecx = 1;                   /**< APERF/MPERF */
+                break;
+        case 0x7:
+                if (subleaf==0)
+                        out->ebx = (1<<12) | (1<<15);   /**< CMT & CAT */
+                break;
+        case 0xa:
+                if (m_sim.pmu) {
+                        /**
+                         * version 4, 4 general purpose counters,
+                         * 7 architectural events all available,
+                         * 3 fixed counters
+                         */
+                        out->eax = (7<<24) | (SIM_PMU_WIDTH<<16) | (4<<8) | 4;
+                        out->edx = (SIM_PMU_WIDTH<<5) | 3;
+                }
+                break;
+        case 0xf:
+                if (subleaf==0) {
+                        out->ebx = m_sim.num_rmids - 1;
+                        out->edx = (1<<1);              /**< L3 monitoring */
+                } else if (subleaf==1) {
+                        out->ebx = SIM_SCALE_FACTOR;
+                        out->ecx = m_sim.num_rmids - 1;
+                        out->edx = 1;                   /**< LLC occupancy */
+                }
+                break;
+        case 0x10:
+                if (subleaf==0) {
+                        out->ebx = (1<<1);              /**< L3 CAT */
+                } else if (subleaf==1) {
+                        out->eax = m_sim.num_ways - 1;
+                        out->ebx = m_sim.shareable;
+                        out->edx = m_sim.num_cos - 1;
+                }
+                break;
+        case 0x80000000:
+                out->eax = 0x80000008;
+                break;
+        default:
+                break;
+        }
+
+        return 0;
+}
+
+static int
+sim_msr_read(void *context,
+             const unsigned lcore,
+             const uint32_t reg,
+             uint64_t *value)
+{
+        struct sim_core *c = NULL;
+
+        (void) context;
+
+        if (lcore>=sim_num_cores())
+                return -1;
+        c = &m_sim.cores[lcore];
+
+        if (reg>=SIM_MSR_L3CA_MASK_START &&
+            reg<SIM_MSR_L3CA_MASK_START+m_sim.num_cos) {
+                *value = m_sim.sockets[c->socket].l3ca_mask[reg-SIM_MSR_L3CA_MASK_START];
+                return 0;
+        }
+
+        if (m_sim.pmu)
+                switch (reg) {
+                case SIM_MSR_FIXED_CTR0:
+                case SIM_MSR_FIXED_CTR1:
+                case SIM_MSR_PMC0:
+                        sim_pmu_update(lcore);
+                        *value = sim_pmu_counter((reg==SIM_MSR_FIXED_CTR0) ?
+                                                 c->instructions :
+                                                 (reg==SIM_MSR_FIXED_CTR1) ?
+                                                 c->cycles : c->llc_misses);
+                        return 0;
+                case SIM_MSR_FIXED_CTR_CTRL:
+                        *value = c->fixed_ctrl;
+                        return 0;
+                case SIM_MSR_GLOBAL_CTRL:
+                        *value = c->global_ctrl;
+                        return 0;
+                case SIM_MSR_PERFEVTSEL0:
+                        *value = c->evtsel0;
+                        return 0;
+                default:
+                        break;
+                }
+
+        if (m_sim.aperf && (reg==SIM_MSR_APERF || reg==SIM_MSR_MPERF)) {
+                sim_pmu_update(lcore);
+                *value = (uint64_t) ((reg==SIM_MSR_APERF) ? c->aperf : c->mperf);
+                return 0;
+        }
+
+        if (m_sim.rapl)
+                switch (reg) {
+                case SIM_MSR_RAPL_POWER_UNIT:
+                        *value = SIM_RAPL_POWER_UNIT;
+                        return 0;
+                case SIM_MSR_PKG_ENERGY:
+                        sim_rapl_update(c->socket);
+                        *value = sim_energy_counter(m_sim.sockets[c->socket].pkg_energy,
+                                                    SIM_RAPL_ESU);
+                        return 0;
+                case SIM_MSR_DRAM_ENERGY:
+                        if (m_sim.rapl<2)
+                                return -1;      /**< no DRAM domain */
+                        sim_rapl_update(c->socket);
+                        *value = sim_energy_counter(m_sim.sockets[c->socket].dram_energy,
+                                                    SIM_RAPL_DRAM_ESU);
+                        return 0;
+                default:
+                        break;
+                }
+
+        switch (reg) {
+        case SIM_MSR_ASSOC:
+                *value = c->assoc;
+                break;
+        case SIM_MSR_PLATFORM_INFO:
+                *value = (uint64_t) (SIM_CORE_HZ / 1e8) << 8;
+                break;
+        case SIM_MSR_IIO_LLC_WAYS:
+                if (m_sim.io_ways==0)
+                        return -1;                      /**< not implemented */
+                *value = m_sim.io_ways;
+                break;
+        case SIM_MSR_MON_EVTSEL:
+                *value = c->evtsel;
+                break;
+        case SIM_MSR_MON_QMC: {
+                unsigned rmid = (unsigned) ((c->evtsel>>32) & SIM_RMID_MASK);
+                unsigned evt = (unsigned) (c->evtsel & 0xff);
+
+                if (evt!=SIM_EVENT_L3_OCCUP || rmid>=m_sim.num_rmids) {
+                        *value = SIM_QMC_ERROR;
+                        break;
+                }
+                *value = sim_rmid_occupancy(c->socket, rmid) / SIM_SCALE_FACTOR;
+        }
+                break;
+        default:
+                return -1;
+        }
+
+        return 0;
+}
+
+static int
+sim_msr_write(void *context,
+              const unsigned lcore,
+              const uint32_t reg,
+              const uint64_t value)
+{
+        struct sim_core *c = NULL;
+
+        (void) context;
+
+        if (lcore>=sim_num_cores())
+                return -1;
+        c = &m_sim.cores[lcore];
+
+        if (reg>=SIM_MSR_L3CA_MASK_START &&
+            reg<SIM_MSR_L3CA_MASK_START+m_sim.num_cos) {
+                if (!sim_mask_valid(value))
+                        return -1;                      /**< #GP on hardware */
+                sim_update_socket(c->socket);
+                m_sim.sockets[c->socket].l3ca_mask[reg-SIM_MSR_L3CA_MASK_START] = value;
+                return 0;
+        }
+
+        if (m_sim.pmu)
+                switch (reg) {
+                case SIM_MSR_FIXED_CTR0:
+                case SIM_MSR_FIXED_CTR1:
+                case SIM_MSR_PMC0:
+                        if (value>SIM_PMU_MASK)
+                                return -1;
+                        sim_pmu_update(lcore);
+                        if (reg==SIM_MSR_FIXED_CTR0)
+                                c->instructions = (double) value;
+                        else if (reg==SIM_MSR_FIXED_CTR1)
+                                c->cycles = (double) value;
+                        else
+                                c->llc_misses = (double) value;
+                        return 0;
+                case SIM_MSR_FIXED_CTR_CTRL:
+                        sim_pmu_update(lcore);
+                        c->fixed_ctrl = value;
+                        return 0;
+                case SIM_MSR_GLOBAL_CTRL:
+                        sim_pmu_update(lcore);
+                        c->global_ctrl = value;
+                        return 0;
+                case SIM_MSR_PERFEVTSEL0:
+                        sim_pmu_update(lcore);
+                        c->evtsel0 = value;
+                        return 0;
+                default:
+                        break;
+                }
+
+        if (m_sim.aperf && (reg==SIM_MSR_APERF || reg==SIM_MSR_MPERF)) {
+                sim_pmu_update(lcore);
+                if (reg==SIM_MSR_APERF)
+                        c->aperf = (double) value;
+                else
+                        c->mperf = (double) value;
+                return 0;
+        }
+
+        switch (reg) {
+        case SIM_MSR_ASSOC:
+                if ((value>>32)>=m_sim.num_cos ||
+                    (value&SIM_RMID_MASK)>=m_sim.num_rmids)
+                        return -1;
+                sim_update_socket(c->socket);
+                c->assoc = value;
+                break;
+        case SIM_MSR_MON_EVTSEL:
+                c->evtsel = value;
+                break;
+        default:
+                return -1;
+        }
+
+        return 0;
+}
+
+/**
+ * =======================================
+ * Specification parsing
+ * =======================================
+ */
+
+/**
+ * @brief Adds working set phase to cores listed in \a str
+ *
+ * @param str "<cores>:<kB>[@<sec>]" where cores is a list like "0,2,4-7"
+ *
+ * @return Operation status
+ */
+static int
+sim_parse_load(char *str)
+{
+        char *p = strchr(str, ':'), *at = NULL, *tok = NULL, *saveptr = NULL;
+        uint64_t bytes;
+        double start = 0.0;
+
+        if (p==NULL)
+                return PQOS_RETVAL_PARAM;
+        *p++ = '\0';
+
+        at = strchr(p, '@');
+        if (at!=NULL) {
+                *at++ = '\0';
+                start = strtod(at, NULL);
+        }
+        bytes = strtoull(p, NULL, 0) * 1024ULL;
+
+        for (tok=strtok_r(str, "+", &saveptr); tok!=NULL;
+             tok=strtok_r(NULL, "+", &saveptr)) {
+                unsigned lo, hi, i;
+                char *dash = strchr(tok, '-');
+
+                lo = (unsigned) strtoul(tok, NULL, 0);
+                hi = (dash!=NULL) ? (unsigned) strtoul(dash+1, NULL, 0) : lo;
+                if (lo>hi || hi>=sim_num_cores())
+                        return PQOS_RETVAL_PARAM;
+
+                for (i=lo;i<=hi;i++) {
+                        struct sim_core *c = &m_sim.cores[i];
+
+                        if (c->num_phases>=SIM_MAX_PHASES)
+                                return PQOS_RETVAL_PARAM;
+                        c->phases[c->num_phases].start = start;
+                        c->phases[c->num_phases].bytes = bytes;
+                        c->num_phases++;
+                }
+        }
+
+        return PQOS_RETVAL_OK;
+}
+
+/**
+ * @brief Parses platform geometry and loads from \a spec
+ *
+ * Geometry is parsed in the first pass (\a loads is 0) and
+ * core loads in the second one, once cores are allocated.
+ */
+static int
+sim_parse_spec(const char *spec, const int loads)
+{
+        char *cp = NULL, *tok = NULL, *saveptr = NULL;
+        int ret = PQOS_RETVAL_OK;
+
+        if (spec==NULL || spec[0]=='\0')
+                return PQOS_RETVAL_OK;
+
+        cp = strdup(spec);
+        if (cp==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (tok=strtok_r(cp, ";,", &saveptr);
+             tok!=NULL && ret==PQOS_RETVAL_OK;
+             tok=strtok_r(NULL, ";,", &saveptr)) {
+                static const struct {
+                        const char *key;
+                        unsigned *val;
+                } keytab[] = {
+                        { "sockets=", &m_sim.num_sockets },
+                        { "cores=",   &m_sim.cores_per_socket },
+                        { "ways=",    &m_sim.num_ways },
+                        { "cos=",     &m_sim.num_cos },
+                        { "rmids=",   &m_sim.num_rmids },
+                        { "llc=",     &m_sim.llc_kb },
+                        { "shared=",  &m_sim.shareable },
+                        { "io=",      &m_sim.io_ways },
+                        { "pmu=",     &m_sim.pmu },
+                        { "aperf=",   &m_sim.aperf },
+                        { "rapl=",    &m_sim.rapl },
+                        { "energy=",  &m_sim.energy },
+                };
+                unsigned i;
+
+                if (strncasecmp(tok, "load=", 5)==0) {
+                        if (loads)
+                                ret = sim_parse_load(tok+5);
+                        continue;
+                }
+
+                for (i=0;i<DIM(keytab);i++)
+                        if (strncasecmp(tok, keytab[i].key,
+                                        strlen(keytab[i].key))==0)
+                                break;
+                if (i>=DIM(keytab)) {
+                        printf("Unrecognized simulation parameter '%s'\n", tok);
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+                if (!loads)
+                        *keytab[i].val = (unsigned)
+                                strtoul(tok+strlen(keytab[i].key), NULL, 0);
+        }
+
+        free(cp);
+        return ret;
+}
+
+/**
+ * =======================================
+ * Init and fini
+ * =======================================
+ */
+
+int
+sim_init(const char *spec, struct pqos_config *cfg)
+{
+        unsigned i, j, ncores;
+        size_t sz;
+        int ret;
+
+        if (cfg==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        memset(&m_sim, 0, sizeof(m_sim));
+        m_sim.num_sockets = 1;
+        m_sim.cores_per_socket = 8;
+        m_sim.num_ways = 20;
+        m_sim.num_cos = 4;
+        m_sim.num_rmids = 64;
+        m_sim.llc_kb = 25600;
+        m_sim.io_ways = ~0U;
+        m_sim.pmu = 1;
+        m_sim.aperf = 1;
+        m_sim.rapl = 2;
+
+        ret = sim_parse_spec(spec, 0);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        /**
+         * By default I/O uses the two top ways
+         */
+        if (m_sim.io_ways==~0U)
+                m_sim.io_ways = (m_sim.num_ways>=2) ?
+                        (3U << (m_sim.num_ways-2)) : 0;
+
+        if (m_sim.num_sockets==0 || m_sim.cores_per_socket==0 ||
+            m_sim.num_ways==0 || m_sim.num_ways>32 ||
+            (m_sim.num_ways<32 && (m_sim.shareable >> m_sim.num_ways)!=0) ||
+            (m_sim.num_ways<32 && (m_sim.io_ways >> m_sim.num_ways)!=0) ||
+            m_sim.num_cos==0 || m_sim.num_cos>SIM_MAX_COS ||
+            m_sim.num_rmids<2 || m_sim.num_rmids>1024 || m_sim.rapl>2 ||
+            sim_way_size()<SIM_LINE_SIZE || sim_num_cores()<2) {
+                printf("Invalid simulated platform geometry!\n");
+                return PQOS_RETVAL_PARAM;
+        }
+
+        ncores = sim_num_cores();
+        m_sim.cores = (struct sim_core *) calloc(ncores, sizeof(m_sim.cores[0]));
+        m_sim.sockets = (struct sim_socket *) calloc(m_sim.num_sockets,
+                                                     sizeof(m_sim.sockets[0]));
+        sz = sizeof(*m_sim.topology) + ncores*sizeof(m_sim.topology->cores[0]);
+        m_sim.topology = (struct pqos_cpuinfo *) calloc(1, sz);
+        if (m_sim.cores==NULL || m_sim.sockets==NULL || m_sim.topology==NULL) {
+                sim_fini();
+                return PQOS_RETVAL_RESOURCE;
+        }
+
+        m_sim.topology->mem_size = (unsigned) sz;
+        m_sim.topology->num_cores = ncores;
+        for (i=0;i<ncores;i++) {
+                m_sim.cores[i].socket = i / m_sim.cores_per_socket;
+                m_sim.topology->cores[i].lcore = i;
+                m_sim.topology->cores[i].socket = m_sim.cores[i].socket;
+                m_sim.topology->cores[i].cluster = m_sim.cores[i].socket;
+        }
+
+        /**
+         * After reset all classes of service can use all ways
+         */
+        for (i=0;i<m_sim.num_sockets;i++)
+                for (j=0;j<m_sim.num_cos;j++)
+                        m_sim.sockets[i].l3ca_mask[j] =
+                                (m_sim.num_ways>=64) ? ~0ULL :
+                                ((1ULL<<m_sim.num_ways)-1ULL);
+
+        ret = sim_parse_spec(spec, 1);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("Invalid simulated core load!\n");
+                sim_fini();
+                return ret;
+        }
+
+        m_sim.start = sim_now();
+        sim_update_phases(0.0);
+        for (i=0;i<ncores;i++)
+                m_sim.cores[i].pmu_update = m_sim.start;
+        for (i=0;i<m_sim.num_sockets;i++) {
+                m_sim.sockets[i].pkg_energy = (double) m_sim.energy;
+                m_sim.sockets[i].dram_energy = (double) m_sim.energy;
+                m_sim.sockets[i].rapl_update = m_sim.start;
+        }
+
+        m_sim.ops.cpuid = sim_cpuid;
+        m_sim.ops.msr_read = sim_msr_read;
+        m_sim.ops.msr_write = sim_msr_write;
+        m_sim.ops.context = NULL;
+
+        cfg->topology = m_sim.topology;
+        cfg->machine = &m_sim.ops;
+        return PQOS_RETVAL_OK;
+}
+
+void
+sim_fini(void)
+{
+        if (m_sim.cores!=NULL)
+                free(m_sim.cores);
+        if (m_sim.sockets!=NULL)
+                free(m_sim.sockets);
+        if (m_sim.topology!=NULL)
+                free(m_sim.topology);
+        memset(&m_sim, 0, sizeof(m_sim));
+}
+
+int
+sim_set_load(const unsigned lcore, const uint64_t bytes)
+{
+        if (m_sim.cores==NULL || lcore>=sim_num_cores())
+                return PQOS_RETVAL_PARAM;
+
+        sim_rapl_update(m_sim.cores[lcore].socket);
+        sim_update_socket(m_sim.cores[lcore].socket);
+        m_sim.cores[lcore].wss = bytes;
+        m_sim.cores[lcore].num_phases = 0;
+        return PQOS_RETVAL_OK;
+}
@@ -0,0 +1,86 @@
+/**
+ * @file sim.h
+ * @brief Simulated platform with CMT and CAT
+ *
+ * The simulated platform provides CPU topology, CPUID leaves and
+ * MSRs through PQoS library configuration structure so that
+ * the library and the utility can run without RDT hardware.
+ * LLC occupancy of each core follows a simple cache model driven
+ * by per core working set sizes and class of service masks,
+ * core performance counters follow the resulting LLC miss rate,
+ * frequency follows the number of busy cores and energy counters
+ * follow frequency and the miss rate.
+ */
+
+#ifndef __SIM_H__
+#define __SIM_H__
+
+#include "pqos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SIM_MAX_PHASES 8                        /**< max working set phases per core */
+
+/**
+ * @brief Initializes simulated platform
+ *
+ * \a spec is a list of "key=value" items separated with ';' or ','
+ *     sockets=<n>   number of CPU sockets (default 1)
+ *     cores=<n>     number of logical cores per socket (default 8)
+ *     ways=<n>      number of LLC ways (default 20)
+ *     cos=<n>       number of classes of service (default 4)
+ *     rmids=<n>     number of RMIDs (default 64)
+ *     llc=<kB>      LLC size in kilobytes (default 25600)
+ *     shared=<mask> shareable ways reported by CPUID (default 0)
+ *     io=<mask>     IIO LLC ways register, 0 if not implemented
+ *                   (default two top ways)
+ *     pmu=<0|1>     architectural performance monitoring with
+ *                   instructions, cycles and LLC misses counters
+ *                   (default 1)
+ *     aperf=<0|1>   APERF/MPERF effective frequency counters (default 1)
+ *     rapl=<n>      RAPL energy domains, 0 none, 1 package,
+ *                   2 package and DRAM (default 2)
+ *     energy=<J>    initial value of the energy counters in Joules,
+ *                   package counter wraps at 262144J and DRAM counter
+ *                   at 65536J, e.g. energy=262100 gets both to wrap
+ *                   within seconds (default 0)
+ *     load=<cores>:<kB>[@<sec>]
+ *                   working set size of the cores starting from
+ *                   given second of the simulation (default 0),
+ *                   cores are listed with '+' e.g. "0+2+4-7",
+ *                   phases of a core are applied in the given order
+ *
+ * On success topology and machine fields of \a cfg point at
+ * the simulated platform.
+ *
+ * @param [in] spec platform specification, can be NULL or empty
+ * @param [out] cfg library configuration structure to update
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int sim_init(const char *spec, struct pqos_config *cfg);
+
+/**
+ * @brief Shuts down simulated platform and frees its resources
+ */
+void sim_fini(void);
+
+/**
+ * @brief Changes working set size of \a lcore
+ *
+ * @param [in] lcore logical core id
+ * @param [in] bytes working set size in bytes
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int sim_set_load(const unsigned lcore, const uint64_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SIM_H__ */
@@ -0,0 +1,302 @@
+/**
+ * @file stats.c
+ * @brief Online statistics of monitoring groups
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "stats.h"
+
+/**
+ * Bucket growth factor, bucket midpoint is within STATS_ACCURACY
+ * of any value in the bucket
+ */
+#define STATS_GAMMA ((1.0 + STATS_ACCURACY) / (1.0 - STATS_ACCURACY))
+
+void
+stats_init(struct stats_acc *s)
+{
+        memset(s, 0, sizeof(*s));
+}
+
+/**
+ * @brief Returns histogram bucket of value \a v >= 1
+ */
+static unsigned
+stats_bucket(const double v)
+{
+        const double i = ceil(log(v) / log(STATS_GAMMA));
+
+        if (i<=0.0)
+                return 0;
+        if (i>=(double) (STATS_BUCKETS - 1))
+                return STATS_BUCKETS - 1;
+        return (unsigned) i;
+}
+
+void
+stats_add(struct stats_acc *s, double v)
+{
+        double delta;
+
+        if (v<0.0)
+                v = 0.0;
+
+        if (s->count==0 || v<s->min)
+                s->min = v;
+        if (s->count==0 || v>s->max)
+                s->max = v;
+        s->count++;
+        delta = v - s->mean;
+        s->mean += delta / (double) s->count;
+        s->m2 += delta * (v - s->mean);
+
+        if (v<1.0)
+                s->low++;
+        else
+                s->buckets[stats_bucket(v)]++;
+}
+
+void
+stats_merge(struct stats_acc *dst, const struct stats_acc *src)
+{
+        double n, delta;
+        unsigned i;
+
+        if (src->count==0)
+                return;
+        if (dst->count==0) {
+                *dst = *src;
+                return;
+        }
+
+        n = (double) (dst->count + src->count);
+        delta = src->mean - dst->mean;
+        dst->m2 += src->m2 +
+                delta * delta * (double) dst->count * (double) src->count / n;
+        dst->mean += delta * (double) src->count / n;
+        dst->count += src->count;
+        if (src->min<dst->min)
+                dst->min = src->min;
+        if (src->max>dst->max)
+                dst->max = src->max;
+
+        dst->low += src->low;
+        for (i=0;i<STATS_BUCKETS;i++)
+                dst->buckets[i] += src->buckets[i];
+}
+
+double
+stats_stddev(const struct stats_acc *s)
+{
+        if (s->count<2)
+                return 0.0;
+        return sqrt(s->m2 / (double) (s->count - 1));
+}
+
+double
+stats_quantile(const struct stats_acc *s, const double q)
+{
+        double rank, v;
+        uint64_t seen;
+        unsigned i;
+
+        if (s->count==0)
+                return 0.0;
+        if (q<=0.0)
+                return s->min;
+        if (q>=1.0)
+                return s->max;
+
+        rank = q * (double) (s->count - 1);
+        seen = s->low;
+        if ((double) seen>rank)
+                return s->min;
+
+        for (i=0;i<STATS_BUCKETS-1;i++) {
+                seen += s->buckets[i];
+                if ((double) seen>rank)
+                        break;
+        }
+
+        v = 2.0 * pow(STATS_GAMMA, (double) i) / (STATS_GAMMA + 1.0);
+        if (v<s->min)
+                v = s->min;
+        if (v>s->max)
+                v = s->max;
+        return v;
+}
+
+/**
+ * @brief Merges statistics of all groups on \a socket with \a event
+ *
+ * @return Number of groups merged
+ */
+static unsigned
+stats_socket_total(const struct stats_group *groups, const unsigned num,
+                   const unsigned socket, const char *event,
+                   struct stats_acc *total)
+{
+        unsigned i, n = 0;
+
+        stats_init(total);
+        for (i=0;i<num;i++)
+                if (groups[i].socket==socket &&
+                    strcmp(groups[i].event, event)==0) {
+                        stats_merge(total, &groups[i].acc);
+                        n++;
+                }
+        return n;
+}
+
+/**
+ * @brief Tells if \a i is the first group with its event on its socket
+ */
+static int
+stats_first_on_socket(const struct stats_group *groups, const unsigned i)
+{
+        unsigned j;
+
+        for (j=0;j<i;j++)
+                if (groups[j].socket==groups[i].socket &&
+                    strcmp(groups[j].event, groups[i].event)==0)
+                        return 0;
+        return 1;
+}
+
+/**
+ * @brief Prints single text table row, values divided by \a scale
+ */
+static void
+stats_row_text(FILE *fp, const struct stats_acc *s, const double scale)
+{
+        fprintf(fp, " %10llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+                (unsigned long long) s->count, s->min / scale,
+                s->mean / scale, s->max / scale, stats_stddev(s) / scale,
+                stats_quantile(s, 0.50) / scale,
+                stats_quantile(s, 0.90) / scale,
+                stats_quantile(s, 0.99) / scale);
+}
+
+void
+stats_report_text(FILE *fp, const struct stats_group *groups,
+                  const unsigned num, const double duration)
+{
+        struct stats_acc *total = NULL;
+        unsigned i;
+
+        if (fp==NULL || groups==NULL)
+                return;
+
+        fprintf(fp, "STATS %u row(s) over %.1fs\n"
+                "SOCKET     CORE     RMID EVENT UNIT      COUNT       MIN"
+                "      MEAN       MAX    STDDEV       P50       P90       P99"
+                "\n", num, duration);
+        for (i=0;i<num;i++) {
+                fprintf(fp, "%6u %8u %8u %-5s %-4s", groups[i].socket,
+                        groups[i].core, groups[i].rmid, groups[i].event,
+                        groups[i].unit);
+                stats_row_text(fp, &groups[i].acc, groups[i].scale);
+        }
+
+        total = malloc(sizeof(*total));
+        if (total==NULL)
+                return;
+        for (i=0;i<num;i++) {
+                if (!stats_first_on_socket(groups, i))
+                        continue;
+                if (stats_socket_total(groups, num, groups[i].socket,
+                                       groups[i].event, total)<2)
+                        continue;
+                fprintf(fp, "%6u %8s %8s %-5s %-4s", groups[i].socket, "all",
+                        "-", groups[i].event, groups[i].unit);
+                stats_row_text(fp, total, groups[i].scale);
+        }
+        free(total);
+        fflush(fp);
+}
+
+/**
+ * @brief Prints statistics fields of JSON object,
+ *        values divided by \a scale
+ */
+static void
+stats_fields_json(FILE *fp, const struct stats_acc *s, const double scale)
+{
+        fprintf(fp, "\"count\":%llu,\"min\":%.3f,\"mean\":%.3f,\"max\":%.3f,"
+                "\"stddev\":%.3f,\"p50\":%.3f,\"p90\":%.3f,\"p99\":%.3f",
+                (unsigned long long) s->count, s->min / scale,
+                s->mean / scale, s->max / scale, stats_stddev(s) / scale,
+                stats_quantile(s, 0.50) / scale,
+                stats_quantile(s, 0.90) / scale,
+                stats_quantile(s, 0.99) / scale);
+}
+
+void
+stats_report_json(FILE *fp, const struct stats_group *groups,
+                  const unsigned num, const double duration)
+{
+        struct stats_acc *total = NULL;
+        unsigned i;
+        int first = 1;
+
+        if (fp==NULL || groups==NULL)
+                return;
+
+        fprintf(fp, "{\"duration_s\":%.3f,\"groups\":[", duration);
+        for (i=0;i<num;i++) {
+                fprintf(fp, "%s{\"socket\":%u,\"core\":%u,\"rmid\":%u,"
+                        "\"event\":\"%s\",\"unit\":\"%s\",", i ? "," : "",
+                        groups[i].socket, groups[i].core, groups[i].rmid,
+                        groups[i].event, groups[i].unit);
+                stats_fields_json(fp, &groups[i].acc, groups[i].scale);
+                fputc('}', fp);
+        }
+        fputs("],\"sockets\":[", fp);
+
+        total = malloc(sizeof(*total));
+        for (i=0;i<num && total!=NULL;i++) {
+                if (!stats_first_on_socket(groups, i))
+                        continue;
+                stats_socket_total(groups, num, groups[i].socket,
+                                   groups[i].event, total);
+                fprintf(fp, "%s{\"socket\":%u,\"event\":\"%s\","
+                        "\"unit\":\"%s\",", first ? "" : ",",
+                        groups[i].socket, groups[i].event, groups[i].unit);
+                stats_fields_json(fp, total, groups[i].scale);
+                fputc('}', fp);
+                first = 0;
+        }
+        free(total);
+        fputs("]}\n", fp);
+}
+
+int
+stats_save_json(const char *path, const struct stats_group *groups,
+                const unsigned num, const double duration)
+{
+        char tmp[256];
+        FILE *fp = NULL;
+        int ret = 0;
+
+        if (path==NULL ||
+            snprintf(tmp, sizeof(tmp), "%s.tmp", path)>=(int) sizeof(tmp))
+                return -1;
+
+        fp = fopen(tmp, "w");
+        if (fp==NULL)
+                return -1;
+        stats_report_json(fp, groups, num, duration);
+        if (ferror(fp))
+                ret = -1;
+        if (fclose(fp)!=0)
+                ret = -1;
+        if (ret==0 && rename(tmp, path)!=0)
+                ret = -1;
+        if (ret!=0)
+                remove(tmp);
+        return ret;
+}
@@ -0,0 +1,142 @@
+/**
+ * @file stats.h
+ * @brief Online statistics of monitoring groups
+ *
+ * Every group and event keeps count, min, max, mean and variance
+ * (Welford's method) and a fixed size logarithmic histogram for
+ * quantiles. Histogram buckets grow by STATS_GAMMA so any quantile
+ * estimate is within STATS_ACCURACY relative error of a real sample.
+ * Memory use does not depend on the number of samples and two
+ * accumulators can be merged by adding their buckets. Metrics below
+ * 1, like IPC, are accumulated multiplied by the group scale so they
+ * keep histogram resolution.
+ */
+
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define STATS_ACCURACY 0.01                     /**< quantile relative error */
+#define STATS_BUCKETS  1024                     /**< histogram buckets, cover
+                                                   values from 1 to ~7e8 */
+
+/**
+ * Streaming statistics accumulator
+ */
+struct stats_acc {
+        uint64_t count;                         /**< number of values */
+        double min;
+        double max;
+        double mean;
+        double m2;                              /**< sum of squared deviations */
+        uint32_t low;                           /**< values below 1 */
+        uint32_t buckets[STATS_BUCKETS];        /**< bucket n holds
+                                                   (gamma^(n-1), gamma^n] */
+};
+
+/**
+ * Statistics of single monitoring group and event
+ */
+struct stats_group {
+        unsigned socket;
+        unsigned core;                          /**< first core of the group */
+        unsigned rmid;
+        const char *event;                      /**< event name */
+        const char *unit;                       /**< unit of values */
+        double scale;                           /**< values are added
+                                                   multiplied by scale */
+        struct stats_acc acc;
+};
+
+/**
+ * @brief Resets accumulator
+ *
+ * @param [out] s accumulator
+ */
+void stats_init(struct stats_acc *s);
+
+/**
+ * @brief Adds value to accumulator
+ *
+ * @param [in,out] s accumulator
+ * @param [in] v value, negative values are accounted as 0
+ */
+void stats_add(struct stats_acc *s, double v);
+
+/**
+ * @brief Merges \a src into \a dst
+ *
+ * Result is the same as if all values of \a src were added to \a dst.
+ *
+ * @param [in,out] dst accumulator
+ * @param [in] src accumulator to merge
+ */
+void stats_merge(struct stats_acc *dst, const struct stats_acc *src);
+
+/**
+ * @brief Returns standard deviation of accumulated values
+ */
+double stats_stddev(const struct stats_acc *s);
+
+/**
+ * @brief Returns estimate of quantile \a q
+ *
+ * @param [in] s accumulator
+ * @param [in] q quantile from 0 to 1
+ *
+ * @return Quantile estimate, 0 if there are no values
+ */
+double stats_quantile(const struct stats_acc *s, const double q);
+
+/**
+ * @brief Prints statistics table of groups and per socket totals
+ *        of each event
+ *
+ * @param [in] fp stream to print to
+ * @param [in] groups group statistics
+ * @param [in] num number of groups
+ * @param [in] duration monitoring time in seconds
+ */
+void stats_report_text(FILE *fp, const struct stats_group *groups,
+                       const unsigned num, const double duration);
+
+/**
+ * @brief Prints statistics of groups as single JSON object
+ *
+ * @param [in] fp stream to print to
+ * @param [in] groups group statistics
+ * @param [in] num number of groups
+ * @param [in] duration monitoring time in seconds
+ */
+void stats_report_json(FILE *fp, const struct stats_group *groups,
+                       const unsigned num, const double duration);
+
+/**
+ * @brief Replaces \a path with JSON statistics
+ *
+ * The file is written under a temporary name and renamed, so
+ * readers never see a partial report.
+ *
+ * @param [in] path file name
+ * @param [in] groups group statistics
+ * @param [in] num number of groups
+ * @param [in] duration monitoring time in seconds
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int stats_save_json(const char *path, const struct stats_group *groups,
+                    const unsigned num, const double duration);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __STATS_H__ */
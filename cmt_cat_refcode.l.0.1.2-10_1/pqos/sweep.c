@@ -0,0 +1,481 @@
+/**
+ * @file sweep.c
+ * @brief Cache allocation sensitivity profiler
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#ifdef DEBUG
+#include <assert.h>
+#endif
+
+#include "sweep.h"
+
+#ifndef DIM
+#define DIM(x) (sizeof(x)/sizeof(x[0]))
+#endif
+
+#ifdef DEBUG
+#define ASSERT assert
+#else
+#define ASSERT(x)
+#endif
+
+/**
+ * Results of a single run
+ */
+struct sweep_result {
+        double runtime;                 /**< wall clock time in seconds */
+        double utime;                   /**< user CPU time in seconds */
+        double stime;                   /**< system CPU time in seconds */
+        double occ_avg;                 /**< average LLC occupancy in bytes */
+        double occ_max;                 /**< maximum LLC occupancy in bytes */
+        uint64_t instructions;          /**< instructions retired in the run */
+        uint64_t cycles;                /**< unhalted core cycles in the run */
+        uint64_t llc_misses;            /**< LLC misses in the run */
+        int status;                     /**< command exit status */
+};
+
+/**
+ * @brief SIGCHLD handler, never runs while the command is sampled
+ *        as SIGCHLD is blocked and taken by sigtimedwait() then
+ *
+ * @param signo signal number
+ */
+static void
+sweep_sigchld(int signo)
+{
+        (void) signo;
+}
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in seconds
+ */
+static double
+sweep_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (double) ts.tv_sec + ((double) ts.tv_nsec / 1e9);
+}
+
+/**
+ * @brief Converts timeval into seconds
+ */
+static double
+tv2sec(const struct timeval *tv)
+{
+        return (double) tv->tv_sec + ((double) tv->tv_usec / 1e6);
+}
+
+void
+sweep_config_default(struct sweep_config *cfg)
+{
+        ASSERT(cfg!=NULL);
+        memset(cfg, 0, sizeof(*cfg));
+        cfg->core = 0;
+        cfg->class_id = -1;
+        cfg->min_ways = 1;
+        cfg->max_ways = 0;
+        cfg->repeat = 1;
+        cfg->interval = 100000L;
+}
+
+int
+sweep_config_parse(struct sweep_config *cfg, const char *opts)
+{
+        char *cp = NULL, *tok = NULL, *saveptr = NULL;
+        int ret = PQOS_RETVAL_OK;
+
+        if (cfg==NULL)
+                return PQOS_RETVAL_PARAM;
+        if (opts==NULL)
+                return PQOS_RETVAL_OK;
+
+        cp = strdup(opts);
+        if (cp==NULL)
+                return PQOS_RETVAL_RESOURCE;
+
+        for (tok=strtok_r(cp, ",", &saveptr); tok!=NULL;
+             tok=strtok_r(NULL, ",", &saveptr)) {
+                char *val = strchr(tok, '=');
+                unsigned long n;
+
+                if (val==NULL) {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+                *val++ = '\0';
+                n = strtoul(val, NULL, 0);
+
+                if (strcasecmp(tok, "core")==0)
+                        cfg->core = (unsigned) n;
+                else if (strcasecmp(tok, "cos")==0)
+                        cfg->class_id = (int) n;
+                else if (strcasecmp(tok, "min")==0)
+                        cfg->min_ways = (unsigned) n;
+                else if (strcasecmp(tok, "max")==0)
+                        cfg->max_ways = (unsigned) n;
+                else if (strcasecmp(tok, "repeat")==0)
+                        cfg->repeat = (unsigned) n;
+                else {
+                        ret = PQOS_RETVAL_PARAM;
+                        break;
+                }
+        }
+
+        free(cp);
+
+        if (ret==PQOS_RETVAL_OK &&
+            (cfg->min_ways==0 || cfg->repeat==0 ||
+             (cfg->max_ways!=0 && cfg->max_ways<cfg->min_ways)))
+                ret = PQOS_RETVAL_PARAM;
+
+        return ret;
+}
+
+/**
+ * @brief Adds core performance counter deltas of the last poll
+ *        of \a group to \a res
+ */
+static void
+sweep_count(const struct pqos_mon_data *group, struct sweep_result *res)
+{
+        res->instructions += group->instructions;
+        res->cycles += group->cycles;
+        res->llc_misses += group->llc_misses;
+}
+
+/**
+ * @brief Runs \a argv pinned to \a core and samples its occupancy
+ *        and core performance counters
+ *
+ * @param [in] core core to pin the command to
+ * @param [in] argv command to run
+ * @param [in] group monitoring group, NULL if not available
+ * @param [in] scale occupancy scale factor
+ * @param [in] interval sampling interval in microseconds
+ * @param [in] stop pointer to stop indicator
+ * @param [out] res run results
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+static int
+sweep_exec(const unsigned core,
+           char * const argv[],
+           struct pqos_mon_data *group,
+           const uint32_t scale,
+           const long interval,
+           const int *stop,
+           struct sweep_result *res)
+{
+        struct sigaction sa, sa_old;
+        sigset_t chld, mask_old;
+        struct rusage ru;
+        double t0, occ_sum = 0.0;
+        unsigned samples = 0;
+        int status = 0;
+        pid_t pid;
+
+        memset(res, 0, sizeof(*res));
+        memset(&ru, 0, sizeof(ru));
+
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = sweep_sigchld;
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGCHLD, &sa, &sa_old);
+
+        /**
+         * SIGCHLD stays pending until the sampling wait takes it,
+         * so an exit between wait4() and the wait is not missed
+         */
+        sigemptyset(&chld);
+        sigaddset(&chld, SIGCHLD);
+        sigprocmask(SIG_BLOCK, &chld, &mask_old);
+
+        /**
+         * Counter deltas of the next poll start here
+         */
+        if (group!=NULL)
+                (void) pqos_mon_poll(group, 1);
+
+        t0 = sweep_now();
+        pid = fork();
+        if (pid<0) {
+                perror("fork");
+                sigprocmask(SIG_SETMASK, &mask_old, NULL);
+                sigaction(SIGCHLD, &sa_old, NULL);
+                return PQOS_RETVAL_ERROR;
+        }
+
+        if (pid==0) {
+                cpu_set_t set;
+
+                sigprocmask(SIG_SETMASK, &mask_old, NULL);
+
+                CPU_ZERO(&set);
+                CPU_SET(core, &set);
+                if (sched_setaffinity(0, sizeof(set), &set)!=0)
+                        fprintf(stderr, "Failed to pin to core %u, "
+                                "running unpinned\n", core);
+                execvp(argv[0], argv);
+                perror(argv[0]);
+                _exit(127);
+        }
+
+        for (;;) {
+                struct timespec ts;
+                pid_t r = wait4(pid, &status, WNOHANG, &ru);
+
+                if (r==pid)
+                        break;
+                if (r<0 && errno!=EINTR) {
+                        perror("wait4");
+                        sigprocmask(SIG_SETMASK, &mask_old, NULL);
+                        sigaction(SIGCHLD, &sa_old, NULL);
+                        return PQOS_RETVAL_ERROR;
+                }
+                if (*stop) {
+                        kill(pid, SIGTERM);
+                        (void) wait4(pid, &status, 0, &ru);
+                        break;
+                }
+
+                if (group!=NULL &&
+                    pqos_mon_poll(group, 1)==PQOS_RETVAL_OK) {
+                        double occ = (double) (group->value * scale);
+
+                        sweep_count(group, res);
+                        occ_sum += occ;
+                        samples++;
+                        if (occ>res->occ_max)
+                                res->occ_max = occ;
+                }
+
+                /**
+                 * Returns at once on command exit, also when it
+                 * ended before the call
+                 */
+                ts.tv_sec = interval / 1000000L;
+                ts.tv_nsec = (interval % 1000000L) * 1000L;
+                (void) sigtimedwait(&chld, NULL, &ts);
+        }
+
+        res->runtime = sweep_now() - t0;
+        if (group!=NULL &&
+            pqos_mon_poll(group, 1)==PQOS_RETVAL_OK)
+                sweep_count(group, res);
+        sigprocmask(SIG_SETMASK, &mask_old, NULL);
+        sigaction(SIGCHLD, &sa_old, NULL);
+        res->utime = tv2sec(&ru.ru_utime);
+        res->stime = tv2sec(&ru.ru_stime);
+        res->occ_avg = (samples>0) ? occ_sum / (double) samples : 0.0;
+        res->status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+        return PQOS_RETVAL_OK;
+}
+
+int
+sweep_run(FILE *fp,
+          const struct pqos_cap *cap,
+          const struct pqos_cpuinfo *cpu,
+          const struct sweep_config *cfg,
+          char * const argv[],
+          const int *stop)
+{
+        const struct pqos_capability *cap_l3ca = NULL;
+        const struct pqos_monitor *l3mon = NULL;
+        struct pqos_l3ca saved[PQOS_MAX_L3CA_COS], ca;
+        struct pqos_mon_data group, *p_group = NULL;
+        enum pqos_mon_event events = PQOS_MON_EVENT_L3_OCCUP;
+        unsigned socket = 0, saved_num = 0, saved_cos = 0;
+        unsigned num_ways, max_ways, ways, i, r;
+        char env[32];
+        int ret, ret2;
+
+        if (fp==NULL || cap==NULL || cpu==NULL || cfg==NULL ||
+            argv==NULL || argv[0]==NULL || stop==NULL)
+                return PQOS_RETVAL_PARAM;
+
+        ret = pqos_cap_get_type(cap, PQOS_CAP_TYPE_L3CA, &cap_l3ca);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("Allocation capability not detected!\n");
+                return ret;
+        }
+        num_ways = cap_l3ca->u.l3ca->num_ways;
+        max_ways = (cfg->max_ways==0 || cfg->max_ways>num_ways) ?
+                num_ways : cfg->max_ways;
+        if (cfg->min_ways>max_ways) {
+                printf("Invalid sweep range %u-%u ways!\n",
+                       cfg->min_ways, max_ways);
+                return PQOS_RETVAL_PARAM;
+        }
+
+        memset(&ca, 0, sizeof(ca));
+        ca.class_id = (cfg->class_id<0) ?
+                cap_l3ca->u.l3ca->num_classes - 1 : (unsigned) cfg->class_id;
+        if (ca.class_id>=cap_l3ca->u.l3ca->num_classes ||
+            ca.class_id>=PQOS_MAX_L3CA_COS) {
+                printf("Invalid class of service %u!\n", ca.class_id);
+                return PQOS_RETVAL_PARAM;
+        }
+
+        ret = pqos_cpu_get_socketid(cpu, cfg->core, &socket);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("Invalid core %u!\n", cfg->core);
+                return ret;
+        }
+
+        /**
+         * Save settings to be restored
+         */
+        ret = pqos_l3ca_get(socket, DIM(saved), &saved_num, saved);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+        ret = pqos_l3ca_assoc_get(cfg->core, &saved_cos);
+        if (ret!=PQOS_RETVAL_OK)
+                return ret;
+
+        ret = pqos_l3ca_assoc_set(cfg->core, ca.class_id);
+        if (ret!=PQOS_RETVAL_OK) {
+                printf("Failed to associate core %u with COS%u!\n",
+                       cfg->core, ca.class_id);
+                return ret;
+        }
+
+        /**
+         * IPC and MPKI are reported where core performance counters
+         * are available, occupancy alone if they are busy
+         */
+        if (pqos_cap_get_event(cap, PQOS_MON_EVENT_L3_OCCUP,
+                               &l3mon)==PQOS_RETVAL_OK) {
+                const struct pqos_monitor *p_mon = NULL;
+
+                if (pqos_cap_get_event(cap, PQOS_PERF_EVENT_IPC,
+                                       &p_mon)==PQOS_RETVAL_OK)
+                        events |= PQOS_PERF_EVENT_IPC;
+                if (pqos_cap_get_event(cap, PQOS_PERF_EVENT_LLC_MISS,
+                                       &p_mon)==PQOS_RETVAL_OK)
+                        events |= PQOS_PERF_EVENT_LLC_MISS;
+                if (pqos_mon_start(1, &cfg->core, events,
+                                   NULL, &group)==PQOS_RETVAL_OK)
+                        p_group = &group;
+                else if (events!=PQOS_MON_EVENT_L3_OCCUP &&
+                         pqos_mon_start(1, &cfg->core,
+                                        PQOS_MON_EVENT_L3_OCCUP,
+                                        NULL, &group)==PQOS_RETVAL_OK) {
+                        printf("Core performance counters not available, "
+                               "IPC and MPKI will not be reported\n");
+                        p_group = &group;
+                }
+        }
+        if (p_group==NULL)
+                printf("LLC occupancy monitoring not available, "
+                       "occupancy will not be reported\n");
+
+        snprintf(env, sizeof(env), "%u", cap_l3ca->u.l3ca->way_size);
+        setenv("PQOS_SWEEP_WAY_SIZE", env, 1);
+
+        fprintf(fp, "ways,mask,run,runtime_s,user_s,sys_s,"
+                "llc_avg_kb,llc_max_kb,ipc,llc_mpki,exit_status\n");
+
+        for (ways=cfg->min_ways; ways<=max_ways && !(*stop); ways++) {
+                ca.ways_mask = (1ULL << ways) - 1ULL;
+                ret = pqos_l3ca_set(socket, 1, &ca);
+                if (ret!=PQOS_RETVAL_OK) {
+                        printf("Failed to set COS%u mask 0x%llx!\n",
+                               ca.class_id,
+                               (unsigned long long) ca.ways_mask);
+                        break;
+                }
+
+                /**
+                 * Tell the command which mask it runs with,
+                 * e.g. for benchmark/latbench
+                 */
+                snprintf(env, sizeof(env), "0x%llx",
+                         (unsigned long long) ca.ways_mask);
+                setenv("PQOS_SWEEP_MASK", env, 1);
+
+                for (r=0;r<cfg->repeat && !(*stop);r++) {
+                        struct sweep_result res;
+                        char ipc[32] = "", mpki[32] = "";
+
+                        ret = sweep_exec(cfg->core, argv, p_group,
+                                         (l3mon!=NULL) ? l3mon->scale_factor : 1,
+                                         cfg->interval, stop, &res);
+                        if (ret!=PQOS_RETVAL_OK)
+                                break;
+
+                        /**
+                         * Columns of events not monitored stay empty
+                         */
+                        if (p_group!=NULL &&
+                            (p_group->event & PQOS_PERF_EVENT_IPC))
+                                snprintf(ipc, sizeof(ipc), "%.3f",
+                                         res.cycles>0 ?
+                                         (double) res.instructions /
+                                         (double) res.cycles : 0.0);
+                        if (p_group!=NULL &&
+                            (p_group->event & PQOS_PERF_EVENT_LLC_MISS))
+                                snprintf(mpki, sizeof(mpki), "%.3f",
+                                         res.instructions>0 ?
+                                         (double) res.llc_misses * 1000.0 /
+                                         (double) res.instructions : 0.0);
+
+                        fprintf(fp, "%u,0x%llx,%u,%.6f,%.6f,%.6f,%.1f,%.1f,"
+                                "%s,%s,%d\n",
+                                ways, (unsigned long long) ca.ways_mask, r,
+                                res.runtime, res.utime, res.stime,
+                                res.occ_avg / 1024.0, res.occ_max / 1024.0,
+                                ipc, mpki, res.status);
+                        fflush(fp);
+                        if (fp!=stdout)
+                                printf("%2u ways run %u: %.3fs\n",
+                                       ways, r, res.runtime);
+                }
+                if (ret!=PQOS_RETVAL_OK)
+                        break;
+        }
+
+        unsetenv("PQOS_SWEEP_MASK");
+        unsetenv("PQOS_SWEEP_WAY_SIZE");
+
+        /**
+         * Restore original settings
+         */
+        if (p_group!=NULL)
+                (void) pqos_mon_stop(p_group);
+
+        for (i=0;i<saved_num;i++)
+                if (saved[i].class_id==ca.class_id)
+                        break;
+        if (i<saved_num) {
+                ret2 = pqos_l3ca_set(socket, 1, &saved[i]);
+                if (ret2!=PQOS_RETVAL_OK) {
+                        printf("Failed to restore COS%u mask!\n", ca.class_id);
+                        ret = ret2;
+                }
+        }
+        ret2 = pqos_l3ca_assoc_set(cfg->core, saved_cos);
+        if (ret2!=PQOS_RETVAL_OK) {
+                printf("Failed to restore core %u association!\n", cfg->core);
+                ret = ret2;
+        }
+
+        return ret;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file sweep.h
+ * @brief Cache allocation sensitivity profiler
+ *
+ * The profiler runs a command pinned to a core that has a dedicated
+ * class of service and steps the class way mask from the smallest to
+ * the largest size. Runtime and LLC occupancy of each run are recorded
+ * as CSV, one line per run, giving a way-vs-performance curve of
+ * the workload.
+ */
+
+#ifndef __SWEEP_H__
+#define __SWEEP_H__
+
+#include <stdio.h>
+#include "pqos.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Profiler configuration
+ */
+struct sweep_config {
+        unsigned core;                  /**< core to run the command on */
+        int class_id;                   /**< class of service, negative selects
+                                           the highest class */
+        unsigned min_ways;              /**< first mask size */
+        unsigned max_ways;              /**< last mask size, 0 for all ways */
+        unsigned repeat;                /**< runs per mask size */
+        long interval;                  /**< occupancy sampling interval
+                                           in microseconds */
+};
+
+/**
+ * @brief Fills \a cfg with default profiler settings
+ *
+ * @param [out] cfg profiler configuration
+ */
+void sweep_config_default(struct sweep_config *cfg);
+
+/**
+ * @brief Updates \a cfg with settings from \a opts string
+ *
+ * Options are separated with ',' and can be:
+ *     core=<n>       core to pin the command to (default 0)
+ *     cos=<n>        class of service to use (default highest)
+ *     min=<ways>     first mask size (default 1)
+ *     max=<ways>     last mask size (default all ways)
+ *     repeat=<n>     runs per mask size (default 1)
+ *
+ * @param [in,out] cfg profiler configuration
+ * @param [in] opts option string, NULL leaves \a cfg unchanged
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int sweep_config_parse(struct sweep_config *cfg, const char *opts);
+
+/**
+ * @brief Runs the sweep
+ *
+ * Class of service mask and core association are restored
+ * when the sweep completes or gets interrupted.
+ *
+ * @param [in] fp stream to write CSV records to
+ * @param [in] cap detected PQoS capabilities
+ * @param [in] cpu detected CPU topology
+ * @param [in] cfg profiler configuration
+ * @param [in] argv NULL terminated command to run
+ * @param [in] stop pointer to stop indicator
+ *
+ * @return Operation status
+ * @retval PQOS_RETVAL_OK on success
+ */
+int sweep_run(FILE *fp,
+              const struct pqos_cap *cap,
+              const struct pqos_cpuinfo *cpu,
+              const struct sweep_config *cfg,
+              char * const argv[],
+              const int *stop);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SWEEP_H__ */
@@ -0,0 +1,234 @@
+/**
+ * @file tick.c
+ * @brief Drift-free periodic sampling timer
+ *
+ * Timer is armed once with absolute first expiry and a period so that
+ * the kernel keeps the schedule. Reading timerfd returns the number of
+ * expirations since the previous read, more than one means ticks were
+ * missed while the caller was busy.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "tick.h"
+
+/**
+ * @brief Returns CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t
+tick_now(void)
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ((uint64_t) ts.tv_sec * 1000000000ULL) + (uint64_t) ts.tv_nsec;
+}
+
+/**
+ * @brief Converts nanoseconds to timespec
+ */
+static void
+tick_ns2ts(const uint64_t ns, struct timespec *ts)
+{
+        ts->tv_sec = (time_t) (ns / 1000000000ULL);
+        ts->tv_nsec = (long) (ns % 1000000000ULL);
+}
+
+/**
+ * @brief Adds lateness of a tick to timer statistics
+ *
+ * @param [in,out] t timer
+ * @param [in] late lateness in nanoseconds
+ */
+static void
+tick_account(struct tick_timer *t, const int64_t late)
+{
+        const double d = (double) late - t->late_mean;
+        uint64_t us = (late>0) ? ((uint64_t) late) / 1000ULL : 0;
+        unsigned b = 0;
+
+        t->samples++;
+        t->late_mean += d / (double) t->samples;
+        t->late_m2 += d * ((double) late - t->late_mean);
+        if (t->samples==1 || late<t->late_min)
+                t->late_min = late;
+        if (t->samples==1 || late>t->late_max)
+                t->late_max = late;
+
+        while (us>0 && b<(TICK_HIST_BUCKETS-1)) {
+                us >>= 1;
+                b++;
+        }
+        t->hist[b]++;
+}
+
+/**
+ * @brief Finds histogram upper bound for given fraction of ticks
+ *
+ * @param [in] t timer
+ * @param [in] q fraction of ticks, 0..1
+ *
+ * @return Lateness upper bound in microseconds
+ */
+static uint64_t
+tick_quantile(const struct tick_timer *t, const double q)
+{
+        const double limit = q * (double) t->samples;
+        uint64_t cum = 0;
+        unsigned b;
+
+        for (b=0;b<TICK_HIST_BUCKETS;b++) {
+                cum += t->hist[b];
+                if ((double) cum>=limit)
+                        break;
+        }
+        if (b>=TICK_HIST_BUCKETS)
+                b = TICK_HIST_BUCKETS-1;
+        return 1ULL << b;
+}
+
+int
+tick_parse_interval(const char *str, long *usec)
+{
+        char *end = NULL;
+        double v, scale = 100000.0;
+
+        if (str==NULL || usec==NULL)
+                return -1;
+
+        v = strtod(str, &end);
+        if (end==str || v<=0.0)
+                return -1;
+
+        if (*end=='\0')
+                scale = 100000.0;               /**< 100ms units */
+        else if (strcasecmp(end,"s")==0)
+                scale = 1000000.0;
+        else if (strcasecmp(end,"ms")==0)
+                scale = 1000.0;
+        else if (strcasecmp(end,"us")==0)
+                scale = 1.0;
+        else
+                return -1;
+
+        v *= scale;
+        if (v<1.0 || v>(double) (1L << 30))
+                return -1;
+        *usec = (long) (v + 0.5);
+        return 0;
+}
+
+int
+tick_init(struct tick_timer *t, const long period_us,
+          struct tick_sample *start)
+{
+        struct itimerspec its;
+
+        if (t==NULL || period_us<=0)
+                return -1;
+
+        memset(t, 0, sizeof(*t));
+        t->period_ns = (uint64_t) period_us * 1000ULL;
+
+        t->fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+        if (t->fd==-1)
+                return -1;
+
+        t->start_ns = tick_now();
+        memset(&its, 0, sizeof(its));
+        tick_ns2ts(t->start_ns + t->period_ns, &its.it_value);
+        tick_ns2ts(t->period_ns, &its.it_interval);
+        if (timerfd_settime(t->fd, TFD_TIMER_ABSTIME, &its, NULL)==-1) {
+                close(t->fd);
+                t->fd = -1;
+                return -1;
+        }
+
+        if (start!=NULL) {
+                memset(start, 0, sizeof(*start));
+                start->sched_ns = t->start_ns;
+                start->actual_ns = t->start_ns;
+        }
+        return 0;
+}
+
+int
+tick_wait(struct tick_timer *t, struct tick_sample *s, const int *stop)
+{
+        struct pollfd pfd;
+        uint64_t expired = 0;
+        ssize_t n;
+
+        if (t==NULL || s==NULL || t->fd==-1)
+                return -1;
+
+        pfd.fd = t->fd;
+        pfd.events = POLLIN;
+        for (;;) {
+                if (stop!=NULL && *stop)
+                        return 1;
+                pfd.revents = 0;
+                if (poll(&pfd, 1, -1)==-1) {
+                        if (errno==EINTR)
+                                continue;
+                        return -1;
+                }
+                n = read(t->fd, &expired, sizeof(expired));
+                if (n==(ssize_t) sizeof(expired) && expired>0)
+                        break;
+                if (n==-1 && errno!=EINTR && errno!=EAGAIN)
+                        return -1;
+        }
+
+        s->actual_ns = tick_now();
+        t->seq += expired;
+        t->missed += expired - 1;
+        s->seq = t->seq;
+        s->missed = expired - 1;
+        s->sched_ns = t->start_ns + t->seq * t->period_ns;
+        tick_account(t, (int64_t) (s->actual_ns - s->sched_ns));
+        return 0;
+}
+
+void
+tick_report(FILE *fp, const struct tick_timer *t)
+{
+        double stddev = 0.0;
+
+        if (fp==NULL || t==NULL)
+                return;
+
+        if (t->samples>1)
+                stddev = sqrt(t->late_m2 / (double) (t->samples - 1));
+
+        fprintf(fp, "Sampling: period %.3fms, %llu tick(s), %llu missed\n",
+                (double) t->period_ns / 1e6,
+                (unsigned long long) t->samples,
+                (unsigned long long) t->missed);
+        if (t->samples==0)
+                return;
+        fprintf(fp, "Lateness: min %.1fus, avg %.1fus, max %.1fus, "
+                "stddev %.1fus, p50 <%lluus, p99 <%lluus\n",
+                (double) t->late_min / 1e3, t->late_mean / 1e3,
+                (double) t->late_max / 1e3, stddev / 1e3,
+                (unsigned long long) tick_quantile(t, 0.50),
+                (unsigned long long) tick_quantile(t, 0.99));
+}
+
+void
+tick_fini(struct tick_timer *t)
+{
+        if (t==NULL || t->fd==-1)
+                return;
+        close(t->fd);
+        t->fd = -1;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file tick.h
+ * @brief Drift-free periodic sampling timer
+ *
+ * The timer is based on timerfd with CLOCK_MONOTONIC absolute expiry
+ * times. Tick n is scheduled at start + n * period regardless of time
+ * spent processing previous samples, so the sampling cadence does not
+ * drift. Expirations that passed while processing took too long are
+ * counted as missed ticks and lateness of every tick is recorded
+ * for the jitter report.
+ */
+
+#ifndef __TICK_H__
+#define __TICK_H__
+
+#include <stdio.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TICK_HIST_BUCKETS 32                    /**< log2 lateness histogram size */
+
+/**
+ * Sampling timer
+ */
+struct tick_timer {
+        int fd;                                 /**< timerfd descriptor */
+        uint64_t period_ns;                     /**< tick period */
+        uint64_t start_ns;                      /**< CLOCK_MONOTONIC start time */
+        uint64_t seq;                           /**< number of last expired tick */
+        uint64_t samples;                       /**< ticks delivered */
+        uint64_t missed;                        /**< ticks skipped */
+        int64_t late_min;                       /**< min lateness in ns */
+        int64_t late_max;                       /**< max lateness in ns */
+        double late_mean;                       /**< mean lateness in ns */
+        double late_m2;                         /**< sum of squared deviations */
+        uint64_t hist[TICK_HIST_BUCKETS];       /**< lateness histogram,
+                                                   bucket n holds [2^(n-1), 2^n) us */
+};
+
+/**
+ * Single tick delivered by the timer
+ */
+struct tick_sample {
+        uint64_t seq;                           /**< tick number, 0 is the start */
+        uint64_t sched_ns;                      /**< scheduled time */
+        uint64_t actual_ns;                     /**< wake up time */
+        uint64_t missed;                        /**< ticks skipped before this one */
+};
+
+/**
+ * @brief Converts interval string to microseconds
+ *
+ * A plain number is given in 100ms units. Numbers with "s", "ms"
+ * or "us" suffix are given in seconds, milliseconds or microseconds.
+ *
+ * @param [in] str interval string
+ * @param [out] usec interval in microseconds
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 invalid interval
+ */
+int tick_parse_interval(const char *str, long *usec);
+
+/**
+ * @brief Starts the timer
+ *
+ * @param [out] t timer to initialize
+ * @param [in] period_us tick period in microseconds
+ * @param [out] start optional start sample, tick 0
+ *
+ * @return Operation status
+ * @retval 0 on success
+ * @retval -1 on error
+ */
+int tick_init(struct tick_timer *t, const long period_us,
+              struct tick_sample *start);
+
+/**
+ * @brief Waits for the next tick
+ *
+ * The wait gets interrupted by signals in order to check
+ * the \a stop indicator.
+ *
+ * @param [in,out] t timer
+ * @param [out] s tick data
+ * @param [in] stop pointer to stop indicator, can be NULL
+ *
+ * @return Operation status
+ * @retval 0 tick expired
+ * @retval 1 stopped before the tick expired
+ * @retval -1 on error
+ */
+int tick_wait(struct tick_timer *t, struct tick_sample *s, const int *stop);
+
+/**
+ * @brief Prints jitter report of the timer
+ *
+ * @param [in] fp stream to print to
+ * @param [in] t timer
+ */
+void tick_report(FILE *fp, const struct tick_timer *t);
+
+/**
+ * @brief Stops the timer
+ *
+ * @param [in,out] t timer
+ */
+void tick_fini(struct tick_timer *t);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __TICK_H__ */
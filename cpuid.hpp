@@ -0,0 +1,202 @@
+/**
+ * @file cpuid.hpp
+ * @brief Typed CPUID leaf and field decoders
+ *
+ * Fields are constexpr descriptions of (leaf, subleaf, register, bits)
+ * generated from the table in pqos lib/cpuid_fields.h, the same table
+ * the library's capability discovery uses through its C shim
+ * (lib/cpuid_cache.h). Leaves are read once and cached, e.g.
+ *     cpuid::Cache &c = cpuid::cache();
+ *     if (c.get(cpuid::field::RDT_M))
+ *         maxRmid = c.get(cpuid::field::CMT_MAX_RMID);
+ * @version 0.1
+ * @date 2026-10-19
+ */
+
+#ifndef CPUID_HPP
+#define CPUID_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <map>
+#include <string>
+#include <utility>
+#include <cpuid.h>
+
+#include "cmt_cat_refcode.l.0.1.2-10_1/pqos/lib/cpuid_fields.h"
+
+namespace cpuid
+{
+
+enum Reg
+{
+    EAX,
+    EBX,
+    ECX,
+    EDX
+};
+
+/**
+ * @brief Registers returned by one leaf, indexed by Reg
+ */
+struct Regs
+{
+    uint32_t r[4];
+};
+
+/**
+ * @brief Compile time description of a CPUID bit field
+ */
+struct Field
+{
+    uint32_t leaf;
+    uint32_t subleaf;
+    Reg reg;
+    unsigned lsb;
+    unsigned width;
+    const char *name;
+
+    constexpr uint32_t mask() const
+    {
+        return width >= 32 ? 0xffffffffu : ((1u << width) - 1u);
+    }
+
+    constexpr uint32_t decode(const Regs &regs) const
+    {
+        return (regs.r[reg] >> lsb) & mask();
+    }
+};
+
+namespace field
+{
+#define CPUID_HPP_FIELD(name, leaf, subleaf, reg, lsb, width) \
+    constexpr Field name{leaf, subleaf, reg, lsb, width, #name};
+CPUID_FIELDS(CPUID_HPP_FIELD)
+#undef CPUID_HPP_FIELD
+
+#define CPUID_HPP_ENTRY(name, leaf, subleaf, reg, lsb, width) \
+    {leaf, subleaf, reg, lsb, width, #name},
+constexpr Field all[] = {CPUID_FIELDS(CPUID_HPP_ENTRY)};
+#undef CPUID_HPP_ENTRY
+
+constexpr size_t count = sizeof(all) / sizeof(all[0]);
+
+constexpr bool valid(size_t i)
+{
+    return i >= count ||
+           (all[i].width > 0 && all[i].lsb + all[i].width <= 32 && valid(i + 1));
+}
+
+static_assert(valid(0), "CPUID field does not fit its register");
+} // namespace field
+
+/**
+ * @brief Return if CPUID is supported
+ *
+ * On 32 bit x86 this checks that EFLAGS.ID (bit 21) can be toggled,
+ * every x86-64 CPU has CPUID.
+ */
+inline bool supported()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __get_cpuid_max(0, NULL) != 0;
+#else
+    return false;
+#endif
+}
+
+/**
+ * @brief Execute CPUID.leaf.subleaf on the current core
+ */
+inline Regs query(uint32_t leaf, uint32_t subleaf)
+{
+    Regs regs = {{0, 0, 0, 0}};
+#if defined(__x86_64__) || defined(__i386__)
+    __cpuid_count(leaf, subleaf, regs.r[EAX], regs.r[EBX], regs.r[ECX], regs.r[EDX]);
+#endif
+    return regs;
+}
+
+/**
+ * @brief Leaves read so far, each leaf is executed once
+ */
+class Cache
+{
+public:
+    const Regs &leaf(uint32_t leaf, uint32_t subleaf = 0)
+    {
+        const std::pair<uint32_t, uint32_t> key(leaf, subleaf);
+        std::map<std::pair<uint32_t, uint32_t>, Regs>::iterator it = leaves.find(key);
+        if (it == leaves.end())
+            it = leaves.insert(std::make_pair(key, query(leaf, subleaf))).first;
+        return it->second;
+    }
+
+    /**
+     * @brief Return if the CPU enumerates the leaf of \a f
+     */
+    bool has(const Field &f)
+    {
+        if (f.leaf >= 0x80000000u)
+            return leaf(0x80000000u).r[EAX] >= f.leaf;
+        return leaf(0).r[EAX] >= f.leaf;
+    }
+
+    /**
+     * @brief Return field value, 0 when its leaf is not enumerated
+     */
+    uint32_t get(const Field &f)
+    {
+        return has(f) ? f.decode(leaf(f.leaf, f.subleaf)) : 0;
+    }
+
+    uint32_t operator[](const Field &f)
+    {
+        return get(f);
+    }
+
+    /**
+     * @brief Return vendor string of CPUID.0 (EBX, EDX, ECX)
+     */
+    std::string vendor()
+    {
+        const Regs &r = leaf(0);
+        char name[13];
+        memcpy(name, &r.r[EBX], 4);
+        memcpy(name + 4, &r.r[EDX], 4);
+        memcpy(name + 8, &r.r[ECX], 4);
+        name[12] = '\0';
+        return name;
+    }
+
+    /**
+     * @brief Return brand string of CPUID.0x80000002-4, empty if not enumerated
+     */
+    std::string brand()
+    {
+        char name[49];
+        if (leaf(0x80000000u).r[EAX] < 0x80000004u)
+            return std::string();
+        for (uint32_t i = 0; i < 3; i++)
+            memcpy(name + 16 * i, leaf(0x80000002u + i).r, 16);
+        name[48] = '\0';
+        return name;
+    }
+
+private:
+    std::map<std::pair<uint32_t, uint32_t>, Regs> leaves;
+};
+
+/**
+ * @brief Return the process wide leaf cache
+ */
+inline Cache &cache()
+{
+    static Cache c;
+    return c;
+}
+
+} // namespace cpuid
+
+#endif
@@ -0,0 +1,461 @@
+/**
+ * @file rdtinfo.cpp
+ * @brief Intel RDT inventory of all logical CPUs as JSON
+ *
+ * One thread is started per CPU with its affinity set before it runs,
+ * so CPUID is executed on that CPU. All threads probe in parallel and
+ * report CMT/MBM events, RMID range, CAT/CDP/L2 CAT/MBA geometry and,
+ * when /dev/cpu/N/msr is readable, the current IA32_PQR_ASSOC RMID and
+ * COS. CPUs with identical capabilities are grouped, more than one
+ * group means the host is heterogeneous. A CPU whose thread can't be
+ * started on it, e.g. offline or outside the cpuset, is reported with
+ * an error and null caps rather than probed elsewhere, e.g.
+ *     ./rdtinfo > $(hostname).json
+ *     ./rdtinfo -c 0-3 -M
+ * @version 0.1
+ * @date 2026-10-19
+ */
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <getopt.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include "cpuid.hpp"
+using namespace std;
+
+#define MSR_PQR_ASSOC 0xC8F
+#define PQR_ASSOC_RMID_MASK ((1ULL << 10) - 1ULL)
+#define PQR_ASSOC_COS_SHIFT 32
+
+/**
+ * @brief Result of probing one CPU
+ */
+struct Probe
+{
+    int cpu;
+    bool pinned;         // thread ran on the requested CPU
+    int ranOn;           // CPU the probe ran on
+    uint32_t apicId;
+    bool haveAssoc;      // IA32_PQR_ASSOC was read
+    uint64_t assoc;
+    string msrError;
+    string error;        // CPU could not be probed, caps are empty
+    string caps;         // capability object, grouped across CPUs
+};
+
+struct Options
+{
+    vector<int> cpus;
+    bool readMsr = true;
+};
+
+static void usage(const char *prog)
+{
+    cerr << "Usage: " << prog << " [-c <cpu list>] [-M]\n"
+         << "  -c  CPUs to probe, e.g. 0-3,8 (default: all online)\n"
+         << "  -M  do not read IA32_PQR_ASSOC through /dev/cpu/N/msr\n";
+}
+
+/**
+ * @brief Parse CPU list like 0-3,8,10-11
+ */
+static bool parseCpuList(const string &str, vector<int> &cpus)
+{
+    stringstream ss(str);
+    string item;
+
+    cpus.clear();
+    while (getline(ss, item, ','))
+    {
+        char *end = NULL;
+        long first = strtol(item.c_str(), &end, 10), last = first;
+
+        if (end == item.c_str() || first < 0)
+            return false;
+        if (*end == '-')
+        {
+            const char *p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first)
+                return false;
+        }
+        if (*end != '\0' && *end != '\n')
+            return false;
+        for (long c = first; c <= last; c++)
+            cpus.push_back((int)c);
+    }
+    return !cpus.empty();
+}
+
+/**
+ * @brief Return online CPUs from sysfs, 0..N-1 if it can't be read
+ */
+static vector<int> onlineCpus()
+{
+    vector<int> cpus;
+    FILE *fp = fopen("/sys/devices/system/cpu/online", "r");
+    char buf[4096];
+
+    if (fp != NULL)
+    {
+        if (fgets(buf, sizeof(buf), fp) != NULL)
+            parseCpuList(buf, cpus);
+        fclose(fp);
+    }
+    if (cpus.empty())
+    {
+        const long n = sysconf(_SC_NPROCESSORS_ONLN);
+        for (long c = 0; c < n; c++)
+            cpus.push_back((int)c);
+    }
+    return cpus;
+}
+
+static string hex(uint64_t v)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "\"0x%llx\"", (unsigned long long)v);
+    return buf;
+}
+
+static const char *jsonBool(uint32_t v)
+{
+    return v ? "true" : "false";
+}
+
+/**
+ * @brief Build capability object from leaves of the current CPU
+ */
+static string capsJson(cpuid::Cache &c)
+{
+    namespace f = cpuid::field;
+    ostringstream o;
+    uint32_t family = c.get(f::FAMILY), model = c.get(f::MODEL);
+
+    if (family == 0xf)
+        family += c.get(f::EXT_FAMILY);
+    if (family == 0x6 || family >= 0xf)
+        model |= c.get(f::EXT_MODEL) << 4;
+
+    const uint64_t ways = c.get(f::L3_WAYS) + 1ULL;
+    const uint64_t sets = c.get(f::L3_SETS) + 1ULL;
+    const uint64_t line = c.get(f::L3_LINE_SIZE) + 1ULL;
+    const uint64_t parts = c.get(f::L3_PARTITIONS) + 1ULL;
+
+    o << "{\"family\":" << family
+      << ",\"model\":" << model
+      << ",\"stepping\":" << c.get(f::STEPPING)
+      << ",\"l3\":{\"ways\":" << ways
+      << ",\"sets\":" << sets
+      << ",\"line_size\":" << line
+      << ",\"partitions\":" << parts
+      << ",\"size_bytes\":" << ways * sets * line * parts << "}"
+      << ",\"rdt_m\":" << jsonBool(c.get(f::RDT_M))
+      << ",\"rdt_a\":" << jsonBool(c.get(f::RDT_A));
+
+    o << ",\"cmt\":";
+    if (c.get(f::RDT_M))
+    {
+        o << "{\"max_rmid\":" << c.get(f::CMT_MAX_RMID) << ",\"l3\":";
+        if (c.get(f::CMT_L3))
+            o << "{\"max_rmid\":" << c.get(f::L3MON_MAX_RMID)
+              << ",\"scale_factor\":" << c.get(f::L3MON_SCALE)
+              << ",\"occupancy\":" << jsonBool(c.get(f::L3MON_OCCUP))
+              << ",\"mbm_total\":" << jsonBool(c.get(f::L3MON_TOTAL_BW))
+              << ",\"mbm_local\":" << jsonBool(c.get(f::L3MON_LOCAL_BW)) << "}";
+        else
+            o << "null";
+        o << "}";
+    }
+    else
+        o << "null";
+
+    const bool rdtA = c.get(f::RDT_A) != 0;
+
+    o << ",\"l3ca\":";
+    if (rdtA && c.get(f::RDTA_L3CA))
+        o << "{\"num_cos\":" << c.get(f::L3CA_MAX_COS) + 1
+          << ",\"cbm_len\":" << c.get(f::L3CA_CBM_LEN) + 1
+          << ",\"shareable_mask\":" << hex(c.get(f::L3CA_SHAREABLE))
+          << ",\"cdp\":" << jsonBool(c.get(f::L3CA_CDP)) << "}";
+    else
+        o << "null";
+
+    o << ",\"l2ca\":";
+    if (rdtA && c.get(f::RDTA_L2CA))
+        o << "{\"num_cos\":" << c.get(f::L2CA_MAX_COS) + 1
+          << ",\"cbm_len\":" << c.get(f::L2CA_CBM_LEN) + 1
+          << ",\"shareable_mask\":" << hex(c.get(f::L2CA_SHAREABLE))
+          << ",\"cdp\":" << jsonBool(c.get(f::L2CA_CDP)) << "}";
+    else
+        o << "null";
+
+    o << ",\"mba\":";
+    if (rdtA && c.get(f::RDTA_MBA))
+        o << "{\"num_cos\":" << c.get(f::MBA_MAX_COS) + 1
+          << ",\"max_throttle\":" << c.get(f::MBA_MAX_THRTL) + 1
+          << ",\"linear\":" << jsonBool(c.get(f::MBA_LINEAR)) << "}";
+    else
+        o << "null";
+
+    o << "}";
+    return o.str();
+}
+
+struct Job
+{
+    Probe *probe;
+    bool readMsr;
+};
+
+/**
+ * @brief Probe thread body, runs pinned to job->probe->cpu
+ */
+static void *probeCpu(void *arg)
+{
+    Job *job = (Job *)arg;
+    Probe &p = *job->probe;
+    cpuid::Cache c;
+
+    p.ranOn = sched_getcpu();
+    p.pinned = p.ranOn == p.cpu;
+    if (!p.pinned)
+    {
+        p.error = "probe did not run on the CPU";
+        return NULL;
+    }
+    p.apicId = c.has(cpuid::field::X2APIC_ID) ? c.get(cpuid::field::X2APIC_ID)
+                                                : c.get(cpuid::field::APIC_ID);
+    p.caps = capsJson(c);
+
+    if (!job->readMsr || (!c.get(cpuid::field::RDT_M) && !c.get(cpuid::field::RDT_A)))
+        return NULL;
+
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/cpu/%d/msr", p.cpu);
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        p.msrError = strerror(errno);
+        return NULL;
+    }
+    if (pread(fd, &p.assoc, sizeof(p.assoc), MSR_PQR_ASSOC) == (ssize_t)sizeof(p.assoc))
+        p.haveAssoc = true;
+    else
+        p.msrError = strerror(errno);
+    close(fd);
+    return NULL;
+}
+
+/**
+ * @brief Probe all CPUs of \a opt in parallel
+ */
+static vector<Probe> probeAll(const Options &opt)
+{
+    const size_t n = opt.cpus.size();
+    vector<Probe> probes(n);
+    vector<Job> jobs(n);
+    vector<pthread_t> threads(n);
+    vector<bool> started(n, false);
+
+    for (size_t i = 0; i < n; i++)
+    {
+        pthread_attr_t attr;
+        cpu_set_t set;
+
+        probes[i].cpu = opt.cpus[i];
+        probes[i].pinned = false;
+        probes[i].ranOn = -1;
+        probes[i].apicId = 0;
+        probes[i].haveAssoc = false;
+        probes[i].assoc = 0;
+        jobs[i].probe = &probes[i];
+        jobs[i].readMsr = opt.readMsr;
+
+        CPU_ZERO(&set);
+        CPU_SET(opt.cpus[i], &set);
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, 256 * 1024);
+        // a CPU that is offline or outside our cpuset can't be probed,
+        // running unpinned would report another CPU's caps as its own
+        int rc = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        if (rc == 0)
+            rc = pthread_create(&threads[i], &attr, probeCpu, &jobs[i]);
+        if (rc == 0)
+            started[i] = true;
+        else
+            probes[i].error = string("thread not started on the CPU: ") + strerror(rc);
+        pthread_attr_destroy(&attr);
+    }
+
+    for (size_t i = 0; i < n; i++)
+        if (started[i])
+            pthread_join(threads[i], NULL);
+    return probes;
+}
+
+/**
+ * @brief Format sorted CPU ids as 0-3,8
+ */
+static string cpuList(const vector<int> &cpus)
+{
+    ostringstream o;
+    for (size_t i = 0; i < cpus.size();)
+    {
+        size_t j = i;
+        while (j + 1 < cpus.size() && cpus[j + 1] == cpus[j] + 1)
+            j++;
+        if (i > 0)
+            o << ",";
+        o << cpus[i];
+        if (j > i)
+            o << "-" << cpus[j];
+        i = j + 1;
+    }
+    return o.str();
+}
+
+static string jsonString(const string &s)
+{
+    string out = "\"";
+    for (size_t i = 0; i < s.size(); i++)
+    {
+        const unsigned char ch = s[i];
+        if (ch == '"' || ch == '\\')
+            out += '\\', out += ch;
+        else if (ch < 0x20)
+        {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", ch);
+            out += buf;
+        }
+        else
+            out += ch;
+    }
+    return out + "\"";
+}
+
+int main(int argc, char *argv[])
+{
+    Options opt;
+    int c;
+
+    while ((c = getopt(argc, argv, "c:Mh")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            if (!parseCpuList(optarg, opt.cpus))
+            {
+                cerr << "Invalid CPU list " << optarg << endl;
+                return 1;
+            }
+            break;
+        case 'M':
+            opt.readMsr = false;
+            break;
+        case 'h':
+            usage(argv[0]);
+            return 0;
+        default:
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (!cpuid::supported())
+    {
+        cerr << "CPUID Not Supported" << endl;
+        return 1;
+    }
+    if (opt.cpus.empty())
+        opt.cpus = onlineCpus();
+
+    const chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    const vector<Probe> probes = probeAll(opt);
+    const double elapsedUs =
+        chrono::duration<double, micro>(chrono::steady_clock::now() - t0).count();
+
+    // group CPUs with identical capabilities, in order of first appearance,
+    // CPUs that could not be probed are left out
+    vector<string> groups;
+    vector<vector<int> > groupCpus;
+    map<string, size_t> groupId;
+    vector<size_t> cpuGroup(probes.size());
+    size_t numErrors = 0;
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        if (!probes[i].error.empty())
+        {
+            numErrors++;
+            continue;
+        }
+        map<string, size_t>::iterator it = groupId.find(probes[i].caps);
+        if (it == groupId.end())
+        {
+            it = groupId.insert(make_pair(probes[i].caps, groups.size())).first;
+            groups.push_back(probes[i].caps);
+            groupCpus.push_back(vector<int>());
+        }
+        cpuGroup[i] = it->second;
+        groupCpus[it->second].push_back(probes[i].cpu);
+    }
+
+    char host[256] = "";
+    gethostname(host, sizeof(host) - 1);
+    cpuid::Cache &cache = cpuid::cache();
+
+    cout << "{\"host\":" << jsonString(host)
+         << ",\"vendor\":" << jsonString(cache.vendor())
+         << ",\"brand\":" << jsonString(cache.brand())
+         << ",\"num_cpus\":" << probes.size()
+         << ",\"num_errors\":" << numErrors
+         << ",\"elapsed_us\":" << (long long)(elapsedUs + 0.5)
+         << ",\"homogeneous\":" << jsonBool(groups.size() <= 1)
+         << ",\n\"capabilities\":[";
+    for (size_t g = 0; g < groups.size(); g++)
+        cout << (g ? ",\n" : "\n") << "{\"cpus\":\"" << cpuList(groupCpus[g])
+             << "\",\"caps\":" << groups[g] << "}";
+    cout << "],\n\"cpus\":[";
+    for (size_t i = 0; i < probes.size(); i++)
+    {
+        const Probe &p = probes[i];
+        cout << (i ? ",\n" : "\n") << "{\"cpu\":" << p.cpu
+             << ",\"pinned\":" << jsonBool(p.pinned);
+        if (!p.error.empty())
+        {
+            cout << ",\"ran_on\":";
+            if (p.ranOn >= 0)
+                cout << p.ranOn;
+            else
+                cout << "null";
+            cout << ",\"apic_id\":null,\"caps\":null,\"rmid\":null,\"cos\":null"
+                 << ",\"error\":" << jsonString(p.error) << "}";
+            continue;
+        }
+        cout << ",\"ran_on\":" << p.ranOn
+             << ",\"apic_id\":" << p.apicId
+             << ",\"caps\":" << cpuGroup[i];
+        if (p.haveAssoc)
+            cout << ",\"rmid\":" << (p.assoc & PQR_ASSOC_RMID_MASK)
+                 << ",\"cos\":" << (p.assoc >> PQR_ASSOC_COS_SHIFT);
+        else
+            cout << ",\"rmid\":null,\"cos\":null";
+        if (!p.msrError.empty())
+            cout << ",\"msr_error\":" << jsonString(p.msrError);
+        cout << "}";
+    }
+    cout << "]}" << endl;
+    return 0;
+}